@@ -20,6 +20,8 @@
 #include <jni.h>
 #include <errno.h>
 
+#include <string>
+
 #include <android/sensor.h>
 #include <android/log.h>
 #include <android_native_app_glue.h>
@@ -29,6 +31,7 @@
 #include "TeapotRenderer.h"
 #include "NDKHelper.h"
 #include "LeiaJNIDisplayParameters.h"
+#include "glCapture.h"
 
 //-------------------------------------------------------------------------
 // Preprocessor
@@ -36,6 +39,18 @@
 #define HELPER_CLASS_NAME \
   "com/sample/helper/NDKHelper"  // Class name of helper function
 
+#ifdef RENDER_PATH_AB
+// Frames rendered by each path before switching between the per view loop and
+// single pass multiview, so both timings end up in the log
+const int32_t MULTIVIEW_TOGGLE_FRAMES = 600;
+#endif
+
+#ifdef GL3STUB_CAPTURE
+// Frames from the first window written to the internal data directory,
+// adb pull it and run host/gl-replay on it
+const int32_t GL_CAPTURE_FRAMES = 300;
+#endif
+
 //-------------------------------------------------------------------------
 // Shared state for our app.
 //-------------------------------------------------------------------------
@@ -60,6 +75,7 @@ class Engine {
   ASensorManager* sensor_manager_;
   const ASensor* accelerometer_sensor_;
   ASensorEventQueue* sensor_event_queue_;
+  bool render_with_multiview_ext_;
 
   void UpdateFPS(float fFPS);
   void ShowUI();
@@ -99,7 +115,8 @@ Engine::Engine()
       app_(NULL),
       sensor_manager_(NULL),
       accelerometer_sensor_(NULL),
-      sensor_event_queue_(NULL) {
+      sensor_event_queue_(NULL),
+      render_with_multiview_ext_(true) {
   gl_context_ = ndk_helper::GLContext::GetInstance();
 }
 
@@ -127,6 +144,11 @@ void Engine::UnloadResources() { renderer_.Unload(); }
 int Engine::InitDisplay(android_app* app) {
   if (!initialized_resources_) {
     gl_context_->Init(app_->window);
+#ifdef GL3STUB_CAPTURE
+    std::string trace = app_->activity->internalDataPath;
+    trace += "/classic-teapot.gltrace";
+    leia_helper::StartGlCapture(trace.c_str(), GL_CAPTURE_FRAMES);
+#endif
     LoadResources();
     initialized_resources_ = true;
   } else if(app->window != gl_context_->GetANativeWindow()) {
@@ -177,7 +199,16 @@ void Engine::DrawFrame() {
     UpdateFPS(fps);
   }
 
-  renderer_.Update(monitor_.GetCurrentTime());
+#ifdef RENDER_PATH_AB
+  static int32_t frame_count = 0;
+  if (++frame_count > MULTIVIEW_TOGGLE_FRAMES) {
+    frame_count = 0;
+    render_with_multiview_ext_ = !render_with_multiview_ext_;
+  }
+#endif
+
+  // Multiview whenever the renderer supports it on this device
+  renderer_.Update(monitor_.GetCurrentTime(), render_with_multiview_ext_);
 
   // Just fill the screen with a color.
   glClearColor(0.5f, 0.5f, 0.5f, 1.f);
@@ -189,6 +220,7 @@ void Engine::DrawFrame() {
     UnloadResources();
     LoadResources();
   }
+  leia_helper::EndGlCaptureFrame();
 }
 
 /**
@@ -28,6 +28,8 @@
 //--------------------------------------------------------------------------------
 #include "teapot.inl"
 #include <cstdlib>
+#include <stdio.h>
+#include <string.h>
 
 #include "LeiaCameraViews.h"
 #include "LeiaNativeSDK.h"
@@ -40,6 +42,24 @@ LeiaCameraData data;
 
 GLint leia_vbo;
 
+// Number of frames averaged before RenderViews() timings are logged
+const int32_t RENDER_VIEWS_LOG_FRAMES = 120;
+
+// Panel layout for the indexed interlacing of the multiview path, the
+// alignment offset comes from LeiaJNIDisplayParameters
+const int32_t VIEW_SLANT_NUMERATOR = 0;
+const int32_t VIEW_SLANT_DENOMINATOR = 1;
+const bool VIEW_SUBPIXEL_INTERLACING = false;
+
+// Render every view, or only the view synthesis sources and synthesize the
+// others, see cpuViewSynthesis.h
+const leia_helper::VIEW_SYNTHESIS_MODE VIEW_SYNTHESIS = leia_helper::VIEW_SYNTHESIS_OFF;
+
+// Formats and discards of the view targets, see attachmentPolicy.h. Every path
+// runs depth of field on scene depth, so depth stays a sampled texture
+const leia_helper::ATTACHMENT_POLICY VIEW_ATTACHMENTS = {
+        GL_RGBA8, GL_DEPTH_COMPONENT32F, true, true};
+
 //--------------------------------------------------------------------------------
 // Ctor
 //--------------------------------------------------------------------------------
@@ -52,10 +72,41 @@ TeapotRenderer::~TeapotRenderer() { Unload(); }
 
 void TeapotRenderer::Init() {
     using_simple_leia_rendering_api = false;
+
+    // Single pass multiview is used when the driver exposes GL_OVR_multiview2,
+    // the per view loop stays as the fallback
+    render_with_multiview_ext_ = false;
+    multiview_shader_param_.program_ = 0;
+    texture_multiview_shader.program_ = 0;
+    multiview_dof_program_ = 0;
+    multiview_interlace_program_ = 0;
+    multiview_interlace_sharpen_program_ = 0;
+    multiview_interlace_dof_program_ = 0;
+    using_fused_interlace_sharpening_ = true;
+    using_folded_dof_ = false;
+    atlas_dof_program_ = 0;
+    atlas_interlace_program_ = 0;
+    atlas_interlace_sharpen_program_ = 0;
+    atlas_interlace_dof_program_ = 0;
+    using_view_atlas_ = true;
+    view_synthesis_program_ = 0;
+    view_synthesis_mode_ = VIEW_SYNTHESIS;
+    for (int32_t i = 0; i < RENDER_PATH_COUNT; ++i) {
+        render_views_time_[i] = 0.0;
+        render_views_frames_[i] = 0;
+    }
+    const int32_t num_views = CAMERAS_WIDE * CAMERAS_HIGH;
+    leia_helper::InitMultiview(num_views);
+
     // Settings
     glFrontFace(GL_CCW);
 
-    // Load shader
+    // Binaries of the programs linked by the last run on this driver
+    leia_helper::ProgramCache::GetInstance()->Init(
+            ndk_helper::JNIHelper::GetInstance()->GetExternalFilesDir() +
+            "/program_cache");
+
+    // Load shader, the 2D path draws with these two
     LoadShaders(&shader_param_, "Shaders/VS_ShaderPlain.vsh",
                 "Shaders/ShaderPlain.fsh");
     LoadShaders(&texture_shader, "Shaders/VS_texture.vsh",
@@ -92,21 +143,82 @@ void TeapotRenderer::Init() {
     delete[] p;
 
     UpdateViewport();
-    mat_model_ = ndk_helper::Mat4::Translation(0, 0, -15.f);
-
-    ndk_helper::Mat4 mat = ndk_helper::Mat4::RotationX(M_PI / 3);
-    mat_model_ = mat * mat_model_;
+    mat_model_ = ndk_helper::Affine::RotationX(M_PI / 3) *
+                 ndk_helper::Affine::Translation(0, 0, -15.f);
+    model_views_.Resize(sNUM_OBJECTS);
+    transform_isa_ = leia_helper::GetBestCpuIsa();
 
+    // The 3D programs build in the background, RenderViews() shows the 2D
+    // path until they are ready
     unsigned int len = 0;
-    dof_shader.program_ = leiaCreateProgram(leiaGetShader(LEIA_VERTEX_DOF, &len),
-                                            leiaGetShader(LEIA_FRAGMENT_DOF, &len));
-    view_interlacing_shader.program_ = leiaCreateProgram(
+    program_builder_.AddProgram(
+            &dof_shader.program_, "leia", leiaGetShader(LEIA_VERTEX_DOF, &len),
+            leiaGetShader(LEIA_FRAGMENT_DOF, &len), leiaCreateProgram);
+    program_builder_.AddProgram(
+            &view_interlacing_shader.program_, "leia",
             leiaGetShader(LEIA_VERTEX_VIEW_INTERLACE, &len),
-            leiaGetShader(LEIA_FRAGMENT_VIEW_INTERLACE, &len));
-    view_sharpening_shader.program_ = leiaCreateProgram(
+            leiaGetShader(LEIA_FRAGMENT_VIEW_INTERLACE, &len), leiaCreateProgram);
+    program_builder_.AddProgram(
+            &view_sharpening_shader.program_, "leia",
             leiaGetShader(LEIA_VERTEX_VIEW_SHARPENING, &len),
-            leiaGetShader(LEIA_FRAGMENT_VIEW_SHARPENING, &len));
+            leiaGetShader(LEIA_FRAGMENT_VIEW_SHARPENING, &len), leiaCreateProgram);
+
+    if (leia_helper::IsMultiviewSupported()) {
+        char str_num_views[16];
+        snprintf(str_num_views, sizeof(str_num_views), "%d", num_views);
+        std::map<std::string, std::string> defines;
+        defines["%NUM_VIEWS%"] = str_num_views;
+        AddShaders(&multiview_shader_param_, "Shaders/VS_multiview.vsh",
+                   "Shaders/ShaderPlain.fsh", &defines);
+        AddShaders(&texture_multiview_shader, "Shaders/VS_texture_multiview.vsh",
+                   "Shaders/texture.fsh", &defines);
+        leia_helper::AddPostProgram(&program_builder_, &multiview_dof_program_,
+                                    leia_helper::POST_SHADER_MULTIVIEW_DOF, num_views);
+        leia_helper::AddPostProgram(&program_builder_, &multiview_interlace_program_,
+                                    leia_helper::POST_SHADER_VIEW_INTERLACE_INDEXED,
+                                    num_views);
+        leia_helper::AddPostProgram(&program_builder_,
+                                    &multiview_interlace_sharpen_program_,
+                                    leia_helper::POST_SHADER_VIEW_INTERLACE_SHARPEN_INDEXED,
+                                    num_views);
+        leia_helper::AddPostProgram(&program_builder_, &multiview_interlace_dof_program_,
+                                    leia_helper::POST_SHADER_VIEW_INTERLACE_DOF_INDEXED,
+                                    num_views);
+    }
+
+    leia_helper::AddPostProgram(&program_builder_, &atlas_dof_program_,
+                                leia_helper::POST_SHADER_ATLAS_DOF, num_views);
+    leia_helper::AddPostProgram(&program_builder_, &atlas_interlace_program_,
+                                leia_helper::POST_SHADER_VIEW_INTERLACE_INDEXED_ATLAS,
+                                num_views);
+    leia_helper::AddPostProgram(&program_builder_, &atlas_interlace_sharpen_program_,
+                                leia_helper::POST_SHADER_VIEW_INTERLACE_SHARPEN_INDEXED_ATLAS,
+                                num_views);
+    leia_helper::AddPostProgram(&program_builder_, &atlas_interlace_dof_program_,
+                                leia_helper::POST_SHADER_VIEW_INTERLACE_DOF_INDEXED_ATLAS,
+                                num_views);
+    leia_helper::AddPostProgram(&program_builder_, &view_synthesis_program_,
+                                leia_helper::POST_SHADER_VIEW_SYNTHESIS_ATLAS, num_views);
+    programs_ready_ = false;
+    program_builder_.Start();
+}
+
+//--------------------------------------------------------------------------------
+// OnProgramsReady
+//--------------------------------------------------------------------------------
+void TeapotRenderer::OnProgramsReady() {
     leia_vbo = leiaBuildQuadVertexBuffer(view_sharpening_shader.program_);
+    if (multiview_shader_param_.program_) GetUniformLocations(&multiview_shader_param_);
+    if (texture_multiview_shader.program_) GetUniformLocations(&texture_multiview_shader);
+
+    leia_helper::PROGRAM_CACHE_STATS cache_stats =
+            leia_helper::ProgramCache::GetInstance()->GetStats();
+    LOGI("%d programs ready after %.1f ms (%s, %.1f ms on the render thread), "
+         "%d loaded, %d compiled, %d rejected binaries",
+         program_builder_.GetNumPrograms(), program_builder_.GetBuildTime(),
+         leia_helper::GetProgramBuildModeName(program_builder_.GetMode()),
+         program_builder_.GetBlockedTime(), cache_stats.hits,
+         cache_stats.misses + cache_stats.rejects, cache_stats.rejects);
 }
 
 void TeapotRenderer::UpdateViewport() {
@@ -138,12 +250,70 @@ void TeapotRenderer::UpdateViewport() {
         LOGE("leiaCalculateViews did not work. The camera data is invalid.");
     }
 
+    // The previous targets go back to the pool, those of the same size and
+    // format are handed out again below and the rest is trimmed
+    ReleaseSurfaces();
+    attachment_policy_ = leia_helper::ResolveAttachmentPolicy(VIEW_ATTACHMENTS);
     PrepareFullscreenSurface();
     PrepareRenderTargetSurfaces();
     PrepareCheckerboard();
+    multiview_target_.Init(view_width_pixels_, view_height_pixels_,
+                           CAMERAS_WIDE * CAMERAS_HIGH);
+    if (view_atlas_.Init(view_width_pixels_, view_height_pixels_,
+                         CAMERAS_WIDE * CAMERAS_HIGH, attachment_policy_)) {
+        leia_helper::RENDER_TARGET_STATS separate =
+                leia_helper::EstimateSeparateTargetStats(view_width_pixels_,
+                                                         view_height_pixels_,
+                                                         CAMERAS_WIDE * CAMERAS_HIGH,
+                                                         attachment_policy_);
+        leia_helper::RENDER_TARGET_STATS atlas = view_atlas_.EstimateStats();
+        LOGI("View atlas %dx%d per frame: FBO binds %d -> %d, clears %d -> %d, "
+             "resolve %.2f -> %.2f MB",
+             view_atlas_.GetWidth(), view_atlas_.GetHeight(),
+             separate.framebuffer_binds, atlas.framebuffer_binds,
+             separate.clears, atlas.clears,
+             separate.resolve_bytes / (1024.0 * 1024.0),
+             atlas.resolve_bytes / (1024.0 * 1024.0));
+    }
+    view_synthesis_target_.Init(view_width_pixels_, view_height_pixels_);
+    leia_helper::RenderTargetPool *pool = leia_helper::RenderTargetPool::GetInstance();
+    pool->Trim();
+    leia_helper::RENDER_TARGET_POOL_STATS pool_stats = pool->GetStats();
+    LOGI("Render targets %.2f MB (peak %.2f MB) in %d textures, %d allocated, %d reused",
+         pool_stats.current_bytes / (1024.0 * 1024.0),
+         pool_stats.peak_bytes / (1024.0 * 1024.0), pool_stats.num_textures,
+         pool_stats.allocations, pool_stats.reuses);
+    leia_helper::ATTACHMENT_BANDWIDTH bandwidth = leia_helper::EstimateAttachmentBandwidth(
+            attachment_policy_, view_width_pixels_, view_height_pixels_,
+            CAMERAS_WIDE * CAMERAS_HIGH, screen_width_pixels_, screen_height_pixels_);
+    LOGI("Attachments %s + %s%s%s: %.2f MB written, %.2f MB read per frame "
+         "(scene %.2f, dof %.2f/%.2f, interlace %.2f/%.2f, sharpen %.2f/%.2f, "
+         "loads %.2f MB)",
+         leia_helper::GetFormatName(attachment_policy_.color_format),
+         leia_helper::GetFormatName(attachment_policy_.depth_format),
+         attachment_policy_.depth_sampled ? "" : " transient",
+         attachment_policy_.discard ? ", discard" : "",
+         bandwidth.total_written / (1024.0 * 1024.0),
+         bandwidth.total_read / (1024.0 * 1024.0),
+         bandwidth.scene_written / (1024.0 * 1024.0),
+         bandwidth.dof_written / (1024.0 * 1024.0), bandwidth.dof_read / (1024.0 * 1024.0),
+         bandwidth.interlace_written / (1024.0 * 1024.0),
+         bandwidth.interlace_read / (1024.0 * 1024.0),
+         bandwidth.sharpen_written / (1024.0 * 1024.0),
+         bandwidth.sharpen_read / (1024.0 * 1024.0),
+         bandwidth.loads / (1024.0 * 1024.0));
+    LOGI("Folded depth of field blurs %d screen pixels per frame instead of %d "
+         "view pixels%s", screen_width_pixels_ * screen_height_pixels_,
+         view_width_pixels_ * view_height_pixels_ * CAMERAS_WIDE * CAMERAS_HIGH,
+         VIEW_SUBPIXEL_INTERLACING ? ", up to 3 views each" : "");
 }
 
 void TeapotRenderer::Unload() {
+    // Programs still building are deleted, finished ones below
+    program_builder_.Cancel();
+    programs_ready_ = false;
+    leia_helper::LeiaRenderContext *context = leia_helper::LeiaRenderContext::GetInstance();
+
     if (vbo_) {
         glDeleteBuffers(1, &vbo_);
         vbo_ = 0;
@@ -154,96 +324,125 @@ void TeapotRenderer::Unload() {
         ibo_ = 0;
     }
 
-    if (shader_param_.program_) {
-        glDeleteProgram(shader_param_.program_);
-        shader_param_.program_ = 0;
-    }
-
-    if (fullscreen_fbo) {
-        glDeleteFramebuffers(1, &fullscreen_fbo);
-        fullscreen_fbo = 0;
-    }
-
-    if (fullscreen_texture) {
-        glDeleteFramebuffers(1, &fullscreen_texture);
-        fullscreen_texture = 0;
-    }
-
-    if (fbos[0]) {
-        glDeleteFramebuffers(RT_COUNT, fbos);
-        glDeleteTextures(RT_COUNT, render_textures);
-        glDeleteTextures(RT_COUNT, depth_textures);
-        for (int i = 0; i < RT_COUNT; ++i) {
-            fbos[i] = 0;
-            render_textures[i] = 0;
-            depth_textures[i] = 0;
-        }
-    }
-    if (fbo_dof[RT_COUNT - 1]) {
-        glDeleteTextures(RT_COUNT, fbo_dof);
-        glDeleteTextures(RT_COUNT, texture_dof);
-        for (int i = 0; i < RT_COUNT; ++i) {
-            fbo_dof[i] = 0;
-            texture_dof[i] = 0;
-        }
-    }
-
-    if (checkerboard_texture) {
-        glDeleteTextures(1, &checkerboard_texture);
-        checkerboard_texture = 0;
-    }
-
-    if (dof_shader.program_) {
-        glDeleteProgram(dof_shader.program_);
-        dof_shader.program_ = 0;
-    }
-    if (view_interlacing_shader.program_) {
-        glDeleteProgram(view_interlacing_shader.program_);
-        view_interlacing_shader.program_ = 0;
-    }
-    if (view_sharpening_shader.program_) {
-        glDeleteProgram(view_sharpening_shader.program_);
-        view_sharpening_shader.program_ = 0;
-    }
-    if (texture_shader.program_) {
-        glDeleteProgram(texture_shader.program_);
-        texture_shader.program_ = 0;
-    }
+    context->DeleteProgram(&shader_param_.program_);
+    camera_buffer_.Unload();
+    model_views_.Unload();
+    view_mvps_.Unload();
+
+    ReleaseSurfaces();
+
+    context->DeleteProgram(&dof_shader.program_);
+    context->DeleteProgram(&view_interlacing_shader.program_);
+    context->DeleteProgram(&view_sharpening_shader.program_);
+    context->DeleteProgram(&texture_shader.program_);
+
+    multiview_target_.Unload();
+    view_index_map_.Unload();
+    view_atlas_.Unload();
+    view_synthesis_target_.Unload();
+    // Everything acquired from the pool has been released above
+    leia_helper::RenderTargetPool::GetInstance()->Unload();
+    context->DeleteProgram(&view_synthesis_program_);
+    context->DeleteProgram(&atlas_dof_program_);
+    context->DeleteProgram(&atlas_interlace_program_);
+    context->DeleteProgram(&atlas_interlace_sharpen_program_);
+    context->DeleteProgram(&atlas_interlace_dof_program_);
+    context->DeleteProgram(&multiview_shader_param_.program_);
+    context->DeleteProgram(&texture_multiview_shader.program_);
+    context->DeleteProgram(&multiview_dof_program_);
+    context->DeleteProgram(&multiview_interlace_program_);
+    context->DeleteProgram(&multiview_interlace_sharpen_program_);
+    context->DeleteProgram(&multiview_interlace_dof_program_);
+    context->Unload();
 }
 
-void TeapotRenderer::Update(float fTime) {
+void TeapotRenderer::Update(float fTime, bool render_with_multiview_ext) {
     const float CAM_X = 0.f;
     const float CAM_Y = 0.f;
     const float CAM_Z = 100.0f;
-    ndk_helper::Mat4 mat_trans[3];
-    ndk_helper::Mat4 mat_scale[3];
-
-    mat_trans[0] = ndk_helper::Mat4::Translation(0, 0, 0);
-    mat_trans[1] = ndk_helper::Mat4::Translation(-30.0, 45.0, -100.0);
-    mat_trans[2] = ndk_helper::Mat4::Translation(50.0, -100.0, -300.0);
-
-    mat_scale[0] = ndk_helper::Mat4::Identity();
-    mat_scale[1] = ndk_helper::Mat4::Identity();
-    mat_scale[2] = ndk_helper::Mat4::Identity();
-    for (int i = 0; i < 3; ++i) {
-        mat_view_[i] = ndk_helper::Mat4::LookAt(ndk_helper::Vec3(CAM_X, CAM_Y, CAM_Z),
-                                                ndk_helper::Vec3(0.f, 0.f, 0.f),
-                                                ndk_helper::Vec3(0.f, 1.f, 0.f));
-
-        if (camera_) {
-            camera_->Update();
-            ndk_helper::Mat4 world =
-                    mat_trans[i] * camera_->GetRotationMatrix() * mat_scale[i] * mat_model_;
-            mat_view_[i] = camera_->GetTransformMatrix() * mat_view_[i] * world;
-        } else {
-            mat_view_[i] = mat_view_[i] * mat_trans[i] * mat_scale[i] * mat_model_;
-        }
+    const ndk_helper::Affine mat_trans[sNUM_OBJECTS] = {
+            ndk_helper::Affine::Translation(0, 0, 0),
+            ndk_helper::Affine::Translation(-30.0, 45.0, -100.0),
+            ndk_helper::Affine::Translation(50.0, -100.0, -300.0)};
+    ndk_helper::Affine view = ndk_helper::Affine::LookAt(ndk_helper::Vec3(CAM_X, CAM_Y, CAM_Z),
+                                                         ndk_helper::Vec3(0.f, 0.f, 0.f),
+                                                         ndk_helper::Vec3(0.f, 1.f, 0.f));
+
+    // camera transform * view * trans * rotation * model, in 3x4 products. The
+    // teapots share everything but trans.
+    ndk_helper::Affine model = mat_model_;
+    if (camera_) {
+        // One step per teapot as before, the momentum decays at the same rate
+        for (unsigned int i = 0; i < sNUM_OBJECTS; ++i) camera_->Update();
+        view = camera_->GetTransformMatrix() * view;
+        model = camera_->GetRotationMatrix() * model;
     }
+    for (unsigned int i = 0; i < sNUM_OBJECTS; ++i) {
+        ndk_helper::Mat4 model_view = (view * mat_trans[i] * model).ToMat4();
+        memcpy(model_views_.Get(i), model_view.Ptr(), 16 * sizeof(GLfloat));
+    }
+
+    render_with_multiview_ext_ = render_with_multiview_ext &&
+                                 multiview_target_.GetColorTexture() &&
+                                 multiview_shader_param_.program_ &&
+                                 texture_multiview_shader.program_ &&
+                                 multiview_dof_program_ &&
+                                 multiview_interlace_program_ &&
+                                 multiview_interlace_sharpen_program_ &&
+                                 multiview_interlace_dof_program_;
 
 }
 
 void TeapotRenderer::RenderViews(bool is_backlight_still_on) {
-    if (is_backlight_still_on) {
+    if (!programs_ready_ && program_builder_.Poll()) {
+        programs_ready_ = true;
+        OnProgramsReady();
+    }
+    // 2D until the 3D programs are built
+    is_backlight_still_on = is_backlight_still_on && programs_ready_;
+    // Nothing is known of the binds made since the last frame
+    leia_helper::LeiaRenderContext *context = leia_helper::LeiaRenderContext::GetInstance();
+    context->Invalidate();
+    UpdateCameraBlock();
+
+#ifdef RENDER_PATH_AB
+    // Alternate the fused and the two pass post processing, the view atlas and
+    // the per view framebuffers, and the separate and folded depth of field,
+    // for comparison
+    static int toggle_count = 0;
+    if (++toggle_count > RENDER_VIEWS_LOG_FRAMES) {
+        toggle_count = 0;
+        using_fused_interlace_sharpening_ = !using_fused_interlace_sharpening_;
+        if (using_fused_interlace_sharpening_) {
+            using_view_atlas_ = !using_view_atlas_;
+            if (using_view_atlas_) {
+                using_folded_dof_ = !using_folded_dof_;
+            }
+        }
+    }
+#endif
+    bool render_with_view_atlas = using_view_atlas_ &&
+                                  view_atlas_.GetColorTexture() &&
+                                  atlas_dof_program_ && atlas_interlace_program_ &&
+                                  atlas_interlace_sharpen_program_ &&
+                                  atlas_interlace_dof_program_;
+
+    if (is_backlight_still_on && render_with_multiview_ext_) {
+        double start = ndk_helper::PerfMonitor::GetCurrentTime();
+        RenderViewsMultiview();
+        LogRenderViewsTime(using_folded_dof_ ? RENDER_PATH_MULTIVIEW_FOLDED_DOF :
+                           using_fused_interlace_sharpening_ ?
+                           RENDER_PATH_MULTIVIEW_FUSED : RENDER_PATH_MULTIVIEW,
+                           ndk_helper::PerfMonitor::GetCurrentTime() - start);
+    } else if (is_backlight_still_on && render_with_view_atlas) {
+        double start = ndk_helper::PerfMonitor::GetCurrentTime();
+        RenderViewsAtlas();
+        LogRenderViewsTime(using_folded_dof_ ? RENDER_PATH_ATLAS_FOLDED_DOF :
+                           using_fused_interlace_sharpening_ ?
+                           RENDER_PATH_ATLAS_FUSED : RENDER_PATH_ATLAS,
+                           ndk_helper::PerfMonitor::GetCurrentTime() - start);
+    } else if (is_backlight_still_on) {
+        double start = ndk_helper::PerfMonitor::GetCurrentTime();
 
         static int count = 0;
         ++count;
@@ -267,14 +466,20 @@ void TeapotRenderer::RenderViews(bool is_backlight_still_on) {
 
         float debug = 0.0f;
         glViewport(0, 0, view_width_pixels_, view_height_pixels_);
+        UpdateViewMVPs(cameras[0][0].matrix, sizeof(LeiaCameraView) / sizeof(GLfloat),
+                       CAMERAS_WIDE * CAMERAS_HIGH);
         for (unsigned int y = 0; y < CAMERAS_HIGH; ++y) {
             for (unsigned int x = 0; x < CAMERAS_WIDE; ++x) {
                 unsigned int index = y * CAMERAS_WIDE + x;
-                glBindFramebuffer(GL_FRAMEBUFFER, fbos[index]);
+                context->BindFramebuffer(fbos[index]);
                 glClearColor(1.0, 0.0, 1.0, 1.0);
                 glEnable(GL_DEPTH_TEST);
                 glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-                RenderView(x, y, is_backlight_still_on);
+                RenderView(index);
+                leia_helper::DiscardTransientDepth(attachment_policy_);
+                // Depth of field overwrites the whole target
+                context->BindFramebuffer(fbo_dof[index]);
+                leia_helper::DiscardColor(attachment_policy_);
                 if (using_simple_leia_rendering_api) {
                     leiaDOF(render_textures[index], depth_textures[index],
                             &data, dof_shader.program_, fbo_dof[index], 1.0f);
@@ -283,9 +488,12 @@ void TeapotRenderer::RenderViews(bool is_backlight_still_on) {
                                    &data, dof_shader.program_, fbo_dof[index], 1.0f, debug);
                     leiaDrawQuad(dof_shader.program_, 0, vbo_id);
                 }
+                context->Invalidate();
             }
         }
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        context->BindFramebuffer(fullscreen_fbo);
+        leia_helper::DiscardColor(attachment_policy_);
+        context->BindFramebuffer(0);
         CHECK_GL_ERROR();
 
         if (using_simple_leia_rendering_api) {
@@ -307,33 +515,57 @@ void TeapotRenderer::RenderViews(bool is_backlight_still_on) {
             leiaDrawQuad(view_sharpening_shader.program_, 0, vbo_id);
             LOGE("complex");
         }
+        context->Invalidate();
+        LogRenderViewsTime(RENDER_PATH_PER_VIEW,
+                           ndk_helper::PerfMonitor::GetCurrentTime() - start);
     } else
     {
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        context->BindFramebuffer(0);
         glEnable(GL_DEPTH_TEST);
         glClearColor(0.4, 0.4, 0.4, 1.0);
         glClearDepthf(1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        RenderView(-1, -1, is_backlight_still_on);
+        UpdateViewMVPs(mat_projection_.Ptr(), 16, 1);
+        RenderView(0);
     }
 }
 
-void TeapotRenderer::RenderView(unsigned int x, unsigned int y, bool use_leia) {
+// Cameras only change with the viewport, an unchanged block is not uploaded again
+void TeapotRenderer::UpdateCameraBlock() {
+    const GLfloat light0[3] = {100.f, -200.f, -600.f};
+    TEAPOT_MATERIALS material = {
+            {1.0f, 0.5f, 0.5f},
+            {1.0f, 1.0f, 1.0f, 10.f},
+            {0.1f, 0.1f, 0.1f},};
+    camera_buffer_.SetCamera(&data);
+    camera_buffer_.SetViewProjections(cameras[0][0].matrix,
+                                      sizeof(LeiaCameraView) / sizeof(GLfloat),
+                                      CAMERAS_WIDE * CAMERAS_HIGH);
+    camera_buffer_.SetLight(light0, material.ambient_color, material.specular_color);
+    camera_buffer_.Upload();
+}
 
-    ndk_helper::Mat4 perspective;
-    perspective = mat_projection_;
-    if (use_leia) {
-        for (int i = 0; i < 16; ++i) {
-            perspective.Ptr()[i] = cameras[y][x].matrix[i];
-        }
+void TeapotRenderer::UpdateViewMVPs(const float *projections, int32_t projection_stride,
+                                    int32_t num_views) {
+    view_projections_.resize(num_views * 16);
+    for (int32_t i = 0; i < num_views; ++i) {
+        memcpy(&view_projections_[i * 16], projections + i * projection_stride,
+               16 * sizeof(GLfloat));
     }
+    // The three teapots for every view in one call, instead of a Mat4 product
+    // per teapot in each view
+    view_mvps_.Resize(num_views * sNUM_OBJECTS);
+    leia_helper::MultiplyViewMatrices(projections, projection_stride, num_views,
+                                      model_views_.Get(0), sNUM_OBJECTS,
+                                      view_mvps_.Get(0), transform_isa_, 0);
+}
 
-    ndk_helper::Mat4 mat_vp[3];
-    for (int i = 0; i < 3; ++i) {
-        mat_vp[i] = perspective * mat_view_[i];
-    }
+void TeapotRenderer::RenderView(int32_t view) {
+    const GLfloat *mvps = view_mvps_.Get(view * sNUM_OBJECTS);
 
-    glUseProgram(shader_param_.program_);
+    leia_helper::LeiaRenderContext::GetInstance()->UseProgram(shader_param_.program_);
+    // Light and specular material come from the camera block
+    leia_helper::UseCameraBlock(shader_param_.program_);
     // Bind the VBO
     glBindBuffer(GL_ARRAY_BUFFER, vbo_);
 
@@ -359,20 +591,10 @@ void TeapotRenderer::RenderView(unsigned int x, unsigned int y, bool use_leia) {
     glUniform4f(shader_param_.material_diffuse_, material.diffuse_color[0],
                 material.diffuse_color[1], material.diffuse_color[2], 1.f);
 
-    glUniform4f(shader_param_.material_specular_, material.specular_color[0],
-                material.specular_color[1], material.specular_color[2],
-                material.specular_color[3]);
-    //
-    // using glUniform3fv here was troublesome
-    //
-    glUniform3f(shader_param_.material_ambient_, material.ambient_color[0],
-                material.ambient_color[1], material.ambient_color[2]);
-
-    for (int i = 0; i < 3; ++i) {
-        glUniformMatrix4fv(shader_param_.matrix_projection_, 1, GL_FALSE,
-                           mat_vp[i].Ptr());
-        glUniformMatrix4fv(shader_param_.matrix_view_, 1, GL_FALSE, mat_view_[i].Ptr());
-        glUniform3f(shader_param_.light0_, 100.f, -200.f, -600.f);
+
+    for (unsigned int i = 0; i < sNUM_OBJECTS; ++i) {
+        glUniformMatrix4fv(shader_param_.matrix_projection_, 1, GL_FALSE, mvps + i * 16);
+        glUniformMatrix4fv(shader_param_.matrix_view_, 1, GL_FALSE, model_views_.Get(i));
 
         glDrawElements(GL_TRIANGLES, num_indices_, GL_UNSIGNED_SHORT,
                        BUFFER_OFFSET(0));
@@ -381,85 +603,292 @@ void TeapotRenderer::RenderView(unsigned int x, unsigned int y, bool use_leia) {
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 
-    ndk_helper::Mat4 persp_mat;
-    persp_mat = perspective;
-    DrawBillboard(persp_mat.Ptr());
+    DrawBillboard(texture_shader.program_, &view_projections_[view * 16], 1);
 }
 
-bool TeapotRenderer::LoadShaders(SHADER_PARAMS *params, const char *strVsh,
-                                 const char *strFsh) {
-    GLuint program;
-    GLuint vert_shader, frag_shader;
-
-    // Create shader program
-    program = glCreateProgram();
-    LOGI("Created Shader %d", program);
-
-    // Create and compile vertex shader
-    if (!ndk_helper::shader::CompileShader(&vert_shader, GL_VERTEX_SHADER,
-                                           strVsh)) {
-        LOGI("Failed to compile vertex shader");
-        glDeleteProgram(program);
-        return false;
+void TeapotRenderer::RenderViewsMultiview() {
+    // All views are rendered by one pass into the layers of the multiview target
+    multiview_target_.BindScene();
+    glClearColor(1.0, 0.0, 1.0, 1.0);
+    glEnable(GL_DEPTH_TEST);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    RenderViewMultiview();
+
+    UpdateViewIndexMap();
+    if (using_folded_dof_) {
+        // Depth of field only on the texels the interlacer shows, straight from
+        // the scene layers
+        leia_helper::ViewInterlaceDOFIndexed(multiview_target_.GetColorTexture(),
+                                             multiview_target_.GetDepthTexture(),
+                                             view_index_map_.GetTexture(), &data,
+                                             multiview_interlace_dof_program_,
+                                             fullscreen_fbo, screen_width_pixels_,
+                                             screen_height_pixels_, 1.0f);
+        SharpenFullscreen();
+        CHECK_GL_ERROR();
+        return;
     }
 
-    // Create and compile fragment shader
-    if (!ndk_helper::shader::CompileShader(&frag_shader, GL_FRAGMENT_SHADER,
-                                           strFsh)) {
-        LOGI("Failed to compile fragment shader");
-        glDeleteProgram(program);
-        return false;
+    // Depth of field on every layer at once
+    leia_helper::PrepareMultiviewDOF(multiview_target_.GetColorTexture(),
+                                     multiview_target_.GetDepthTexture(), &data,
+                                     multiview_dof_program_,
+                                     multiview_target_.GetDOFFramebuffer(), 1.0f);
+    leia_helper::DrawQuad();
+
+    if (using_fused_interlace_sharpening_) {
+        // Straight to the back buffer, fullscreen_fbo is skipped
+        leia_helper::ViewInterlaceAndSharpenIndexed(
+                multiview_target_.GetDOFTexture(), view_index_map_.GetTexture(),
+                multiview_interlace_sharpen_program_, 0, screen_width_pixels_,
+                screen_height_pixels_, LeiaJNIDisplayParameters::mViewSharpeningParams, 2);
+    } else {
+        leia_helper::ViewInterlaceIndexed(multiview_target_.GetDOFTexture(),
+                                          view_index_map_.GetTexture(),
+                                          multiview_interlace_program_, fullscreen_fbo,
+                                          screen_width_pixels_, screen_height_pixels_);
+        SharpenFullscreen();
     }
+    CHECK_GL_ERROR();
+}
 
-    // Attach vertex shader to program
-    glAttachShader(program, vert_shader);
+void TeapotRenderer::RenderViewMultiview() {
+    const int32_t num_views = CAMERAS_WIDE * CAMERAS_HIGH;
 
-    // Attach fragment shader to program
-    glAttachShader(program, frag_shader);
+    // Projections, light and specular material come from the camera block
+    leia_helper::LeiaRenderContext::GetInstance()->UseProgram(
+            multiview_shader_param_.program_);
+    leia_helper::UseCameraBlock(multiview_shader_param_.program_);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo_);
 
-    // Bind attribute locations
-    // this needs to be done prior to linking
-    glBindAttribLocation(program, ATTRIB_VERTEX, "myVertex");
-    glBindAttribLocation(program, ATTRIB_NORMAL, "myNormal");
-    glBindAttribLocation(program, ATTRIB_UV, "myUV");
+    int32_t iStride = sizeof(TEAPOT_VERTEX);
+    glVertexAttribPointer(ATTRIB_VERTEX, 3, GL_FLOAT, GL_FALSE, iStride,
+                          BUFFER_OFFSET(0));
+    glEnableVertexAttribArray(ATTRIB_VERTEX);
 
-    // Link program
-    if (!ndk_helper::shader::LinkProgram(program)) {
-        LOGI("Failed to link program: %d", program);
+    glVertexAttribPointer(ATTRIB_NORMAL, 3, GL_FLOAT, GL_FALSE, iStride,
+                          BUFFER_OFFSET(3 * sizeof(GLfloat)));
+    glEnableVertexAttribArray(ATTRIB_NORMAL);
 
-        if (vert_shader) {
-            glDeleteShader(vert_shader);
-            vert_shader = 0;
-        }
-        if (frag_shader) {
-            glDeleteShader(frag_shader);
-            frag_shader = 0;
-        }
-        if (program) {
-            glDeleteProgram(program);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo_);
+
+    TEAPOT_MATERIALS material = {
+            {1.0f, 0.5f, 0.5f},
+            {1.0f, 1.0f, 1.0f, 10.f},
+            {0.1f, 0.1f, 0.1f},};
+
+    glUniform4f(multiview_shader_param_.material_diffuse_, material.diffuse_color[0],
+                material.diffuse_color[1], material.diffuse_color[2], 1.f);
+
+    // Projection is applied per view in the shader
+    for (unsigned int i = 0; i < sNUM_OBJECTS; ++i) {
+        glUniformMatrix4fv(multiview_shader_param_.matrix_view_, 1, GL_FALSE,
+                           model_views_.Get(i));
+        glDrawElements(GL_TRIANGLES, num_indices_, GL_UNSIGNED_SHORT,
+                       BUFFER_OFFSET(0));
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    // The block keeps the projections packed, as the billboard wants them
+    DrawBillboard(texture_multiview_shader.program_,
+                  camera_buffer_.GetBlock().view_projections[0], num_views);
+}
+
+//--------------------------------------------------------------------------------
+// View atlas rendering
+//--------------------------------------------------------------------------------
+void TeapotRenderer::RenderViewsAtlas() {
+    // One framebuffer and one clear for every view, each view is drawn into its
+    // own region of the atlas
+    view_atlas_.BindScene();
+    glClearColor(1.0, 0.0, 1.0, 1.0);
+    glEnable(GL_DEPTH_TEST);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    if (!RenderViewSynthesisSources()) {
+        UpdateViewMVPs(cameras[0][0].matrix, sizeof(LeiaCameraView) / sizeof(GLfloat),
+                       CAMERAS_WIDE * CAMERAS_HIGH);
+        for (unsigned int y = 0; y < CAMERAS_HIGH; ++y) {
+            for (unsigned int x = 0; x < CAMERAS_WIDE; ++x) {
+                view_atlas_.BindView(y * CAMERAS_WIDE + x);
+                RenderView(y * CAMERAS_WIDE + x);
+            }
         }
+    }
+    view_atlas_.FinishScene();
+
+    UpdateViewIndexMap();
+    if (using_folded_dof_) {
+        leia_helper::LeiaRenderContext::GetInstance()->BindFramebuffer(fullscreen_fbo);
+        leia_helper::DiscardColor(attachment_policy_);
+        leia_helper::ViewInterlaceDOFIndexedAtlas(
+                view_atlas_.GetColorTexture(), view_atlas_.GetDepthTexture(),
+                view_atlas_.GetViewRectTable(), view_index_map_.GetTexture(), &data,
+                atlas_interlace_dof_program_, fullscreen_fbo, screen_width_pixels_,
+                screen_height_pixels_, 1.0f);
+        SharpenFullscreen();
+        CHECK_GL_ERROR();
+        return;
+    }
+
+    // Depth of field on every view at once
+    view_atlas_.BindDOF();
+    leia_helper::PrepareAtlasDOF(view_atlas_.GetColorTexture(),
+                                 view_atlas_.GetDepthTexture(),
+                                 view_atlas_.GetViewRectTable(), &data, atlas_dof_program_,
+                                 view_atlas_.GetDOFFramebuffer(), view_atlas_.GetWidth(),
+                                 view_atlas_.GetHeight(), 1.0f);
+    leia_helper::DrawQuad();
+
+    if (using_fused_interlace_sharpening_) {
+        leia_helper::ViewInterlaceAndSharpenIndexedAtlas(
+                view_atlas_.GetDOFTexture(), view_atlas_.GetViewRectTable(),
+                view_atlas_.GetNumViews(), view_index_map_.GetTexture(),
+                atlas_interlace_sharpen_program_, 0, screen_width_pixels_,
+                screen_height_pixels_, LeiaJNIDisplayParameters::mViewSharpeningParams, 2);
+    } else {
+        leia_helper::LeiaRenderContext::GetInstance()->BindFramebuffer(fullscreen_fbo);
+        leia_helper::DiscardColor(attachment_policy_);
+        leia_helper::ViewInterlaceIndexedAtlas(
+                view_atlas_.GetDOFTexture(), view_atlas_.GetViewRectTable(),
+                view_atlas_.GetNumViews(), view_index_map_.GetTexture(),
+                atlas_interlace_program_, fullscreen_fbo, screen_width_pixels_,
+                screen_height_pixels_);
+        SharpenFullscreen();
+    }
+    CHECK_GL_ERROR();
+}
 
+bool TeapotRenderer::RenderViewSynthesisSources() {
+    // Only the source views are rendered, the synthesis pass fills every view
+    // region of the atlas, color and depth, for the passes that follow
+    leia_helper::VIEW_SYNTHESIS_PARAMS params;
+    if (view_synthesis_mode_ == leia_helper::VIEW_SYNTHESIS_OFF ||
+        !view_synthesis_program_ || !view_synthesis_target_.GetColorTexture() ||
+        !leia_helper::GetViewSynthesisParams(&data, view_synthesis_mode_, &params)) {
         return false;
     }
 
-    // Get uniform locations
-    params->matrix_projection_ = glGetUniformLocation(program, "uPMatrix");
-    params->matrix_view_ = glGetUniformLocation(program, "uMVMatrix");
+    GLfloat projections[leia_helper::VIEW_SYNTHESIS_MAX_SOURCES * 16];
+    for (int32_t i = 0; i < params.num_sources; ++i) {
+        leia_helper::InterpolateViewMatrix(cameras[0], CAMERAS_WIDE,
+                                           params.source_positions[i], &projections[i * 16]);
+    }
+    UpdateViewMVPs(projections, 16, params.num_sources);
+    for (int32_t i = 0; i < params.num_sources; ++i) {
+        view_synthesis_target_.BindSource(i);
+        glClearColor(1.0, 0.0, 1.0, 1.0);
+        glEnable(GL_DEPTH_TEST);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        RenderView(i);
+    }
 
-    params->light0_ = glGetUniformLocation(program, "vLight0");
-    params->material_diffuse_ = glGetUniformLocation(program, "vMaterialDiffuse");
-    params->material_ambient_ = glGetUniformLocation(program, "vMaterialAmbient");
-    params->material_specular_ =
-            glGetUniformLocation(program, "vMaterialSpecular");
+    leia_helper::ViewSynthesisAtlas(view_synthesis_target_.GetColorTexture(),
+                                    view_synthesis_target_.GetDepthTexture(),
+                                    view_atlas_.GetViewRectTable(), params,
+                                    view_synthesis_program_, view_atlas_.GetFramebuffer(),
+                                    view_atlas_.GetWidth(), view_atlas_.GetHeight());
+    CHECK_GL_ERROR();
+    return true;
+}
 
-    // Release vertex and fragment shaders
-    if (vert_shader) glDeleteShader(vert_shader);
-    if (frag_shader) glDeleteShader(frag_shader);
+void TeapotRenderer::SetViewSynthesisMode(leia_helper::VIEW_SYNTHESIS_MODE mode) {
+    view_synthesis_mode_ = mode;
+}
 
-    params->program_ = program;
+// The Leia SDK binds on its own, the context forgets what it tracked
+void TeapotRenderer::SharpenFullscreen() {
+    leiaViewSharpening(fullscreen_texture, &data, view_sharpening_shader.program_, 0,
+                       screen_width_pixels_,
+                       LeiaJNIDisplayParameters::mViewSharpeningParams, 2);
+    leia_helper::LeiaRenderContext::GetInstance()->Invalidate();
+}
+
+void TeapotRenderer::UpdateViewIndexMap() {
+    // Only rebuilt when the calibration changes
+    leia_helper::VIEW_INDEX_CALIBRATION calibration = {
+            LeiaJNIDisplayParameters::mAlignmentOffset, VIEW_SLANT_NUMERATOR,
+            VIEW_SLANT_DENOMINATOR, VIEW_SUBPIXEL_INTERLACING};
+    view_index_map_.Update(&data, calibration);
+}
+
+void TeapotRenderer::LogRenderViewsTime(RENDER_PATH path, double elapsed) {
+    render_views_time_[path] += elapsed;
+    if (++render_views_frames_[path] >= RENDER_VIEWS_LOG_FRAMES) {
+        const char *names[RENDER_PATH_COUNT] = {"per view loop", "multiview",
+                                                "multiview, fused sharpening",
+                                                "multiview, folded depth of field",
+                                                "view atlas",
+                                                "view atlas, fused sharpening",
+                                                "view atlas, folded depth of field"};
+        LOGI("RenderViews (%s): %.3f ms CPU per frame", names[path],
+             render_views_time_[path] * 1000.0 / render_views_frames_[path]);
+        // Since the last log, which may include frames of another path
+        leia_helper::LeiaRenderContext *context =
+                leia_helper::LeiaRenderContext::GetInstance();
+        leia_helper::RENDER_CONTEXT_STATS stats = context->GetStats();
+        const int32_t frames = render_views_frames_[path];
+        LOGI("RenderViews (%s): %d binds, %d elided, %d uniform queries per frame",
+             names[path],
+             (stats.program_binds + stats.framebuffer_binds + stats.texture_binds) / frames,
+             (stats.programs_elided + stats.framebuffers_elided + stats.textures_elided) /
+             frames, stats.uniform_queries / frames);
+        context->ResetStats();
+        render_views_time_[path] = 0.0;
+        render_views_frames_[path] = 0;
+    }
+}
+
+// Shader attribute locations need to be explicitly specified before linking
+static const leia_helper::PROGRAM_ATTRIBUTE TEAPOT_ATTRIBUTES[] = {
+        {ATTRIB_VERTEX, "myVertex"}, {ATTRIB_NORMAL, "myNormal"}, {ATTRIB_UV, "myUV"}};
+static const int32_t NUM_TEAPOT_ATTRIBUTES =
+        sizeof(TEAPOT_ATTRIBUTES) / sizeof(TEAPOT_ATTRIBUTES[0]);
+
+// Both stages, with the LeiaCamera block added to defines
+static bool ReadShaders(const char *strVsh, const char *strFsh,
+                        const std::map<std::string, std::string> *defines,
+                        std::string *vert_source, std::string *frag_source) {
+    std::map<std::string, std::string> shader_defines;
+    if (defines) shader_defines = *defines;
+    shader_defines[CAMERA_BLOCK_TAG] = leia_helper::CAMERA_BLOCK_SOURCE;
+    return ndk_helper::shader::ReadShader(strVsh, &shader_defines, vert_source) &&
+           ndk_helper::shader::ReadShader(strFsh, &shader_defines, frag_source);
+}
+
+bool TeapotRenderer::LoadShaders(SHADER_PARAMS *params, const char *strVsh,
+                                 const char *strFsh,
+                                 const std::map<std::string, std::string> *defines) {
+    std::string vert_source, frag_source;
+    if (!ReadShaders(strVsh, strFsh, defines, &vert_source, &frag_source)) return false;
+    params->program_ = leia_helper::CreateProgram(
+            "teapot", vert_source.c_str(), frag_source.c_str(), TEAPOT_ATTRIBUTES,
+            NUM_TEAPOT_ATTRIBUTES);
+    if (!params->program_) return false;
+    LOGI("Created Shader %d", params->program_);
+    GetUniformLocations(params);
+    return true;
+}
+
+// Queued on program_builder_, GetUniformLocations() once it is ready
+bool TeapotRenderer::AddShaders(SHADER_PARAMS *params, const char *strVsh,
+                                const char *strFsh,
+                                const std::map<std::string, std::string> *defines) {
+    std::string vert_source, frag_source;
+    if (!ReadShaders(strVsh, strFsh, defines, &vert_source, &frag_source)) return false;
+    program_builder_.AddProgram(&params->program_, "teapot", vert_source, frag_source,
+                                TEAPOT_ATTRIBUTES, NUM_TEAPOT_ATTRIBUTES);
     return true;
 }
 
+void TeapotRenderer::GetUniformLocations(SHADER_PARAMS *params) {
+    GLuint program = params->program_;
+    params->matrix_projection_ = glGetUniformLocation(program, "uPMatrix");
+    params->matrix_view_ = glGetUniformLocation(program, "uMVMatrix");
+    params->material_diffuse_ = glGetUniformLocation(program, "vMaterialDiffuse");
+}
+
 bool TeapotRenderer::Bind(ndk_helper::TapCamera *camera) {
     camera_ = camera;
     return true;
@@ -467,14 +896,8 @@ bool TeapotRenderer::Bind(ndk_helper::TapCamera *camera) {
 
 void TeapotRenderer::PrepareFullscreenSurface() {
     glGenFramebuffers(1, &fullscreen_fbo);
-    glGenTextures(1, &fullscreen_texture);
-    glBindTexture(GL_TEXTURE_2D, fullscreen_texture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, screen_width_pixels_, screen_height_pixels_, 0,
-                 GL_RGBA,
-                 GL_UNSIGNED_BYTE,
-                 NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    fullscreen_texture = AcquireTexture(screen_width_pixels_, screen_height_pixels_,
+                                        GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
     glBindFramebuffer(GL_FRAMEBUFFER, fullscreen_fbo);
     GLenum attachment = GL_COLOR_ATTACHMENT0;
     glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, fullscreen_texture, 0);
@@ -492,17 +915,16 @@ void TeapotRenderer::PrepareRenderTargetSurfaces() {
         // the objects need to be drawn into FBOs
         // This is the general rendering FBO set
         glBindFramebuffer(GL_FRAMEBUFFER, fbos[i]);
-        render_textures[i] = CreateTexture(view_width_pixels_, view_height_pixels_,
-                                           GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        render_textures[i] = leia_helper::AcquireColorAttachment(
+                attachment_policy_, view_width_pixels_, view_height_pixels_);
         GLenum attachment = GL_COLOR_ATTACHMENT0;
         glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D,
                                render_textures[i], 0);
 
-        depth_textures[i] = CreateTexture(view_width_pixels_, view_height_pixels_,
-                                          GL_DEPTH_COMPONENT32F, GL_DEPTH_COMPONENT,
-                                          GL_FLOAT, NULL);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
-                               GL_TEXTURE_2D, depth_textures[i], 0);
+        // A renderbuffer when nothing samples depth, see attachmentPolicy.h
+        depth_textures[i] = leia_helper::AcquireDepthAttachment(
+                attachment_policy_, view_width_pixels_, view_height_pixels_);
+        leia_helper::AttachDepth(attachment_policy_, depth_textures[i]);
 
         glDrawBuffers(1, &attachment);
         GLuint status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
@@ -514,8 +936,8 @@ void TeapotRenderer::PrepareRenderTargetSurfaces() {
         // Create the FBOs and Textures needed for the DoF pass
         // Also verify the framebuffer is valid after creation
         glBindFramebuffer(GL_FRAMEBUFFER, fbo_dof[i]);
-        texture_dof[i] = CreateTexture(view_width_pixels_, view_height_pixels_, GL_RGBA8,
-                                       GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        texture_dof[i] = leia_helper::AcquireColorAttachment(
+                attachment_policy_, view_width_pixels_, view_height_pixels_);
         attachment = GL_COLOR_ATTACHMENT0;
         glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, texture_dof[i], 0);
         glDrawBuffers(1, &attachment);
@@ -529,6 +951,36 @@ void TeapotRenderer::PrepareRenderTargetSurfaces() {
     glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
 }
 
+void TeapotRenderer::ReleaseSurfaces() {
+    leia_helper::RenderTargetPool *pool = leia_helper::RenderTargetPool::GetInstance();
+    if (fullscreen_fbo) {
+        glDeleteFramebuffers(1, &fullscreen_fbo);
+        fullscreen_fbo = 0;
+    }
+    pool->ReleaseTexture(fullscreen_texture);
+    fullscreen_texture = 0;
+
+    if (fbos[0]) {
+        glDeleteFramebuffers(RT_COUNT, fbos);
+    }
+    if (fbo_dof[0]) {
+        glDeleteFramebuffers(RT_COUNT, fbo_dof);
+    }
+    for (int i = 0; i < RT_COUNT; ++i) {
+        pool->ReleaseTexture(render_textures[i]);
+        leia_helper::ReleaseDepthAttachment(attachment_policy_, depth_textures[i]);
+        pool->ReleaseTexture(texture_dof[i]);
+        fbos[i] = 0;
+        fbo_dof[i] = 0;
+        render_textures[i] = 0;
+        depth_textures[i] = 0;
+        texture_dof[i] = 0;
+    }
+
+    pool->ReleaseTexture(checkerboard_texture);
+    checkerboard_texture = 0;
+}
+
 void TeapotRenderer::PrepareCheckerboard() {
     // Making a texture that is the size of our 3d screen...because...
     unsigned char *ptex = new unsigned char[view_width_pixels_ *
@@ -621,140 +1073,61 @@ void TeapotRenderer::PrepareCheckerboard() {
             }
         }
 
-        checkerboard_texture = CreateTexture(view_width_pixels_, view_height_pixels_,
-                                             GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, ptex);
+        checkerboard_texture = AcquireTexture(view_width_pixels_, view_height_pixels_,
+                                              GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, ptex);
 
         delete[] ptex;
     }
 }
 
-GLuint TeapotRenderer::CreateTexture(int width, int height,
-                                     GLint internal_format,
-                                     GLenum format, GLenum type,
-                                     void *data) {
-    GLuint texture_id;
-    glGenTextures(1, &texture_id);
-    glBindTexture(GL_TEXTURE_2D, texture_id);
-    glTexImage2D(GL_TEXTURE_2D, 0, internal_format, width, height, 0, format, type,
-                 data);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+GLuint TeapotRenderer::AcquireTexture(int width, int height,
+                                      GLint internal_format,
+                                      GLenum format, GLenum type,
+                                      void *data) {
+    // Same size and format as a released target reuses it without allocating
+    GLuint texture_id = leia_helper::RenderTargetPool::GetInstance()->AcquireTexture(
+            width, height, internal_format);
+    if (data) {
+        glBindTexture(GL_TEXTURE_2D, texture_id);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, format, type, data);
+    }
 
     return texture_id;
 }
 
-void TeapotRenderer::DrawBillboard(float *persp) {
+void TeapotRenderer::DrawBillboard(GLuint program, const float *persp, int32_t num_views) {
 
     CHECK_GL_ERROR();
-    glUseProgram(texture_shader.program_);
+    leia_helper::LeiaRenderContext *context = leia_helper::LeiaRenderContext::GetInstance();
+    context->UseProgram(program);
 
     // Setup the billboard program sampler (Texture read)
-    GLint tex_sampler_loc = glGetUniformLocation(texture_shader.program_, "tex_sampler");
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, checkerboard_texture);
-    glUniform1i(tex_sampler_loc, 0);
+    context->BindTexture(0, GL_TEXTURE_2D, checkerboard_texture);
+    glUniform1i(context->GetUniformLocation(program, "tex_sampler"), 0);
 
     // Effectively random location in the scene to move the quad to
-    GLint translation_loc = glGetUniformLocation(texture_shader.program_, "translation");
-
-    ndk_helper::Mat4 translation = ndk_helper::Mat4::Translation(0.0, 50.0, -200.0f);
-    ndk_helper::Mat4 scalar = ndk_helper::Mat4::Scale(50.0, 50.0, 1.0);
-    ndk_helper::Mat4 transform = translation * scalar;
-    glUniformMatrix4fv(translation_loc, 1, GL_FALSE, transform.Ptr());
+    ndk_helper::Mat4 transform = (ndk_helper::Affine::Translation(0.0, 50.0, -200.0f) *
+                                  ndk_helper::Affine::Scale(50.0, 50.0, 1.0))
+                                         .ToMat4();
+    glUniformMatrix4fv(context->GetUniformLocation(program, "translation"), 1, GL_FALSE,
+                       transform.Ptr());
 
     const float CAM_X = 0.0f;
     const float CAM_Y = 0.0f;
     const float CAM_Z = 100.0f;
-    ndk_helper::Mat4 cam = ndk_helper::Mat4::LookAt(ndk_helper::Vec3(CAM_X, CAM_Y, CAM_Z),
-                                                    ndk_helper::Vec3(0.0f, 0.0f, 0.0f),
-                                                    ndk_helper::Vec3(0.0f, 1.0f, 0.0f));
+    ndk_helper::Affine view = ndk_helper::Affine::LookAt(ndk_helper::Vec3(CAM_X, CAM_Y, CAM_Z),
+                                                         ndk_helper::Vec3(0.0f, 0.0f, 0.0f),
+                                                         ndk_helper::Vec3(0.0f, 1.0f, 0.0f));
 
-    cam = camera_->GetTransformMatrix() * cam;
-    // We use the same perspective matrix as with the previous objects drawn
-    GLint cam_loc = glGetUniformLocation(texture_shader.program_, "cam");
-    glUniformMatrix4fv(cam_loc, 1, GL_FALSE, cam.Ptr());
+    ndk_helper::Mat4 cam = (camera_->GetTransformMatrix() * view).ToMat4();
+    glUniformMatrix4fv(context->GetUniformLocation(program, "cam"), 1, GL_FALSE, cam.Ptr());
 
-    // We use the same perspective matrix as with the previous objects drawn
-    GLint persp_loc = glGetUniformLocation(texture_shader.program_, "perspective");
-    glUniformMatrix4fv(persp_loc, 1, GL_FALSE, persp);
+    // We use the same perspective matrix as with the previous objects drawn,
+    // one per view for the multiview program
+    glUniformMatrix4fv(context->GetUniformLocation(program, "perspective"), num_views,
+                       GL_FALSE, persp);
 
-    // Basic quad drawing
-    DrawTexturedQuad(texture_shader.program_);
+    // Basic quad drawing, the fullscreen quad scaled by translation
+    context->DrawQuad(ATTRIB_VERTEX, ATTRIB_UV);
     CHECK_GL_ERROR();
 }
-
-void TeapotRenderer::DrawTexturedQuad(GLint program_id) {
-    CHECK_GL_ERROR();
-
-// vao and vbo handle
-    static GLuint vbo, ibo;
-    GLuint pos_loc = glGetAttribLocation(program_id, "myVertex");
-    GLuint tex_loc = glGetAttribLocation(program_id, "myUV");
-
-    // generate and bind the vertex buffer object
-    glGenBuffers(1, &vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    CHECK_GL_ERROR();
-
-    // data for a fullscreen quad (this time with texture coords)
-    GLfloat vertexData[] = {
-            //  X     Y     Z           U     V
-            1.0f, 1.0f, 0.0f, 1.0f, 1.0f, // vertex 0
-            -1.0f, 1.0f, 0.0f, 0.0f, 1.0f, // vertex 1
-            1.0f, -1.0f, 0.0f, 1.0f, 0.0f, // vertex 2
-            -1.0f, -1.0f, 0.0f, 0.0f, 0.0f, // vertex 3
-    }; // 4 vertices with 5 components (floats) each
-
-    // fill with data
-    glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * 4 * 5, vertexData, GL_STATIC_DRAW);
-
-
-    // set up generic attrib pointers
-    glEnableVertexAttribArray(pos_loc);
-    CHECK_GL_ERROR();
-    glVertexAttribPointer(pos_loc, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat),
-                          (char *) 0 + 0 * sizeof(GLfloat));
-
-    glEnableVertexAttribArray(tex_loc);
-    glVertexAttribPointer(tex_loc, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat),
-                          (char *) 0 + 3 * sizeof(GLfloat));
-
-
-    // generate and bind the index buffer object
-    glGenBuffers(1, &ibo);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
-    CHECK_GL_ERROR();
-
-    GLuint indexData[] = {
-            0, 1, 2, // first triangle
-            2, 1, 3, // second triangle
-    };
-
-    // fill with data
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * 2 * 3, indexData, GL_STATIC_DRAW);
-
-    CHECK_GL_ERROR();
-
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glVertexAttribPointer(pos_loc, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat),
-                          (char *) 0 + 0 * sizeof(GLfloat));
-    glVertexAttribPointer(tex_loc, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat),
-                          (char *) 0 + 3 * sizeof(GLfloat));
-    glEnableVertexAttribArray(pos_loc);
-    glEnableVertexAttribArray(tex_loc);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
-    CHECK_GL_ERROR();
-
-    // draw
-    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-    CHECK_GL_ERROR();
-
-    glDisableVertexAttribArray(pos_loc);
-    glDisableVertexAttribArray(tex_loc);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-    glDeleteBuffers(1, &vbo);
-    glDeleteBuffers(1, &ibo);
-}
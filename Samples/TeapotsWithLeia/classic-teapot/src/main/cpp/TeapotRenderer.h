@@ -27,6 +27,8 @@
 #include <jni.h>
 #include <errno.h>
 
+#include <map>
+#include <string>
 #include <vector>
 
 #include <EGL/egl.h>
@@ -42,6 +44,17 @@
 #define APPLICATION_CLASS_NAME "com/sample/teapot/TeapotApplication"
 
 #include "NDKHelper.h"
+#include "attachmentPolicy.h"
+#include "cameraBuffer.h"
+#include "multiview.h"
+#include "postProcess.h"
+#include "programBuilder.h"
+#include "renderContext.h"
+#include "renderTargetPool.h"
+#include "viewAtlas.h"
+#include "viewIndexMap.h"
+#include "viewSynthesis.h"
+#include "viewTransforms.h"
 
 #define BUFFER_OFFSET(i) ((char*)NULL + (i))
 
@@ -58,10 +71,7 @@ enum SHADER_ATTRIBUTES {
 
 struct SHADER_PARAMS {
     GLuint program_;
-    GLuint light0_;
     GLuint material_diffuse_;
-    GLuint material_ambient_;
-    GLuint material_specular_;
 
     GLuint matrix_projection_;
     GLuint matrix_view_;
@@ -81,14 +91,32 @@ class TeapotRenderer {
 
     SHADER_PARAMS shader_param_;
 
+    SHADER_PARAMS multiview_shader_param_;
+
     bool LoadShaders(SHADER_PARAMS *params, const char *strVsh,
-                     const char *strFsh);
+                     const char *strFsh,
+                     const std::map<std::string, std::string> *defines = NULL);
+    bool AddShaders(SHADER_PARAMS *params, const char *strVsh,
+                    const char *strFsh,
+                    const std::map<std::string, std::string> *defines = NULL);
+    void GetUniformLocations(SHADER_PARAMS *params);
+
+    // Programs of the 3D paths, built while the 2D path is shown
+    leia_helper::ProgramBuilder program_builder_;
+    bool programs_ready_;
+    void OnProgramsReady();
 
     static const unsigned int sNUM_OBJECTS = 3;
-    ndk_helper::Mat4 mat_view_[sNUM_OBJECTS];
+    // Model view of every teapot for the frame, written by Update(), and the
+    // model view projection of every teapot for each view being rendered,
+    // view after view, with the projections the billboard draws with
+    leia_helper::MatrixBuffer model_views_;
+    leia_helper::MatrixBuffer view_mvps_;
+    std::vector<GLfloat> view_projections_;
+    leia_helper::CPU_ISA transform_isa_;
 
     ndk_helper::Mat4 mat_projection_;
-    ndk_helper::Mat4 mat_model_;
+    ndk_helper::Affine mat_model_;
 
     ndk_helper::TapCamera *camera_;
 
@@ -116,7 +144,68 @@ class TeapotRenderer {
 
     GLuint checkerboard_texture;
 
+    // Single pass multiview (GL_OVR_multiview2) resources
+    SHADER_PARAMS texture_multiview_shader;
+    leia_helper::MultiviewTarget multiview_target_;
+    leia_helper::ViewIndexMap view_index_map_;
+    GLuint multiview_dof_program_;
+    GLuint multiview_interlace_program_;
+    GLuint multiview_interlace_sharpen_program_;
+    GLuint multiview_interlace_dof_program_;
+    bool render_with_multiview_ext_;
+    bool using_fused_interlace_sharpening_;
+    // Depth of field evaluated by the interlacer, no depth of field pass
+    bool using_folded_dof_;
+
+    // All views in one framebuffer, used instead of the per view
+    // framebuffers when GL_OVR_multiview2 is not available
+    leia_helper::ViewAtlas view_atlas_;
+    leia_helper::ATTACHMENT_POLICY attachment_policy_;
+    GLuint atlas_dof_program_;
+    GLuint atlas_interlace_program_;
+    GLuint atlas_interlace_sharpen_program_;
+    GLuint atlas_interlace_dof_program_;
+    bool using_view_atlas_;
+
+    // Views synthesized from one or two rendered views on the atlas path
+    leia_helper::ViewSynthesisTarget view_synthesis_target_;
+    GLuint view_synthesis_program_;
+    leia_helper::VIEW_SYNTHESIS_MODE view_synthesis_mode_;
+
+    // CPU time spent in RenderViews(), per path
+    enum RENDER_PATH {
+        RENDER_PATH_PER_VIEW,
+        RENDER_PATH_MULTIVIEW,
+        RENDER_PATH_MULTIVIEW_FUSED,
+        RENDER_PATH_MULTIVIEW_FOLDED_DOF,
+        RENDER_PATH_ATLAS,
+        RENDER_PATH_ATLAS_FUSED,
+        RENDER_PATH_ATLAS_FOLDED_DOF,
+        RENDER_PATH_COUNT
+    };
+    double render_views_time_[RENDER_PATH_COUNT];
+    int32_t render_views_frames_[RENDER_PATH_COUNT];
+
     bool using_simple_leia_rendering_api;
+
+    void RenderViewsMultiview();
+
+    void RenderViewsAtlas();
+
+    bool RenderViewSynthesisSources();
+
+    void UpdateViewIndexMap();
+    void SharpenFullscreen();
+
+    // Before RenderView(): the products of every view for the projections
+    void UpdateViewMVPs(const float *projections, int32_t projection_stride,
+                        int32_t num_views);
+
+    // Per frame camera and lighting uniforms shared by the scene and post programs
+    leia_helper::CameraBuffer camera_buffer_;
+    void UpdateCameraBlock();
+
+    void LogRenderViewsTime(RENDER_PATH path, double elapsed);
 public:
     TeapotRenderer();
 
@@ -130,11 +219,15 @@ public:
 
     void PrepareRenderTargetSurfaces();
 
+    void ReleaseSurfaces();
+
     void RenderViews(bool is_backlight_still_on);
 
-    void RenderView(unsigned int x, unsigned int y, bool use_leia);
+    void RenderView(int32_t view);
+
+    void RenderViewMultiview();
 
-    void Update(float dTime);
+    void Update(float dTime, bool render_with_multiview_ext);
 
     bool Bind(ndk_helper::TapCamera *camera);
 
@@ -142,12 +235,12 @@ public:
 
     void UpdateViewport();
 
-    GLuint CreateTexture(int width, int height, GLint internal_format,
-                         GLenum format, GLenum type, void *data);
+    void SetViewSynthesisMode(leia_helper::VIEW_SYNTHESIS_MODE mode);
 
-    void DrawTexturedQuad(GLint shader_id);
+    GLuint AcquireTexture(int width, int height, GLint internal_format,
+                          GLenum format, GLenum type, void *data);
 
-    void DrawBillboard(float *persp);
+    void DrawBillboard(GLuint program, const float *persp, int32_t num_views);
 };
 
 #define CHECK_GL_ERROR() \
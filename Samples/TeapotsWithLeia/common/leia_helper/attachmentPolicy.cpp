@@ -0,0 +1,160 @@
+/*
+ * Copyright 2018 Leia Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//--------------------------------------------------------------------------------
+// attachmentPolicy.cpp
+// Render target formats, discards and their memory traffic
+//--------------------------------------------------------------------------------
+#include <string.h>
+
+#include "JNIHelper.h"
+#include "attachmentPolicy.h"
+#include "renderTargetPool.h"
+
+namespace leia_helper {
+
+static bool HasExtension(const char* name) {
+  const char* extensions = (const char*)glGetString(GL_EXTENSIONS);
+  return extensions && strstr(extensions, name);
+}
+
+ATTACHMENT_POLICY ResolveAttachmentPolicy(const ATTACHMENT_POLICY& policy) {
+  ATTACHMENT_POLICY resolved = policy;
+  switch (policy.color_format) {
+    case GL_RGBA8:
+    case GL_RGB565:
+    case GL_RGB10_A2:
+      break;
+    case GL_R11F_G11F_B10F:
+      if (HasExtension("GL_EXT_color_buffer_float")) break;
+      // Fall through
+    default:
+      LOGW("%s is not renderable, using RGBA8",
+           GetFormatName(policy.color_format));
+      resolved.color_format = GL_RGBA8;
+      break;
+  }
+  switch (policy.depth_format) {
+    case GL_DEPTH_COMPONENT16:
+    case GL_DEPTH_COMPONENT24:
+    case GL_DEPTH_COMPONENT32F:
+      break;
+    default:
+      LOGW("%s is not a depth format, using DEPTH32F",
+           GetFormatName(policy.depth_format));
+      resolved.depth_format = GL_DEPTH_COMPONENT32F;
+      break;
+  }
+  return resolved;
+}
+
+GLuint AcquireColorAttachment(const ATTACHMENT_POLICY& policy, int32_t width,
+                              int32_t height) {
+  return RenderTargetPool::GetInstance()->AcquireTexture(width, height,
+                                                         policy.color_format);
+}
+
+GLuint AcquireDepthAttachment(const ATTACHMENT_POLICY& policy, int32_t width,
+                              int32_t height) {
+  RENDER_TARGET_DESC desc = {width, height, 1, policy.depth_format,
+                             policy.depth_sampled
+                                 ? RENDER_TARGET_USAGE_TEXTURE
+                                 : RENDER_TARGET_USAGE_RENDERBUFFER};
+  return RenderTargetPool::GetInstance()->AcquireTexture(desc);
+}
+
+void ReleaseDepthAttachment(const ATTACHMENT_POLICY& policy, GLuint depth) {
+  RenderTargetPool* pool = RenderTargetPool::GetInstance();
+  if (policy.depth_sampled) {
+    pool->ReleaseTexture(depth);
+  } else {
+    pool->ReleaseRenderbuffer(depth);
+  }
+}
+
+void AttachDepth(const ATTACHMENT_POLICY& policy, GLuint depth) {
+  if (policy.depth_sampled) {
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D,
+                           depth, 0);
+  } else {
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                              GL_RENDERBUFFER, depth);
+  }
+}
+
+void DiscardColor(const ATTACHMENT_POLICY& policy) {
+  if (!policy.discard) return;
+  const GLenum attachment = GL_COLOR_ATTACHMENT0;
+  glInvalidateFramebuffer(GL_FRAMEBUFFER, 1, &attachment);
+}
+
+void DiscardTransientDepth(const ATTACHMENT_POLICY& policy) {
+  if (policy.depth_sampled) return;
+  const GLenum attachment = GL_DEPTH_ATTACHMENT;
+  glInvalidateFramebuffer(GL_FRAMEBUFFER, 1, &attachment);
+}
+
+ATTACHMENT_BANDWIDTH EstimateAttachmentBandwidth(
+    const ATTACHMENT_POLICY& policy, int32_t view_width, int32_t view_height,
+    int32_t num_views, int32_t screen_width, int32_t screen_height) {
+  const int64_t views = (int64_t)view_width * view_height * num_views;
+  const int64_t screen = (int64_t)screen_width * screen_height;
+  const int64_t color = GetFormatBytesPerPixel(policy.color_format);
+  const int64_t depth =
+      policy.depth_sampled ? GetFormatBytesPerPixel(policy.depth_format) : 0;
+  const int64_t screen_color = GetFormatBytesPerPixel(GL_RGBA8);
+
+  ATTACHMENT_BANDWIDTH bandwidth;
+  bandwidth.scene_written = views * (color + depth);
+  bandwidth.dof_read = views * (color + depth);
+  bandwidth.dof_written = views * color;
+  bandwidth.interlace_read = (screen < views ? screen : views) * color;
+  bandwidth.interlace_written = screen * screen_color;
+  bandwidth.sharpen_read = screen * screen_color;
+  bandwidth.sharpen_written = screen * screen_color;
+  // The depth of field and interlaced targets, the window is not ours
+  bandwidth.loads =
+      policy.discard ? 0 : views * color + screen * screen_color;
+  bandwidth.total_read = bandwidth.dof_read + bandwidth.interlace_read +
+                         bandwidth.sharpen_read + bandwidth.loads;
+  bandwidth.total_written = bandwidth.scene_written + bandwidth.dof_written +
+                            bandwidth.interlace_written +
+                            bandwidth.sharpen_written;
+  return bandwidth;
+}
+
+const char* GetFormatName(const GLenum internal_format) {
+  switch (internal_format) {
+    case GL_RGBA8:
+      return "RGBA8";
+    case GL_RGB565:
+      return "RGB565";
+    case GL_RGB10_A2:
+      return "RGB10A2";
+    case GL_R11F_G11F_B10F:
+      return "R11G11B10F";
+    case GL_DEPTH_COMPONENT16:
+      return "DEPTH16";
+    case GL_DEPTH_COMPONENT24:
+      return "DEPTH24";
+    case GL_DEPTH_COMPONENT32F:
+      return "DEPTH32F";
+    default:
+      return "unknown";
+  }
+}
+
+}  // namespace leia_helper
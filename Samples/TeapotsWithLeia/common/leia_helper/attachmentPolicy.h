@@ -0,0 +1,112 @@
+/*
+ * Copyright 2018 Leia Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//--------------------------------------------------------------------------------
+// attachmentPolicy.h
+//--------------------------------------------------------------------------------
+#ifndef LEIA_HELPER_ATTACHMENTPOLICY_H_
+#define LEIA_HELPER_ATTACHMENTPOLICY_H_
+
+#include "gl3stub.h"
+
+namespace leia_helper {
+
+/******************************************************************
+ * Formats and storage of the scene and depth of field targets
+ *
+ * color_format: scene and depth of field colour. GL_RGB565 halves the
+ *               colour traffic, alpha is never used. GL_RGB10_A2 and
+ *               GL_R11F_G11F_B10F are 32 bits like GL_RGBA8: they buy
+ *               precision, not bandwidth.
+ * depth_format: GL_DEPTH_COMPONENT16, 24 or 32F. Depth of field reads
+ *               linearised depth, 16 bits bands the blur far from the
+ *               convergence plane.
+ * depth_sampled: a later pass reads scene depth (depth of field, folded or
+ *               not). Depth is then a texture and is written back to memory.
+ *               Otherwise it is a renderbuffer, discarded at the end of the
+ *               scene pass and never leaves tile memory on tiled GPUs.
+ * discard: glInvalidateFramebuffer on targets a fullscreen pass overwrites,
+ *          before drawing, so tilers do not load their old contents.
+ */
+struct ATTACHMENT_POLICY {
+  GLenum color_format;
+  GLenum depth_format;
+  bool depth_sampled;
+  bool discard;
+};
+
+// The formats the targets have always had
+const ATTACHMENT_POLICY DEFAULT_ATTACHMENT_POLICY = {
+    GL_RGBA8, GL_DEPTH_COMPONENT32F, true, false};
+
+/******************************************************************
+ * ResolveAttachmentPolicy()
+ * The policy with the formats the context cannot render to replaced by
+ * GL_RGBA8 and GL_DEPTH_COMPONENT32F. GL_R11F_G11F_B10F needs
+ * EXT_color_buffer_float.
+ */
+ATTACHMENT_POLICY ResolveAttachmentPolicy(const ATTACHMENT_POLICY& policy);
+
+/******************************************************************
+ * Attachments from the RenderTargetPool
+ * Depth is a texture or a renderbuffer depending on depth_sampled and goes
+ * back with ReleaseDepthAttachment() and the policy it was acquired with,
+ * colour with RenderTargetPool::ReleaseTexture().
+ * The others work on the bound GL_FRAMEBUFFER:
+ * AttachDepth(): as a texture or a renderbuffer, like it was acquired
+ * DiscardColor(): before a fullscreen pass, when discard is set
+ * DiscardTransientDepth(): at the end of the scene pass, when depth is not
+ *                          sampled
+ */
+GLuint AcquireColorAttachment(const ATTACHMENT_POLICY& policy, int32_t width,
+                              int32_t height);
+GLuint AcquireDepthAttachment(const ATTACHMENT_POLICY& policy, int32_t width,
+                              int32_t height);
+void ReleaseDepthAttachment(const ATTACHMENT_POLICY& policy, GLuint depth);
+void AttachDepth(const ATTACHMENT_POLICY& policy, GLuint depth);
+void DiscardColor(const ATTACHMENT_POLICY& policy);
+void DiscardTransientDepth(const ATTACHMENT_POLICY& policy);
+
+/******************************************************************
+ * Per frame memory traffic of scene, separate depth of field, interlacing
+ * and sharpening for a policy, in bytes
+ * Every target texel is written once and every input texel read once.
+ * loads counts the old contents tiled GPUs read back into the fullscreen
+ * targets that are not discarded. Interlacing reads at most one texel per
+ * screen pixel. Screen targets stay GL_RGBA8.
+ */
+struct ATTACHMENT_BANDWIDTH {
+  int64_t scene_written;
+  int64_t dof_read;
+  int64_t dof_written;
+  int64_t interlace_read;
+  int64_t interlace_written;
+  int64_t sharpen_read;
+  int64_t sharpen_written;
+  int64_t loads;
+  int64_t total_read;
+  int64_t total_written;
+};
+
+ATTACHMENT_BANDWIDTH EstimateAttachmentBandwidth(
+    const ATTACHMENT_POLICY& policy, int32_t view_width, int32_t view_height,
+    int32_t num_views, int32_t screen_width, int32_t screen_height);
+
+// "RGBA8", "DEPTH16"... for logs
+const char* GetFormatName(const GLenum internal_format);
+
+}  // namespace leia_helper
+#endif /* LEIA_HELPER_ATTACHMENTPOLICY_H_ */
@@ -0,0 +1,146 @@
+/*
+ * Copyright 2018 Leia Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//--------------------------------------------------------------------------------
+// cameraBuffer.cpp
+// Per frame camera and lighting uniforms in one std140 uniform buffer
+//--------------------------------------------------------------------------------
+#include <math.h>
+#include <string.h>
+
+#include "cameraBuffer.h"
+#include "renderContext.h"
+
+namespace leia_helper {
+
+// Members match across stages, precisions included
+const char* CAMERA_BLOCK_SOURCE = R"(
+layout(std140) uniform LeiaCamera {
+    highp mat4 leia_view_projections[16];
+    highp vec4 leia_light0;
+    highp vec4 leia_material_ambient;
+    highp vec4 leia_material_specular;
+    highp vec4 leia_view_size;
+    highp vec4 leia_camera;
+    highp vec4 leia_num_views;
+};
+)";
+
+static_assert(CAMERA_BLOCK_MAX_VIEWS == 16,
+              "CAMERA_BLOCK_SOURCE declares 16 view projections");
+static_assert(sizeof(CAMERA_BLOCK) == (16 * 16 + 6 * 4) * sizeof(GLfloat),
+              "CAMERA_BLOCK must have the std140 layout, no padding");
+
+// Uploads per storage of the buffer, a frame uploads once or twice
+static const int32_t CAMERA_BUFFER_SLOTS = 8;
+
+CameraBuffer::CameraBuffer()
+    : buffer_(0), slot_size_(0), slot_(0), valid_(false), num_uploads_(0) {
+  memset(&block_, 0, sizeof(block_));
+  memset(&uploaded_, 0, sizeof(uploaded_));
+}
+
+CameraBuffer::~CameraBuffer() {}
+
+void CameraBuffer::SetCamera(const LeiaCameraData* data) {
+  const float to_radians = 3.14159f / 180.0f;
+  block_.view_size[0] = data->mViewResXPixels;
+  block_.view_size[1] = data->mViewResYPixels;
+  block_.view_size[2] = data->mViewResXPixels / data->mViewResYPixels;
+  block_.view_size[3] = 0.5f * data->mViewResYPixels /
+                        tanf(0.5f * data->mVerticalFieldOfView * to_radians);
+  block_.camera[0] = data->mConvergenceDistance;
+  block_.camera[1] = data->mBaseline;
+  block_.camera[2] = data->mNear;
+  block_.camera[3] = data->mFar;
+  block_.num_views[0] = (float)data->mNumViewsHorizontal;
+  block_.num_views[1] = (float)data->mNumViewsVertical;
+  block_.num_views[2] =
+      (float)(data->mNumViewsHorizontal * data->mNumViewsVertical);
+}
+
+void CameraBuffer::SetViewProjections(const float* projections,
+                                      int32_t stride, int32_t num_views) {
+  if (num_views > CAMERA_BLOCK_MAX_VIEWS) num_views = CAMERA_BLOCK_MAX_VIEWS;
+  for (int32_t i = 0; i < num_views; ++i) {
+    memcpy(block_.view_projections[i], projections + i * stride,
+           16 * sizeof(GLfloat));
+  }
+}
+
+void CameraBuffer::SetLight(const float* light0, const float* material_ambient,
+                            const float* material_specular) {
+  memcpy(block_.light0, light0, 3 * sizeof(GLfloat));
+  memcpy(block_.material_ambient, material_ambient, 3 * sizeof(GLfloat));
+  memcpy(block_.material_specular, material_specular, 4 * sizeof(GLfloat));
+}
+
+void CameraBuffer::Upload() {
+  if (!buffer_) {
+    GLint alignment = 1;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    if (alignment < 1) alignment = 1;
+    slot_size_ = (sizeof(CAMERA_BLOCK) + alignment - 1) / alignment * alignment;
+    glGenBuffers(1, &buffer_);
+    slot_ = CAMERA_BUFFER_SLOTS - 1;
+    valid_ = false;
+  }
+
+  if (!valid_ || memcmp(&block_, &uploaded_, sizeof(block_))) {
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer_);
+    if (++slot_ >= CAMERA_BUFFER_SLOTS) {
+      // Fresh storage, frames in flight keep reading the old one
+      glBufferData(GL_UNIFORM_BUFFER, slot_size_ * CAMERA_BUFFER_SLOTS, NULL,
+                   GL_STREAM_DRAW);
+      slot_ = 0;
+    }
+    // Not written since the orphaning, nothing to synchronize with
+    GLintptr offset = slot_ * slot_size_;
+    void* mapped = glMapBufferRange(
+        GL_UNIFORM_BUFFER, offset, sizeof(block_),
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT |
+            GL_MAP_UNSYNCHRONIZED_BIT);
+    bool written = false;
+    if (mapped) {
+      memcpy(mapped, &block_, sizeof(block_));
+      written = glUnmapBuffer(GL_UNIFORM_BUFFER) == GL_TRUE;
+    }
+    if (!written) {
+      glBufferSubData(GL_UNIFORM_BUFFER, offset, sizeof(block_), &block_);
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    uploaded_ = block_;
+    valid_ = true;
+    ++num_uploads_;
+  }
+  glBindBufferRange(GL_UNIFORM_BUFFER, CAMERA_BLOCK_BINDING, buffer_,
+                    slot_ * slot_size_, sizeof(block_));
+}
+
+void CameraBuffer::Unload() {
+  if (buffer_) {
+    glDeleteBuffers(1, &buffer_);
+    buffer_ = 0;
+  }
+  valid_ = false;
+}
+
+void UseCameraBlock(const GLuint program) {
+  LeiaRenderContext::GetInstance()->BindUniformBlock(program, "LeiaCamera",
+                                                     CAMERA_BLOCK_BINDING);
+}
+
+}  // namespace leia_helper
@@ -0,0 +1,117 @@
+/*
+ * Copyright 2018 Leia Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//--------------------------------------------------------------------------------
+// cameraBuffer.h
+//--------------------------------------------------------------------------------
+#ifndef LEIA_HELPER_CAMERABUFFER_H_
+#define LEIA_HELPER_CAMERABUFFER_H_
+
+#include "gl3stub.h"
+#include "LeiaCameraViews.h"
+
+namespace leia_helper {
+
+static const int32_t CAMERA_BLOCK_MAX_VIEWS = 16;
+// Uniform buffer binding point of the LeiaCamera block
+static const GLuint CAMERA_BLOCK_BINDING = 0;
+// Shader tag replaced by CAMERA_BLOCK_SOURCE, see shader::ReadShader()
+#define CAMERA_BLOCK_TAG "%LEIA_CAMERA_BLOCK%"
+
+/******************************************************************
+ * The LeiaCamera uniform block, std140, as CAMERA_BLOCK_SOURCE declares it
+ *
+ * view_projections: projection of each view, view y * horizontal + x
+ * light0, material_ambient, material_specular: lighting of the scene
+ *                   programs, xyz, xyz and xyz + power
+ * view_size: view width and height in pixels, width / height, focal length
+ *            in pixels
+ * camera: convergence distance, baseline, near, far
+ * num_views: horizontal, vertical, total
+ */
+struct CAMERA_BLOCK {
+  GLfloat view_projections[CAMERA_BLOCK_MAX_VIEWS][16];
+  GLfloat light0[4];
+  GLfloat material_ambient[4];
+  GLfloat material_specular[4];
+  GLfloat view_size[4];
+  GLfloat camera[4];
+  GLfloat num_views[4];
+};
+
+// GLSL ES 3.00 declaration of the block, for shaders to include
+extern const char* CAMERA_BLOCK_SOURCE;
+
+/******************************************************************
+ * Per frame camera uniforms of the scene and post programs, one upload
+ * whatever the view and object count
+ *
+ *   camera_buffer.SetCamera(&data);
+ *   camera_buffer.SetViewProjections(cameras[0][0].matrix, 32, num_views);
+ *   camera_buffer.Upload();
+ *   ...
+ *   context->UseProgram(program);
+ *   UseCameraBlock(program);
+ *
+ * Upload() writes the block to the next slot of a ring in one buffer and
+ * binds that slot to CAMERA_BLOCK_BINDING. The buffer is orphaned when the
+ * ring wraps around, slots are only ever written once per storage, so
+ * mapping never waits for frames the GPU is still reading. A block equal
+ * to the last upload only binds again.
+ */
+class CameraBuffer {
+ private:
+  CAMERA_BLOCK block_;
+  CAMERA_BLOCK uploaded_;
+  GLuint buffer_;
+  GLsizeiptr slot_size_;
+  int32_t slot_;
+  bool valid_;
+  int32_t num_uploads_;
+
+  CameraBuffer(const CameraBuffer&);
+  CameraBuffer& operator=(const CameraBuffer&);
+
+ public:
+  CameraBuffer();
+  ~CameraBuffer();
+
+  // View size, focal length, convergence, baseline, clip planes, view count
+  void SetCamera(const LeiaCameraData* data);
+  // num_views matrices, stride floats apart, more than
+  // CAMERA_BLOCK_MAX_VIEWS are dropped
+  void SetViewProjections(const float* projections, int32_t stride,
+                          int32_t num_views);
+  void SetLight(const float* light0, const float* material_ambient,
+                const float* material_specular);
+
+  void Upload();
+  void Unload();
+
+  const CAMERA_BLOCK& GetBlock() const { return block_; }
+  // Uploads that wrote the buffer, binds of an unchanged block not counted
+  int32_t GetNumUploads() const { return num_uploads_; }
+};
+
+/******************************************************************
+ * UseCameraBlock()
+ * Connects the LeiaCamera block of program to CAMERA_BLOCK_BINDING. Block
+ * bindings are program state, LeiaRenderContext sets them once per program.
+ */
+void UseCameraBlock(const GLuint program);
+
+}  // namespace leia_helper
+#endif /* LEIA_HELPER_CAMERABUFFER_H_ */
@@ -0,0 +1,424 @@
+/*
+ * Copyright 2018 Leia Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//--------------------------------------------------------------------------------
+// cpuInterlacer.cpp
+// CPU reference of the interlacing and view sharpening passes
+//
+// Must be built with -ffp-contract=off: the scalar and SIMD kernels run the
+// same float operations in the same order, fused multiply-adds would make
+// them disagree.
+//--------------------------------------------------------------------------------
+#include <math.h>
+#include <string.h>
+
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#include <immintrin.h>
+#define LEIA_HELPER_X86 1
+#endif
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#define LEIA_HELPER_NEON 1
+#endif
+
+#include "cpuInterlacer.h"
+#include "cpuParallel.h"
+
+namespace leia_helper {
+
+//--------------------------------------------------------------------------------
+// ISA selection
+//--------------------------------------------------------------------------------
+bool IsCpuIsaSupported(const CPU_ISA isa) {
+  switch (isa) {
+    case CPU_ISA_SCALAR:
+      return true;
+#if defined(LEIA_HELPER_X86)
+    case CPU_ISA_SSE2:
+      return true;
+    case CPU_ISA_AVX2:
+      return __builtin_cpu_supports("avx2");
+#endif
+#if defined(LEIA_HELPER_NEON)
+    case CPU_ISA_NEON:
+      return true;
+#endif
+    default:
+      return false;
+  }
+}
+
+CPU_ISA GetBestCpuIsa() {
+  if (IsCpuIsaSupported(CPU_ISA_AVX2)) return CPU_ISA_AVX2;
+  if (IsCpuIsaSupported(CPU_ISA_SSE2)) return CPU_ISA_SSE2;
+  if (IsCpuIsaSupported(CPU_ISA_NEON)) return CPU_ISA_NEON;
+  return CPU_ISA_SCALAR;
+}
+
+const char* GetCpuIsaName(const CPU_ISA isa) {
+  static const char* names[CPU_ISA_COUNT] = {"scalar", "sse2", "avx2", "neon"};
+  return isa >= 0 && isa < CPU_ISA_COUNT ? names[isa] : "unknown";
+}
+
+//--------------------------------------------------------------------------------
+// Sharpening kernels
+// A row is first linearised, lin = (v / 255)^2 for every channel, with two
+// clamped pixels of padding on each side. The filter is then a 5 tap over
+// floats 4 apart, identical for every channel:
+//   out = sqrt(clamp((c - b*ll - a*l - a*r - b*rr) / (1 - 2a - 2b), 0, 1))
+//--------------------------------------------------------------------------------
+struct SHARPEN_PARAMS {
+  float a;
+  float b;
+  float multiplier;
+};
+
+static const int32_t PAD = 2;
+
+static void LinearizeScalar(const uint8_t* src, float* dst, int32_t count) {
+  for (int32_t i = 0; i < count; ++i) {
+    float f = src[i] / 255.0f;
+    dst[i] = f * f;
+  }
+}
+
+static void FilterScalar(const float* lin, uint8_t* dst, int32_t count,
+                         const SHARPEN_PARAMS& p) {
+  for (int32_t i = 0; i < count; ++i) {
+    float ll = p.b * lin[i];
+    float l = p.a * lin[i + 4];
+    float r = p.a * lin[i + 12];
+    float rr = p.b * lin[i + 16];
+    float v = lin[i + 8] - ll;
+    v = v - l;
+    v = v - r;
+    v = v - rr;
+    v = v / p.multiplier;
+    v = v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v);
+    v = sqrtf(v) * 255.0f;
+    v = v + 0.5f;
+    dst[i] = (uint8_t)(int32_t)v;
+  }
+}
+
+#if defined(LEIA_HELPER_X86)
+static void LinearizeSSE2(const uint8_t* src, float* dst, int32_t count) {
+  const __m128 scale = _mm_set1_ps(255.0f);
+  const __m128i zero = _mm_setzero_si128();
+  int32_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+    __m128i lo = _mm_unpacklo_epi8(v, zero);
+    __m128i hi = _mm_unpackhi_epi8(v, zero);
+    __m128i q[4] = {_mm_unpacklo_epi16(lo, zero), _mm_unpackhi_epi16(lo, zero),
+                    _mm_unpacklo_epi16(hi, zero), _mm_unpackhi_epi16(hi, zero)};
+    for (int32_t k = 0; k < 4; ++k) {
+      __m128 f = _mm_div_ps(_mm_cvtepi32_ps(q[k]), scale);
+      _mm_storeu_ps(dst + i + k * 4, _mm_mul_ps(f, f));
+    }
+  }
+  LinearizeScalar(src + i, dst + i, count - i);
+}
+
+static void FilterSSE2(const float* lin, uint8_t* dst, int32_t count,
+                       const SHARPEN_PARAMS& p) {
+  const __m128 a = _mm_set1_ps(p.a);
+  const __m128 b = _mm_set1_ps(p.b);
+  const __m128 multiplier = _mm_set1_ps(p.multiplier);
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128 scale = _mm_set1_ps(255.0f);
+  const __m128 half = _mm_set1_ps(0.5f);
+  int32_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m128i q[4];
+    for (int32_t k = 0; k < 4; ++k) {
+      const float* s = lin + i + k * 4;
+      __m128 v = _mm_sub_ps(_mm_loadu_ps(s + 8), _mm_mul_ps(b, _mm_loadu_ps(s)));
+      v = _mm_sub_ps(v, _mm_mul_ps(a, _mm_loadu_ps(s + 4)));
+      v = _mm_sub_ps(v, _mm_mul_ps(a, _mm_loadu_ps(s + 12)));
+      v = _mm_sub_ps(v, _mm_mul_ps(b, _mm_loadu_ps(s + 16)));
+      v = _mm_div_ps(v, multiplier);
+      v = _mm_min_ps(_mm_max_ps(v, zero), one);
+      v = _mm_add_ps(_mm_mul_ps(_mm_sqrt_ps(v), scale), half);
+      q[k] = _mm_cvttps_epi32(v);
+    }
+    __m128i lo = _mm_packs_epi32(q[0], q[1]);
+    __m128i hi = _mm_packs_epi32(q[2], q[3]);
+    _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(lo, hi));
+  }
+  FilterScalar(lin + i, dst + i, count - i, p);
+}
+
+__attribute__((target("avx2"))) static void LinearizeAVX2(const uint8_t* src,
+                                                           float* dst,
+                                                           int32_t count) {
+  const __m256 scale = _mm256_set1_ps(255.0f);
+  int32_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m128i v = _mm_loadl_epi64((const __m128i*)(src + i));
+    __m256 f = _mm256_div_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(v)), scale);
+    _mm256_storeu_ps(dst + i, _mm256_mul_ps(f, f));
+  }
+  LinearizeScalar(src + i, dst + i, count - i);
+}
+
+__attribute__((target("avx2"))) static void FilterAVX2(
+    const float* lin, uint8_t* dst, int32_t count, const SHARPEN_PARAMS& p) {
+  const __m256 a = _mm256_set1_ps(p.a);
+  const __m256 b = _mm256_set1_ps(p.b);
+  const __m256 multiplier = _mm256_set1_ps(p.multiplier);
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 one = _mm256_set1_ps(1.0f);
+  const __m256 scale = _mm256_set1_ps(255.0f);
+  const __m256 half = _mm256_set1_ps(0.5f);
+  int32_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m256i q[2];
+    for (int32_t k = 0; k < 2; ++k) {
+      const float* s = lin + i + k * 8;
+      __m256 v = _mm256_sub_ps(_mm256_loadu_ps(s + 8),
+                               _mm256_mul_ps(b, _mm256_loadu_ps(s)));
+      v = _mm256_sub_ps(v, _mm256_mul_ps(a, _mm256_loadu_ps(s + 4)));
+      v = _mm256_sub_ps(v, _mm256_mul_ps(a, _mm256_loadu_ps(s + 12)));
+      v = _mm256_sub_ps(v, _mm256_mul_ps(b, _mm256_loadu_ps(s + 16)));
+      v = _mm256_div_ps(v, multiplier);
+      v = _mm256_min_ps(_mm256_max_ps(v, zero), one);
+      v = _mm256_add_ps(_mm256_mul_ps(_mm256_sqrt_ps(v), scale), half);
+      q[k] = _mm256_cvttps_epi32(v);
+    }
+    // Packs work per 128 bit lane, put the lanes back in order afterwards
+    __m256i w = _mm256_packs_epi32(q[0], q[1]);
+    __m256i bytes = _mm256_packus_epi16(w, w);
+    bytes = _mm256_permutevar8x32_epi32(bytes,
+                                        _mm256_setr_epi32(0, 4, 1, 5, 0, 0, 0, 0));
+    _mm_storeu_si128((__m128i*)(dst + i), _mm256_castsi256_si128(bytes));
+  }
+  FilterScalar(lin + i, dst + i, count - i, p);
+}
+#endif
+
+#if defined(LEIA_HELPER_NEON)
+static void LinearizeNEON(const uint8_t* src, float* dst, int32_t count) {
+  const float32x4_t scale = vdupq_n_f32(255.0f);
+  int32_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    uint8x16_t v = vld1q_u8(src + i);
+    uint16x8_t lo = vmovl_u8(vget_low_u8(v));
+    uint16x8_t hi = vmovl_u8(vget_high_u8(v));
+    uint32x4_t q[4] = {vmovl_u16(vget_low_u16(lo)), vmovl_u16(vget_high_u16(lo)),
+                       vmovl_u16(vget_low_u16(hi)), vmovl_u16(vget_high_u16(hi))};
+    for (int32_t k = 0; k < 4; ++k) {
+      float32x4_t f = vdivq_f32(vcvtq_f32_u32(q[k]), scale);
+      vst1q_f32(dst + i + k * 4, vmulq_f32(f, f));
+    }
+  }
+  LinearizeScalar(src + i, dst + i, count - i);
+}
+
+static void FilterNEON(const float* lin, uint8_t* dst, int32_t count,
+                       const SHARPEN_PARAMS& p) {
+  const float32x4_t a = vdupq_n_f32(p.a);
+  const float32x4_t b = vdupq_n_f32(p.b);
+  const float32x4_t multiplier = vdupq_n_f32(p.multiplier);
+  const float32x4_t zero = vdupq_n_f32(0.0f);
+  const float32x4_t one = vdupq_n_f32(1.0f);
+  const float32x4_t scale = vdupq_n_f32(255.0f);
+  const float32x4_t half = vdupq_n_f32(0.5f);
+  int32_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    uint32x4_t q[4];
+    for (int32_t k = 0; k < 4; ++k) {
+      const float* s = lin + i + k * 4;
+      float32x4_t v = vsubq_f32(vld1q_f32(s + 8), vmulq_f32(b, vld1q_f32(s)));
+      v = vsubq_f32(v, vmulq_f32(a, vld1q_f32(s + 4)));
+      v = vsubq_f32(v, vmulq_f32(a, vld1q_f32(s + 12)));
+      v = vsubq_f32(v, vmulq_f32(b, vld1q_f32(s + 16)));
+      v = vdivq_f32(v, multiplier);
+      v = vminq_f32(vmaxq_f32(v, zero), one);
+      v = vaddq_f32(vmulq_f32(vsqrtq_f32(v), scale), half);
+      q[k] = vcvtq_u32_f32(v);
+    }
+    uint16x8_t lo = vcombine_u16(vmovn_u32(q[0]), vmovn_u32(q[1]));
+    uint16x8_t hi = vcombine_u16(vmovn_u32(q[2]), vmovn_u32(q[3]));
+    vst1q_u8(dst + i, vcombine_u8(vmovn_u16(lo), vmovn_u16(hi)));
+  }
+  FilterScalar(lin + i, dst + i, count - i, p);
+}
+#endif
+
+static void SharpenRow(const uint8_t* padded_row, float* lin, uint8_t* dst,
+                       int32_t width, const SHARPEN_PARAMS& p,
+                       const CPU_ISA isa) {
+  const int32_t padded_count = (width + 2 * PAD) * 4;
+  const int32_t count = width * 4;
+  switch (isa) {
+#if defined(LEIA_HELPER_X86)
+    case CPU_ISA_SSE2:
+      LinearizeSSE2(padded_row, lin, padded_count);
+      FilterSSE2(lin, dst, count, p);
+      return;
+    case CPU_ISA_AVX2:
+      LinearizeAVX2(padded_row, lin, padded_count);
+      FilterAVX2(lin, dst, count, p);
+      return;
+#endif
+#if defined(LEIA_HELPER_NEON)
+    case CPU_ISA_NEON:
+      LinearizeNEON(padded_row, lin, padded_count);
+      FilterNEON(lin, dst, count, p);
+      return;
+#endif
+    default:
+      LinearizeScalar(padded_row, lin, padded_count);
+      FilterScalar(lin, dst, count, p);
+      return;
+  }
+}
+
+static void PadRow(uint8_t* padded_row, int32_t width) {
+  for (int32_t i = 0; i < PAD; ++i) {
+    memcpy(padded_row + i * 4, padded_row + PAD * 4, 4);
+    memcpy(padded_row + (PAD + width + i) * 4,
+           padded_row + (PAD + width - 1) * 4, 4);
+  }
+}
+
+static SHARPEN_PARAMS GetSharpenParams(const float* act_coefficients,
+                                       int num_act_coefficients) {
+  SHARPEN_PARAMS p;
+  p.a = num_act_coefficients > 0 ? act_coefficients[0] : 0.0f;
+  p.b = num_act_coefficients > 1 ? act_coefficients[1] : 0.0f;
+  p.multiplier = 1.0f - (2.0f * p.a) - (2.0f * p.b);
+  return p;
+}
+
+//--------------------------------------------------------------------------------
+// Interlacing
+// Pure gather, each pixel is one 32 bit copy from the view its column maps to,
+// through per column tables. Memory bound, the ISA does not change it.
+//--------------------------------------------------------------------------------
+struct INTERLACE_TABLES {
+  std::vector<int32_t> source_x;
+  std::vector<int32_t> view_x;
+  int32_t num_h;
+  int32_t num_v;
+};
+
+// GL_NEAREST fetch of the texel under a pixel centre:
+// floor((i + 0.5) * source / target)
+static int32_t NearestTexel(int32_t i, int32_t source, int32_t target) {
+  return (int32_t)(((int64_t)(2 * i + 1) * source) / (2 * (int64_t)target));
+}
+
+static void BuildInterlaceTables(const CPU_VIEWS& views,
+                                 const LeiaCameraData* data,
+                                 int alignment_offset, int32_t screen_width,
+                                 INTERLACE_TABLES* tables) {
+  tables->num_h = data->mNumViewsHorizontal > 0
+                      ? (int32_t)data->mNumViewsHorizontal
+                      : 1;
+  tables->num_v =
+      data->mNumViewsVertical > 0 ? (int32_t)data->mNumViewsVertical : 1;
+  tables->source_x.resize(screen_width);
+  tables->view_x.resize(screen_width);
+  for (int32_t x = 0; x < screen_width; ++x) {
+    tables->source_x[x] = NearestTexel(x, views.view_width, screen_width);
+    int32_t view = (x + alignment_offset) % tables->num_h;
+    tables->view_x[x] = view < 0 ? view + tables->num_h : view;
+  }
+}
+
+static void InterlaceRow(const CPU_VIEWS& views, const INTERLACE_TABLES& tables,
+                         int32_t y, int32_t screen_width, int32_t screen_height,
+                         uint8_t* dst) {
+  const int32_t source_y = NearestTexel(y, views.view_height, screen_height);
+  const size_t row_offset = (size_t)source_y * views.view_width;
+  const uint8_t* const* row_views =
+      views.views + (y % tables.num_v) * tables.num_h;
+  for (int32_t x = 0; x < screen_width; ++x) {
+    const uint8_t* src =
+        row_views[tables.view_x[x]] + (row_offset + tables.source_x[x]) * 4;
+    memcpy(dst + x * 4, src, 4);
+  }
+}
+
+//--------------------------------------------------------------------------------
+// Passes
+//--------------------------------------------------------------------------------
+void CpuViewInterlace(const CPU_VIEWS& views, const LeiaCameraData* data,
+                      int alignment_offset, uint8_t* interlaced,
+                      int32_t screen_width, int32_t screen_height,
+                      const CPU_ISA isa, int32_t num_threads) {
+  INTERLACE_TABLES tables;
+  BuildInterlaceTables(views, data, alignment_offset, screen_width, &tables);
+  ParallelRanges(screen_height, num_threads, 1, [&](int32_t begin, int32_t end) {
+    for (int32_t y = begin; y < end; ++y) {
+      InterlaceRow(views, tables, y, screen_width, screen_height,
+                   interlaced + (size_t)y * screen_width * 4);
+    }
+  });
+}
+
+void CpuViewSharpening(const uint8_t* interlaced, int32_t screen_width,
+                       int32_t screen_height, const float* act_coefficients,
+                       int num_act_coefficients, uint8_t* sharpened,
+                       const CPU_ISA isa, int32_t num_threads) {
+  const SHARPEN_PARAMS p =
+      GetSharpenParams(act_coefficients, num_act_coefficients);
+  ParallelRanges(screen_height, num_threads, 1, [&](int32_t begin, int32_t end) {
+    std::vector<uint8_t> padded_row((screen_width + 2 * PAD) * 4);
+    std::vector<float> lin(padded_row.size());
+    for (int32_t y = begin; y < end; ++y) {
+      memcpy(&padded_row[PAD * 4], interlaced + (size_t)y * screen_width * 4,
+             screen_width * 4);
+      PadRow(&padded_row[0], screen_width);
+      SharpenRow(&padded_row[0], &lin[0],
+                 sharpened + (size_t)y * screen_width * 4, screen_width, p,
+                 isa);
+    }
+  });
+}
+
+void CpuViewInterlaceAndSharpen(const CPU_VIEWS& views,
+                                const LeiaCameraData* data,
+                                int alignment_offset,
+                                const float* act_coefficients,
+                                int num_act_coefficients, uint8_t* sharpened,
+                                int32_t screen_width, int32_t screen_height,
+                                const CPU_ISA isa, int32_t num_threads) {
+  INTERLACE_TABLES tables;
+  BuildInterlaceTables(views, data, alignment_offset, screen_width, &tables);
+  const SHARPEN_PARAMS p =
+      GetSharpenParams(act_coefficients, num_act_coefficients);
+  ParallelRanges(screen_height, num_threads, 1, [&](int32_t begin, int32_t end) {
+    std::vector<uint8_t> padded_row((screen_width + 2 * PAD) * 4);
+    std::vector<float> lin(padded_row.size());
+    for (int32_t y = begin; y < end; ++y) {
+      InterlaceRow(views, tables, y, screen_width, screen_height,
+                   &padded_row[PAD * 4]);
+      PadRow(&padded_row[0], screen_width);
+      SharpenRow(&padded_row[0], &lin[0],
+                 sharpened + (size_t)y * screen_width * 4, screen_width, p,
+                 isa);
+    }
+  });
+}
+
+}  // namespace leia_helper
@@ -0,0 +1,108 @@
+/*
+ * Copyright 2018 Leia Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//--------------------------------------------------------------------------------
+// cpuInterlacer.h
+//--------------------------------------------------------------------------------
+#ifndef LEIA_HELPER_CPUINTERLACER_H_
+#define LEIA_HELPER_CPUINTERLACER_H_
+
+#include <stdint.h>
+
+#include "LeiaCameraViews.h"
+
+namespace leia_helper {
+
+/******************************************************************
+ * CPU reference of the Leia interlacing and view sharpening passes
+ *
+ * Computes what leiaViewInterlace() and leiaViewSharpening() render, on
+ * tightly packed RGBA8 buffers, for regression tests of the GL passes and
+ * offline encoding. No GL context is needed.
+ *
+ * Buffers are in GL order: the first row is the bottom of the image, like
+ * glReadPixels() returns it. Views are sampled with GL_NEAREST and the
+ * sharpening neighbours are clamped to the screen edge.
+ *
+ * Every ISA produces bit identical output. Against the GPU passes results
+ * agree within 1 LSB, shader float precision and rounding differ slightly;
+ * host/pipeline-bench reads the GL results back and checks it on llvmpipe.
+ * A fused GL pass reading views more precise than RGBA8 sharpens those
+ * values and is not covered.
+ */
+enum CPU_ISA {
+  CPU_ISA_SCALAR,
+  CPU_ISA_SSE2,
+  CPU_ISA_AVX2,
+  CPU_ISA_NEON,
+  CPU_ISA_COUNT
+};
+
+bool IsCpuIsaSupported(const CPU_ISA isa);
+CPU_ISA GetBestCpuIsa();
+const char* GetCpuIsaName(const CPU_ISA isa);
+
+/******************************************************************
+ * Source views for the CPU passes
+ * views holds data->mNumViewsHorizontal * mNumViewsVertical pointers, view
+ * (x, y) at index y * mNumViewsHorizontal + x, each view_width * view_height
+ * RGBA8 pixels.
+ */
+struct CPU_VIEWS {
+  const uint8_t* const* views;
+  int32_t view_width;
+  int32_t view_height;
+};
+
+/******************************************************************
+ * CpuViewInterlace()
+ *
+ * arguments:
+ *  in: views, source views
+ *  in: data, view layout
+ *  in: alignment_offset, same as leiaViewInterlace()
+ *  out: interlaced, screen_width * screen_height RGBA8 pixels
+ *  in: isa, instruction set, must be supported
+ *  in: num_threads, rows are split across threads, 0 picks the core count
+ */
+void CpuViewInterlace(const CPU_VIEWS& views, const LeiaCameraData* data,
+                      int alignment_offset, uint8_t* interlaced,
+                      int32_t screen_width, int32_t screen_height,
+                      const CPU_ISA isa, int32_t num_threads);
+
+/******************************************************************
+ * CpuViewSharpening()
+ * act_coefficients are the {a, b} pair leiaViewSharpening() takes.
+ */
+void CpuViewSharpening(const uint8_t* interlaced, int32_t screen_width,
+                       int32_t screen_height, const float* act_coefficients,
+                       int num_act_coefficients, uint8_t* sharpened,
+                       const CPU_ISA isa, int32_t num_threads);
+
+/******************************************************************
+ * CpuViewInterlaceAndSharpen()
+ * Both passes row by row, without the screen sized intermediate buffer.
+ */
+void CpuViewInterlaceAndSharpen(const CPU_VIEWS& views,
+                                const LeiaCameraData* data,
+                                int alignment_offset,
+                                const float* act_coefficients,
+                                int num_act_coefficients, uint8_t* sharpened,
+                                int32_t screen_width, int32_t screen_height,
+                                const CPU_ISA isa, int32_t num_threads);
+
+}  // namespace leia_helper
+#endif /* LEIA_HELPER_CPUINTERLACER_H_ */
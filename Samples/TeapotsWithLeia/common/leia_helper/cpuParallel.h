@@ -0,0 +1,62 @@
+/*
+ * Copyright 2018 Leia Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//--------------------------------------------------------------------------------
+// cpuParallel.h
+// Splitting of the CPU passes across threads
+//--------------------------------------------------------------------------------
+#ifndef LEIA_HELPER_CPUPARALLEL_H_
+#define LEIA_HELPER_CPUPARALLEL_H_
+
+#include <stdint.h>
+
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace leia_helper {
+
+/******************************************************************
+ * ParallelRanges()
+ * Calls range(begin, end) over [0, count) split in num_threads contiguous
+ * ranges, the calling thread takes the first one. num_threads <= 0 picks the
+ * core count, no range is smaller than min_range items.
+ */
+inline void ParallelRanges(int32_t count, int32_t num_threads,
+                           int32_t min_range,
+                           const std::function<void(int32_t, int32_t)>& range) {
+  if (num_threads <= 0) num_threads = (int32_t)std::thread::hardware_concurrency();
+  if (min_range > 1 && num_threads > count / min_range)
+    num_threads = count / min_range;
+  if (num_threads > count) num_threads = count;
+  if (num_threads <= 1) {
+    range(0, count);
+    return;
+  }
+
+  std::vector<std::thread> threads;
+  threads.reserve(num_threads - 1);
+  for (int32_t i = 1; i < num_threads; ++i) {
+    int32_t begin = (int32_t)((int64_t)count * i / num_threads);
+    int32_t end = (int32_t)((int64_t)count * (i + 1) / num_threads);
+    threads.push_back(std::thread(range, begin, end));
+  }
+  range(0, count / num_threads);
+  for (size_t i = 0; i < threads.size(); ++i) threads[i].join();
+}
+
+}  // namespace leia_helper
+#endif /* LEIA_HELPER_CPUPARALLEL_H_ */
@@ -0,0 +1,188 @@
+/*
+ * Copyright 2018 Leia Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//--------------------------------------------------------------------------------
+// cpuViewSynthesis.cpp
+// Depth image based view synthesis, parameters and CPU reference
+//--------------------------------------------------------------------------------
+#include <math.h>
+#include <string.h>
+
+#include "cpuViewSynthesis.h"
+
+namespace leia_helper {
+
+// Search steps per mode
+static const int32_t FAST_SEARCH_STEPS = 16;
+static const int32_t QUALITY_SEARCH_STEPS = 48;
+// The search window is capped to this fraction of the view width per step,
+// content with more disparity than that does not fuse on the display anyway
+static const float MAX_DISPARITY_VIEW_FRACTION = 1.0f / 16.0f;
+// Targets closer than this to a source, in view steps, are plain copies
+static const float COPY_DISTANCE = 1.0e-4f;
+
+const char* GetViewSynthesisModeName(const VIEW_SYNTHESIS_MODE mode) {
+  static const char* names[VIEW_SYNTHESIS_MODE_COUNT] = {"off", "fast",
+                                                         "quality"};
+  return mode >= 0 && mode < VIEW_SYNTHESIS_MODE_COUNT ? names[mode]
+                                                       : "unknown";
+}
+
+bool GetViewSynthesisParams(const LeiaCameraData* data,
+                            const VIEW_SYNTHESIS_MODE mode,
+                            VIEW_SYNTHESIS_PARAMS* params) {
+  if (mode != VIEW_SYNTHESIS_FAST && mode != VIEW_SYNTHESIS_QUALITY)
+    return false;
+  if (data->mNumViewsVertical != 1 || data->mNumViewsHorizontal < 2)
+    return false;
+
+  memset(params, 0, sizeof(*params));
+  params->num_views = data->mNumViewsHorizontal;
+  float centre = 0.5f * (params->num_views - 1);
+  if (mode == VIEW_SYNTHESIS_FAST) {
+    params->num_sources = 1;
+    params->source_positions[0] = centre;
+    params->search_steps = FAST_SEARCH_STEPS;
+  } else {
+    params->num_sources = 2;
+    params->source_positions[0] = centre - 0.5f;
+    params->source_positions[1] = centre + 0.5f;
+    params->search_steps = QUALITY_SEARCH_STEPS;
+  }
+
+  // Same focal length in pixels as the depth of field pass
+  const float to_radians = 3.14159f / 180.0f;
+  float f_in_pixels = 0.5f * data->mViewResYPixels /
+                      tanf(0.5f * data->mVerticalFieldOfView * to_radians);
+  params->disparity_scale = data->mBaseline * f_in_pixels;
+  params->convergence_distance = data->mConvergenceDistance;
+  params->near = data->mNear;
+  params->far = data->mFar;
+
+  // Disparity goes from the near plane (most negative) to the far plane
+  float limit = data->mViewResXPixels * MAX_DISPARITY_VIEW_FRACTION;
+  float near_disparity = params->disparity_scale *
+                         (1.0f / params->convergence_distance - 1.0f / params->near);
+  float far_disparity = params->disparity_scale *
+                        (1.0f / params->convergence_distance - 1.0f / params->far);
+  params->min_disparity = fmaxf(near_disparity, -limit);
+  params->max_disparity = fminf(far_disparity, limit);
+  return params->min_disparity < params->max_disparity;
+}
+
+//--------------------------------------------------------------------------------
+// CPU reference
+// Runs the operations of the GL pass in the same order
+//--------------------------------------------------------------------------------
+static float LinearDepth(const VIEW_SYNTHESIS_PARAMS& params, float depth) {
+  float z_n = 2.0f * depth - 1.0f;
+  return 2.0f * params.near * params.far /
+         (params.far + params.near - z_n * (params.far - params.near));
+}
+
+static float Disparity(const VIEW_SYNTHESIS_PARAMS& params, float z) {
+  return params.disparity_scale *
+         (1.0f / params.convergence_distance - 1.0f / z);
+}
+
+// Source texel landing on pixel x of a view offset view_steps from the source,
+// or the farthest texel searched when none does
+static bool SearchSource(const VIEW_SYNTHESIS_PARAMS& params,
+                         const float* depth_row, int32_t view_width,
+                         float view_steps, int32_t x, int32_t* texel,
+                         int32_t* background_texel) {
+  float x_target = x + 0.5f;
+  if (fabsf(view_steps) < COPY_DISTANCE) {
+    *texel = x;
+    return true;
+  }
+
+  float step =
+      (params.max_disparity - params.min_disparity) / params.search_steps;
+  float tolerance = 0.5f * fmaxf(1.0f, fabsf(view_steps) * step);
+  float best_z = 0.0f;
+  float background_z = 0.0f;
+  bool found = false;
+  for (int32_t i = 0; i < params.search_steps; ++i) {
+    float d = params.min_disparity + (i + 0.5f) * step;
+    int32_t sx = (int32_t)floorf(x_target - view_steps * d);
+    sx = sx < 0 ? 0 : (sx >= view_width ? view_width - 1 : sx);
+    float z = LinearDepth(params, depth_row[sx]);
+    if (i == 0 || z > background_z) {
+      background_z = z;
+      *background_texel = sx;
+    }
+    float error =
+        fabsf(sx + 0.5f + view_steps * Disparity(params, z) - x_target);
+    if (error <= tolerance && (!found || z < best_z)) {
+      best_z = z;
+      *texel = sx;
+      found = true;
+    }
+  }
+  return found;
+}
+
+void CpuViewSynthesis(const VIEW_SYNTHESIS_PARAMS& params,
+                      const uint8_t* const* source_colors,
+                      const float* const* source_depths, int32_t view_width,
+                      int32_t view_height, uint8_t* const* views,
+                      float* const* view_depths, VIEW_SYNTHESIS_STATS* stats) {
+  VIEW_SYNTHESIS_STATS counts = {0, 0, 0};
+  for (int32_t view = 0; view < params.num_views; ++view) {
+    // Nearest source first, the other one fills disocclusions
+    int32_t primary = 0;
+    if (params.num_sources > 1 &&
+        fabsf(view - params.source_positions[1]) <
+            fabsf(view - params.source_positions[0]))
+      primary = 1;
+    int32_t secondary = params.num_sources > 1 ? 1 - primary : -1;
+    float primary_steps = view - params.source_positions[primary];
+    if (fabsf(primary_steps) >= COPY_DISTANCE)
+      counts.synthesized_pixels += (int64_t)view_width * view_height;
+
+    for (int32_t y = 0; y < view_height; ++y) {
+      for (int32_t x = 0; x < view_width; ++x) {
+        int32_t source = primary;
+        int32_t texel = 0;
+        int32_t background_texel = 0;
+        int32_t unused;
+        const float* depth_row = source_depths[primary] + y * view_width;
+        if (!SearchSource(params, depth_row, view_width, primary_steps, x,
+                          &texel, &background_texel)) {
+          if (secondary >= 0 &&
+              SearchSource(params, source_depths[secondary] + y * view_width,
+                           view_width, view - params.source_positions[secondary],
+                           x, &texel, &unused)) {
+            source = secondary;
+            ++counts.second_source_pixels;
+          } else {
+            texel = background_texel;
+            ++counts.background_pixels;
+          }
+        }
+
+        int32_t src = y * view_width + texel;
+        int32_t dst = y * view_width + x;
+        memcpy(&views[view][dst * 4], &source_colors[source][src * 4], 4);
+        if (view_depths) view_depths[view][dst] = source_depths[source][src];
+      }
+    }
+  }
+  if (stats) *stats = counts;
+}
+
+}  // namespace leia_helper
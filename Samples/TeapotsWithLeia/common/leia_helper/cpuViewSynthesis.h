@@ -0,0 +1,121 @@
+/*
+ * Copyright 2018 Leia Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//--------------------------------------------------------------------------------
+// cpuViewSynthesis.h
+//--------------------------------------------------------------------------------
+#ifndef LEIA_HELPER_CPUVIEWSYNTHESIS_H_
+#define LEIA_HELPER_CPUVIEWSYNTHESIS_H_
+
+#include <stdint.h>
+
+#include "LeiaCameraViews.h"
+
+namespace leia_helper {
+
+/******************************************************************
+ * Depth image based view synthesis
+ * Only one or two source views are rendered, with depth. Every other view is
+ * reprojected from them: a point at depth z moves horizontally by
+ *   disparity(z) = mBaseline * f_in_pixels * (1 / mConvergenceDistance - 1 / z)
+ * pixels per view step, the same model the depth of field pass uses. View i
+ * sits at position i, view i + 1 one baseline to its right, the way
+ * leiaCalculateViews() lays out a row of views.
+ *
+ * Each target pixel searches the horizontal line of the source for the texels
+ * that land on it and keeps the front most one. Pixels no source texel lands
+ * on (disocclusions) are taken from the other source view when there is one,
+ * else from the farthest texel of the search, stretching the background.
+ *
+ * VIEW_SYNTHESIS_FAST renders the centre view only, with a short search.
+ * VIEW_SYNTHESIS_QUALITY renders the two inner views, half a step either side
+ * of the centre (the inner views themselves with an even view count), with a
+ * finer search and disocclusions filled from the other view.
+ * Only horizontal view rows are synthesized, mNumViewsVertical must be 1.
+ */
+enum VIEW_SYNTHESIS_MODE {
+  VIEW_SYNTHESIS_OFF,
+  VIEW_SYNTHESIS_FAST,
+  VIEW_SYNTHESIS_QUALITY,
+  VIEW_SYNTHESIS_MODE_COUNT
+};
+
+const char* GetViewSynthesisModeName(const VIEW_SYNTHESIS_MODE mode);
+
+const int32_t VIEW_SYNTHESIS_MAX_SOURCES = 2;
+
+/******************************************************************
+ * Parameters shared by the CPU reference and the GL pass
+ * (PrepareViewSynthesisAtlas() in postProcess.h)
+ * Disparities are in view pixels per view step. The search covers
+ * [min_disparity, max_disparity] in search_steps steps.
+ */
+struct VIEW_SYNTHESIS_PARAMS {
+  int32_t num_views;
+  int32_t num_sources;
+  float source_positions[VIEW_SYNTHESIS_MAX_SOURCES];
+  float disparity_scale;
+  float convergence_distance;
+  float near;
+  float far;
+  float min_disparity;
+  float max_disparity;
+  int32_t search_steps;
+};
+
+/******************************************************************
+ * GetViewSynthesisParams()
+ *
+ * arguments:
+ *  in: data, camera data of the views to synthesize
+ *  in: mode, VIEW_SYNTHESIS_FAST or VIEW_SYNTHESIS_QUALITY
+ *  out: params
+ * return: false when the mode is off or the layout cannot be synthesized
+ */
+bool GetViewSynthesisParams(const LeiaCameraData* data,
+                            const VIEW_SYNTHESIS_MODE mode,
+                            VIEW_SYNTHESIS_PARAMS* params);
+
+/******************************************************************
+ * What the synthesis did, per frame
+ */
+struct VIEW_SYNTHESIS_STATS {
+  int64_t synthesized_pixels;
+  int64_t second_source_pixels;
+  int64_t background_pixels;
+};
+
+/******************************************************************
+ * CpuViewSynthesis()
+ * CPU reference of the GL pass, on tightly packed buffers in GL row order.
+ *
+ * arguments:
+ *  in: params, from GetViewSynthesisParams()
+ *  in: source_colors, source_depths, params.num_sources RGBA8 views and
+ *      their depth buffer values in [0, 1]
+ *  in: view_width, view_height, size of every view
+ *  out: views, params.num_views RGBA8 views
+ *  out: view_depths, depth buffer values of the views, may be NULL
+ *  out: stats, may be NULL
+ */
+void CpuViewSynthesis(const VIEW_SYNTHESIS_PARAMS& params,
+                      const uint8_t* const* source_colors,
+                      const float* const* source_depths, int32_t view_width,
+                      int32_t view_height, uint8_t* const* views,
+                      float* const* view_depths, VIEW_SYNTHESIS_STATS* stats);
+
+}  // namespace leia_helper
+#endif /* LEIA_HELPER_CPUVIEWSYNTHESIS_H_ */
@@ -0,0 +1,437 @@
+/*
+ * Copyright 2018 Leia Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//--------------------------------------------------------------------------------
+// frustumCulling.cpp
+// Bounding sphere culling against the union and each of the view frusta
+//--------------------------------------------------------------------------------
+#include <math.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define LEIA_HELPER_X86 1
+#endif
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#define LEIA_HELPER_NEON 1
+#endif
+
+#include "frustumCulling.h"
+
+namespace leia_helper {
+
+//--------------------------------------------------------------------------------
+// Planes
+// Rows of the projection combine into the six clip planes, left, right,
+// bottom, top, near and far, as in Gribb and Hartmann
+//--------------------------------------------------------------------------------
+static void ExtractPlanes(const float* p, double planes[6][4]) {
+  for (int32_t i = 0; i < 6; ++i) {
+    const int32_t row = i / 2;
+    const double sign = i % 2 ? -1.0 : 1.0;
+    double length = 0.0;
+    for (int32_t c = 0; c < 4; ++c) {
+      planes[i][c] = (double)p[c * 4 + 3] + sign * p[c * 4 + row];
+      if (c < 3) length += planes[i][c] * planes[i][c];
+    }
+    length = sqrt(length);
+    for (int32_t c = 0; c < 4; ++c) planes[i][c] /= length;
+  }
+}
+
+static bool Invert(const float* m, double inverse[16]) {
+  double inv[16];
+  inv[0] = (double)m[5] * m[10] * m[15] - (double)m[5] * m[11] * m[14] -
+           (double)m[9] * m[6] * m[15] + (double)m[9] * m[7] * m[14] +
+           (double)m[13] * m[6] * m[11] - (double)m[13] * m[7] * m[10];
+  inv[4] = -(double)m[4] * m[10] * m[15] + (double)m[4] * m[11] * m[14] +
+           (double)m[8] * m[6] * m[15] - (double)m[8] * m[7] * m[14] -
+           (double)m[12] * m[6] * m[11] + (double)m[12] * m[7] * m[10];
+  inv[8] = (double)m[4] * m[9] * m[15] - (double)m[4] * m[11] * m[13] -
+           (double)m[8] * m[5] * m[15] + (double)m[8] * m[7] * m[13] +
+           (double)m[12] * m[5] * m[11] - (double)m[12] * m[7] * m[9];
+  inv[12] = -(double)m[4] * m[9] * m[14] + (double)m[4] * m[10] * m[13] +
+            (double)m[8] * m[5] * m[14] - (double)m[8] * m[6] * m[13] -
+            (double)m[12] * m[5] * m[10] + (double)m[12] * m[6] * m[9];
+  inv[1] = -(double)m[1] * m[10] * m[15] + (double)m[1] * m[11] * m[14] +
+           (double)m[9] * m[2] * m[15] - (double)m[9] * m[3] * m[14] -
+           (double)m[13] * m[2] * m[11] + (double)m[13] * m[3] * m[10];
+  inv[5] = (double)m[0] * m[10] * m[15] - (double)m[0] * m[11] * m[14] -
+           (double)m[8] * m[2] * m[15] + (double)m[8] * m[3] * m[14] +
+           (double)m[12] * m[2] * m[11] - (double)m[12] * m[3] * m[10];
+  inv[9] = -(double)m[0] * m[9] * m[15] + (double)m[0] * m[11] * m[13] +
+           (double)m[8] * m[1] * m[15] - (double)m[8] * m[3] * m[13] -
+           (double)m[12] * m[1] * m[11] + (double)m[12] * m[3] * m[9];
+  inv[13] = (double)m[0] * m[9] * m[14] - (double)m[0] * m[10] * m[13] -
+            (double)m[8] * m[1] * m[14] + (double)m[8] * m[2] * m[13] +
+            (double)m[12] * m[1] * m[10] - (double)m[12] * m[2] * m[9];
+  inv[2] = (double)m[1] * m[6] * m[15] - (double)m[1] * m[7] * m[14] -
+           (double)m[5] * m[2] * m[15] + (double)m[5] * m[3] * m[14] +
+           (double)m[13] * m[2] * m[7] - (double)m[13] * m[3] * m[6];
+  inv[6] = -(double)m[0] * m[6] * m[15] + (double)m[0] * m[7] * m[14] +
+           (double)m[4] * m[2] * m[15] - (double)m[4] * m[3] * m[14] -
+           (double)m[12] * m[2] * m[7] + (double)m[12] * m[3] * m[6];
+  inv[10] = (double)m[0] * m[5] * m[15] - (double)m[0] * m[7] * m[13] -
+            (double)m[4] * m[1] * m[15] + (double)m[4] * m[3] * m[13] +
+            (double)m[12] * m[1] * m[7] - (double)m[12] * m[3] * m[5];
+  inv[14] = -(double)m[0] * m[5] * m[14] + (double)m[0] * m[6] * m[13] +
+            (double)m[4] * m[1] * m[14] - (double)m[4] * m[2] * m[13] -
+            (double)m[12] * m[1] * m[6] + (double)m[12] * m[2] * m[5];
+  inv[3] = -(double)m[1] * m[6] * m[11] + (double)m[1] * m[7] * m[10] +
+           (double)m[5] * m[2] * m[11] - (double)m[5] * m[3] * m[10] -
+           (double)m[9] * m[2] * m[7] + (double)m[9] * m[3] * m[6];
+  inv[7] = (double)m[0] * m[6] * m[11] - (double)m[0] * m[7] * m[10] -
+           (double)m[4] * m[2] * m[11] + (double)m[4] * m[3] * m[10] +
+           (double)m[8] * m[2] * m[7] - (double)m[8] * m[3] * m[6];
+  inv[11] = -(double)m[0] * m[5] * m[11] + (double)m[0] * m[7] * m[9] +
+            (double)m[4] * m[1] * m[11] - (double)m[4] * m[3] * m[9] -
+            (double)m[8] * m[1] * m[7] + (double)m[8] * m[3] * m[5];
+  inv[15] = (double)m[0] * m[5] * m[10] - (double)m[0] * m[6] * m[9] -
+            (double)m[4] * m[1] * m[10] + (double)m[4] * m[2] * m[9] +
+            (double)m[8] * m[1] * m[6] - (double)m[8] * m[2] * m[5];
+  double det = m[0] * inv[0] + m[1] * inv[4] + m[2] * inv[8] + m[3] * inv[12];
+  if (det == 0.0) return false;
+  for (int32_t i = 0; i < 16; ++i) inverse[i] = inv[i] / det;
+  return true;
+}
+
+// Corner (x, y, z) of normalized device coordinates, each -1 or 1
+static void Corner(const double inverse[16], double x, double y, double z,
+                   double out[3]) {
+  double p[4];
+  for (int32_t r = 0; r < 4; ++r) {
+    p[r] = inverse[r] * x + inverse[4 + r] * y + inverse[8 + r] * z +
+           inverse[12 + r];
+  }
+  for (int32_t r = 0; r < 3; ++r) out[r] = p[r] / p[3];
+}
+
+static double Distance(const double plane[4], const double point[3]) {
+  return plane[0] * point[0] + plane[1] * point[1] + plane[2] * point[2] +
+         plane[3];
+}
+
+// Plane through a, b and c, facing inside
+static bool PlaneThrough(const double a[3], const double b[3],
+                         const double c[3], const double inside[3],
+                         double plane[4]) {
+  double u[3], v[3];
+  for (int32_t i = 0; i < 3; ++i) {
+    u[i] = b[i] - a[i];
+    v[i] = c[i] - a[i];
+  }
+  plane[0] = u[1] * v[2] - u[2] * v[1];
+  plane[1] = u[2] * v[0] - u[0] * v[2];
+  plane[2] = u[0] * v[1] - u[1] * v[0];
+  double length = sqrt(plane[0] * plane[0] + plane[1] * plane[1] +
+                       plane[2] * plane[2]);
+  if (length == 0.0) return false;
+  for (int32_t i = 0; i < 3; ++i) plane[i] /= length;
+  plane[3] = -(plane[0] * a[0] + plane[1] * a[1] + plane[2] * a[2]);
+  if (Distance(plane, inside) < 0.0) {
+    for (int32_t i = 0; i < 4; ++i) plane[i] = -plane[i];
+  }
+  return true;
+}
+
+//--------------------------------------------------------------------------------
+// Kernels
+// inside[i] is 1 when sphere i is on the inner side of every plane or cuts
+// it. Distances are ((a x + b y) + c z) + d in every ISA.
+//--------------------------------------------------------------------------------
+typedef void (*CULL_KERNEL)(const float (*)[4], int32_t, const float*,
+                            const float*, const float*, const float*, int32_t,
+                            uint8_t*);
+
+static void CullScalar(const float (*planes)[4], int32_t num_planes,
+                       const float* x, const float* y, const float* z,
+                       const float* radius, int32_t count, uint8_t* inside) {
+  for (int32_t i = 0; i < count; ++i) {
+    uint8_t in = 1;
+    for (int32_t p = 0; p < num_planes; ++p) {
+      float d = planes[p][0] * x[i] + planes[p][1] * y[i];
+      d = d + planes[p][2] * z[i];
+      d = d + planes[p][3];
+      if (d < -radius[i]) in = 0;
+    }
+    inside[i] = in;
+  }
+}
+
+#if defined(LEIA_HELPER_X86)
+static void CullSse2(const float (*planes)[4], int32_t num_planes,
+                     const float* x, const float* y, const float* z,
+                     const float* radius, int32_t count, uint8_t* inside) {
+  const __m128 sign = _mm_set1_ps(-0.0f);
+  int32_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    const __m128 vx = _mm_loadu_ps(x + i);
+    const __m128 vy = _mm_loadu_ps(y + i);
+    const __m128 vz = _mm_loadu_ps(z + i);
+    const __m128 neg_radius = _mm_xor_ps(_mm_loadu_ps(radius + i), sign);
+    __m128 outside = _mm_setzero_ps();
+    for (int32_t p = 0; p < num_planes; ++p) {
+      __m128 d = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes[p][0]), vx),
+                            _mm_mul_ps(_mm_set1_ps(planes[p][1]), vy));
+      d = _mm_add_ps(d, _mm_mul_ps(_mm_set1_ps(planes[p][2]), vz));
+      d = _mm_add_ps(d, _mm_set1_ps(planes[p][3]));
+      outside = _mm_or_ps(outside, _mm_cmplt_ps(d, neg_radius));
+    }
+    const int mask = _mm_movemask_ps(outside);
+    for (int32_t k = 0; k < 4; ++k) inside[i + k] = !((mask >> k) & 1);
+  }
+  CullScalar(planes, num_planes, x + i, y + i, z + i, radius + i, count - i,
+             inside + i);
+}
+#endif
+
+#if defined(LEIA_HELPER_NEON)
+static void CullNeon(const float (*planes)[4], int32_t num_planes,
+                     const float* x, const float* y, const float* z,
+                     const float* radius, int32_t count, uint8_t* inside) {
+  int32_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    const float32x4_t vx = vld1q_f32(x + i);
+    const float32x4_t vy = vld1q_f32(y + i);
+    const float32x4_t vz = vld1q_f32(z + i);
+    const float32x4_t neg_radius = vnegq_f32(vld1q_f32(radius + i));
+    uint32x4_t outside = vdupq_n_u32(0);
+    for (int32_t p = 0; p < num_planes; ++p) {
+      // Separate multiply and add, vfmaq would round differently
+      float32x4_t d = vaddq_f32(vmulq_n_f32(vx, planes[p][0]),
+                                vmulq_n_f32(vy, planes[p][1]));
+      d = vaddq_f32(d, vmulq_n_f32(vz, planes[p][2]));
+      d = vaddq_f32(d, vdupq_n_f32(planes[p][3]));
+      outside = vorrq_u32(outside, vcltq_f32(d, neg_radius));
+    }
+    inside[i] = !vgetq_lane_u32(outside, 0);
+    inside[i + 1] = !vgetq_lane_u32(outside, 1);
+    inside[i + 2] = !vgetq_lane_u32(outside, 2);
+    inside[i + 3] = !vgetq_lane_u32(outside, 3);
+  }
+  CullScalar(planes, num_planes, x + i, y + i, z + i, radius + i, count - i,
+             inside + i);
+}
+#endif
+
+static CULL_KERNEL GetKernel(const CPU_ISA isa) {
+  switch (isa) {
+#if defined(LEIA_HELPER_X86)
+    case CPU_ISA_SSE2:
+    case CPU_ISA_AVX2:
+      return CullSse2;
+#endif
+#if defined(LEIA_HELPER_NEON)
+    case CPU_ISA_NEON:
+      return CullNeon;
+#endif
+    default:
+      return CullScalar;
+  }
+}
+
+//--------------------------------------------------------------------------------
+// FrustumCuller
+//--------------------------------------------------------------------------------
+FrustumCuller::FrustumCuller() : num_views_(0) {
+  union_planes_.count = 0;
+  memset(&stats_, 0, sizeof(stats_));
+}
+
+FrustumCuller::~FrustumCuller() {}
+
+void FrustumCuller::SetViews(const float* projections, const int32_t stride,
+                             const int32_t num_views) {
+  num_views_ = num_views < CULL_MAX_VIEWS ? num_views : CULL_MAX_VIEWS;
+  union_planes_.count = 0;
+  if (num_views_ <= 0) {
+    num_views_ = 0;
+    return;
+  }
+
+  std::vector<double> planes(num_views_ * 6 * 4);
+  std::vector<double> corners(num_views_ * 8 * 3);
+  double center[3] = {0.0, 0.0, 0.0};
+  double extent = 0.0;
+  for (int32_t v = 0; v < num_views_; ++v) {
+    const float* projection = projections + v * stride;
+    double(*view_planes)[4] = (double(*)[4]) & planes[v * 24];
+    ExtractPlanes(projection, view_planes);
+    view_planes_[v].count = 6;
+    for (int32_t i = 0; i < 6; ++i) {
+      for (int32_t c = 0; c < 4; ++c)
+        view_planes_[v].planes[i][c] = (float)view_planes[i][c];
+    }
+    double inverse[16];
+    if (!Invert(projection, inverse)) {
+      // Nothing to bound the union with, every object is inside it
+      union_planes_.count = -1;
+      continue;
+    }
+    for (int32_t k = 0; k < 8; ++k) {
+      double* corner = &corners[(v * 8 + k) * 3];
+      Corner(inverse, k & 1 ? 1.0 : -1.0, k & 2 ? 1.0 : -1.0,
+             k & 4 ? 1.0 : -1.0, corner);
+      for (int32_t c = 0; c < 3; ++c) {
+        center[c] += corner[c] / (num_views_ * 8);
+        if (fabs(corner[c]) > extent) extent = fabs(corner[c]);
+      }
+    }
+  }
+  if (union_planes_.count < 0) {
+    union_planes_.count = 0;
+    return;
+  }
+
+  // The union is bounded by, for each of the six sides, the plane of one
+  // view that holds every corner, or for the four sides of off axis views a
+  // plane through the near edge of one view and a far corner of another.
+  // The tightest such plane is kept, a side without one is left open.
+  const double tolerance = 1e-5 * extent;
+  const int32_t num_corners = num_views_ * 8;
+  for (int32_t side = 0; side < 6; ++side) {
+    std::vector<double> candidates;
+    for (int32_t v = 0; v < num_views_; ++v) {
+      candidates.insert(candidates.end(), &planes[(v * 6 + side) * 4],
+                        &planes[(v * 6 + side) * 4] + 4);
+    }
+    if (side < 4) {
+      // Corner index bits are x, y and z, the side fixes one of x and y
+      const int32_t axis_bit = side < 2 ? 1 : 2;
+      const int32_t other_bit = side < 2 ? 2 : 1;
+      const int32_t fixed = side % 2 ? axis_bit : 0;
+      for (int32_t near_view = 0; near_view < num_views_; ++near_view) {
+        const double* a = &corners[(near_view * 8 + fixed) * 3];
+        const double* b = &corners[(near_view * 8 + fixed + other_bit) * 3];
+        for (int32_t far_view = 0; far_view < num_views_; ++far_view) {
+          for (int32_t k = 0; k < 2; ++k) {
+            const double* c =
+                &corners[(far_view * 8 + 4 + fixed + k * other_bit) * 3];
+            double plane[4];
+            if (PlaneThrough(a, b, c, center, plane))
+              candidates.insert(candidates.end(), plane, plane + 4);
+          }
+        }
+      }
+    }
+
+    double best_score = 0.0;
+    int32_t best = -1;
+    for (size_t i = 0; i < candidates.size() / 4; ++i) {
+      const double* plane = &candidates[i * 4];
+      double score = 0.0;
+      bool holds = true;
+      for (int32_t k = 0; k < num_corners && holds; ++k) {
+        double d = Distance(plane, &corners[k * 3]);
+        holds = d >= -tolerance;
+        score += d;
+      }
+      if (holds && (best < 0 || score < best_score)) {
+        best = (int32_t)i;
+        best_score = score;
+      }
+    }
+    if (best < 0) continue;
+    float* plane = union_planes_.planes[union_planes_.count++];
+    for (int32_t c = 0; c < 4; ++c) plane[c] = (float)candidates[best * 4 + c];
+    // Corners sit on the plane within rounding, keep them inside
+    plane[3] += (float)tolerance;
+  }
+}
+
+void FrustumCuller::SetNumObjects(const int32_t count) {
+  center_x_.resize(count);
+  center_y_.resize(count);
+  center_z_.resize(count);
+  radius_.resize(count);
+}
+
+void FrustumCuller::SetBounds(const int32_t index, const float x,
+                              const float y, const float z,
+                              const float radius) {
+  center_x_[index] = x;
+  center_y_[index] = y;
+  center_z_[index] = z;
+  radius_[index] = radius;
+}
+
+void FrustumCuller::SetBounds(const MatrixBuffer& model_views,
+                              const float* center, const float radius) {
+  const int32_t count = model_views.GetCount();
+  SetNumObjects(count);
+  for (int32_t i = 0; i < count; ++i) {
+    const float* m = model_views.Get(i);
+    center_x_[i] =
+        m[0] * center[0] + m[4] * center[1] + m[8] * center[2] + m[12];
+    center_y_[i] =
+        m[1] * center[0] + m[5] * center[1] + m[9] * center[2] + m[13];
+    center_z_[i] =
+        m[2] * center[0] + m[6] * center[1] + m[10] * center[2] + m[14];
+    radius_[i] = radius;
+  }
+}
+
+void FrustumCuller::Cull(const CPU_ISA isa) {
+  const CULL_KERNEL kernel = GetKernel(isa);
+  const int32_t count = (int32_t)center_x_.size();
+  memset(&stats_, 0, sizeof(stats_));
+  stats_.objects = count;
+  visible_.resize(count);
+  visible_x_.resize(count);
+  visible_y_.resize(count);
+  visible_z_.resize(count);
+  visible_radius_.resize(count);
+  view_masks_.clear();
+  if (!count) return;
+
+  // Union of the views over every object
+  inside_.resize(count);
+  uint8_t* inside = &inside_[0];
+  kernel(union_planes_.planes, union_planes_.count, &center_x_[0],
+         &center_y_[0], &center_z_[0], &radius_[0], count, inside);
+  int32_t num_visible = 0;
+  for (int32_t i = 0; i < count; ++i) {
+    // Written whether visible or not, no branch to mispredict
+    visible_[num_visible] = i;
+    visible_x_[num_visible] = center_x_[i];
+    visible_y_[num_visible] = center_y_[i];
+    visible_z_[num_visible] = center_z_[i];
+    visible_radius_[num_visible] = radius_[i];
+    num_visible += inside[i];
+  }
+  visible_.resize(num_visible);
+  stats_.visible = num_visible;
+  stats_.culled = count - num_visible;
+  view_masks_.assign(num_visible, 0);
+  if (!num_visible) return;
+
+  // Each view over the objects in the union
+  for (int32_t v = 0; v < num_views_; ++v) {
+    kernel(view_planes_[v].planes, view_planes_[v].count, &visible_x_[0],
+           &visible_y_[0], &visible_z_[0], &visible_radius_[0], num_visible,
+           inside);
+    int32_t view_visible = 0;
+    for (int32_t k = 0; k < num_visible; ++k) {
+      view_masks_[k] |= (uint32_t)inside[k] << v;
+      view_visible += inside[k];
+    }
+    stats_.view_visible[v] = view_visible;
+    stats_.view_draws += view_visible;
+  }
+}
+
+}  // namespace leia_helper
@@ -0,0 +1,127 @@
+/*
+ * Copyright 2018 Leia Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//--------------------------------------------------------------------------------
+// frustumCulling.h
+//--------------------------------------------------------------------------------
+#ifndef LEIA_HELPER_FRUSTUMCULLING_H_
+#define LEIA_HELPER_FRUSTUMCULLING_H_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "cpuInterlacer.h"
+#include "viewTransforms.h"
+
+namespace leia_helper {
+
+// Views of one culler, one bit each in the view masks
+static const int32_t CULL_MAX_VIEWS = 32;
+
+/******************************************************************
+ * Objects tested by the last Cull()
+ * visible: objects inside the union of the view frusta
+ * view_visible: of those, objects inside each view frustum
+ * view_draws: sum of view_visible, the draws the per view paths make
+ */
+struct CULL_STATS {
+  int32_t objects;
+  int32_t culled;
+  int32_t visible;
+  int32_t view_draws;
+  int32_t view_visible[CULL_MAX_VIEWS];
+};
+
+/******************************************************************
+ * Two level culling of bounding spheres against the frusta of the views
+ *
+ *   culler.SetViews(cameras[0][0].matrix, 32, num_views);
+ *   culler.SetBounds(model_views, center, radius);
+ *   culler.Cull(isa);
+ *   for (k = 0; k < culler.GetNumVisible(); ++k)
+ *     if (culler.GetViewMasks()[k] & (1u << view))
+ *       draw object culler.GetVisible()[k] in view
+ *
+ * The views of leiaCalculateViews() are narrow off axis frusta that mostly
+ * overlap. Every sphere is first tested against their union, the convex
+ * hull of all frusta, and only the spheres inside it against each view.
+ * Spheres are stored as structure of arrays and tested four at a time with
+ * SSE2 or NEON. Past the first test the work follows the visible objects,
+ * not the scene size.
+ *
+ * Planes are taken from the projections, spheres are in the space the
+ * projections apply to, eye space for the renderers. Every ISA produces the
+ * same masks.
+ */
+class FrustumCuller {
+ private:
+  // Planes a x + b y + c z + d >= 0 inside, (a, b, c) unit length
+  struct PLANES {
+    int32_t count;
+    float planes[6][4];
+  };
+
+  int32_t num_views_;
+  PLANES union_planes_;
+  PLANES view_planes_[CULL_MAX_VIEWS];
+
+  // Bounds of every object, then of the objects visible in the union
+  std::vector<float> center_x_;
+  std::vector<float> center_y_;
+  std::vector<float> center_z_;
+  std::vector<float> radius_;
+  std::vector<float> visible_x_;
+  std::vector<float> visible_y_;
+  std::vector<float> visible_z_;
+  std::vector<float> visible_radius_;
+  std::vector<int32_t> visible_;
+  std::vector<uint32_t> view_masks_;
+  std::vector<uint8_t> inside_;
+  CULL_STATS stats_;
+
+  FrustumCuller(const FrustumCuller&);
+  FrustumCuller& operator=(const FrustumCuller&);
+
+ public:
+  FrustumCuller();
+  virtual ~FrustumCuller();
+
+  // num_views projections, stride floats apart, at most CULL_MAX_VIEWS
+  void SetViews(const float* projections, const int32_t stride,
+                const int32_t num_views);
+
+  void SetNumObjects(const int32_t count);
+  void SetBounds(const int32_t index, const float x, const float y,
+                 const float z, const float radius);
+  // Sphere center, radius in model space through every model view. The
+  // model views must not scale.
+  void SetBounds(const MatrixBuffer& model_views, const float* center,
+                 const float radius);
+
+  void Cull(const CPU_ISA isa);
+
+  // Objects inside the union in increasing order, and for each the views
+  // it is inside of, bit v for view v
+  int32_t GetNumVisible() const { return (int32_t)visible_.size(); }
+  const std::vector<int32_t>& GetVisible() const { return visible_; }
+  const std::vector<uint32_t>& GetViewMasks() const { return view_masks_; }
+  int32_t GetNumViews() const { return num_views_; }
+  const CULL_STATS& GetStats() const { return stats_; }
+};
+
+}  // namespace leia_helper
+#endif /* LEIA_HELPER_FRUSTUMCULLING_H_ */
@@ -0,0 +1,770 @@
+/*
+ * Copyright 2018 Leia Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//--------------------------------------------------------------------------------
+// glCapture.cpp
+// Wrappers of the gl3stub pointers, recording to a GlTraceWriter
+//--------------------------------------------------------------------------------
+#include <string.h>
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "JNIHelper.h"
+#include "gl3stub.h"
+#include "glCapture.h"
+#include "glTrace.h"
+
+namespace leia_helper {
+
+#ifdef GL3STUB_CAPTURE
+
+// The driver entry points, what the gl3stub pointers held before the capture
+struct GL_PROCS {
+#define GL_CAPTURE_FIELD(op, ret, name, params, args) \
+  ret(GL_APIENTRY* name) params;
+  GL3STUB_ES2_CAPTURE_PROCS(GL_CAPTURE_FIELD)
+  GL3STUB_ES3_CAPTURE_PROCS(GL_CAPTURE_FIELD)
+#undef GL_CAPTURE_FIELD
+};
+
+// A glMapBufferRange() range, written to the trace at glUnmapBuffer()
+struct MAPPING {
+  GLenum target;
+  const void* data;
+  uint32_t length;
+  GLbitfield access;
+};
+
+// The mutex guards everything below it
+static std::mutex capture_mutex;
+static GL_PROCS real;
+static GlTraceWriter writer;
+static bool active = false;
+static int32_t num_frames = 0;
+static int32_t frame_index = 0;
+static std::chrono::steady_clock::time_point frame_start;
+static GLint unpack_alignment = 4;
+static GLuint unpack_buffer = 0;
+static std::vector<MAPPING> mappings;
+
+//--------------------------------------------------------------------------------
+// Recording
+//--------------------------------------------------------------------------------
+static uint32_t Word(const GLfloat value) { return GlTraceWord(value); }
+
+// Offsets into buffers passed as pointers
+static uint32_t Word(const void* pointer) {
+  return (uint32_t)(uintptr_t)pointer;
+}
+
+template <typename T>
+static uint32_t Word(const T value) {
+  return (uint32_t)value;
+}
+
+template <typename... A>
+static void RecordData(const GL_TRACE_OP op, const void* data,
+                       const size_t size, A... args) {
+  const uint32_t words[] = {Word(args)...};
+  std::lock_guard<std::mutex> lock(capture_mutex);
+  if (active) writer.Write(op, words, sizeof...(A), data, (uint32_t)size);
+}
+
+template <typename... A>
+static void RecordCall(const GL_TRACE_OP op, A... args) {
+  RecordData(op, NULL, 0, args...);
+}
+
+// Bytes glTexSubImage2D() reads, 0 for formats it does not know
+static size_t ImageSize(const GLsizei width, const GLsizei height,
+                        const GLenum format, const GLenum type) {
+  size_t components = 0;
+  switch (format) {
+    case GL_ALPHA:
+    case GL_LUMINANCE:
+    case GL_RED:
+    case GL_RED_INTEGER:
+    case GL_DEPTH_COMPONENT:
+      components = 1;
+      break;
+    case GL_LUMINANCE_ALPHA:
+    case GL_RG:
+    case GL_RG_INTEGER:
+      components = 2;
+      break;
+    case GL_RGB:
+    case GL_RGB_INTEGER:
+      components = 3;
+      break;
+    case GL_RGBA:
+    case GL_RGBA_INTEGER:
+      components = 4;
+      break;
+  }
+  size_t pixel_size = 0;
+  switch (type) {
+    case GL_UNSIGNED_BYTE:
+    case GL_BYTE:
+      pixel_size = components;
+      break;
+    case GL_UNSIGNED_SHORT:
+    case GL_SHORT:
+    case GL_HALF_FLOAT:
+      pixel_size = components * 2;
+      break;
+    case GL_UNSIGNED_INT:
+    case GL_INT:
+    case GL_FLOAT:
+      pixel_size = components * 4;
+      break;
+    case GL_UNSIGNED_SHORT_5_6_5:
+    case GL_UNSIGNED_SHORT_4_4_4_4:
+    case GL_UNSIGNED_SHORT_5_5_5_1:
+      pixel_size = 2;
+      break;
+    case GL_UNSIGNED_INT_2_10_10_10_REV:
+    case GL_UNSIGNED_INT_10F_11F_11F_REV:
+    case GL_UNSIGNED_INT_5_9_9_9_REV:
+    case GL_UNSIGNED_INT_24_8:
+      pixel_size = 4;
+      break;
+  }
+  if (!pixel_size || width <= 0 || height <= 0) return 0;
+  std::lock_guard<std::mutex> lock(capture_mutex);
+  // pixels is an offset into the unpack buffer then
+  if (unpack_buffer) return 0;
+  // Rows start at the unpack alignment, the last one is not padded
+  const size_t alignment = unpack_alignment;
+  const size_t row =
+      (width * pixel_size + alignment - 1) / alignment * alignment;
+  return row * (height - 1) + width * pixel_size;
+}
+
+//--------------------------------------------------------------------------------
+// Wrappers, OpenGL ES 2.0
+//--------------------------------------------------------------------------------
+static void GL_APIENTRY CaptureActiveTexture(GLenum texture) {
+  real.ActiveTexture(texture);
+  RecordCall(GL_TRACE_ACTIVE_TEXTURE, texture);
+}
+
+static void GL_APIENTRY CaptureAttachShader(GLuint program, GLuint shader) {
+  real.AttachShader(program, shader);
+  RecordCall(GL_TRACE_ATTACH_SHADER, program, shader);
+}
+
+static void GL_APIENTRY CaptureBindAttribLocation(GLuint program, GLuint index,
+                                                  const GLchar* name) {
+  real.BindAttribLocation(program, index, name);
+  RecordData(GL_TRACE_BIND_ATTRIB_LOCATION, name, strlen(name) + 1, program,
+             index);
+}
+
+static void GL_APIENTRY CaptureBindBuffer(GLenum target, GLuint buffer) {
+  real.BindBuffer(target, buffer);
+  if (target == GL_PIXEL_UNPACK_BUFFER) {
+    std::lock_guard<std::mutex> lock(capture_mutex);
+    unpack_buffer = buffer;
+  }
+  RecordCall(GL_TRACE_BIND_BUFFER, target, buffer);
+}
+
+static void GL_APIENTRY CaptureBindFramebuffer(GLenum target,
+                                               GLuint framebuffer) {
+  real.BindFramebuffer(target, framebuffer);
+  RecordCall(GL_TRACE_BIND_FRAMEBUFFER, target, framebuffer);
+}
+
+static void GL_APIENTRY CaptureBindRenderbuffer(GLenum target,
+                                                GLuint renderbuffer) {
+  real.BindRenderbuffer(target, renderbuffer);
+  RecordCall(GL_TRACE_BIND_RENDERBUFFER, target, renderbuffer);
+}
+
+static void GL_APIENTRY CaptureBindTexture(GLenum target, GLuint texture) {
+  real.BindTexture(target, texture);
+  RecordCall(GL_TRACE_BIND_TEXTURE, target, texture);
+}
+
+static void GL_APIENTRY CaptureBufferData(GLenum target, GLsizeiptr size,
+                                          const void* data, GLenum usage) {
+  real.BufferData(target, size, data, usage);
+  RecordData(GL_TRACE_BUFFER_DATA, data, data ? size : 0, target, size, usage,
+             data ? 1 : 0);
+}
+
+static void GL_APIENTRY CaptureBufferSubData(GLenum target, GLintptr offset,
+                                             GLsizeiptr size,
+                                             const void* data) {
+  real.BufferSubData(target, offset, size, data);
+  RecordData(GL_TRACE_BUFFER_SUB_DATA, data, size, target, offset, size);
+}
+
+static void GL_APIENTRY CaptureClear(GLbitfield mask) {
+  real.Clear(mask);
+  RecordCall(GL_TRACE_CLEAR, mask);
+}
+
+static void GL_APIENTRY CaptureClearColor(GLfloat red, GLfloat green,
+                                          GLfloat blue, GLfloat alpha) {
+  real.ClearColor(red, green, blue, alpha);
+  RecordCall(GL_TRACE_CLEAR_COLOR, red, green, blue, alpha);
+}
+
+static void GL_APIENTRY CaptureClearDepthf(GLfloat depth) {
+  real.ClearDepthf(depth);
+  RecordCall(GL_TRACE_CLEAR_DEPTHF, depth);
+}
+
+static void GL_APIENTRY CaptureCompileShader(GLuint shader) {
+  real.CompileShader(shader);
+  RecordCall(GL_TRACE_COMPILE_SHADER, shader);
+}
+
+static GLuint GL_APIENTRY CaptureCreateProgram() {
+  GLuint program = real.CreateProgram();
+  RecordCall(GL_TRACE_CREATE_PROGRAM, program);
+  return program;
+}
+
+static GLuint GL_APIENTRY CaptureCreateShader(GLenum type) {
+  GLuint shader = real.CreateShader(type);
+  RecordCall(GL_TRACE_CREATE_SHADER, type, shader);
+  return shader;
+}
+
+static void GL_APIENTRY CaptureDeleteBuffers(GLsizei n,
+                                             const GLuint* buffers) {
+  real.DeleteBuffers(n, buffers);
+  RecordData(GL_TRACE_DELETE_BUFFERS, buffers, n * sizeof(GLuint), n);
+}
+
+static void GL_APIENTRY CaptureDeleteFramebuffers(GLsizei n,
+                                                  const GLuint* framebuffers) {
+  real.DeleteFramebuffers(n, framebuffers);
+  RecordData(GL_TRACE_DELETE_FRAMEBUFFERS, framebuffers, n * sizeof(GLuint),
+             n);
+}
+
+static void GL_APIENTRY CaptureDeleteProgram(GLuint program) {
+  real.DeleteProgram(program);
+  RecordCall(GL_TRACE_DELETE_PROGRAM, program);
+}
+
+static void GL_APIENTRY
+CaptureDeleteRenderbuffers(GLsizei n, const GLuint* renderbuffers) {
+  real.DeleteRenderbuffers(n, renderbuffers);
+  RecordData(GL_TRACE_DELETE_RENDERBUFFERS, renderbuffers, n * sizeof(GLuint),
+             n);
+}
+
+static void GL_APIENTRY CaptureDeleteShader(GLuint shader) {
+  real.DeleteShader(shader);
+  RecordCall(GL_TRACE_DELETE_SHADER, shader);
+}
+
+static void GL_APIENTRY CaptureDeleteTextures(GLsizei n,
+                                              const GLuint* textures) {
+  real.DeleteTextures(n, textures);
+  RecordData(GL_TRACE_DELETE_TEXTURES, textures, n * sizeof(GLuint), n);
+}
+
+static void GL_APIENTRY CaptureDepthFunc(GLenum func) {
+  real.DepthFunc(func);
+  RecordCall(GL_TRACE_DEPTH_FUNC, func);
+}
+
+static void GL_APIENTRY CaptureDepthMask(GLboolean flag) {
+  real.DepthMask(flag);
+  RecordCall(GL_TRACE_DEPTH_MASK, flag);
+}
+
+static void GL_APIENTRY CaptureDisable(GLenum cap) {
+  real.Disable(cap);
+  RecordCall(GL_TRACE_DISABLE, cap);
+}
+
+static void GL_APIENTRY CaptureDisableVertexAttribArray(GLuint index) {
+  real.DisableVertexAttribArray(index);
+  RecordCall(GL_TRACE_DISABLE_VERTEX_ATTRIB_ARRAY, index);
+}
+
+static void GL_APIENTRY CaptureDrawArrays(GLenum mode, GLint first,
+                                          GLsizei count) {
+  real.DrawArrays(mode, first, count);
+  RecordCall(GL_TRACE_DRAW_ARRAYS, mode, first, count);
+}
+
+static void GL_APIENTRY CaptureDrawElements(GLenum mode, GLsizei count,
+                                            GLenum type, const void* indices) {
+  real.DrawElements(mode, count, type, indices);
+  RecordCall(GL_TRACE_DRAW_ELEMENTS, mode, count, type, indices);
+}
+
+static void GL_APIENTRY CaptureEnable(GLenum cap) {
+  real.Enable(cap);
+  RecordCall(GL_TRACE_ENABLE, cap);
+}
+
+static void GL_APIENTRY CaptureEnableVertexAttribArray(GLuint index) {
+  real.EnableVertexAttribArray(index);
+  RecordCall(GL_TRACE_ENABLE_VERTEX_ATTRIB_ARRAY, index);
+}
+
+static void GL_APIENTRY CaptureFramebufferRenderbuffer(
+    GLenum target, GLenum attachment, GLenum renderbuffertarget,
+    GLuint renderbuffer) {
+  real.FramebufferRenderbuffer(target, attachment, renderbuffertarget,
+                               renderbuffer);
+  RecordCall(GL_TRACE_FRAMEBUFFER_RENDERBUFFER, target, attachment,
+             renderbuffertarget, renderbuffer);
+}
+
+static void GL_APIENTRY CaptureFramebufferTexture2D(GLenum target,
+                                                    GLenum attachment,
+                                                    GLenum textarget,
+                                                    GLuint texture,
+                                                    GLint level) {
+  real.FramebufferTexture2D(target, attachment, textarget, texture, level);
+  RecordCall(GL_TRACE_FRAMEBUFFER_TEXTURE_2D, target, attachment, textarget,
+             texture, level);
+}
+
+static void GL_APIENTRY CaptureFrontFace(GLenum mode) {
+  real.FrontFace(mode);
+  RecordCall(GL_TRACE_FRONT_FACE, mode);
+}
+
+static void GL_APIENTRY CaptureGenBuffers(GLsizei n, GLuint* buffers) {
+  real.GenBuffers(n, buffers);
+  RecordData(GL_TRACE_GEN_BUFFERS, buffers, n * sizeof(GLuint), n);
+}
+
+static void GL_APIENTRY CaptureGenFramebuffers(GLsizei n,
+                                               GLuint* framebuffers) {
+  real.GenFramebuffers(n, framebuffers);
+  RecordData(GL_TRACE_GEN_FRAMEBUFFERS, framebuffers, n * sizeof(GLuint), n);
+}
+
+static void GL_APIENTRY CaptureGenRenderbuffers(GLsizei n,
+                                                GLuint* renderbuffers) {
+  real.GenRenderbuffers(n, renderbuffers);
+  RecordData(GL_TRACE_GEN_RENDERBUFFERS, renderbuffers, n * sizeof(GLuint),
+             n);
+}
+
+static void GL_APIENTRY CaptureGenTextures(GLsizei n, GLuint* textures) {
+  real.GenTextures(n, textures);
+  RecordData(GL_TRACE_GEN_TEXTURES, textures, n * sizeof(GLuint), n);
+}
+
+static void GL_APIENTRY CaptureGenerateMipmap(GLenum target) {
+  real.GenerateMipmap(target);
+  RecordCall(GL_TRACE_GENERATE_MIPMAP, target);
+}
+
+static GLint GL_APIENTRY CaptureGetUniformLocation(GLuint program,
+                                                   const GLchar* name) {
+  GLint location = real.GetUniformLocation(program, name);
+  RecordData(GL_TRACE_GET_UNIFORM_LOCATION, name, strlen(name) + 1, program,
+             location);
+  return location;
+}
+
+static void GL_APIENTRY CaptureLinkProgram(GLuint program) {
+  real.LinkProgram(program);
+  RecordCall(GL_TRACE_LINK_PROGRAM, program);
+}
+
+static void GL_APIENTRY CapturePixelStorei(GLenum pname, GLint param) {
+  real.PixelStorei(pname, param);
+  if (pname == GL_UNPACK_ALIGNMENT) {
+    std::lock_guard<std::mutex> lock(capture_mutex);
+    unpack_alignment = param;
+  }
+  RecordCall(GL_TRACE_PIXEL_STOREI, pname, param);
+}
+
+static void GL_APIENTRY CaptureRenderbufferStorage(GLenum target,
+                                                   GLenum internalformat,
+                                                   GLsizei width,
+                                                   GLsizei height) {
+  real.RenderbufferStorage(target, internalformat, width, height);
+  RecordCall(GL_TRACE_RENDERBUFFER_STORAGE, target, internalformat, width,
+             height);
+}
+
+static void GL_APIENTRY CaptureScissor(GLint x, GLint y, GLsizei width,
+                                       GLsizei height) {
+  real.Scissor(x, y, width, height);
+  RecordCall(GL_TRACE_SCISSOR, x, y, width, height);
+}
+
+static void GL_APIENTRY CaptureShaderSource(GLuint shader, GLsizei count,
+                                            const GLchar* const* string,
+                                            const GLint* length) {
+  real.ShaderSource(shader, count, string, length);
+  // Replayed as a single string
+  std::string source;
+  for (GLsizei i = 0; i < count; ++i) {
+    if (length && length[i] >= 0)
+      source.append(string[i], length[i]);
+    else
+      source.append(string[i]);
+  }
+  RecordData(GL_TRACE_SHADER_SOURCE, source.c_str(), source.size() + 1,
+             shader);
+}
+
+static void GL_APIENTRY CaptureTexParameterf(GLenum target, GLenum pname,
+                                             GLfloat param) {
+  real.TexParameterf(target, pname, param);
+  RecordCall(GL_TRACE_TEX_PARAMETERF, target, pname, param);
+}
+
+static void GL_APIENTRY CaptureTexParameteri(GLenum target, GLenum pname,
+                                             GLint param) {
+  real.TexParameteri(target, pname, param);
+  RecordCall(GL_TRACE_TEX_PARAMETERI, target, pname, param);
+}
+
+static void GL_APIENTRY CaptureTexSubImage2D(GLenum target, GLint level,
+                                             GLint xoffset, GLint yoffset,
+                                             GLsizei width, GLsizei height,
+                                             GLenum format, GLenum type,
+                                             const void* pixels) {
+  real.TexSubImage2D(target, level, xoffset, yoffset, width, height, format,
+                     type, pixels);
+  const size_t size = pixels ? ImageSize(width, height, format, type) : 0;
+  RecordData(GL_TRACE_TEX_SUB_IMAGE_2D, pixels, size, target, level, xoffset,
+             yoffset, width, height, format, type);
+}
+
+static void GL_APIENTRY CaptureUniform1f(GLint location, GLfloat v0) {
+  real.Uniform1f(location, v0);
+  RecordCall(GL_TRACE_UNIFORM_1F, location, v0);
+}
+
+static void GL_APIENTRY CaptureUniform1fv(GLint location, GLsizei count,
+                                          const GLfloat* value) {
+  real.Uniform1fv(location, count, value);
+  RecordData(GL_TRACE_UNIFORM_1FV, value, count * sizeof(GLfloat), location,
+             count);
+}
+
+static void GL_APIENTRY CaptureUniform1i(GLint location, GLint v0) {
+  real.Uniform1i(location, v0);
+  RecordCall(GL_TRACE_UNIFORM_1I, location, v0);
+}
+
+static void GL_APIENTRY CaptureUniform2f(GLint location, GLfloat v0,
+                                         GLfloat v1) {
+  real.Uniform2f(location, v0, v1);
+  RecordCall(GL_TRACE_UNIFORM_2F, location, v0, v1);
+}
+
+static void GL_APIENTRY CaptureUniform3f(GLint location, GLfloat v0,
+                                         GLfloat v1, GLfloat v2) {
+  real.Uniform3f(location, v0, v1, v2);
+  RecordCall(GL_TRACE_UNIFORM_3F, location, v0, v1, v2);
+}
+
+static void GL_APIENTRY CaptureUniform4f(GLint location, GLfloat v0,
+                                         GLfloat v1, GLfloat v2, GLfloat v3) {
+  real.Uniform4f(location, v0, v1, v2, v3);
+  RecordCall(GL_TRACE_UNIFORM_4F, location, v0, v1, v2, v3);
+}
+
+static void GL_APIENTRY CaptureUniform4fv(GLint location, GLsizei count,
+                                          const GLfloat* value) {
+  real.Uniform4fv(location, count, value);
+  RecordData(GL_TRACE_UNIFORM_4FV, value, count * 4 * sizeof(GLfloat),
+             location, count);
+}
+
+static void GL_APIENTRY CaptureUniformMatrix4fv(GLint location, GLsizei count,
+                                                GLboolean transpose,
+                                                const GLfloat* value) {
+  real.UniformMatrix4fv(location, count, transpose, value);
+  RecordData(GL_TRACE_UNIFORM_MATRIX_4FV, value, count * 16 * sizeof(GLfloat),
+             location, count, transpose);
+}
+
+static void GL_APIENTRY CaptureUseProgram(GLuint program) {
+  real.UseProgram(program);
+  RecordCall(GL_TRACE_USE_PROGRAM, program);
+}
+
+static void GL_APIENTRY CaptureVertexAttribPointer(GLuint index, GLint size,
+                                                   GLenum type,
+                                                   GLboolean normalized,
+                                                   GLsizei stride,
+                                                   const void* pointer) {
+  real.VertexAttribPointer(index, size, type, normalized, stride, pointer);
+  RecordCall(GL_TRACE_VERTEX_ATTRIB_POINTER, index, size, type, normalized,
+             stride, pointer);
+}
+
+static void GL_APIENTRY CaptureViewport(GLint x, GLint y, GLsizei width,
+                                        GLsizei height) {
+  real.Viewport(x, y, width, height);
+  RecordCall(GL_TRACE_VIEWPORT, x, y, width, height);
+}
+
+//--------------------------------------------------------------------------------
+// Wrappers, OpenGL ES 3.0
+//--------------------------------------------------------------------------------
+static void GL_APIENTRY CaptureBindBufferRange(GLenum target, GLuint index,
+                                               GLuint buffer, GLintptr offset,
+                                               GLsizeiptr size) {
+  real.BindBufferRange(target, index, buffer, offset, size);
+  RecordCall(GL_TRACE_BIND_BUFFER_RANGE, target, index, buffer, offset, size);
+}
+
+static void GL_APIENTRY CaptureBindVertexArray(GLuint array) {
+  real.BindVertexArray(array);
+  RecordCall(GL_TRACE_BIND_VERTEX_ARRAY, array);
+}
+
+static void GL_APIENTRY CaptureDeleteVertexArrays(GLsizei n,
+                                                  const GLuint* arrays) {
+  real.DeleteVertexArrays(n, arrays);
+  RecordData(GL_TRACE_DELETE_VERTEX_ARRAYS, arrays, n * sizeof(GLuint), n);
+}
+
+static void GL_APIENTRY CaptureDrawBuffers(GLsizei n, const GLenum* bufs) {
+  real.DrawBuffers(n, bufs);
+  RecordData(GL_TRACE_DRAW_BUFFERS, bufs, n * sizeof(GLenum), n);
+}
+
+static void GL_APIENTRY CaptureDrawElementsInstanced(GLenum mode,
+                                                     GLsizei count,
+                                                     GLenum type,
+                                                     const void* indices,
+                                                     GLsizei instancecount) {
+  real.DrawElementsInstanced(mode, count, type, indices, instancecount);
+  RecordCall(GL_TRACE_DRAW_ELEMENTS_INSTANCED, mode, count, type, indices,
+             instancecount);
+}
+
+static void GL_APIENTRY CaptureFramebufferTextureLayer(GLenum target,
+                                                       GLenum attachment,
+                                                       GLuint texture,
+                                                       GLint level,
+                                                       GLint layer) {
+  real.FramebufferTextureLayer(target, attachment, texture, level, layer);
+  RecordCall(GL_TRACE_FRAMEBUFFER_TEXTURE_LAYER, target, attachment, texture,
+             level, layer);
+}
+
+static void GL_APIENTRY CaptureGenVertexArrays(GLsizei n, GLuint* arrays) {
+  real.GenVertexArrays(n, arrays);
+  RecordData(GL_TRACE_GEN_VERTEX_ARRAYS, arrays, n * sizeof(GLuint), n);
+}
+
+static GLuint GL_APIENTRY
+CaptureGetUniformBlockIndex(GLuint program, const GLchar* uniformBlockName) {
+  GLuint index = real.GetUniformBlockIndex(program, uniformBlockName);
+  RecordData(GL_TRACE_GET_UNIFORM_BLOCK_INDEX, uniformBlockName,
+             strlen(uniformBlockName) + 1, program, index);
+  return index;
+}
+
+static void GL_APIENTRY CaptureInvalidateFramebuffer(
+    GLenum target, GLsizei numAttachments, const GLenum* attachments) {
+  real.InvalidateFramebuffer(target, numAttachments, attachments);
+  RecordData(GL_TRACE_INVALIDATE_FRAMEBUFFER, attachments,
+             numAttachments * sizeof(GLenum), target, numAttachments);
+}
+
+static void* GL_APIENTRY CaptureMapBufferRange(GLenum target, GLintptr offset,
+                                               GLsizeiptr length,
+                                               GLbitfield access) {
+  void* data = real.MapBufferRange(target, offset, length, access);
+  if (data) {
+    std::lock_guard<std::mutex> lock(capture_mutex);
+    MAPPING mapping = {target, data, (uint32_t)length, access};
+    mappings.push_back(mapping);
+  }
+  RecordCall(GL_TRACE_MAP_BUFFER_RANGE, target, offset, length, access);
+  return data;
+}
+
+static void GL_APIENTRY CaptureProgramBinary(GLuint program,
+                                             GLenum binaryFormat,
+                                             const void* binary,
+                                             GLsizei length) {
+  real.ProgramBinary(program, binaryFormat, binary, length);
+  RecordData(GL_TRACE_PROGRAM_BINARY, binary, length, program, binaryFormat,
+             length);
+}
+
+static void GL_APIENTRY CaptureProgramParameteri(GLuint program, GLenum pname,
+                                                 GLint value) {
+  real.ProgramParameteri(program, pname, value);
+  RecordCall(GL_TRACE_PROGRAM_PARAMETERI, program, pname, value);
+}
+
+static void GL_APIENTRY CaptureTexStorage2D(GLenum target, GLsizei levels,
+                                            GLenum internalformat,
+                                            GLsizei width, GLsizei height) {
+  real.TexStorage2D(target, levels, internalformat, width, height);
+  RecordCall(GL_TRACE_TEX_STORAGE_2D, target, levels, internalformat, width,
+             height);
+}
+
+static void GL_APIENTRY CaptureTexStorage3D(GLenum target, GLsizei levels,
+                                            GLenum internalformat,
+                                            GLsizei width, GLsizei height,
+                                            GLsizei depth) {
+  real.TexStorage3D(target, levels, internalformat, width, height, depth);
+  RecordCall(GL_TRACE_TEX_STORAGE_3D, target, levels, internalformat, width,
+             height, depth);
+}
+
+static void GL_APIENTRY CaptureUniformBlockBinding(GLuint program,
+                                                   GLuint uniformBlockIndex,
+                                                   GLuint uniformBlockBinding) {
+  real.UniformBlockBinding(program, uniformBlockIndex, uniformBlockBinding);
+  RecordCall(GL_TRACE_UNIFORM_BLOCK_BINDING, program, uniformBlockIndex,
+             uniformBlockBinding);
+}
+
+static GLboolean GL_APIENTRY CaptureUnmapBuffer(GLenum target) {
+  {
+    // The range is only readable until it is unmapped
+    std::lock_guard<std::mutex> lock(capture_mutex);
+    for (size_t i = 0; i < mappings.size(); ++i) {
+      if (mappings[i].target != target) continue;
+      const bool written = (mappings[i].access & GL_MAP_WRITE_BIT) != 0;
+      const uint32_t args[1] = {target};
+      if (active) {
+        writer.Write(GL_TRACE_UNMAP_BUFFER, args, 1,
+                     written ? mappings[i].data : NULL,
+                     written ? mappings[i].length : 0);
+      }
+      mappings.erase(mappings.begin() + i);
+      return real.UnmapBuffer(target);
+    }
+  }
+  RecordCall(GL_TRACE_UNMAP_BUFFER, target);
+  return real.UnmapBuffer(target);
+}
+
+static void GL_APIENTRY CaptureVertexAttribDivisor(GLuint index,
+                                                   GLuint divisor) {
+  real.VertexAttribDivisor(index, divisor);
+  RecordCall(GL_TRACE_VERTEX_ATTRIB_DIVISOR, index, divisor);
+}
+
+//--------------------------------------------------------------------------------
+// Capture
+//--------------------------------------------------------------------------------
+static void StopLocked() {
+#define GL_CAPTURE_RESTORE_ES2(op, ret, name, params, args) \
+  gl3stub_gl##name = real.name;
+#define GL_CAPTURE_RESTORE_ES3(op, ret, name, params, args) \
+  GL3STUB_ES3_POINTER(name) = real.name;
+  GL3STUB_ES2_CAPTURE_PROCS(GL_CAPTURE_RESTORE_ES2)
+  GL3STUB_ES3_CAPTURE_PROCS(GL_CAPTURE_RESTORE_ES3)
+#undef GL_CAPTURE_RESTORE_ES2
+#undef GL_CAPTURE_RESTORE_ES3
+  active = false;
+  const int64_t num_records = writer.GetNumRecords();
+  const int64_t num_bytes = writer.GetNumBytes();
+  if (writer.Close()) {
+    LOGI("GL capture done, %d frames, %lld records, %.1f MB", frame_index,
+         (long long)num_records, num_bytes / (1024.0 * 1024.0));
+  } else {
+    LOGW("GL capture failed writing the trace");
+  }
+}
+
+bool StartGlCapture(const char* path, const int32_t frames) {
+  std::lock_guard<std::mutex> lock(capture_mutex);
+  if (active) return false;
+  // The viewport starts as the size of the first surface made current
+  GLint viewport[4] = {0, 0, 0, 0};
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  if (!writer.Open(path, viewport[2], viewport[3])) {
+    LOGW("Can not write GL trace %s", path);
+    return false;
+  }
+#define GL_CAPTURE_INSTALL_ES2(op, ret, name, params, args) \
+  real.name = gl3stub_gl##name;                             \
+  gl3stub_gl##name = Capture##name;
+#define GL_CAPTURE_INSTALL_ES3(op, ret, name, params, args) \
+  real.name = GL3STUB_ES3_POINTER(name);                    \
+  GL3STUB_ES3_POINTER(name) = Capture##name;
+  GL3STUB_ES2_CAPTURE_PROCS(GL_CAPTURE_INSTALL_ES2)
+  GL3STUB_ES3_CAPTURE_PROCS(GL_CAPTURE_INSTALL_ES3)
+#undef GL_CAPTURE_INSTALL_ES2
+#undef GL_CAPTURE_INSTALL_ES3
+  active = true;
+  num_frames = frames;
+  frame_index = 0;
+  frame_start = std::chrono::steady_clock::now();
+  // Unknown before the capture, assume the default
+  unpack_alignment = 4;
+  unpack_buffer = 0;
+  mappings.clear();
+  LOGI("GL capture to %s", path);
+  return true;
+}
+
+void EndGlCaptureFrame() {
+  std::lock_guard<std::mutex> lock(capture_mutex);
+  if (!active) return;
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  const uint32_t args[2] = {
+      (uint32_t)frame_index,
+      (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+          now - frame_start)
+          .count()};
+  writer.Write(GL_TRACE_FRAME, args, 2, NULL, 0);
+  frame_start = now;
+  if (++frame_index == num_frames) StopLocked();
+}
+
+void StopGlCapture() {
+  std::lock_guard<std::mutex> lock(capture_mutex);
+  if (active) StopLocked();
+}
+
+bool IsGlCaptureActive() {
+  std::lock_guard<std::mutex> lock(capture_mutex);
+  return active;
+}
+
+#else
+
+bool StartGlCapture(const char* path, const int32_t frames) {
+  LOGW("GL capture needs a build with GL3STUB_CAPTURE");
+  return false;
+}
+
+void EndGlCaptureFrame() {}
+
+void StopGlCapture() {}
+
+bool IsGlCaptureActive() { return false; }
+
+#endif
+
+}  // namespace leia_helper
@@ -0,0 +1,51 @@
+/*
+ * Copyright 2018 Leia Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//--------------------------------------------------------------------------------
+// glCapture.h
+//--------------------------------------------------------------------------------
+#ifndef LEIA_HELPER_GLCAPTURE_H_
+#define LEIA_HELPER_GLCAPTURE_H_
+
+#include <stdint.h>
+
+namespace leia_helper {
+
+/******************************************************************
+ * Records the GL calls of gl3stubProcs.h to a trace file for host/glReplay
+ *
+ *   StartGlCapture(path, 60);  // context current, before loading resources
+ *   ...
+ *   EndGlCaptureFrame();       // after each eglSwapBuffers()
+ *
+ * StartGlCapture() swaps the gl3stub pointers for wrappers that call the
+ * driver, then append the call, the objects it created and the data it read
+ * to the trace. The capture stops after num_frames frames, or at
+ * StopGlCapture() when num_frames is 0, and puts the pointers back.
+ *
+ * The OpenGL ES 2.0 calls only go through gl3stub in builds with
+ * GL3STUB_CAPTURE, elsewhere StartGlCapture() fails. The Leia SDK library
+ * calls GL directly, its calls are not in the trace. Calls of every thread
+ * go to one stream in the order they return, start the capture before other
+ * threads use GL.
+ */
+bool StartGlCapture(const char* path, const int32_t num_frames);
+void EndGlCaptureFrame();
+void StopGlCapture();
+bool IsGlCaptureActive();
+
+}  // namespace leia_helper
+#endif /* LEIA_HELPER_GLCAPTURE_H_ */
@@ -0,0 +1,177 @@
+/*
+ * Copyright 2018 Leia Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//--------------------------------------------------------------------------------
+// glTrace.cpp
+// Trace files of glCapture.cpp
+//
+// Arguments and data of the ops, where they differ from the parameters:
+//   frame                    frame index, CPU time since the last frame in
+//                            microseconds
+//   glGen*, glDelete*        n, data the names
+//   glCreateProgram          the program
+//   glCreateShader           type, the shader
+//   glGetUniformLocation     program, the location, data the name
+//   glGetUniformBlockIndex   program, the index, data the name
+//   glBindAttribLocation     program, index, data the name
+//   glShaderSource           shader, data the sources joined
+//   glBufferData             target, size, usage, 1 with data, data
+//   glBufferSubData          target, offset, size, data
+//   glTexSubImage2D          target, level, x, y, width, height, format,
+//                            type, data the pixels when they were sized
+//   glUniform*fv             location, count, data the values
+//   glUniformMatrix4fv       location, count, transpose, data the values
+//   glDrawBuffers            n, data the buffers
+//   glInvalidateFramebuffer  target, count, data the attachments
+//   glProgramBinary          program, format, length, data the binary
+//   glMapBufferRange         target, offset, length, access
+//   glUnmapBuffer            target, data the mapped range when written
+//--------------------------------------------------------------------------------
+#include "glTrace.h"
+
+namespace leia_helper {
+
+static const char* OP_NAMES[GL_TRACE_OP_COUNT] = {
+    "frame",
+#define GL_TRACE_OP_NAME(op, ret, name, params, args) "gl" #name,
+    GL3STUB_ES2_CAPTURE_PROCS(GL_TRACE_OP_NAME)
+    GL3STUB_ES3_CAPTURE_PROCS(GL_TRACE_OP_NAME)
+#undef GL_TRACE_OP_NAME
+};
+
+const char* GetGlTraceOpName(const GL_TRACE_OP op) {
+  if (op < 0 || op >= GL_TRACE_OP_COUNT) return "unknown";
+  return OP_NAMES[op];
+}
+
+GL_TRACE_OP FindGlTraceOp(const char* name) {
+  for (int32_t op = 0; op < GL_TRACE_OP_COUNT; ++op) {
+    if (!strcmp(OP_NAMES[op], name)) return (GL_TRACE_OP)op;
+  }
+  return GL_TRACE_OP_COUNT;
+}
+
+//--------------------------------------------------------------------------------
+// GlTraceWriter
+//--------------------------------------------------------------------------------
+GlTraceWriter::GlTraceWriter()
+    : file_(NULL), num_records_(0), num_bytes_(0), failed_(false) {}
+
+GlTraceWriter::~GlTraceWriter() { Close(); }
+
+bool GlTraceWriter::Open(const char* path, const int32_t width,
+                         const int32_t height) {
+  Close();
+  file_ = fopen(path, "wb");
+  if (!file_) return false;
+  // Uploads make large records, write them in big blocks
+  setvbuf(file_, NULL, _IOFBF, 1 << 20);
+  num_records_ = 0;
+  num_bytes_ = 0;
+  failed_ = false;
+  GL_TRACE_HEADER header = {GL_TRACE_MAGIC, GL_TRACE_VERSION, width, height};
+  WriteBytes(&header, sizeof(header));
+  return !failed_;
+}
+
+void GlTraceWriter::WriteBytes(const void* data, const size_t size) {
+  if (!size) return;
+  if (fwrite(data, 1, size, file_) != size) failed_ = true;
+  num_bytes_ += size;
+}
+
+void GlTraceWriter::Write(const GL_TRACE_OP op, const uint32_t* args,
+                          const int32_t num_args, const void* data,
+                          const uint32_t data_size) {
+  if (!file_) return;
+  GL_TRACE_RECORD record = {(uint16_t)op, (uint16_t)num_args, data_size};
+  WriteBytes(&record, sizeof(record));
+  WriteBytes(args, num_args * sizeof(uint32_t));
+  WriteBytes(data, data_size);
+  const uint32_t zero = 0;
+  WriteBytes(&zero, (4 - (data_size & 3)) & 3);
+  ++num_records_;
+}
+
+bool GlTraceWriter::Close() {
+  if (!file_) return !failed_;
+  if (fclose(file_)) failed_ = true;
+  file_ = NULL;
+  return !failed_;
+}
+
+//--------------------------------------------------------------------------------
+// GlTraceReader
+//--------------------------------------------------------------------------------
+GlTraceReader::GlTraceReader() : position_(0), complete_(false) {
+  memset(&header_, 0, sizeof(header_));
+}
+
+GlTraceReader::~GlTraceReader() {}
+
+bool GlTraceReader::Open(const char* path) {
+  bytes_.clear();
+  position_ = 0;
+  complete_ = false;
+  FILE* file = fopen(path, "rb");
+  if (!file) return false;
+  uint8_t buffer[1 << 16];
+  size_t size;
+  while ((size = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    bytes_.insert(bytes_.end(), buffer, buffer + size);
+  fclose(file);
+
+  if (bytes_.size() < sizeof(header_)) return false;
+  memcpy(&header_, &bytes_[0], sizeof(header_));
+  if (header_.magic != GL_TRACE_MAGIC || header_.version != GL_TRACE_VERSION)
+    return false;
+  Rewind();
+  return true;
+}
+
+void GlTraceReader::Rewind() {
+  position_ = sizeof(header_);
+  complete_ = position_ == bytes_.size();
+}
+
+bool GlTraceReader::Next(GL_TRACE_CALL* call) {
+  const size_t size = bytes_.size();
+  if (position_ + sizeof(GL_TRACE_RECORD) > size) {
+    complete_ = position_ == size;
+    return false;
+  }
+  GL_TRACE_RECORD record;
+  memcpy(&record, &bytes_[position_], sizeof(record));
+  const size_t args_size = record.num_args * sizeof(uint32_t);
+  const size_t data_size = (record.data_size + 3) & ~(size_t)3;
+  const size_t end = position_ + sizeof(record) + args_size + data_size;
+  if (end > size || record.op >= GL_TRACE_OP_COUNT) {
+    complete_ = false;
+    return false;
+  }
+  // Records are 4 byte aligned from the start of the file
+  call->op = (GL_TRACE_OP)record.op;
+  call->num_args = record.num_args;
+  const uint8_t* bytes = bytes_.data() + position_ + sizeof(record);
+  call->args = (const uint32_t*)bytes;
+  call->data_size = record.data_size;
+  call->data = bytes + args_size;
+  position_ = end;
+  complete_ = position_ == size;
+  return true;
+}
+
+}  // namespace leia_helper
@@ -0,0 +1,170 @@
+/*
+ * Copyright 2018 Leia Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//--------------------------------------------------------------------------------
+// glTrace.h
+//--------------------------------------------------------------------------------
+#ifndef LEIA_HELPER_GLTRACE_H_
+#define LEIA_HELPER_GLTRACE_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+
+#include "gl3stubProcs.h"
+
+namespace leia_helper {
+
+// "LGLT", little endian
+static const uint32_t GL_TRACE_MAGIC = 0x544C474C;
+static const uint32_t GL_TRACE_VERSION = 1;
+
+/******************************************************************
+ * A call of gl3stubProcs.h, or the end of a frame
+ */
+enum GL_TRACE_OP {
+  GL_TRACE_FRAME,
+#define GL_TRACE_OP_ENUM(op, ret, name, params, args) GL_TRACE_##op,
+  GL3STUB_ES2_CAPTURE_PROCS(GL_TRACE_OP_ENUM)
+  GL3STUB_ES3_CAPTURE_PROCS(GL_TRACE_OP_ENUM)
+#undef GL_TRACE_OP_ENUM
+  GL_TRACE_OP_COUNT
+};
+
+// "glBindBuffer", "frame" for GL_TRACE_FRAME
+const char* GetGlTraceOpName(const GL_TRACE_OP op);
+// GL_TRACE_OP_COUNT when no op has the name
+GL_TRACE_OP FindGlTraceOp(const char* name);
+
+/******************************************************************
+ * Trace file layout, every field little endian
+ *
+ *   GL_TRACE_HEADER
+ *   GL_TRACE_RECORD, num_args 32 bit words, data_size bytes, padded to 4
+ *   ...
+ *
+ * Arguments are the call parameters in order, floats by their bits and
+ * offsets passed as pointers by their value. Results that name something,
+ * created objects, uniform locations, come after the parameters. Arrays,
+ * strings and pixels the call reads are the data. glTrace.cpp lists the
+ * arguments and data of each op.
+ *
+ * width, height: the default framebuffer, the viewport when the capture
+ *                started
+ */
+struct GL_TRACE_HEADER {
+  uint32_t magic;
+  uint32_t version;
+  int32_t width;
+  int32_t height;
+};
+
+struct GL_TRACE_RECORD {
+  uint16_t op;
+  uint16_t num_args;
+  uint32_t data_size;
+};
+
+// A record of a trace loaded by GlTraceReader
+struct GL_TRACE_CALL {
+  GL_TRACE_OP op;
+  int32_t num_args;
+  const uint32_t* args;
+  uint32_t data_size;
+  const uint8_t* data;
+};
+
+inline uint32_t GlTraceWord(const float value) {
+  uint32_t word;
+  memcpy(&word, &value, sizeof(word));
+  return word;
+}
+
+inline float GlTraceFloat(const uint32_t word) {
+  float value;
+  memcpy(&value, &word, sizeof(value));
+  return value;
+}
+
+/******************************************************************
+ * Buffered writer of trace files. Not thread safe, the capture serializes
+ * the calls.
+ */
+class GlTraceWriter {
+ private:
+  FILE* file_;
+  int64_t num_records_;
+  int64_t num_bytes_;
+  bool failed_;
+
+  void WriteBytes(const void* data, const size_t size);
+
+  GlTraceWriter(const GlTraceWriter&);
+  GlTraceWriter& operator=(const GlTraceWriter&);
+
+ public:
+  GlTraceWriter();
+  ~GlTraceWriter();
+
+  bool Open(const char* path, const int32_t width, const int32_t height);
+  void Write(const GL_TRACE_OP op, const uint32_t* args,
+             const int32_t num_args, const void* data,
+             const uint32_t data_size);
+  // False when a write failed since Open()
+  bool Close();
+
+  bool IsOpen() const { return file_ != NULL; }
+  int64_t GetNumRecords() const { return num_records_; }
+  int64_t GetNumBytes() const { return num_bytes_; }
+};
+
+/******************************************************************
+ * A trace file in memory, records in file order
+ *
+ *   reader.Open(path);
+ *   GL_TRACE_CALL call;
+ *   while (reader.Next(&call)) ...
+ *   if (!reader.IsComplete()) the file ends inside a record
+ */
+class GlTraceReader {
+ private:
+  std::vector<uint8_t> bytes_;
+  GL_TRACE_HEADER header_;
+  size_t position_;
+  bool complete_;
+
+  GlTraceReader(const GlTraceReader&);
+  GlTraceReader& operator=(const GlTraceReader&);
+
+ public:
+  GlTraceReader();
+  ~GlTraceReader();
+
+  // False when the file can not be read or is no trace of this version
+  bool Open(const char* path);
+  bool Next(GL_TRACE_CALL* call);
+  void Rewind();
+
+  bool IsComplete() const { return complete_; }
+  int32_t GetWidth() const { return header_.width; }
+  int32_t GetHeight() const { return header_.height; }
+  size_t GetSize() const { return bytes_.size(); }
+};
+
+}  // namespace leia_helper
+#endif /* LEIA_HELPER_GLTRACE_H_ */
@@ -0,0 +1,170 @@
+/*
+ * Copyright 2018 Leia Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//--------------------------------------------------------------------------------
+// multiview.cpp
+// Single pass multiview render targets (GL_OVR_multiview2)
+//--------------------------------------------------------------------------------
+#include <string.h>
+#include <EGL/egl.h>
+
+#include "JNIHelper.h"
+#include "multiview.h"
+#include "renderContext.h"
+#include "renderTargetPool.h"
+
+namespace leia_helper {
+
+static PFNGLFRAMEBUFFERTEXTUREMULTIVIEWOVR glFramebufferTextureMultiviewOVR =
+    NULL;
+static bool multiview_supported = false;
+
+static bool HasExtension(const char* extension) {
+  const char* extensions = (const char*)glGetString(GL_EXTENSIONS);
+  if (extensions == NULL) return false;
+
+  // Match whole words only, "GL_OVR_multiview" is a prefix of
+  // "GL_OVR_multiview2"
+  size_t len = strlen(extension);
+  const char* p = extensions;
+  while ((p = strstr(p, extension)) != NULL) {
+    if ((p == extensions || p[-1] == ' ') && (p[len] == ' ' || p[len] == 0))
+      return true;
+    p += len;
+  }
+  return false;
+}
+
+bool InitMultiview(int32_t num_views) {
+  multiview_supported = false;
+
+  if (!HasExtension("GL_OVR_multiview2")) {
+    LOGI("GL_OVR_multiview2 is not available, using per view rendering");
+    return false;
+  }
+
+  glFramebufferTextureMultiviewOVR = (PFNGLFRAMEBUFFERTEXTUREMULTIVIEWOVR)
+      eglGetProcAddress("glFramebufferTextureMultiviewOVR");
+  if (glFramebufferTextureMultiviewOVR == NULL) {
+    LOGW("glFramebufferTextureMultiviewOVR could not be loaded");
+    return false;
+  }
+
+  GLint max_views = 0;
+  glGetIntegerv(GL_MAX_VIEWS_OVR, &max_views);
+  if (max_views < num_views) {
+    LOGI("GL_OVR_multiview2 supports %d views, %d are needed", max_views,
+         num_views);
+    return false;
+  }
+
+  multiview_supported = true;
+  return true;
+}
+
+bool IsMultiviewSupported() { return multiview_supported; }
+
+//--------------------------------------------------------------------------------
+// MultiviewTarget
+//--------------------------------------------------------------------------------
+MultiviewTarget::MultiviewTarget()
+    : fbo_(0),
+      color_texture_(0),
+      depth_texture_(0),
+      fbo_dof_(0),
+      texture_dof_(0),
+      width_(0),
+      height_(0),
+      num_views_(0) {}
+
+MultiviewTarget::~MultiviewTarget() { Unload(); }
+
+static GLuint CreateTextureArray(int32_t width, int32_t height, int32_t layers,
+                                 GLenum internal_format) {
+  RENDER_TARGET_DESC desc = {width, height, layers, internal_format,
+                             RENDER_TARGET_USAGE_TEXTURE_ARRAY};
+  return RenderTargetPool::GetInstance()->AcquireTexture(desc);
+}
+
+bool MultiviewTarget::Init(const int32_t width, const int32_t height,
+                           const int32_t num_views) {
+  if (!multiview_supported) return false;
+
+  Unload();
+  width_ = width;
+  height_ = height;
+  num_views_ = num_views;
+
+  color_texture_ = CreateTextureArray(width, height, num_views, GL_RGBA8);
+  depth_texture_ =
+      CreateTextureArray(width, height, num_views, GL_DEPTH_COMPONENT32F);
+  texture_dof_ = CreateTextureArray(width, height, num_views, GL_RGBA8);
+
+  GLenum attachment = GL_COLOR_ATTACHMENT0;
+  glGenFramebuffers(1, &fbo_);
+  glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
+  glFramebufferTextureMultiviewOVR(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                                   color_texture_, 0, 0, num_views);
+  glFramebufferTextureMultiviewOVR(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                                   depth_texture_, 0, 0, num_views);
+  glDrawBuffers(1, &attachment);
+  GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+  if (status != GL_FRAMEBUFFER_COMPLETE) {
+    LOGE("Multiview scene FBO is incomplete: 0x%x", status);
+    Unload();
+    return false;
+  }
+
+  glGenFramebuffers(1, &fbo_dof_);
+  glBindFramebuffer(GL_FRAMEBUFFER, fbo_dof_);
+  glFramebufferTextureMultiviewOVR(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                                   texture_dof_, 0, 0, num_views);
+  glDrawBuffers(1, &attachment);
+  status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+  if (status != GL_FRAMEBUFFER_COMPLETE) {
+    LOGE("Multiview DOF FBO is incomplete: 0x%x", status);
+    Unload();
+    return false;
+  }
+
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  return true;
+}
+
+void MultiviewTarget::Unload() {
+  if (fbo_) {
+    glDeleteFramebuffers(1, &fbo_);
+    fbo_ = 0;
+  }
+  if (fbo_dof_) {
+    glDeleteFramebuffers(1, &fbo_dof_);
+    fbo_dof_ = 0;
+  }
+  RenderTargetPool* pool = RenderTargetPool::GetInstance();
+  pool->ReleaseTexture(color_texture_);
+  pool->ReleaseTexture(depth_texture_);
+  pool->ReleaseTexture(texture_dof_);
+  color_texture_ = 0;
+  depth_texture_ = 0;
+  texture_dof_ = 0;
+}
+
+void MultiviewTarget::BindScene() {
+  LeiaRenderContext::GetInstance()->BindFramebuffer(fbo_);
+  glViewport(0, 0, width_, height_);
+}
+
+}  // namespace leia_helper
@@ -0,0 +1,92 @@
+/*
+ * Copyright 2018 Leia Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//--------------------------------------------------------------------------------
+// multiview.h
+//--------------------------------------------------------------------------------
+#ifndef LEIA_HELPER_MULTIVIEW_H_
+#define LEIA_HELPER_MULTIVIEW_H_
+
+#include "gl3stub.h"
+
+//--------------------------------------------------------------------------------
+// GL_OVR_multiview tokens, not present in the NDK headers we build against
+//--------------------------------------------------------------------------------
+#ifndef GL_OVR_multiview
+#define GL_FRAMEBUFFER_ATTACHMENT_TEXTURE_NUM_VIEWS_OVR 0x9630
+#define GL_FRAMEBUFFER_ATTACHMENT_TEXTURE_BASE_VIEW_INDEX_OVR 0x9632
+#define GL_MAX_VIEWS_OVR 0x9631
+#define GL_FRAMEBUFFER_INCOMPLETE_VIEW_TARGETS_OVR 0x9633
+#endif
+
+typedef void (*PFNGLFRAMEBUFFERTEXTUREMULTIVIEWOVR)(GLenum target,
+                                                    GLenum attachment,
+                                                    GLuint texture, GLint level,
+                                                    GLint base_view_index,
+                                                    GLsizei num_views);
+
+namespace leia_helper {
+
+/******************************************************************
+ * GL_OVR_multiview2 support
+ * InitMultiview() must be called with a current context before any other
+ * multiview call. It returns false when the driver does not expose the
+ * extension or enough views, in which case callers keep rendering each view
+ * with its own draw loop.
+ */
+bool InitMultiview(int32_t num_views);
+bool IsMultiviewSupported();
+
+/******************************************************************
+ * Render target for single pass multiview rendering
+ * All views live in the layers of one GL_TEXTURE_2D_ARRAY (colour + depth),
+ * and a second array receives the per-view depth of field result.
+ * Both framebuffers are layered with glFramebufferTextureMultiviewOVR, so one
+ * draw call reaches every view.
+ */
+class MultiviewTarget {
+ private:
+  GLuint fbo_;
+  GLuint color_texture_;
+  GLuint depth_texture_;
+
+  GLuint fbo_dof_;
+  GLuint texture_dof_;
+
+  int32_t width_;
+  int32_t height_;
+  int32_t num_views_;
+
+ public:
+  MultiviewTarget();
+  virtual ~MultiviewTarget();
+
+  bool Init(const int32_t width, const int32_t height, const int32_t num_views);
+  void Unload();
+
+  void BindScene();
+
+  GLuint GetColorTexture() const { return color_texture_; }
+  GLuint GetDepthTexture() const { return depth_texture_; }
+  GLuint GetDOFTexture() const { return texture_dof_; }
+  GLuint GetDOFFramebuffer() const { return fbo_dof_; }
+  int32_t GetWidth() const { return width_; }
+  int32_t GetHeight() const { return height_; }
+  int32_t GetNumViews() const { return num_views_; }
+};
+
+}  // namespace leia_helper
+#endif /* LEIA_HELPER_MULTIVIEW_H_ */
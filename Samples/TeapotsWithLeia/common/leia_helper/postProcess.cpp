@@ -0,0 +1,946 @@
+/*
+ * Copyright 2018 Leia Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//--------------------------------------------------------------------------------
+// postProcess.cpp
+// Leia post processing passes working on texture arrays and view atlases
+//--------------------------------------------------------------------------------
+#include <stdio.h>
+
+#include <string>
+
+#include "postProcess.h"
+#include "JNIHelper.h"
+#include "cameraBuffer.h"
+#include "programBuilder.h"
+#include "renderContext.h"
+
+namespace leia_helper {
+
+//--------------------------------------------------------------------------------
+// Shader sources
+// Every source is prefixed at build time with the #version line, the
+// extensions the pass needs, "#define NUM_VIEWS n" and, for the passes that
+// read the camera, the LeiaCamera block of cameraBuffer.h.
+//--------------------------------------------------------------------------------
+static const char* QUAD_VERTEX_SHADER = R"(
+in highp vec2 myVertex;
+in highp vec2 myUV;
+
+out highp vec2 v_tex;
+
+void main(void)
+{
+    gl_Position = vec4(myVertex, 0.0, 1.0);
+    v_tex = myUV;
+}
+)";
+
+static const char* MULTIVIEW_DOF_VERTEX_SHADER = R"(
+layout(num_views = NUM_VIEWS) in;
+
+in highp vec2 myVertex;
+in highp vec2 myUV;
+
+out highp vec2 v_tex;
+flat out int tex_id;
+
+void main(void)
+{
+    gl_Position = vec4(myVertex, 0.0, 1.0);
+    tex_id = int(gl_ViewID_OVR);
+    v_tex = myUV;
+}
+)";
+
+// Depth of field of a multiview array, one layer per view. Built with ATLAS
+// it runs over a whole view atlas instead: the view under each fragment is
+// looked up in view_rects and taps are clamped to its region.
+// Built with INTERLACE it is the interlacer: the view index map picks the
+// views of each screen pixel and only those are blurred, so views are never
+// blurred in full and no depth of field target is written.
+// The camera comes from the LeiaCamera block, only the aperture is set per
+// pass.
+static const char* DOF_FRAGMENT_SHADER = R"(
+precision highp float;
+precision highp sampler2D;
+precision highp sampler2DArray;
+precision highp usampler2D;
+
+#define view_width leia_view_size.x
+#define aspect_ratio leia_view_size.z
+#define f_in_pixels leia_view_size.w
+#define convergence_distance leia_camera.x
+#define baseline leia_camera.y
+#define near leia_camera.z
+#define far leia_camera.w
+
+#ifdef ATLAS
+uniform sampler2D colorTex;
+uniform sampler2D depthTex;
+uniform vec4 view_rects[NUM_VIEWS];
+#define half_texel (0.5 / leia_view_size.xy)
+vec4 view_rect;
+#define SELECT_VIEW(i) view_rect = view_rects[i]
+#define VIEW_UV(uv) (view_rect.xy + clamp(uv, half_texel, 1.0 - half_texel) * view_rect.zw)
+#else
+uniform sampler2DArray colorTex;
+uniform sampler2DArray depthTex;
+#ifdef INTERLACE
+int tex_id;
+#define SELECT_VIEW(i) tex_id = i
+#else
+flat in int tex_id;
+#endif
+#define VIEW_UV(uv) vec3(uv, float(tex_id))
+#endif
+
+#ifdef INTERLACE
+uniform usampler2D view_index;
+#endif
+
+uniform float aperture;
+
+in vec2 v_tex;
+
+out vec4 final_color;
+
+#define DITHERING_FACTOR 0.5
+
+const int kernel_size = 16;
+const vec2[] kernel = vec2[](
+  vec2( 0.00000000, 0.00000000), vec2( 0.54545456, 0.00000000),
+  vec2( 0.16855472, 0.51875810), vec2(-0.44128203, 0.32061010),
+  vec2(-0.44128197,-0.32061020), vec2( 0.16855480,-0.51875810),
+  vec2( 1.00000000, 0.00000000), vec2( 0.80901700, 0.58778524),
+  vec2( 0.30901697, 0.95105654), vec2(-0.30901703, 0.95105650),
+  vec2(-0.80901706, 0.58778520), vec2(-1.00000000, 0.00000000),
+  vec2(-0.80901694,-0.58778536), vec2(-0.30901664,-0.95105660),
+  vec2( 0.30901712,-0.95105650), vec2( 0.80901694,-0.58778530)
+);
+const float[] weights = float[](
+  0.16097572005690314,  0.10087772702157849,  0.10087772972724006,
+  0.100877728733224,    0.10087772696353085,  0.10087772545381421,
+  0.033463564488187894, 0.03346356476936258,  0.033463562909953504,
+  0.03346356496009724,  0.03346356213802727,  0.033463564488187894,
+  0.033463562457240095, 0.033463567631518164, 0.03346356203630138,
+  0.03346356616483319
+);
+
+float real_z(vec2 uv)
+{
+    float z_b = texture(depthTex, VIEW_UV(uv)).r;
+    float z_n = 2.0 * z_b - 1.0;
+    return 2.0 * near * far / (far + near - z_n * (far - near));
+}
+
+float getBlurInTexelSpace(vec2 uv)
+{
+    float disparity_in_pixels = baseline * f_in_pixels *
+                                (1.0 / convergence_distance - 1.0 / real_z(uv));
+    return aperture * (disparity_in_pixels / view_width);
+}
+
+float rand(float n)
+{
+    return fract(sin(n) * 1784358.5453123) - 0.5;
+}
+
+vec2 getDitheringOffset(vec2 uv, float iteration)
+{
+    uv += uv * iteration;
+    return DITHERING_FACTOR * vec2(rand(uv.x - uv.x * uv.y), rand(uv.y - uv.y * uv.x));
+}
+
+vec4 depthOfField(vec2 uv)
+{
+    vec4 result = vec4(0.0);
+    float blur_radius = getBlurInTexelSpace(uv);
+    for (int i = 0; i < kernel_size; i++) {
+        vec2 point = kernel[i] + getDitheringOffset(uv, float(i));
+        point.y /= aspect_ratio;
+        result += texture(colorTex, VIEW_UV(uv + blur_radius * point)) * weights[i];
+    }
+    return result;
+}
+
+void main(void)
+{
+#if defined(INTERLACE)
+    // Centre of the view texel under the fragment, where the separate pass
+    // would have evaluated it. Channels showing the same view share one blur.
+    vec2 view_res = leia_view_size.xy;
+    vec2 uv = (floor(v_tex * view_res) + 0.5) / view_res;
+    ivec2 texel = ivec2(gl_FragCoord.xy) % textureSize(view_index, 0);
+    ivec3 layer = ivec3(texelFetch(view_index, texel, 0).rgb);
+    SELECT_VIEW(layer.r);
+    vec4 c = depthOfField(uv);
+    final_color.r = c.r;
+    if (layer.g != layer.r) {
+        SELECT_VIEW(layer.g);
+        c = depthOfField(uv);
+    }
+    final_color.g = c.g;
+    if (layer.b != layer.g) {
+        SELECT_VIEW(layer.b);
+        c = depthOfField(uv);
+    }
+    final_color.b = c.b;
+    final_color.a = 1.0;
+#elif defined(ATLAS)
+    view_rect = view_rects[0];
+    for (int i = 1; i < NUM_VIEWS; i++) {
+        vec4 r = view_rects[i];
+        if (all(greaterThanEqual(v_tex, r.xy)) && all(lessThan(v_tex, r.xy + r.zw)))
+            view_rect = r;
+    }
+    final_color = depthOfField((v_tex - view_rect.xy) / view_rect.zw);
+#else
+    final_color = depthOfField(v_tex);
+#endif
+}
+)";
+
+// Views are laid out row major in the array, layer = y * horizontal + x.
+// The view count is a uniform so one program serves 2, 4 or 8 view panels.
+static const char* VIEW_INTERLACE_ARRAY_FRAGMENT_SHADER = R"(
+precision highp float;
+precision highp sampler2DArray;
+
+uniform sampler2DArray views;
+uniform float alignment_offset;
+uniform vec2 num_views;
+
+in highp vec2 v_tex;
+
+out vec4 final_color;
+
+void main()
+{
+    vec2 view = mod(floor(gl_FragCoord.xy + vec2(alignment_offset, 0.0)), num_views);
+    final_color = texture(views, vec3(v_tex, view.y * num_views.x + view.x));
+}
+)";
+
+// Interlace and view sharpening in one pass. The interlaced neighbours the
+// sharpening filter needs are fetched straight from the view array, so the
+// interlaced image never goes through memory. Same filter as the SDK pass:
+// sqrt((c^2 - a(l^2 + r^2) - b(ll^2 + rr^2)) / (1 - 2a - 2b))
+static const char* VIEW_INTERLACE_SHARPEN_ARRAY_FRAGMENT_SHADER = R"(
+precision highp float;
+precision highp sampler2DArray;
+
+uniform sampler2DArray views;
+uniform float alignment_offset;
+uniform vec2 num_views;
+uniform float width;
+uniform float a;
+uniform float b;
+
+in highp vec2 v_tex;
+
+out vec4 final_color;
+
+vec4 linearInterlaced(float dx)
+{
+    // Clamp to the screen like a fetch from the interlaced texture would
+    float x = clamp(gl_FragCoord.x + dx, 0.5, width - 0.5);
+    vec2 view = mod(floor(vec2(x + alignment_offset, gl_FragCoord.y)), num_views);
+    vec2 uv = vec2(v_tex.x + (x - gl_FragCoord.x) / width, v_tex.y);
+    vec4 c = texture(views, vec3(uv, view.y * num_views.x + view.x));
+    return c * c;
+}
+
+void main()
+{
+    float multiplier = 1.0 - (2.0 * a) - (2.0 * b);
+    vec4 linear = linearInterlaced(0.0) -
+                  a * (linearInterlaced(-1.0) + linearInterlaced(1.0)) -
+                  b * (linearInterlaced(-2.0) + linearInterlaced(2.0));
+    final_color = sqrt(clamp(linear / multiplier, 0.0, 1.0));
+}
+)";
+
+// Interlacing through the view index map (see viewIndexMap.h). One integer
+// fetch gives the layer of each colour channel, which covers pixel and sub
+// pixel layouts and any slant. Built with and without SHARPEN, and with ATLAS
+// to read the views from the regions of a view atlas instead of an array.
+static const char* VIEW_INTERLACE_INDEXED_FRAGMENT_SHADER = R"(
+precision highp float;
+precision highp sampler2D;
+precision highp sampler2DArray;
+precision highp usampler2D;
+
+#ifdef ATLAS
+uniform sampler2D views;
+uniform vec4 view_rects[NUM_VIEWS];
+#define VIEW_UV(uv, layer) (view_rects[int(layer)].xy + (uv) * view_rects[int(layer)].zw)
+#else
+uniform sampler2DArray views;
+#define VIEW_UV(uv, layer) vec3(uv, layer)
+#endif
+uniform usampler2D view_index;
+uniform float width;
+uniform float a;
+uniform float b;
+
+in highp vec2 v_tex;
+
+out vec4 final_color;
+
+vec3 interlaced(float dx)
+{
+    // Clamp to the screen like a fetch from the interlaced texture would
+    float x = clamp(gl_FragCoord.x + dx, 0.5, width - 0.5);
+    ivec2 texel = ivec2(int(x), int(gl_FragCoord.y)) % textureSize(view_index, 0);
+    vec3 layer = vec3(texelFetch(view_index, texel, 0).rgb);
+    vec2 uv = vec2(v_tex.x + (x - gl_FragCoord.x) / width, v_tex.y);
+    return vec3(texture(views, VIEW_UV(uv, layer.r)).r,
+                texture(views, VIEW_UV(uv, layer.g)).g,
+                texture(views, VIEW_UV(uv, layer.b)).b);
+}
+
+void main()
+{
+#ifdef SHARPEN
+    vec3 c = interlaced(0.0);
+    vec3 l = interlaced(-1.0);
+    vec3 r = interlaced(1.0);
+    vec3 ll = interlaced(-2.0);
+    vec3 rr = interlaced(2.0);
+    float multiplier = 1.0 - (2.0 * a) - (2.0 * b);
+    vec3 linear = c * c - a * (l * l + r * r) - b * (ll * ll + rr * rr);
+    final_color = vec4(sqrt(clamp(linear / multiplier, 0.0, 1.0)), 1.0);
+#else
+    final_color = vec4(interlaced(0.0), 1.0);
+#endif
+}
+)";
+
+// View synthesis into a view atlas, see cpuViewSynthesis.h for the model.
+// Colour and depth of each view come from the nearest source view layer; the
+// depth is written too so the depth of field pass runs unchanged afterwards.
+// Mirrors CpuViewSynthesis() operation for operation, view-synthesis-bench
+// checks the colour it writes against it.
+static const char* VIEW_SYNTHESIS_ATLAS_FRAGMENT_SHADER = R"(
+precision highp float;
+precision highp int;
+precision highp sampler2DArray;
+
+uniform sampler2DArray source_color;
+uniform sampler2DArray source_depth;
+uniform vec4 view_rects[NUM_VIEWS];
+uniform float source_positions[2];
+uniform int num_sources;
+uniform float disparity_scale;
+uniform float convergence_distance;
+uniform float near;
+uniform float far;
+uniform float min_disparity;
+uniform float max_disparity;
+uniform int search_steps;
+
+in highp vec2 v_tex;
+
+out vec4 final_color;
+
+#define COPY_DISTANCE 1.0e-4
+
+int background_texel;
+
+float linearDepth(float depth)
+{
+    float z_n = 2.0 * depth - 1.0;
+    return 2.0 * near * far / (far + near - z_n * (far - near));
+}
+
+float disparity(float z)
+{
+    return disparity_scale * (1.0 / convergence_distance - 1.0 / z);
+}
+
+// Source texel landing on pixel x of a view offset view_steps from the
+// source, background_texel is the farthest texel searched
+bool searchSource(int layer, int width, int y, float view_steps, int x, out int texel)
+{
+    float x_target = float(x) + 0.5;
+    texel = x;
+    if (abs(view_steps) < COPY_DISTANCE)
+        return true;
+
+    float step = (max_disparity - min_disparity) / float(search_steps);
+    float tolerance = 0.5 * max(1.0, abs(view_steps) * step);
+    float best_z = 0.0;
+    float background_z = 0.0;
+    bool found = false;
+    for (int i = 0; i < search_steps; i++) {
+        float d = min_disparity + (float(i) + 0.5) * step;
+        int sx = clamp(int(floor(x_target - view_steps * d)), 0, width - 1);
+        float z = linearDepth(texelFetch(source_depth, ivec3(sx, y, layer), 0).r);
+        if (i == 0 || z > background_z) {
+            background_z = z;
+            background_texel = sx;
+        }
+        float error = abs(float(sx) + 0.5 + view_steps * disparity(z) - x_target);
+        if (error <= tolerance && (!found || z < best_z)) {
+            best_z = z;
+            texel = sx;
+            found = true;
+        }
+    }
+    return found;
+}
+
+void main()
+{
+    int view = 0;
+    for (int i = 1; i < NUM_VIEWS; i++) {
+        vec4 r = view_rects[i];
+        if (all(greaterThanEqual(v_tex, r.xy)) && all(lessThan(v_tex, r.xy + r.zw)))
+            view = i;
+    }
+    ivec2 size = textureSize(source_color, 0).xy;
+    vec4 rect = view_rects[view];
+    ivec2 pixel = ivec2(gl_FragCoord.xy) - ivec2(round(rect.xy / rect.zw * vec2(size)));
+
+    // Nearest source first, the other one fills disocclusions
+    float position = float(view);
+    int primary = 0;
+    if (num_sources > 1 &&
+        abs(position - source_positions[1]) < abs(position - source_positions[0]))
+        primary = 1;
+    int source = primary;
+    int texel;
+    if (!searchSource(primary, size.x, pixel.y, position - source_positions[primary],
+                      pixel.x, texel)) {
+        int background = background_texel;
+        if (num_sources > 1 &&
+            searchSource(1 - primary, size.x, pixel.y,
+                         position - source_positions[1 - primary], pixel.x, texel))
+            source = 1 - primary;
+        else
+            texel = background;
+    }
+
+    ivec3 src = ivec3(texel, pixel.y, source);
+    final_color = texelFetch(source_color, src, 0);
+    gl_FragDepth = texelFetch(source_depth, src, 0).r;
+}
+)";
+
+// View sharpening of an interlaced image, the filter of leiaViewSharpening()
+// and of the SHARPEN interlacers, for chains that run without the SDK passes
+static const char* VIEW_SHARPENING_FRAGMENT_SHADER = R"(
+precision highp float;
+precision highp sampler2D;
+
+uniform sampler2D interlaced;
+uniform float a;
+uniform float b;
+
+out vec4 final_color;
+
+vec3 linearInterlaced(int dx)
+{
+    // Neighbours are clamped to the screen edge
+    int x = clamp(int(gl_FragCoord.x) + dx, 0, textureSize(interlaced, 0).x - 1);
+    vec3 c = texelFetch(interlaced, ivec2(x, int(gl_FragCoord.y)), 0).rgb;
+    return c * c;
+}
+
+void main()
+{
+    float multiplier = 1.0 - (2.0 * a) - (2.0 * b);
+    vec3 linear = linearInterlaced(0) -
+                  a * (linearInterlaced(-1) + linearInterlaced(1)) -
+                  b * (linearInterlaced(-2) + linearInterlaced(2));
+    final_color = vec4(sqrt(clamp(linear / multiplier, 0.0, 1.0)), 1.0);
+}
+)";
+
+struct POST_SHADER_SOURCE {
+  const char* vertex_header;
+  const char* fragment_header;
+  const char* vertex;
+  const char* fragment;
+  // The fragment shader reads the LeiaCamera block
+  bool camera_block;
+};
+
+static const POST_SHADER_SOURCE POST_SHADER_SOURCES[POST_SHADER_COUNT] = {
+    // POST_SHADER_MULTIVIEW_DOF
+    {"#extension GL_OVR_multiview2 : require\n", "",
+     MULTIVIEW_DOF_VERTEX_SHADER, DOF_FRAGMENT_SHADER, true},
+    // POST_SHADER_VIEW_INTERLACE_ARRAY
+    {"", "", QUAD_VERTEX_SHADER, VIEW_INTERLACE_ARRAY_FRAGMENT_SHADER,
+     false},
+    // POST_SHADER_VIEW_INTERLACE_SHARPEN_ARRAY
+    {"", "", QUAD_VERTEX_SHADER, VIEW_INTERLACE_SHARPEN_ARRAY_FRAGMENT_SHADER,
+     false},
+    // POST_SHADER_VIEW_INTERLACE_INDEXED
+    {"", "", QUAD_VERTEX_SHADER, VIEW_INTERLACE_INDEXED_FRAGMENT_SHADER,
+     false},
+    // POST_SHADER_VIEW_INTERLACE_SHARPEN_INDEXED
+    {"", "#define SHARPEN\n", QUAD_VERTEX_SHADER,
+     VIEW_INTERLACE_INDEXED_FRAGMENT_SHADER, false},
+    // POST_SHADER_ATLAS_DOF
+    {"", "#define ATLAS\n", QUAD_VERTEX_SHADER, DOF_FRAGMENT_SHADER, true},
+    // POST_SHADER_VIEW_INTERLACE_INDEXED_ATLAS
+    {"", "#define ATLAS\n", QUAD_VERTEX_SHADER,
+     VIEW_INTERLACE_INDEXED_FRAGMENT_SHADER, false},
+    // POST_SHADER_VIEW_INTERLACE_SHARPEN_INDEXED_ATLAS
+    {"", "#define ATLAS\n#define SHARPEN\n", QUAD_VERTEX_SHADER,
+     VIEW_INTERLACE_INDEXED_FRAGMENT_SHADER, false},
+    // POST_SHADER_VIEW_INTERLACE_DOF_INDEXED
+    {"", "#define INTERLACE\n", QUAD_VERTEX_SHADER, DOF_FRAGMENT_SHADER, true},
+    // POST_SHADER_VIEW_INTERLACE_DOF_INDEXED_ATLAS
+    {"", "#define ATLAS\n#define INTERLACE\n", QUAD_VERTEX_SHADER,
+     DOF_FRAGMENT_SHADER, true},
+    // POST_SHADER_VIEW_SYNTHESIS_ATLAS
+    {"", "", QUAD_VERTEX_SHADER, VIEW_SYNTHESIS_ATLAS_FRAGMENT_SHADER,
+     false},
+    // POST_SHADER_VIEW_SHARPENING
+    {"", "", QUAD_VERTEX_SHADER, VIEW_SHARPENING_FRAGMENT_SHADER, false},
+};
+
+static std::string GetPostSource(const char* prefix, const int32_t num_views,
+                                 const char* body, bool camera_block) {
+  char header[256];
+  snprintf(header, sizeof(header), "#version 300 es\n%s#define NUM_VIEWS %d\n",
+           prefix, num_views);
+  std::string source(header);
+  if (camera_block) source.append(CAMERA_BLOCK_SOURCE);
+  source.append(body);
+  return source;
+}
+
+static const PROGRAM_ATTRIBUTE POST_PROGRAM_ATTRIBUTES[] = {
+    {POST_ATTRIB_VERTEX, "myVertex"}, {POST_ATTRIB_UV, "myUV"}};
+static const int32_t NUM_POST_PROGRAM_ATTRIBUTES =
+    sizeof(POST_PROGRAM_ATTRIBUTES) / sizeof(POST_PROGRAM_ATTRIBUTES[0]);
+
+GLuint CreatePostProgram(const POST_SHADER shader, const int32_t num_views) {
+  if (shader < 0 || shader >= POST_SHADER_COUNT) return 0;
+  const POST_SHADER_SOURCE& src = POST_SHADER_SOURCES[shader];
+
+  std::string vert_source =
+      GetPostSource(src.vertex_header, num_views, src.vertex, false);
+  std::string frag_source = GetPostSource(src.fragment_header, num_views,
+                                          src.fragment, src.camera_block);
+  GLuint program =
+      CreateProgram("post", vert_source.c_str(), frag_source.c_str(),
+                    POST_PROGRAM_ATTRIBUTES, NUM_POST_PROGRAM_ATTRIBUTES);
+  if (!program) LOGI("Failed to create post program %d", shader);
+  return program;
+}
+
+void AddPostProgram(ProgramBuilder* builder, GLuint* program,
+                    const POST_SHADER shader, const int32_t num_views) {
+  if (shader < 0 || shader >= POST_SHADER_COUNT) return;
+  const POST_SHADER_SOURCE& src = POST_SHADER_SOURCES[shader];
+  builder->AddProgram(
+      program, "post",
+      GetPostSource(src.vertex_header, num_views, src.vertex, false),
+      GetPostSource(src.fragment_header, num_views, src.fragment,
+                    src.camera_block),
+      POST_PROGRAM_ATTRIBUTES, NUM_POST_PROGRAM_ATTRIBUTES);
+}
+
+//--------------------------------------------------------------------------------
+// Passes
+//--------------------------------------------------------------------------------
+// Binds and uniform locations go through LeiaRenderContext, passes that run
+// every frame query each location once
+static GLint UniformLocation(GLuint program, const char* name) {
+  return LeiaRenderContext::GetInstance()->GetUniformLocation(program, name);
+}
+
+// The camera is in the LeiaCamera block, uploaded once for the frame
+static void PrepareDOF(GLenum texture_target, GLuint color, GLuint depth,
+                       GLuint dof_program, GLuint fbo_target, int width,
+                       int height, float aperture) {
+  LeiaRenderContext* context = LeiaRenderContext::GetInstance();
+  context->BindFramebuffer(fbo_target);
+  glViewport(0, 0, width, height);
+  glDisable(GL_DEPTH_TEST);
+  context->UseProgram(dof_program);
+  UseCameraBlock(dof_program);
+
+  context->BindTexture(0, texture_target, color);
+  glUniform1i(UniformLocation(dof_program, "colorTex"), 0);
+  context->BindTexture(1, texture_target, depth);
+  glUniform1i(UniformLocation(dof_program, "depthTex"), 1);
+
+  glUniform1f(UniformLocation(dof_program, "aperture"), aperture);
+}
+
+static void SetAtlasDOFUniforms(GLuint dof_program, const GLfloat* view_rects,
+                                const LeiaCameraData* data) {
+  glUniform4fv(UniformLocation(dof_program, "view_rects"),
+               data->mNumViewsHorizontal * data->mNumViewsVertical,
+               view_rects);
+}
+
+void PrepareMultiviewDOF(GLuint color_array, GLuint depth_array,
+                         const LeiaCameraData* data, GLuint dof_program,
+                         GLuint fbo_target, float aperture) {
+  PrepareDOF(GL_TEXTURE_2D_ARRAY, color_array, depth_array, dof_program,
+             fbo_target, (int)data->mViewResXPixels,
+             (int)data->mViewResYPixels, aperture);
+}
+
+void PrepareAtlasDOF(GLuint color_atlas, GLuint depth_atlas,
+                     const GLfloat* view_rects, const LeiaCameraData* data,
+                     GLuint dof_program, GLuint fbo_target, int atlas_width,
+                     int atlas_height, float aperture) {
+  PrepareDOF(GL_TEXTURE_2D, color_atlas, depth_atlas, dof_program,
+             fbo_target, atlas_width, atlas_height, aperture);
+  SetAtlasDOFUniforms(dof_program, view_rects, data);
+}
+
+static void SetSharpenUniforms(GLuint program, const float* act_coefficients,
+                               int num_act_coefficients) {
+  glUniform1f(UniformLocation(program, "a"),
+              num_act_coefficients > 0 ? act_coefficients[0] : 0.0f);
+  glUniform1f(UniformLocation(program, "b"),
+              num_act_coefficients > 1 ? act_coefficients[1] : 0.0f);
+}
+
+void PrepareViewInterlace(GLuint views_array, const LeiaCameraData* data,
+                          GLuint view_interlace_program, GLuint fbo_target,
+                          int screen_width_pixels, int screen_height_pixels,
+                          int alignment_offset) {
+  LeiaRenderContext* context = LeiaRenderContext::GetInstance();
+  context->BindFramebuffer(fbo_target);
+  glViewport(0, 0, screen_width_pixels, screen_height_pixels);
+  glDisable(GL_DEPTH_TEST);
+  context->UseProgram(view_interlace_program);
+
+  context->BindTexture(0, GL_TEXTURE_2D_ARRAY, views_array);
+  glUniform1i(UniformLocation(view_interlace_program, "views"), 0);
+  glUniform1f(UniformLocation(view_interlace_program, "alignment_offset"),
+              (float)alignment_offset);
+  glUniform2f(UniformLocation(view_interlace_program, "num_views"),
+              (float)data->mNumViewsHorizontal, (float)data->mNumViewsVertical);
+}
+
+void ViewInterlace(GLuint views_array, const LeiaCameraData* data,
+                   GLuint view_interlace_program, GLuint fbo_target,
+                   int screen_width_pixels, int screen_height_pixels,
+                   int alignment_offset) {
+  PrepareViewInterlace(views_array, data, view_interlace_program, fbo_target,
+                       screen_width_pixels, screen_height_pixels,
+                       alignment_offset);
+  DrawQuad();
+}
+
+void PrepareViewInterlaceAndSharpen(GLuint views_array,
+                                    const LeiaCameraData* data,
+                                    GLuint interlace_sharpen_program,
+                                    GLuint fbo_target, int screen_width_pixels,
+                                    int screen_height_pixels,
+                                    int alignment_offset,
+                                    const float* act_coefficients,
+                                    int num_act_coefficients) {
+  PrepareViewInterlace(views_array, data, interlace_sharpen_program, fbo_target,
+                       screen_width_pixels, screen_height_pixels,
+                       alignment_offset);
+  glUniform1f(UniformLocation(interlace_sharpen_program, "width"),
+              (float)screen_width_pixels);
+  SetSharpenUniforms(interlace_sharpen_program, act_coefficients,
+                     num_act_coefficients);
+}
+
+void ViewInterlaceAndSharpen(GLuint views_array, const LeiaCameraData* data,
+                             GLuint interlace_sharpen_program,
+                             GLuint fbo_target, int screen_width_pixels,
+                             int screen_height_pixels, int alignment_offset,
+                             const float* act_coefficients,
+                             int num_act_coefficients) {
+  PrepareViewInterlaceAndSharpen(views_array, data, interlace_sharpen_program,
+                                 fbo_target, screen_width_pixels,
+                                 screen_height_pixels, alignment_offset,
+                                 act_coefficients, num_act_coefficients);
+  DrawQuad();
+}
+
+static void PrepareIndexed(GLenum views_target, GLuint views,
+                           GLuint view_index_texture,
+                           GLuint view_interlace_program, GLuint fbo_target,
+                           int screen_width_pixels, int screen_height_pixels) {
+  LeiaRenderContext* context = LeiaRenderContext::GetInstance();
+  context->BindFramebuffer(fbo_target);
+  glViewport(0, 0, screen_width_pixels, screen_height_pixels);
+  glDisable(GL_DEPTH_TEST);
+  context->UseProgram(view_interlace_program);
+
+  context->BindTexture(0, views_target, views);
+  glUniform1i(UniformLocation(view_interlace_program, "views"), 0);
+  context->BindTexture(1, GL_TEXTURE_2D, view_index_texture);
+  glUniform1i(UniformLocation(view_interlace_program, "view_index"), 1);
+  glUniform1f(UniformLocation(view_interlace_program, "width"),
+              (float)screen_width_pixels);
+}
+
+void PrepareViewInterlaceIndexed(GLuint views_array, GLuint view_index_texture,
+                                 GLuint view_interlace_program,
+                                 GLuint fbo_target, int screen_width_pixels,
+                                 int screen_height_pixels) {
+  PrepareIndexed(GL_TEXTURE_2D_ARRAY, views_array, view_index_texture,
+                 view_interlace_program, fbo_target, screen_width_pixels,
+                 screen_height_pixels);
+}
+
+void ViewInterlaceIndexed(GLuint views_array, GLuint view_index_texture,
+                          GLuint view_interlace_program, GLuint fbo_target,
+                          int screen_width_pixels, int screen_height_pixels) {
+  PrepareViewInterlaceIndexed(views_array, view_index_texture,
+                              view_interlace_program, fbo_target,
+                              screen_width_pixels, screen_height_pixels);
+  DrawQuad();
+}
+
+void PrepareViewInterlaceAndSharpenIndexed(
+    GLuint views_array, GLuint view_index_texture,
+    GLuint interlace_sharpen_program, GLuint fbo_target,
+    int screen_width_pixels, int screen_height_pixels,
+    const float* act_coefficients, int num_act_coefficients) {
+  PrepareViewInterlaceIndexed(views_array, view_index_texture,
+                              interlace_sharpen_program, fbo_target,
+                              screen_width_pixels, screen_height_pixels);
+  SetSharpenUniforms(interlace_sharpen_program, act_coefficients,
+                     num_act_coefficients);
+}
+
+void ViewInterlaceAndSharpenIndexed(GLuint views_array,
+                                    GLuint view_index_texture,
+                                    GLuint interlace_sharpen_program,
+                                    GLuint fbo_target, int screen_width_pixels,
+                                    int screen_height_pixels,
+                                    const float* act_coefficients,
+                                    int num_act_coefficients) {
+  PrepareViewInterlaceAndSharpenIndexed(
+      views_array, view_index_texture, interlace_sharpen_program, fbo_target,
+      screen_width_pixels, screen_height_pixels, act_coefficients,
+      num_act_coefficients);
+  DrawQuad();
+}
+
+void PrepareViewInterlaceIndexedAtlas(GLuint views_atlas,
+                                      const GLfloat* view_rects,
+                                      int32_t num_views,
+                                      GLuint view_index_texture,
+                                      GLuint view_interlace_program,
+                                      GLuint fbo_target,
+                                      int screen_width_pixels,
+                                      int screen_height_pixels) {
+  PrepareIndexed(GL_TEXTURE_2D, views_atlas, view_index_texture,
+                 view_interlace_program, fbo_target, screen_width_pixels,
+                 screen_height_pixels);
+  glUniform4fv(UniformLocation(view_interlace_program, "view_rects"),
+               num_views, view_rects);
+}
+
+void ViewInterlaceIndexedAtlas(GLuint views_atlas, const GLfloat* view_rects,
+                               int32_t num_views, GLuint view_index_texture,
+                               GLuint view_interlace_program,
+                               GLuint fbo_target, int screen_width_pixels,
+                               int screen_height_pixels) {
+  PrepareViewInterlaceIndexedAtlas(views_atlas, view_rects, num_views,
+                                   view_index_texture, view_interlace_program,
+                                   fbo_target, screen_width_pixels,
+                                   screen_height_pixels);
+  DrawQuad();
+}
+
+void PrepareViewInterlaceAndSharpenIndexedAtlas(
+    GLuint views_atlas, const GLfloat* view_rects, int32_t num_views,
+    GLuint view_index_texture, GLuint interlace_sharpen_program,
+    GLuint fbo_target, int screen_width_pixels, int screen_height_pixels,
+    const float* act_coefficients, int num_act_coefficients) {
+  PrepareViewInterlaceIndexedAtlas(views_atlas, view_rects, num_views,
+                                   view_index_texture,
+                                   interlace_sharpen_program, fbo_target,
+                                   screen_width_pixels, screen_height_pixels);
+  SetSharpenUniforms(interlace_sharpen_program, act_coefficients,
+                     num_act_coefficients);
+}
+
+void ViewInterlaceAndSharpenIndexedAtlas(
+    GLuint views_atlas, const GLfloat* view_rects, int32_t num_views,
+    GLuint view_index_texture, GLuint interlace_sharpen_program,
+    GLuint fbo_target, int screen_width_pixels, int screen_height_pixels,
+    const float* act_coefficients, int num_act_coefficients) {
+  PrepareViewInterlaceAndSharpenIndexedAtlas(
+      views_atlas, view_rects, num_views, view_index_texture,
+      interlace_sharpen_program, fbo_target, screen_width_pixels,
+      screen_height_pixels, act_coefficients, num_act_coefficients);
+  DrawQuad();
+}
+
+static void PrepareInterlaceDOF(GLenum texture_target, GLuint color,
+                                GLuint depth, GLuint view_index_texture,
+                                GLuint interlace_dof_program, GLuint fbo_target,
+                                int screen_width_pixels,
+                                int screen_height_pixels, float aperture) {
+  LeiaRenderContext* context = LeiaRenderContext::GetInstance();
+  PrepareDOF(texture_target, color, depth, interlace_dof_program, fbo_target,
+             screen_width_pixels, screen_height_pixels, aperture);
+  context->BindTexture(2, GL_TEXTURE_2D, view_index_texture);
+  glUniform1i(UniformLocation(interlace_dof_program, "view_index"), 2);
+}
+
+void PrepareViewInterlaceDOFIndexed(GLuint color_array, GLuint depth_array,
+                                    GLuint view_index_texture,
+                                    const LeiaCameraData* data,
+                                    GLuint interlace_dof_program,
+                                    GLuint fbo_target, int screen_width_pixels,
+                                    int screen_height_pixels, float aperture) {
+  PrepareInterlaceDOF(GL_TEXTURE_2D_ARRAY, color_array, depth_array,
+                      view_index_texture, interlace_dof_program,
+                      fbo_target, screen_width_pixels, screen_height_pixels,
+                      aperture);
+}
+
+void ViewInterlaceDOFIndexed(GLuint color_array, GLuint depth_array,
+                             GLuint view_index_texture,
+                             const LeiaCameraData* data,
+                             GLuint interlace_dof_program, GLuint fbo_target,
+                             int screen_width_pixels, int screen_height_pixels,
+                             float aperture) {
+  PrepareViewInterlaceDOFIndexed(color_array, depth_array, view_index_texture,
+                                 data, interlace_dof_program, fbo_target,
+                                 screen_width_pixels, screen_height_pixels,
+                                 aperture);
+  DrawQuad();
+}
+
+void PrepareViewInterlaceDOFIndexedAtlas(
+    GLuint color_atlas, GLuint depth_atlas, const GLfloat* view_rects,
+    GLuint view_index_texture, const LeiaCameraData* data,
+    GLuint interlace_dof_program, GLuint fbo_target, int screen_width_pixels,
+    int screen_height_pixels, float aperture) {
+  PrepareInterlaceDOF(GL_TEXTURE_2D, color_atlas, depth_atlas,
+                      view_index_texture, interlace_dof_program,
+                      fbo_target, screen_width_pixels, screen_height_pixels,
+                      aperture);
+  SetAtlasDOFUniforms(interlace_dof_program, view_rects, data);
+}
+
+void ViewInterlaceDOFIndexedAtlas(GLuint color_atlas, GLuint depth_atlas,
+                                  const GLfloat* view_rects,
+                                  GLuint view_index_texture,
+                                  const LeiaCameraData* data,
+                                  GLuint interlace_dof_program,
+                                  GLuint fbo_target, int screen_width_pixels,
+                                  int screen_height_pixels, float aperture) {
+  PrepareViewInterlaceDOFIndexedAtlas(
+      color_atlas, depth_atlas, view_rects, view_index_texture, data,
+      interlace_dof_program, fbo_target, screen_width_pixels,
+      screen_height_pixels, aperture);
+  DrawQuad();
+}
+
+void PrepareViewSynthesisAtlas(GLuint source_color_array,
+                               GLuint source_depth_array,
+                               const GLfloat* view_rects,
+                               const VIEW_SYNTHESIS_PARAMS& params,
+                               GLuint view_synthesis_program, GLuint fbo_target,
+                               int atlas_width, int atlas_height) {
+  LeiaRenderContext* context = LeiaRenderContext::GetInstance();
+  context->BindFramebuffer(fbo_target);
+  glViewport(0, 0, atlas_width, atlas_height);
+  glDisable(GL_SCISSOR_TEST);
+  // Depth writes need the depth test on
+  glEnable(GL_DEPTH_TEST);
+  glDepthFunc(GL_ALWAYS);
+  glDepthMask(GL_TRUE);
+  context->UseProgram(view_synthesis_program);
+
+  context->BindTexture(0, GL_TEXTURE_2D_ARRAY, source_color_array);
+  glUniform1i(UniformLocation(view_synthesis_program, "source_color"), 0);
+  context->BindTexture(1, GL_TEXTURE_2D_ARRAY, source_depth_array);
+  glUniform1i(UniformLocation(view_synthesis_program, "source_depth"), 1);
+
+  glUniform4fv(UniformLocation(view_synthesis_program, "view_rects"),
+               params.num_views, view_rects);
+  glUniform1fv(UniformLocation(view_synthesis_program, "source_positions"),
+               VIEW_SYNTHESIS_MAX_SOURCES, params.source_positions);
+  glUniform1i(UniformLocation(view_synthesis_program, "num_sources"),
+              params.num_sources);
+  glUniform1f(UniformLocation(view_synthesis_program, "disparity_scale"),
+              params.disparity_scale);
+  glUniform1f(
+      UniformLocation(view_synthesis_program, "convergence_distance"),
+      params.convergence_distance);
+  glUniform1f(UniformLocation(view_synthesis_program, "near"),
+              params.near);
+  glUniform1f(UniformLocation(view_synthesis_program, "far"), params.far);
+  glUniform1f(UniformLocation(view_synthesis_program, "min_disparity"),
+              params.min_disparity);
+  glUniform1f(UniformLocation(view_synthesis_program, "max_disparity"),
+              params.max_disparity);
+  glUniform1i(UniformLocation(view_synthesis_program, "search_steps"),
+              params.search_steps);
+}
+
+void ViewSynthesisAtlas(GLuint source_color_array, GLuint source_depth_array,
+                        const GLfloat* view_rects,
+                        const VIEW_SYNTHESIS_PARAMS& params,
+                        GLuint view_synthesis_program, GLuint fbo_target,
+                        int atlas_width, int atlas_height) {
+  PrepareViewSynthesisAtlas(source_color_array, source_depth_array, view_rects,
+                            params, view_synthesis_program, fbo_target,
+                            atlas_width, atlas_height);
+  DrawQuad();
+  glDepthFunc(GL_LESS);
+}
+
+void PrepareViewSharpening(GLuint interlaced_texture, GLuint sharpen_program,
+                           GLuint fbo_target, int screen_width_pixels,
+                           int screen_height_pixels,
+                           const float* act_coefficients,
+                           int num_act_coefficients) {
+  LeiaRenderContext* context = LeiaRenderContext::GetInstance();
+  context->BindFramebuffer(fbo_target);
+  glViewport(0, 0, screen_width_pixels, screen_height_pixels);
+  glDisable(GL_DEPTH_TEST);
+  context->UseProgram(sharpen_program);
+
+  context->BindTexture(0, GL_TEXTURE_2D, interlaced_texture);
+  glUniform1i(UniformLocation(sharpen_program, "interlaced"), 0);
+  SetSharpenUniforms(sharpen_program, act_coefficients, num_act_coefficients);
+}
+
+void ViewSharpening(GLuint interlaced_texture, GLuint sharpen_program,
+                    GLuint fbo_target, int screen_width_pixels,
+                    int screen_height_pixels, const float* act_coefficients,
+                    int num_act_coefficients) {
+  PrepareViewSharpening(interlaced_texture, sharpen_program, fbo_target,
+                        screen_width_pixels, screen_height_pixels,
+                        act_coefficients, num_act_coefficients);
+  DrawQuad();
+}
+
+//--------------------------------------------------------------------------------
+// Fullscreen quad
+//--------------------------------------------------------------------------------
+void DrawQuad() {
+  LeiaRenderContext::GetInstance()->DrawQuad(POST_ATTRIB_VERTEX,
+                                             POST_ATTRIB_UV);
+}
+
+}  // namespace leia_helper
@@ -0,0 +1,270 @@
+/*
+ * Copyright 2018 Leia Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//--------------------------------------------------------------------------------
+// postProcess.h
+//--------------------------------------------------------------------------------
+#ifndef LEIA_HELPER_POSTPROCESS_H_
+#define LEIA_HELPER_POSTPROCESS_H_
+
+#include "gl3stub.h"
+#include "LeiaCameraViews.h"
+#include "cpuViewSynthesis.h"
+#include "programBuilder.h"
+
+namespace leia_helper {
+
+/******************************************************************
+ * Leia post processing passes that operate on GL_TEXTURE_2D_ARRAY views, or
+ * on a view atlas (see viewAtlas.h) for the ATLAS programs.
+ * They follow the leiaPrepareXXX() convention of the Leia SDK: a Prepare call
+ * binds the target, program, textures and uniforms, then DrawQuad() runs the
+ * pass. Programs are created with CreatePostProgram() for a fixed view count.
+ * The depth of field programs, DOF and interlace+DOF, read the camera from
+ * the LeiaCamera block: upload the frame's CameraBuffer (cameraBuffer.h)
+ * before their Prepare call, data only gives them the view layout.
+ */
+enum POST_SHADER {
+  POST_SHADER_MULTIVIEW_DOF,
+  POST_SHADER_VIEW_INTERLACE_ARRAY,
+  POST_SHADER_VIEW_INTERLACE_SHARPEN_ARRAY,
+  POST_SHADER_VIEW_INTERLACE_INDEXED,
+  POST_SHADER_VIEW_INTERLACE_SHARPEN_INDEXED,
+  POST_SHADER_ATLAS_DOF,
+  POST_SHADER_VIEW_INTERLACE_INDEXED_ATLAS,
+  POST_SHADER_VIEW_INTERLACE_SHARPEN_INDEXED_ATLAS,
+  POST_SHADER_VIEW_INTERLACE_DOF_INDEXED,
+  POST_SHADER_VIEW_INTERLACE_DOF_INDEXED_ATLAS,
+  POST_SHADER_VIEW_SYNTHESIS_ATLAS,
+  POST_SHADER_VIEW_SHARPENING,
+  POST_SHADER_COUNT
+};
+
+// Vertex attribute slots used by every post processing program
+enum POST_ATTRIBUTES { POST_ATTRIB_VERTEX, POST_ATTRIB_UV };
+
+/******************************************************************
+ * CreatePostProgram()
+ *
+ * arguments:
+ *  in: shader, pass to build
+ *  in: num_views, total number of views (horizontal * vertical), only baked
+ *      into multiview and atlas programs, the array interlacers read the
+ *      count from LeiaCameraData at draw time
+ * return: linked program, 0 when compilation or linkage failed. Loaded from
+ *         the ProgramCache when it holds the binary.
+ */
+GLuint CreatePostProgram(const POST_SHADER shader, const int32_t num_views);
+
+// Queues the program of CreatePostProgram() on builder, see ProgramBuilder
+void AddPostProgram(ProgramBuilder* builder, GLuint* program,
+                    const POST_SHADER shader, const int32_t num_views);
+
+/******************************************************************
+ * Depth of field on every layer of a multiview render target in one pass.
+ * fbo_target must be a multiview framebuffer with data->mNumViewsHorizontal *
+ * data->mNumViewsVertical views.
+ */
+void PrepareMultiviewDOF(GLuint color_array, GLuint depth_array,
+                         const LeiaCameraData* data, GLuint dof_program,
+                         GLuint fbo_target, float aperture);
+
+/******************************************************************
+ * Depth of field over a whole view atlas in one pass, into the DOF atlas
+ * framebuffer. view_rects is ViewAtlas::GetViewRectTable(), blur taps never
+ * cross into a neighbouring view. Use POST_SHADER_ATLAS_DOF programs.
+ */
+void PrepareAtlasDOF(GLuint color_atlas, GLuint depth_atlas,
+                     const GLfloat* view_rects, const LeiaCameraData* data,
+                     GLuint dof_program, GLuint fbo_target, int atlas_width,
+                     int atlas_height, float aperture);
+
+/******************************************************************
+ * Interlacing of a view array into fbo_target.
+ * Layer y * mNumViewsHorizontal + x holds view (x, y). The view is picked per
+ * fragment without branches, so any mNumViewsHorizontal x mNumViewsVertical
+ * layout works with a single program and a single texture unit.
+ * ViewInterlace() is the Prepare + DrawQuad() shortcut, like leiaViewInterlace()
+ */
+void PrepareViewInterlace(GLuint views_array, const LeiaCameraData* data,
+                          GLuint view_interlace_program, GLuint fbo_target,
+                          int screen_width_pixels, int screen_height_pixels,
+                          int alignment_offset);
+void ViewInterlace(GLuint views_array, const LeiaCameraData* data,
+                   GLuint view_interlace_program, GLuint fbo_target,
+                   int screen_width_pixels, int screen_height_pixels,
+                   int alignment_offset);
+
+/******************************************************************
+ * Interlacing and view sharpening fused in one pass, straight into fbo_target.
+ * Gives the same result as ViewInterlace() into an intermediate screen sized
+ * texture followed by leiaViewSharpening() on it, without writing and reading
+ * back that texture. act_coefficients are the same {a, b} pair
+ * leiaViewSharpening() takes.
+ */
+void PrepareViewInterlaceAndSharpen(GLuint views_array,
+                                    const LeiaCameraData* data,
+                                    GLuint interlace_sharpen_program,
+                                    GLuint fbo_target, int screen_width_pixels,
+                                    int screen_height_pixels,
+                                    int alignment_offset,
+                                    const float* act_coefficients,
+                                    int num_act_coefficients);
+void ViewInterlaceAndSharpen(GLuint views_array, const LeiaCameraData* data,
+                             GLuint interlace_sharpen_program,
+                             GLuint fbo_target, int screen_width_pixels,
+                             int screen_height_pixels, int alignment_offset,
+                             const float* act_coefficients,
+                             int num_act_coefficients);
+
+/******************************************************************
+ * Interlacing driven by a view index map (ViewIndexMap::GetTexture()).
+ * The map holds the alignment offset, slant and pixel / sub pixel layout, so
+ * recalibrating only rebuilds the map, never the programs.
+ * Use POST_SHADER_VIEW_INTERLACE_INDEXED programs with the plain variant and
+ * POST_SHADER_VIEW_INTERLACE_SHARPEN_INDEXED with the sharpening variant.
+ */
+void PrepareViewInterlaceIndexed(GLuint views_array, GLuint view_index_texture,
+                                 GLuint view_interlace_program,
+                                 GLuint fbo_target, int screen_width_pixels,
+                                 int screen_height_pixels);
+void ViewInterlaceIndexed(GLuint views_array, GLuint view_index_texture,
+                          GLuint view_interlace_program, GLuint fbo_target,
+                          int screen_width_pixels, int screen_height_pixels);
+void PrepareViewInterlaceAndSharpenIndexed(
+    GLuint views_array, GLuint view_index_texture,
+    GLuint interlace_sharpen_program, GLuint fbo_target,
+    int screen_width_pixels, int screen_height_pixels,
+    const float* act_coefficients, int num_act_coefficients);
+void ViewInterlaceAndSharpenIndexed(GLuint views_array,
+                                    GLuint view_index_texture,
+                                    GLuint interlace_sharpen_program,
+                                    GLuint fbo_target, int screen_width_pixels,
+                                    int screen_height_pixels,
+                                    const float* act_coefficients,
+                                    int num_act_coefficients);
+
+/******************************************************************
+ * Indexed interlacing reading the views from a view atlas, layer i of the
+ * view index map is region i of view_rects (ViewAtlas::GetViewRectTable()).
+ * Use the POST_SHADER_VIEW_INTERLACE_[SHARPEN_]INDEXED_ATLAS programs.
+ */
+void PrepareViewInterlaceIndexedAtlas(GLuint views_atlas,
+                                      const GLfloat* view_rects,
+                                      int32_t num_views,
+                                      GLuint view_index_texture,
+                                      GLuint view_interlace_program,
+                                      GLuint fbo_target,
+                                      int screen_width_pixels,
+                                      int screen_height_pixels);
+void ViewInterlaceIndexedAtlas(GLuint views_atlas, const GLfloat* view_rects,
+                               int32_t num_views, GLuint view_index_texture,
+                               GLuint view_interlace_program,
+                               GLuint fbo_target, int screen_width_pixels,
+                               int screen_height_pixels);
+void PrepareViewInterlaceAndSharpenIndexedAtlas(
+    GLuint views_atlas, const GLfloat* view_rects, int32_t num_views,
+    GLuint view_index_texture, GLuint interlace_sharpen_program,
+    GLuint fbo_target, int screen_width_pixels, int screen_height_pixels,
+    const float* act_coefficients, int num_act_coefficients);
+void ViewInterlaceAndSharpenIndexedAtlas(
+    GLuint views_atlas, const GLfloat* view_rects, int32_t num_views,
+    GLuint view_index_texture, GLuint interlace_sharpen_program,
+    GLuint fbo_target, int screen_width_pixels, int screen_height_pixels,
+    const float* act_coefficients, int num_act_coefficients);
+
+/******************************************************************
+ * Indexed interlacing with the depth of field folded in.
+ * Reads the scene colour and depth instead of depth of field views, and blurs
+ * only the view each screen pixel shows (one per colour channel for sub pixel
+ * layouts). This replaces the separate depth of field pass and its target.
+ * The blur is evaluated at the view texel the interlacer would sample, so the
+ * result matches PrepareMultiviewDOF() / PrepareAtlasDOF() followed by indexed
+ * interlacing. The cost moves from view to screen resolution: it pays off
+ * when the screen has fewer pixels than all the views together.
+ * Sharpening stays a separate pass, leiaViewSharpening() on fbo_target.
+ * Use POST_SHADER_VIEW_INTERLACE_DOF_INDEXED programs with view arrays, and
+ * POST_SHADER_VIEW_INTERLACE_DOF_INDEXED_ATLAS with a view atlas.
+ */
+void PrepareViewInterlaceDOFIndexed(GLuint color_array, GLuint depth_array,
+                                    GLuint view_index_texture,
+                                    const LeiaCameraData* data,
+                                    GLuint interlace_dof_program,
+                                    GLuint fbo_target, int screen_width_pixels,
+                                    int screen_height_pixels, float aperture);
+void ViewInterlaceDOFIndexed(GLuint color_array, GLuint depth_array,
+                             GLuint view_index_texture,
+                             const LeiaCameraData* data,
+                             GLuint interlace_dof_program, GLuint fbo_target,
+                             int screen_width_pixels, int screen_height_pixels,
+                             float aperture);
+void PrepareViewInterlaceDOFIndexedAtlas(
+    GLuint color_atlas, GLuint depth_atlas, const GLfloat* view_rects,
+    GLuint view_index_texture, const LeiaCameraData* data,
+    GLuint interlace_dof_program, GLuint fbo_target, int screen_width_pixels,
+    int screen_height_pixels, float aperture);
+void ViewInterlaceDOFIndexedAtlas(GLuint color_atlas, GLuint depth_atlas,
+                                  const GLfloat* view_rects,
+                                  GLuint view_index_texture,
+                                  const LeiaCameraData* data,
+                                  GLuint interlace_dof_program,
+                                  GLuint fbo_target, int screen_width_pixels,
+                                  int screen_height_pixels, float aperture);
+
+/******************************************************************
+ * View synthesis of every view of a view atlas from the source views in
+ * source_color_array / source_depth_array (ViewSynthesisTarget), see
+ * cpuViewSynthesis.h. Writes colour and depth of the whole atlas,
+ * fbo_target is the atlas scene framebuffer (ViewAtlas::GetFramebuffer()).
+ * The Prepare call leaves glDepthFunc(GL_ALWAYS) set, ViewSynthesisAtlas()
+ * restores GL_LESS after drawing.
+ * Use POST_SHADER_VIEW_SYNTHESIS_ATLAS programs.
+ */
+void PrepareViewSynthesisAtlas(GLuint source_color_array,
+                               GLuint source_depth_array,
+                               const GLfloat* view_rects,
+                               const VIEW_SYNTHESIS_PARAMS& params,
+                               GLuint view_synthesis_program, GLuint fbo_target,
+                               int atlas_width, int atlas_height);
+void ViewSynthesisAtlas(GLuint source_color_array, GLuint source_depth_array,
+                        const GLfloat* view_rects,
+                        const VIEW_SYNTHESIS_PARAMS& params,
+                        GLuint view_synthesis_program, GLuint fbo_target,
+                        int atlas_width, int atlas_height);
+
+/******************************************************************
+ * View sharpening of an interlaced screen texture into fbo_target, the same
+ * filter as leiaViewSharpening(), act_coefficients is the same {a, b} pair.
+ * Use POST_SHADER_VIEW_SHARPENING programs.
+ */
+void PrepareViewSharpening(GLuint interlaced_texture, GLuint sharpen_program,
+                           GLuint fbo_target, int screen_width_pixels,
+                           int screen_height_pixels,
+                           const float* act_coefficients,
+                           int num_act_coefficients);
+void ViewSharpening(GLuint interlaced_texture, GLuint sharpen_program,
+                    GLuint fbo_target, int screen_width_pixels,
+                    int screen_height_pixels, const float* act_coefficients,
+                    int num_act_coefficients);
+
+/******************************************************************
+ * Fullscreen quad shared by every post processing pass, see
+ * LeiaRenderContext::DrawQuad()
+ */
+void DrawQuad();
+
+}  // namespace leia_helper
+#endif /* LEIA_HELPER_POSTPROCESS_H_ */
@@ -0,0 +1,437 @@
+/*
+ * Copyright 2018 Leia Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//--------------------------------------------------------------------------------
+// programBuilder.cpp
+// Program compilation off the render thread
+//--------------------------------------------------------------------------------
+#include <stdlib.h>
+#include <string.h>
+
+#include "JNIHelper.h"
+#include "programBuilder.h"
+
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+namespace leia_helper {
+
+typedef void (*PFNGLMAXSHADERCOMPILERTHREADSKHR)(GLuint count);
+
+static bool HasExtension(const char* name) {
+  const char* extensions = (const char*)glGetString(GL_EXTENSIONS);
+  return extensions && strstr(extensions, name);
+}
+
+static double ElapsedMs(const std::chrono::steady_clock::time_point& start) {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+static GLuint IssueShader(const GLenum type, const std::string& source) {
+  GLuint shader = glCreateShader(type);
+  const GLchar* data = source.c_str();
+  const GLint size = (GLint)source.size();
+  glShaderSource(shader, 1, &data, &size);
+  glCompileShader(shader);
+  return shader;
+}
+
+// Compiles and links without asking for any status, which would wait for the
+// driver threads of GL_KHR_parallel_shader_compile
+static GLuint IssueProgram(const std::string& vert_source,
+                           const std::string& frag_source,
+                           const PROGRAM_ATTRIBUTE* attributes,
+                           int32_t num_attributes, GLuint* vert_shader,
+                           GLuint* frag_shader) {
+  *vert_shader = IssueShader(GL_VERTEX_SHADER, vert_source);
+  *frag_shader = IssueShader(GL_FRAGMENT_SHADER, frag_source);
+  GLuint program = glCreateProgram();
+  glAttachShader(program, *vert_shader);
+  glAttachShader(program, *frag_shader);
+  for (int32_t i = 0; i < num_attributes; ++i)
+    glBindAttribLocation(program, attributes[i].index, attributes[i].name);
+  glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+  glLinkProgram(program);
+  return program;
+}
+
+static void LogShader(const char* tag, GLuint shader) {
+  GLint compiled = 0;
+  glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+  if (compiled) return;
+  GLint length = 0;
+  glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
+  if (length <= 0) return;
+  GLchar* log = (GLchar*)malloc(length);
+  glGetShaderInfoLog(shader, length, &length, log);
+  LOGI("%s shader compile log:\n%s", tag, log);
+  free(log);
+}
+
+// The program once linked, or 0 after logging why not. Deletes the shaders.
+static GLuint ResolveProgram(const char* tag, GLuint program,
+                             GLuint vert_shader, GLuint frag_shader) {
+  GLint linked = 0;
+  glGetProgramiv(program, GL_LINK_STATUS, &linked);
+  if (!linked) {
+    LogShader(tag, vert_shader);
+    LogShader(tag, frag_shader);
+    GLint length = 0;
+    glGetProgramiv(program, GL_INFO_LOG_LENGTH, &length);
+    if (length > 0) {
+      GLchar* log = (GLchar*)malloc(length);
+      glGetProgramInfoLog(program, length, &length, log);
+      LOGI("%s program link log:\n%s", tag, log);
+      free(log);
+    }
+    LOGI("Failed to link %s program", tag);
+    glDeleteProgram(program);
+    program = 0;
+  }
+  glDeleteShader(vert_shader);
+  glDeleteShader(frag_shader);
+  return program;
+}
+
+GLuint CreateProgram(const char* tag, const char* vert_source,
+                     const char* frag_source,
+                     const PROGRAM_ATTRIBUTE* attributes,
+                     int32_t num_attributes) {
+  uint64_t key = GetProgramKey(tag, vert_source, frag_source);
+  ProgramCache* cache = ProgramCache::GetInstance();
+  GLuint program = cache->LoadProgram(key);
+  if (program) return program;
+
+  GLuint vert_shader, frag_shader;
+  program = IssueProgram(vert_source, frag_source, attributes, num_attributes,
+                         &vert_shader, &frag_shader);
+  program = ResolveProgram(tag, program, vert_shader, frag_shader);
+  cache->StoreProgram(key, program);
+  return program;
+}
+
+//--------------------------------------------------------------------------------
+// ProgramBuilder
+//--------------------------------------------------------------------------------
+ProgramBuilder::ProgramBuilder()
+    : num_done_(0),
+      mode_(PROGRAM_BUILD_SYNC),
+      started_(false),
+      build_ms_(0.0),
+      blocked_ms_(0.0),
+      display_(EGL_NO_DISPLAY),
+      worker_context_(EGL_NO_CONTEXT),
+      worker_surface_(EGL_NO_SURFACE),
+      num_built_(0),
+      worker_failed_(false),
+      cancel_(false) {}
+
+ProgramBuilder::~ProgramBuilder() {
+  cancel_ = true;
+  StopWorker();
+}
+
+void ProgramBuilder::AddProgram(GLuint* destination, const char* tag,
+                                const std::string& vert_source,
+                                const std::string& frag_source,
+                                const PROGRAM_ATTRIBUTE* attributes,
+                                int32_t num_attributes) {
+  JOB job;
+  job.destination = destination;
+  job.tag = tag;
+  job.vert_source = vert_source;
+  job.frag_source = frag_source;
+  job.attributes.assign(attributes, attributes + num_attributes);
+  job.build = NULL;
+  job.key = GetProgramKey(tag, vert_source.c_str(), frag_source.c_str());
+  job.vert_shader = 0;
+  job.frag_shader = 0;
+  job.program = 0;
+  job.cached = false;
+  job.done = false;
+  jobs_.push_back(job);
+}
+
+void ProgramBuilder::AddProgram(GLuint* destination, const char* tag,
+                                const char* vert_source,
+                                const char* frag_source,
+                                PROGRAM_BUILDER build) {
+  AddProgram(destination, tag, std::string(vert_source),
+             std::string(frag_source), NULL, 0);
+  jobs_.back().build = build;
+}
+
+GLuint ProgramBuilder::Build(JOB* job) {
+  if (job->build)
+    return job->build(job->vert_source.c_str(), job->frag_source.c_str());
+  GLuint program = IssueProgram(
+      job->vert_source, job->frag_source,
+      job->attributes.empty() ? NULL : &job->attributes[0],
+      (int32_t)job->attributes.size(), &job->vert_shader, &job->frag_shader);
+  return ResolveProgram(job->tag.c_str(), program, job->vert_shader,
+                        job->frag_shader);
+}
+
+void ProgramBuilder::Complete(JOB* job) {
+  if (!job->cached)
+    ProgramCache::GetInstance()->StoreProgram(job->key, job->program);
+  *job->destination = job->program;
+  job->done = true;
+  ++num_done_;
+}
+
+void ProgramBuilder::Start(PROGRAM_BUILD_MODE mode) {
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  start_time_ = start;
+  started_ = true;
+  num_done_ = 0;
+
+  // Binaries load quickly, only the others are worth a thread
+  ProgramCache* cache = ProgramCache::GetInstance();
+  int32_t num_uncached = 0;
+  for (size_t i = 0; i < jobs_.size(); ++i) {
+    JOB& job = jobs_[i];
+    job.program = cache->LoadProgram(job.key);
+    job.cached = job.program != 0;
+    if (job.cached) {
+      Complete(&job);
+    } else {
+      ++num_uncached;
+    }
+  }
+
+  const bool parallel = HasExtension("GL_KHR_parallel_shader_compile");
+  if (!num_uncached) {
+    mode = PROGRAM_BUILD_SYNC;
+  } else if (mode == PROGRAM_BUILD_AUTO) {
+    mode = parallel ? PROGRAM_BUILD_PARALLEL : PROGRAM_BUILD_WORKER;
+  } else if (mode == PROGRAM_BUILD_PARALLEL && !parallel) {
+    LOGW("GL_KHR_parallel_shader_compile missing, building on a worker");
+    mode = PROGRAM_BUILD_WORKER;
+  }
+  if (mode == PROGRAM_BUILD_WORKER && !StartWorker()) {
+    LOGW("No shared context for the program builder, building in Start()");
+    mode = PROGRAM_BUILD_SYNC;
+  }
+  mode_ = mode;
+
+  if (mode_ == PROGRAM_BUILD_PARALLEL) {
+    PFNGLMAXSHADERCOMPILERTHREADSKHR glMaxShaderCompilerThreadsKHR =
+        (PFNGLMAXSHADERCOMPILERTHREADSKHR)eglGetProcAddress(
+            "glMaxShaderCompilerThreadsKHR");
+    // As many threads as the driver likes
+    if (glMaxShaderCompilerThreadsKHR) glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+    for (size_t i = 0; i < jobs_.size(); ++i) {
+      JOB& job = jobs_[i];
+      if (job.done || job.build) continue;
+      job.program = IssueProgram(
+          job.vert_source, job.frag_source,
+          job.attributes.empty() ? NULL : &job.attributes[0],
+          (int32_t)job.attributes.size(), &job.vert_shader, &job.frag_shader);
+    }
+  } else if (mode_ == PROGRAM_BUILD_SYNC) {
+    for (size_t i = 0; i < jobs_.size(); ++i) {
+      JOB& job = jobs_[i];
+      if (job.done) continue;
+      job.program = Build(&job);
+      Complete(&job);
+    }
+  }
+
+  blocked_ms_ = ElapsedMs(start);
+  if (num_done_ == (int32_t)jobs_.size()) build_ms_ = blocked_ms_;
+}
+
+bool ProgramBuilder::PollParallel() {
+  bool built = false;
+  for (size_t i = 0; i < jobs_.size(); ++i) {
+    JOB& job = jobs_[i];
+    if (job.done) continue;
+    if (job.build) {
+      // Opaque builders block, one per frame
+      if (built) continue;
+      job.program = Build(&job);
+      built = true;
+      Complete(&job);
+      continue;
+    }
+    GLint complete = 0;
+    glGetProgramiv(job.program, GL_COMPLETION_STATUS_KHR, &complete);
+    if (!complete) continue;
+    job.program = ResolveProgram(job.tag.c_str(), job.program,
+                                 job.vert_shader, job.frag_shader);
+    Complete(&job);
+  }
+  return num_done_ == (int32_t)jobs_.size();
+}
+
+bool ProgramBuilder::PollWorker() {
+  const int32_t num_built = num_built_.load(std::memory_order_acquire);
+  for (int32_t i = 0; i < num_built; ++i) {
+    if (!jobs_[i].done) Complete(&jobs_[i]);
+  }
+  if (worker_failed_.load(std::memory_order_acquire)) {
+    StopWorker();
+    for (size_t i = num_built; i < jobs_.size(); ++i) {
+      JOB& job = jobs_[i];
+      if (job.done) continue;
+      job.program = Build(&job);
+      Complete(&job);
+    }
+  }
+  if (num_done_ < (int32_t)jobs_.size()) return false;
+  StopWorker();
+  return true;
+}
+
+bool ProgramBuilder::Poll() {
+  if (!started_) return false;
+  if (num_done_ == (int32_t)jobs_.size()) return true;
+
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  bool ready = mode_ == PROGRAM_BUILD_PARALLEL ? PollParallel() : PollWorker();
+  blocked_ms_ += ElapsedMs(start);
+  if (ready) build_ms_ = ElapsedMs(start_time_);
+  return ready;
+}
+
+void ProgramBuilder::Finish() {
+  while (!Poll()) {
+    if (!started_) return;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+void ProgramBuilder::Cancel() {
+  cancel_ = true;
+  StopWorker();
+  // The worker is gone, what it built is safe to delete
+  const int32_t num_built = num_built_.load(std::memory_order_acquire);
+  for (size_t i = 0; i < jobs_.size(); ++i) {
+    JOB& job = jobs_[i];
+    if (job.done) continue;
+    if (mode_ == PROGRAM_BUILD_PARALLEL && !job.build && job.program) {
+      glDeleteShader(job.vert_shader);
+      glDeleteShader(job.frag_shader);
+      glDeleteProgram(job.program);
+    } else if (mode_ == PROGRAM_BUILD_WORKER && (int32_t)i < num_built &&
+               job.program) {
+      glDeleteProgram(job.program);
+    }
+  }
+  jobs_.clear();
+  num_done_ = 0;
+  started_ = false;
+  cancel_ = false;
+}
+
+//--------------------------------------------------------------------------------
+// Worker
+//--------------------------------------------------------------------------------
+bool ProgramBuilder::StartWorker() {
+  display_ = eglGetCurrentDisplay();
+  EGLContext context = eglGetCurrentContext();
+  if (display_ == EGL_NO_DISPLAY || context == EGL_NO_CONTEXT) return false;
+
+  // A context of the same config and version, sharing objects with the
+  // caller's
+  EGLint config_id = 0;
+  EGLint client_version = 3;
+  eglQueryContext(display_, context, EGL_CONFIG_ID, &config_id);
+  eglQueryContext(display_, context, EGL_CONTEXT_CLIENT_VERSION,
+                  &client_version);
+  const EGLint config_attribs[] = {EGL_CONFIG_ID, config_id, EGL_NONE};
+  EGLConfig config;
+  EGLint num_configs = 0;
+  if (!eglChooseConfig(display_, config_attribs, &config, 1, &num_configs) ||
+      !num_configs)
+    return false;
+  const EGLint context_attribs[] = {EGL_CONTEXT_CLIENT_VERSION, client_version,
+                                    EGL_NONE};
+  worker_context_ = eglCreateContext(display_, config, context, context_attribs);
+  if (worker_context_ == EGL_NO_CONTEXT) return false;
+
+  const char* extensions = eglQueryString(display_, EGL_EXTENSIONS);
+  if (!extensions || !strstr(extensions, "EGL_KHR_surfaceless_context")) {
+    const EGLint pbuffer_attribs[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+    worker_surface_ = eglCreatePbufferSurface(display_, config, pbuffer_attribs);
+    if (worker_surface_ == EGL_NO_SURFACE) {
+      eglDestroyContext(display_, worker_context_);
+      worker_context_ = EGL_NO_CONTEXT;
+      return false;
+    }
+  }
+
+  num_built_ = 0;
+  worker_failed_ = false;
+  cancel_ = false;
+  worker_ = std::thread(&ProgramBuilder::RunWorker, this);
+  return true;
+}
+
+void ProgramBuilder::RunWorker() {
+  if (!eglMakeCurrent(display_, worker_surface_, worker_surface_,
+                      worker_context_)) {
+    LOGW("Program builder can not make its context current");
+    worker_failed_.store(true, std::memory_order_release);
+    return;
+  }
+  for (size_t i = 0; i < jobs_.size(); ++i) {
+    if (cancel_.load(std::memory_order_relaxed)) break;
+    JOB& job = jobs_[i];
+    // Cached jobs were completed in Start() before this thread existed
+    if (!job.done) job.program = Build(&job);
+    // The render thread may only use a program the worker finished
+    glFinish();
+    num_built_.store((int32_t)i + 1, std::memory_order_release);
+  }
+  eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+  eglReleaseThread();
+}
+
+void ProgramBuilder::StopWorker() {
+  if (worker_.joinable()) worker_.join();
+  if (worker_context_ != EGL_NO_CONTEXT) {
+    eglDestroyContext(display_, worker_context_);
+    worker_context_ = EGL_NO_CONTEXT;
+  }
+  if (worker_surface_ != EGL_NO_SURFACE) {
+    eglDestroySurface(display_, worker_surface_);
+    worker_surface_ = EGL_NO_SURFACE;
+  }
+}
+
+const char* GetProgramBuildModeName(const PROGRAM_BUILD_MODE mode) {
+  switch (mode) {
+    case PROGRAM_BUILD_AUTO:
+      return "auto";
+    case PROGRAM_BUILD_SYNC:
+      return "sync";
+    case PROGRAM_BUILD_PARALLEL:
+      return "parallel";
+    case PROGRAM_BUILD_WORKER:
+      return "worker";
+    default:
+      return "unknown";
+  }
+}
+
+}  // namespace leia_helper
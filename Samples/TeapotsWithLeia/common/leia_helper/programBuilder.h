@@ -0,0 +1,167 @@
+/*
+ * Copyright 2018 Leia Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//--------------------------------------------------------------------------------
+// programBuilder.h
+//--------------------------------------------------------------------------------
+#ifndef LEIA_HELPER_PROGRAMBUILDER_H_
+#define LEIA_HELPER_PROGRAMBUILDER_H_
+
+#include <EGL/egl.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gl3stub.h"
+#include "programCache.h"
+
+namespace leia_helper {
+
+// An attribute location bound before linking, name must outlive the build
+struct PROGRAM_ATTRIBUTE {
+  GLuint index;
+  const char* name;
+};
+
+/******************************************************************
+ * CreateProgram()
+ * Compiles and links vert_source and frag_source with the attribute
+ * locations bound, through the ProgramCache. tag is the cache tag of
+ * CreateCachedProgram(), ProgramBuilder programs of the same tag and sources
+ * share the binary.
+ * return: linked program, 0 when compilation or linkage failed
+ */
+GLuint CreateProgram(const char* tag, const char* vert_source,
+                     const char* frag_source,
+                     const PROGRAM_ATTRIBUTE* attributes,
+                     int32_t num_attributes);
+
+/******************************************************************
+ * How ProgramBuilder::Start() builds the programs the cache does not hold
+ * SYNC: all of them in Start()
+ * PARALLEL: GL_KHR_parallel_shader_compile, every compile and link is issued
+ *           in Start() and the driver threads build them while Poll() checks
+ *           GL_COMPLETION_STATUS_KHR. PROGRAM_BUILDER programs link one per
+ *           Poll() on the calling thread.
+ * WORKER: a thread with a context sharing the caller's builds them one by
+ *         one, also for PROGRAM_BUILDER programs
+ * AUTO: PARALLEL when the extension is there, else WORKER, else SYNC
+ */
+enum PROGRAM_BUILD_MODE {
+  PROGRAM_BUILD_AUTO,
+  PROGRAM_BUILD_SYNC,
+  PROGRAM_BUILD_PARALLEL,
+  PROGRAM_BUILD_WORKER,
+};
+
+/******************************************************************
+ * Programs built off the render thread
+ *
+ *   builder.AddProgram(&dof_program, "leia", vert, frag, leiaCreateProgram);
+ *   AddPostProgram(&builder, &atlas_dof_program, POST_SHADER_ATLAS_DOF, 4);
+ *   builder.Start();
+ *   ...
+ *   // Every frame, the 2D path until then
+ *   if (builder.Poll()) ...
+ *
+ * Each queued program writes its name, or 0 when it failed, to its
+ * destination once it is ready, and not before: the destinations read 0
+ * while the build runs. Cache lookups and stores happen on the calling
+ * thread, in Start() and Poll(). Start(), Poll(), Finish() and Cancel() need
+ * the caller's context current.
+ */
+class ProgramBuilder {
+ private:
+  struct JOB {
+    GLuint* destination;
+    std::string tag;
+    std::string vert_source;
+    std::string frag_source;
+    std::vector<PROGRAM_ATTRIBUTE> attributes;
+    PROGRAM_BUILDER build;
+    uint64_t key;
+    GLuint vert_shader;
+    GLuint frag_shader;
+    GLuint program;
+    bool cached;
+    bool done;
+  };
+  std::vector<JOB> jobs_;
+  int32_t num_done_;
+  PROGRAM_BUILD_MODE mode_;
+  bool started_;
+  std::chrono::steady_clock::time_point start_time_;
+  double build_ms_;
+  double blocked_ms_;
+
+  // WORKER mode
+  EGLDisplay display_;
+  EGLContext worker_context_;
+  EGLSurface worker_surface_;
+  std::thread worker_;
+  std::atomic<int32_t> num_built_;
+  std::atomic<bool> worker_failed_;
+  std::atomic<bool> cancel_;
+
+  bool StartWorker();
+  void StopWorker();
+  void RunWorker();
+  GLuint Build(JOB* job);
+  void Complete(JOB* job);
+  bool PollParallel();
+  bool PollWorker();
+
+  ProgramBuilder(const ProgramBuilder&);
+  ProgramBuilder& operator=(const ProgramBuilder&);
+
+ public:
+  ProgramBuilder();
+  ~ProgramBuilder();
+
+  void AddProgram(GLuint* destination, const char* tag,
+                  const std::string& vert_source,
+                  const std::string& frag_source,
+                  const PROGRAM_ATTRIBUTE* attributes, int32_t num_attributes);
+  void AddProgram(GLuint* destination, const char* tag,
+                  const char* vert_source, const char* frag_source,
+                  PROGRAM_BUILDER build);
+
+  void Start(PROGRAM_BUILD_MODE mode = PROGRAM_BUILD_AUTO);
+  // Non blocking, true once every destination is written
+  bool Poll();
+  // Blocks until Poll() is true
+  void Finish();
+  // Stops the build and deletes the programs not handed out, the builder can
+  // take programs again afterwards
+  void Cancel();
+
+  bool IsStarted() const { return started_; }
+  PROGRAM_BUILD_MODE GetMode() const { return mode_; }
+  int32_t GetNumPrograms() const { return (int32_t)jobs_.size(); }
+  // From Start() until every program was ready, and the part of it spent in
+  // Start(), Poll() and Finish() on the calling thread
+  double GetBuildTime() const { return build_ms_; }
+  double GetBlockedTime() const { return blocked_ms_; }
+};
+
+// "sync", "parallel", "worker" for logs
+const char* GetProgramBuildModeName(const PROGRAM_BUILD_MODE mode);
+
+}  // namespace leia_helper
+#endif /* LEIA_HELPER_PROGRAMBUILDER_H_ */
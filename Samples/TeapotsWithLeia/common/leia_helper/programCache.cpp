@@ -0,0 +1,267 @@
+/*
+ * Copyright 2018 Leia Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//--------------------------------------------------------------------------------
+// programCache.cpp
+// Program binaries kept across launches and context losses
+//--------------------------------------------------------------------------------
+#include <dirent.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "JNIHelper.h"
+#include "programCache.h"
+
+// SHA-1 of libleiasdk.so, set by CMakeLists.txt. Programs from
+// leiaCreateProgram() depend on the SDK build, not only on their sources.
+#ifndef LEIA_SDK_BUILD
+#define LEIA_SDK_BUILD "unknown"
+#endif
+
+namespace leia_helper {
+
+// "LPC1", bump the digit when PROGRAM_FILE_HEADER changes
+const uint32_t PROGRAM_FILE_MAGIC = 0x3143504c;
+
+struct PROGRAM_FILE_HEADER {
+  uint32_t magic;
+  uint32_t binary_format;
+  uint64_t key;
+  uint64_t driver_key;
+  uint32_t binary_size;
+  uint32_t reserved;
+};
+
+uint64_t HashProgramKey(uint64_t key, const void* data, size_t size) {
+  const uint8_t* bytes = (const uint8_t*)data;
+  for (size_t i = 0; i < size; ++i) {
+    key ^= bytes[i];
+    key *= 1099511628211ULL;
+  }
+  return key;
+}
+
+uint64_t HashProgramKey(uint64_t key, const char* str) {
+  if (!str) str = "";
+  return HashProgramKey(key, str, strlen(str) + 1);
+}
+
+static std::string GetGLString(GLenum name) {
+  const char* str = (const char*)glGetString(name);
+  return str ? std::string(str) : std::string();
+}
+
+static bool ReadTextFile(const std::string& path, std::string* text) {
+  FILE* file = fopen(path.c_str(), "rb");
+  if (!file) return false;
+  char buffer[256];
+  size_t size;
+  text->clear();
+  while ((size = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    text->append(buffer, size);
+  fclose(file);
+  return true;
+}
+
+// Writes next to path then renames, a killed process leaves no torn file
+static bool WriteFileAtomic(const std::string& path, const void* header,
+                            size_t header_size, const void* data,
+                            size_t size) {
+  std::string temp_path = path + ".tmp";
+  FILE* file = fopen(temp_path.c_str(), "wb");
+  if (!file) return false;
+  bool written = fwrite(header, 1, header_size, file) == header_size &&
+                 (!size || fwrite(data, 1, size, file) == size);
+  written = !fclose(file) && written;
+  if (!written || rename(temp_path.c_str(), path.c_str())) {
+    remove(temp_path.c_str());
+    return false;
+  }
+  return true;
+}
+
+ProgramCache::ProgramCache() : driver_key_(0), enabled_(false) {
+  memset(&stats_, 0, sizeof(stats_));
+}
+
+ProgramCache::~ProgramCache() {}
+
+ProgramCache* ProgramCache::GetInstance() {
+  static ProgramCache cache;
+  return &cache;
+}
+
+bool ProgramCache::Init(const std::string& directory) {
+  enabled_ = false;
+  memset(&stats_, 0, sizeof(stats_));
+  directory_ = directory;
+  formats_.clear();
+  if (directory_.empty()) return false;
+
+  GLint num_formats = 0;
+  glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &num_formats);
+  if (num_formats <= 0) {
+    LOGI("No program binary formats, program cache disabled");
+    return false;
+  }
+  formats_.resize(num_formats);
+  glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, &formats_[0]);
+
+  driver_ = GetGLString(GL_VENDOR) + "\n" + GetGLString(GL_RENDERER) + "\n" +
+            GetGLString(GL_VERSION) + "\n" + LEIA_SDK_BUILD + "\n";
+  driver_key_ = HashProgramKey(PROGRAM_KEY_SEED, driver_.c_str());
+
+  if (mkdir(directory_.c_str(), 0700) && errno != EEXIST) {
+    LOGW("Can not create program cache %s", directory_.c_str());
+    return false;
+  }
+
+  // Binaries of another driver or SDK never load again, drop them all
+  std::string driver_path = directory_ + "/driver";
+  std::string cached_driver;
+  if (!ReadTextFile(driver_path, &cached_driver) ||
+      cached_driver != driver_) {
+    Clear();
+    if (!WriteFileAtomic(driver_path, driver_.data(), driver_.size(), NULL,
+                         0)) {
+      LOGW("Can not write program cache %s", driver_path.c_str());
+      return false;
+    }
+  }
+  enabled_ = true;
+  return true;
+}
+
+void ProgramCache::Clear() {
+  DIR* dir = opendir(directory_.c_str());
+  if (!dir) return;
+  int32_t removed = 0;
+  struct dirent* entry;
+  while ((entry = readdir(dir)) != NULL) {
+    const char* ext = strrchr(entry->d_name, '.');
+    if (ext && (!strcmp(ext, ".bin") || !strcmp(ext, ".tmp"))) {
+      std::string path = directory_ + "/" + entry->d_name;
+      if (!remove(path.c_str())) ++removed;
+    }
+  }
+  closedir(dir);
+  if (removed) LOGI("Program cache cleared, %d binaries removed", removed);
+}
+
+std::string ProgramCache::GetPath(uint64_t key) const {
+  char name[32];
+  snprintf(name, sizeof(name), "/%016llx.bin", (unsigned long long)key);
+  return directory_ + name;
+}
+
+bool ProgramCache::IsFormatSupported(GLenum format) const {
+  for (size_t i = 0; i < formats_.size(); ++i) {
+    if ((GLenum)formats_[i] == format) return true;
+  }
+  return false;
+}
+
+GLuint ProgramCache::LoadProgram(uint64_t key) {
+  if (!enabled_) return 0;
+
+  std::string path = GetPath(key);
+  FILE* file = fopen(path.c_str(), "rb");
+  if (!file) {
+    ++stats_.misses;
+    return 0;
+  }
+  PROGRAM_FILE_HEADER header;
+  std::vector<uint8_t> binary;
+  bool valid = fread(&header, sizeof(header), 1, file) == 1 &&
+               header.magic == PROGRAM_FILE_MAGIC && header.key == key &&
+               header.driver_key == driver_key_ && header.binary_size &&
+               IsFormatSupported(header.binary_format);
+  if (valid) {
+    binary.resize(header.binary_size);
+    valid = fread(&binary[0], 1, binary.size(), file) == binary.size();
+  }
+  fclose(file);
+
+  GLuint program = 0;
+  if (valid) {
+    program = glCreateProgram();
+    glProgramBinary(program, header.binary_format, &binary[0],
+                    (GLsizei)binary.size());
+    GLint linked = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (!linked) {
+      glDeleteProgram(program);
+      program = 0;
+    }
+  }
+  if (!program) {
+    LOGI("Program binary %s rejected", path.c_str());
+    remove(path.c_str());
+    ++stats_.rejects;
+    return 0;
+  }
+  ++stats_.hits;
+  return program;
+}
+
+void ProgramCache::StoreProgram(uint64_t key, GLuint program) {
+  if (!enabled_ || !program) return;
+
+  GLint length = 0;
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0) return;
+  std::vector<uint8_t> binary(length);
+  GLsizei size = 0;
+  GLenum format = 0;
+  glGetProgramBinary(program, length, &size, &format, &binary[0]);
+  if (size <= 0) return;
+
+  PROGRAM_FILE_HEADER header;
+  memset(&header, 0, sizeof(header));
+  header.magic = PROGRAM_FILE_MAGIC;
+  header.binary_format = format;
+  header.key = key;
+  header.driver_key = driver_key_;
+  header.binary_size = (uint32_t)size;
+  std::string path = GetPath(key);
+  if (!WriteFileAtomic(path, &header, sizeof(header), &binary[0], size)) {
+    LOGW("Can not write program binary %s", path.c_str());
+    return;
+  }
+  ++stats_.stores;
+}
+
+uint64_t GetProgramKey(const char* tag, const char* vert_source,
+                       const char* frag_source) {
+  uint64_t key = HashProgramKey(PROGRAM_KEY_SEED, tag);
+  key = HashProgramKey(key, vert_source);
+  return HashProgramKey(key, frag_source);
+}
+
+GLuint CreateCachedProgram(const char* tag, const char* vert_source,
+                           const char* frag_source, PROGRAM_BUILDER build) {
+  uint64_t key = GetProgramKey(tag, vert_source, frag_source);
+  ProgramCache* cache = ProgramCache::GetInstance();
+  GLuint program = cache->LoadProgram(key);
+  if (program) return program;
+  program = build(vert_source, frag_source);
+  cache->StoreProgram(key, program);
+  return program;
+}
+
+}  // namespace leia_helper
@@ -0,0 +1,121 @@
+/*
+ * Copyright 2018 Leia Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//--------------------------------------------------------------------------------
+// programCache.h
+//--------------------------------------------------------------------------------
+#ifndef LEIA_HELPER_PROGRAMCACHE_H_
+#define LEIA_HELPER_PROGRAMCACHE_H_
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+#include "gl3stub.h"
+
+namespace leia_helper {
+
+/******************************************************************
+ * 64 bit FNV-1a over program sources and anything else that changes the
+ * linked program (defines, attribute bindings, a tag per builder)
+ * The string overload hashes the terminating zero too, so "ab" + "c" and
+ * "a" + "bc" give different keys.
+ */
+const uint64_t PROGRAM_KEY_SEED = 14695981039346656037ULL;
+
+uint64_t HashProgramKey(uint64_t key, const void* data, size_t size);
+uint64_t HashProgramKey(uint64_t key, const char* str);
+
+// Key of a program linked from vert_source and frag_source, see
+// CreateCachedProgram()
+uint64_t GetProgramKey(const char* tag, const char* vert_source,
+                       const char* frag_source);
+
+/******************************************************************
+ * Programs loaded or created through the cache since Init()
+ * misses found no binary, rejects found one the driver would not load. Both
+ * were compiled. stores counts binaries written.
+ */
+struct PROGRAM_CACHE_STATS {
+  int32_t hits;
+  int32_t misses;
+  int32_t rejects;
+  int32_t stores;
+};
+
+/******************************************************************
+ * glGetProgramBinary() blobs on disk, one file per program key
+ *
+ * Files live in a directory of their own, typically
+ * JNIHelper::GetExternalFilesDir() + "/program_cache". Every file records
+ * the driver it came from: GL_VENDOR, GL_RENDERER, GL_VERSION and the build
+ * of libleiasdk.so. Init() deletes the whole cache when that identity
+ * changed since the last run, LoadProgram() rejects any file that does not
+ * match it, and a binary the driver refuses is deleted and compiled again.
+ *
+ * The cache is off until Init() succeeds and when the driver exposes no
+ * binary format, LoadProgram() then always misses and StoreProgram() does
+ * nothing. GL thread only.
+ */
+class ProgramCache {
+ private:
+  std::string directory_;
+  std::string driver_;
+  uint64_t driver_key_;
+  std::vector<GLint> formats_;
+  bool enabled_;
+  PROGRAM_CACHE_STATS stats_;
+
+  ProgramCache();
+  ~ProgramCache();
+  ProgramCache(const ProgramCache&);
+  ProgramCache& operator=(const ProgramCache&);
+
+  std::string GetPath(uint64_t key) const;
+  bool IsFormatSupported(GLenum format) const;
+  void Clear();
+
+ public:
+  static ProgramCache* GetInstance();
+
+  // Needs the context current, call again after a context loss
+  bool Init(const std::string& directory);
+  bool IsEnabled() const { return enabled_; }
+
+  // A linked program, or 0 when the key is not cached or was rejected
+  GLuint LoadProgram(uint64_t key);
+  // Programs linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT store reliably
+  void StoreProgram(uint64_t key, GLuint program);
+
+  PROGRAM_CACHE_STATS GetStats() const { return stats_; }
+};
+
+/******************************************************************
+ * CreateCachedProgram()
+ * Loads the program of vert_source and frag_source from the ProgramCache,
+ * or builds it with build and stores it. tag tells apart builders that link
+ * the same sources differently.
+ *
+ *   dof_program = CreateCachedProgram("leia", vert, frag, leiaCreateProgram);
+ */
+typedef GLuint (*PROGRAM_BUILDER)(const char* vert_source,
+                                  const char* frag_source);
+
+GLuint CreateCachedProgram(const char* tag, const char* vert_source,
+                           const char* frag_source, PROGRAM_BUILDER build);
+
+}  // namespace leia_helper
+#endif /* LEIA_HELPER_PROGRAMCACHE_H_ */
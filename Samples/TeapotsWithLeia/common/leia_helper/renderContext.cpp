@@ -0,0 +1,236 @@
+/*
+ * Copyright 2018 Leia Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//--------------------------------------------------------------------------------
+// renderContext.cpp
+// Redundant bind elision and cached uniform locations
+//--------------------------------------------------------------------------------
+#include <string.h>
+
+#include "renderContext.h"
+
+namespace leia_helper {
+
+// Never a GL name, tracked state that must be set before it can be skipped
+static const GLuint UNKNOWN_NAME = 0xffffffff;
+
+LeiaRenderContext::LeiaRenderContext() : last_program_(0), quad_vbo_(0) {
+  Invalidate();
+  ResetStats();
+}
+
+LeiaRenderContext::~LeiaRenderContext() {}
+
+LeiaRenderContext* LeiaRenderContext::GetInstance() {
+  static LeiaRenderContext context;
+  return &context;
+}
+
+void LeiaRenderContext::UseProgram(const GLuint program) {
+  if (program == program_) {
+    ++stats_.programs_elided;
+    return;
+  }
+  glUseProgram(program);
+  program_ = program;
+  ++stats_.program_binds;
+}
+
+void LeiaRenderContext::BindFramebuffer(const GLuint framebuffer) {
+  if (framebuffer == framebuffer_) {
+    ++stats_.framebuffers_elided;
+    return;
+  }
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  framebuffer_ = framebuffer;
+  ++stats_.framebuffer_binds;
+}
+
+void LeiaRenderContext::BindTexture(const int32_t unit, const GLenum target,
+                                    const GLuint texture) {
+  bool tracked = unit < MAX_TRACKED_TEXTURE_UNITS;
+  if (tracked && textures_[unit].target == target &&
+      textures_[unit].texture == texture) {
+    ++stats_.textures_elided;
+    return;
+  }
+  if (unit != active_unit_) {
+    glActiveTexture(GL_TEXTURE0 + unit);
+    active_unit_ = unit;
+  }
+  glBindTexture(target, texture);
+  // A unit holds one texture per target, remembering only the last one
+  // makes a bind to another target look new, never the reverse
+  if (tracked) {
+    textures_[unit].target = target;
+    textures_[unit].texture = texture;
+  }
+  ++stats_.texture_binds;
+}
+
+LeiaRenderContext::PROGRAM* LeiaRenderContext::FindProgram(
+    const GLuint program) {
+  if (last_program_ < programs_.size() &&
+      programs_[last_program_].program == program) {
+    return &programs_[last_program_];
+  }
+  for (size_t i = 0; i < programs_.size(); ++i) {
+    if (programs_[i].program == program) {
+      last_program_ = i;
+      return &programs_[i];
+    }
+  }
+  PROGRAM entry;
+  entry.program = program;
+  programs_.push_back(entry);
+  last_program_ = programs_.size() - 1;
+  return &programs_.back();
+}
+
+GLint LeiaRenderContext::GetUniformLocation(const GLuint program,
+                                            const char* name) {
+  ++stats_.uniform_lookups;
+  PROGRAM* entry = FindProgram(program);
+  for (size_t i = 0; i < entry->uniforms.size(); ++i) {
+    if (!strcmp(entry->uniforms[i].name.c_str(), name))
+      return entry->uniforms[i].location;
+  }
+  UNIFORM uniform;
+  uniform.name = name;
+  uniform.location = glGetUniformLocation(program, name);
+  entry->uniforms.push_back(uniform);
+  ++stats_.uniform_queries;
+  return uniform.location;
+}
+
+void LeiaRenderContext::BindUniformBlock(const GLuint program,
+                                         const char* name,
+                                         const GLuint binding) {
+  ++stats_.uniform_lookups;
+  PROGRAM* entry = FindProgram(program);
+  UNIFORM* block = NULL;
+  for (size_t i = 0; i < entry->blocks.size(); ++i) {
+    if (!strcmp(entry->blocks[i].name.c_str(), name)) {
+      block = &entry->blocks[i];
+      break;
+    }
+  }
+  if (block && block->location == (GLint)binding) return;
+  if (!block) {
+    UNIFORM new_block;
+    new_block.name = name;
+    entry->blocks.push_back(new_block);
+    block = &entry->blocks.back();
+  }
+  GLuint index = glGetUniformBlockIndex(program, name);
+  if (index != GL_INVALID_INDEX) glUniformBlockBinding(program, index, binding);
+  block->location = (GLint)binding;
+  ++stats_.uniform_queries;
+}
+
+GLuint LeiaRenderContext::GetQuadVertexArray(const GLuint vertex_attribute,
+                                             const GLuint uv_attribute) {
+  for (size_t i = 0; i < quad_vertex_arrays_.size(); ++i) {
+    const QUAD_VERTEX_ARRAY& entry = quad_vertex_arrays_[i];
+    if (entry.vertex_attribute == vertex_attribute &&
+        entry.uv_attribute == uv_attribute) {
+      return entry.vao;
+    }
+  }
+
+  if (!quad_vbo_) {
+    // Triangle strip, X Y U V
+    const GLfloat vertex_data[] = {
+        -1.0f, -1.0f, 0.0f, 0.0f,
+         1.0f, -1.0f, 1.0f, 0.0f,
+        -1.0f,  1.0f, 0.0f, 1.0f,
+         1.0f,  1.0f, 1.0f, 1.0f,
+    };
+    glGenBuffers(1, &quad_vbo_);
+    glBindBuffer(GL_ARRAY_BUFFER, quad_vbo_);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(vertex_data), vertex_data,
+                 GL_STATIC_DRAW);
+  }
+
+  QUAD_VERTEX_ARRAY entry;
+  entry.vertex_attribute = vertex_attribute;
+  entry.uv_attribute = uv_attribute;
+  glGenVertexArrays(1, &entry.vao);
+  glBindVertexArray(entry.vao);
+  glBindBuffer(GL_ARRAY_BUFFER, quad_vbo_);
+  glVertexAttribPointer(vertex_attribute, 2, GL_FLOAT, GL_FALSE,
+                        4 * sizeof(GLfloat), (char*)0);
+  glEnableVertexAttribArray(vertex_attribute);
+  glVertexAttribPointer(uv_attribute, 2, GL_FLOAT, GL_FALSE,
+                        4 * sizeof(GLfloat), (char*)0 + 2 * sizeof(GLfloat));
+  glEnableVertexAttribArray(uv_attribute);
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  quad_vertex_arrays_.push_back(entry);
+  return entry.vao;
+}
+
+void LeiaRenderContext::DrawQuad(const GLuint vertex_attribute,
+                                 const GLuint uv_attribute) {
+  // The renderers set up their meshes on the default vertex array, leave it
+  // bound for them
+  glBindVertexArray(GetQuadVertexArray(vertex_attribute, uv_attribute));
+  glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+  glBindVertexArray(0);
+  ++stats_.quad_draws;
+}
+
+void LeiaRenderContext::DeleteProgram(GLuint* program) {
+  if (!*program) return;
+  for (size_t i = 0; i < programs_.size(); ++i) {
+    if (programs_[i].program == *program) {
+      programs_.erase(programs_.begin() + i);
+      break;
+    }
+  }
+  // Stays in use until another program is, but its name may come back
+  if (program_ == *program) program_ = UNKNOWN_NAME;
+  glDeleteProgram(*program);
+  *program = 0;
+}
+
+void LeiaRenderContext::Invalidate() {
+  program_ = UNKNOWN_NAME;
+  framebuffer_ = UNKNOWN_NAME;
+  active_unit_ = -1;
+  for (int32_t i = 0; i < MAX_TRACKED_TEXTURE_UNITS; ++i) {
+    textures_[i].target = GL_NONE;
+    textures_[i].texture = UNKNOWN_NAME;
+  }
+}
+
+void LeiaRenderContext::Unload() {
+  for (size_t i = 0; i < quad_vertex_arrays_.size(); ++i) {
+    glDeleteVertexArrays(1, &quad_vertex_arrays_[i].vao);
+  }
+  quad_vertex_arrays_.clear();
+  if (quad_vbo_) {
+    glDeleteBuffers(1, &quad_vbo_);
+    quad_vbo_ = 0;
+  }
+  programs_.clear();
+  last_program_ = 0;
+  Invalidate();
+}
+
+void LeiaRenderContext::ResetStats() { memset(&stats_, 0, sizeof(stats_)); }
+
+}  // namespace leia_helper
@@ -0,0 +1,146 @@
+/*
+ * Copyright 2018 Leia Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//--------------------------------------------------------------------------------
+// renderContext.h
+//--------------------------------------------------------------------------------
+#ifndef LEIA_HELPER_RENDERCONTEXT_H_
+#define LEIA_HELPER_RENDERCONTEXT_H_
+
+#include <string>
+#include <vector>
+
+#include "gl3stub.h"
+
+namespace leia_helper {
+
+/******************************************************************
+ * Calls LeiaRenderContext made and skipped since ResetStats()
+ * The elided counters are binds that matched the tracked state and never
+ * reached GL. uniform_lookups counts GetUniformLocation() and
+ * BindUniformBlock() calls, uniform_queries the ones that had to query GL.
+ */
+struct RENDER_CONTEXT_STATS {
+  int32_t program_binds;
+  int32_t programs_elided;
+  int32_t framebuffer_binds;
+  int32_t framebuffers_elided;
+  int32_t texture_binds;
+  int32_t textures_elided;
+  int32_t uniform_lookups;
+  int32_t uniform_queries;
+  int32_t quad_draws;
+};
+
+/******************************************************************
+ * GL state of the render thread, shared by the renderers and the
+ * leia_helper passes
+ *
+ * Tracks the current program, the GL_FRAMEBUFFER binding, the active texture
+ * unit and the texture on each of the first MAX_TRACKED_TEXTURE_UNITS units,
+ * and skips binds that would not change them. Uniform locations are queried
+ * and uniform block bindings set once per program and name. The fullscreen
+ * quad lives in one buffer with a vertex array object per attribute layout.
+ *
+ * The tracking only holds while every bind goes through the context. Call
+ * Invalidate() after code that binds on its own, the Leia SDK passes among
+ * them, at the start of a frame and after deleting a texture or framebuffer
+ * that may be bound. Delete programs with DeleteProgram(), GL reuses names
+ * and a stale cache would hand out the locations of the deleted program.
+ * Unload() when the context goes away.
+ */
+class LeiaRenderContext {
+ public:
+  static const int32_t MAX_TRACKED_TEXTURE_UNITS = 8;
+
+ private:
+  struct UNIFORM {
+    std::string name;
+    GLint location;
+  };
+  struct PROGRAM {
+    GLuint program;
+    std::vector<UNIFORM> uniforms;
+    // location is the binding point the block was given
+    std::vector<UNIFORM> blocks;
+  };
+  struct QUAD_VERTEX_ARRAY {
+    GLuint vertex_attribute;
+    GLuint uv_attribute;
+    GLuint vao;
+  };
+  struct TEXTURE_BINDING {
+    GLenum target;
+    GLuint texture;
+  };
+
+  GLuint program_;
+  GLuint framebuffer_;
+  int32_t active_unit_;
+  TEXTURE_BINDING textures_[MAX_TRACKED_TEXTURE_UNITS];
+
+  std::vector<PROGRAM> programs_;
+  size_t last_program_;
+  GLuint quad_vbo_;
+  std::vector<QUAD_VERTEX_ARRAY> quad_vertex_arrays_;
+  RENDER_CONTEXT_STATS stats_;
+
+  LeiaRenderContext();
+  ~LeiaRenderContext();
+  LeiaRenderContext(const LeiaRenderContext&);
+  LeiaRenderContext& operator=(const LeiaRenderContext&);
+
+  PROGRAM* FindProgram(const GLuint program);
+  GLuint GetQuadVertexArray(const GLuint vertex_attribute,
+                            const GLuint uv_attribute);
+
+ public:
+  static LeiaRenderContext* GetInstance();
+
+  void UseProgram(const GLuint program);
+  // GL_FRAMEBUFFER, draw and read
+  void BindFramebuffer(const GLuint framebuffer);
+  // Makes unit active and binds texture to target on it
+  void BindTexture(const int32_t unit, const GLenum target,
+                   const GLuint texture);
+  GLint GetUniformLocation(const GLuint program, const char* name);
+  // Uniform block name of program to binding, blocks the program does not
+  // use are skipped
+  void BindUniformBlock(const GLuint program, const char* name,
+                        const GLuint binding);
+
+  /******************************************************************
+   * Fullscreen quad, a triangle strip in clip space with vec2 positions on
+   * vertex_attribute and vec2 texture coordinates on uv_attribute. The
+   * vertex array is unbound again after the draw.
+   */
+  void DrawQuad(const GLuint vertex_attribute, const GLuint uv_attribute);
+
+  // Deletes *program, forgets its uniforms and sets it to 0
+  void DeleteProgram(GLuint* program);
+
+  // Forgets the tracked bindings, the next bind of each always reaches GL
+  void Invalidate();
+  // Deletes the quad buffers and forgets every program, their names are
+  // invalid once the EGL context is gone
+  void Unload();
+
+  RENDER_CONTEXT_STATS GetStats() const { return stats_; }
+  void ResetStats();
+};
+
+}  // namespace leia_helper
+#endif /* LEIA_HELPER_RENDERCONTEXT_H_ */
@@ -0,0 +1,180 @@
+/*
+ * Copyright 2018 Leia Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//--------------------------------------------------------------------------------
+// renderTargetPool.cpp
+// Render target textures reused across viewport changes
+//--------------------------------------------------------------------------------
+#include <string.h>
+
+#include "JNIHelper.h"
+#include "renderTargetPool.h"
+
+namespace leia_helper {
+
+int32_t GetFormatBytesPerPixel(const GLenum internal_format) {
+  switch (internal_format) {
+    case GL_R8:
+      return 1;
+    case GL_RG8:
+    case GL_RGB565:
+    case GL_R16F:
+    case GL_DEPTH_COMPONENT16:
+      return 2;
+    case GL_RGBA8:
+    case GL_RGBA8UI:
+    case GL_RGB10_A2:
+    case GL_R11F_G11F_B10F:
+    case GL_R32F:
+    case GL_DEPTH_COMPONENT24:
+    case GL_DEPTH_COMPONENT32F:
+    case GL_DEPTH24_STENCIL8:
+      return 4;
+    case GL_RGBA16F:
+    case GL_DEPTH32F_STENCIL8:
+      return 8;
+    default:
+      return 0;
+  }
+}
+
+static void DeletePoolTexture(const RENDER_TARGET_DESC& desc, GLuint texture) {
+  if (desc.usage == RENDER_TARGET_USAGE_RENDERBUFFER) {
+    glDeleteRenderbuffers(1, &texture);
+  } else {
+    glDeleteTextures(1, &texture);
+  }
+}
+
+static bool SameDesc(const RENDER_TARGET_DESC& a, const RENDER_TARGET_DESC& b) {
+  return a.width == b.width && a.height == b.height && a.layers == b.layers &&
+         a.internal_format == b.internal_format && a.usage == b.usage;
+}
+
+static GLuint CreatePoolTexture(const RENDER_TARGET_DESC& desc) {
+  if (desc.usage == RENDER_TARGET_USAGE_RENDERBUFFER) {
+    GLuint renderbuffer;
+    glGenRenderbuffers(1, &renderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, desc.internal_format, desc.width,
+                          desc.height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    return renderbuffer;
+  }
+
+  GLenum target = desc.usage == RENDER_TARGET_USAGE_TEXTURE_ARRAY
+                      ? GL_TEXTURE_2D_ARRAY
+                      : GL_TEXTURE_2D;
+  GLuint texture_id;
+  glGenTextures(1, &texture_id);
+  glBindTexture(target, texture_id);
+  if (target == GL_TEXTURE_2D_ARRAY) {
+    glTexStorage3D(target, 1, desc.internal_format, desc.width, desc.height,
+                   desc.layers);
+  } else {
+    glTexStorage2D(target, 1, desc.internal_format, desc.width, desc.height);
+  }
+  glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glBindTexture(target, 0);
+  return texture_id;
+}
+
+RenderTargetPool::RenderTargetPool() { memset(&stats_, 0, sizeof(stats_)); }
+
+RenderTargetPool::~RenderTargetPool() {}
+
+RenderTargetPool* RenderTargetPool::GetInstance() {
+  static RenderTargetPool pool;
+  return &pool;
+}
+
+GLuint RenderTargetPool::AcquireTexture(const RENDER_TARGET_DESC& desc) {
+  if (desc.width <= 0 || desc.height <= 0 || desc.layers <= 0) return 0;
+
+  for (size_t i = 0; i < entries_.size(); ++i) {
+    ENTRY& entry = entries_[i];
+    if (!entry.acquired && SameDesc(entry.desc, desc)) {
+      entry.acquired = true;
+      stats_.acquired_bytes += entry.bytes;
+      ++stats_.num_acquired;
+      ++stats_.reuses;
+      return entry.texture;
+    }
+  }
+
+  ENTRY entry;
+  entry.desc = desc;
+  entry.texture = CreatePoolTexture(desc);
+  entry.bytes = (int64_t)desc.width * desc.height * desc.layers *
+                GetFormatBytesPerPixel(desc.internal_format);
+  entry.acquired = true;
+  entries_.push_back(entry);
+
+  stats_.current_bytes += entry.bytes;
+  stats_.acquired_bytes += entry.bytes;
+  if (stats_.current_bytes > stats_.peak_bytes)
+    stats_.peak_bytes = stats_.current_bytes;
+  ++stats_.num_textures;
+  ++stats_.num_acquired;
+  ++stats_.allocations;
+  return entry.texture;
+}
+
+void RenderTargetPool::Release(const GLuint name, const bool renderbuffer) {
+  if (!name) return;
+  for (size_t i = 0; i < entries_.size(); ++i) {
+    ENTRY& entry = entries_[i];
+    if (entry.texture == name && entry.acquired &&
+        (entry.desc.usage == RENDER_TARGET_USAGE_RENDERBUFFER) ==
+            renderbuffer) {
+      entry.acquired = false;
+      stats_.acquired_bytes -= entry.bytes;
+      --stats_.num_acquired;
+      return;
+    }
+  }
+}
+
+void RenderTargetPool::Trim() {
+  size_t kept = 0;
+  for (size_t i = 0; i < entries_.size(); ++i) {
+    ENTRY& entry = entries_[i];
+    if (entry.acquired) {
+      entries_[kept++] = entry;
+      continue;
+    }
+    DeletePoolTexture(entry.desc, entry.texture);
+    stats_.current_bytes -= entry.bytes;
+    --stats_.num_textures;
+  }
+  entries_.resize(kept);
+}
+
+void RenderTargetPool::Unload() {
+  if (stats_.num_acquired) {
+    LOGW("Render target pool unloaded with %d textures still acquired",
+         stats_.num_acquired);
+  }
+  for (size_t i = 0; i < entries_.size(); ++i)
+    DeletePoolTexture(entries_[i].desc, entries_[i].texture);
+  entries_.clear();
+  memset(&stats_, 0, sizeof(stats_));
+}
+
+}  // namespace leia_helper
@@ -0,0 +1,139 @@
+/*
+ * Copyright 2018 Leia Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//--------------------------------------------------------------------------------
+// renderTargetPool.h
+//--------------------------------------------------------------------------------
+#ifndef LEIA_HELPER_RENDERTARGETPOOL_H_
+#define LEIA_HELPER_RENDERTARGETPOOL_H_
+
+#include <vector>
+
+#include "gl3stub.h"
+
+namespace leia_helper {
+
+/******************************************************************
+ * How a pooled texture is bound
+ * TEXTURE: GL_TEXTURE_2D, attached to a framebuffer and sampled
+ * TEXTURE_ARRAY: GL_TEXTURE_2D_ARRAY, attached per layer or with
+ *                OVR_multiview, sampled as an array
+ * RENDERBUFFER: attached, never sampled, see ATTACHMENT_POLICY
+ */
+enum RENDER_TARGET_USAGE {
+  RENDER_TARGET_USAGE_TEXTURE,
+  RENDER_TARGET_USAGE_TEXTURE_ARRAY,
+  RENDER_TARGET_USAGE_RENDERBUFFER,
+};
+
+/******************************************************************
+ * Key of a pooled texture, layers is 1 for RENDER_TARGET_USAGE_TEXTURE
+ */
+struct RENDER_TARGET_DESC {
+  int32_t width;
+  int32_t height;
+  int32_t layers;
+  GLenum internal_format;
+  RENDER_TARGET_USAGE usage;
+};
+
+/******************************************************************
+ * Memory held by the pool
+ * current_bytes counts acquired and free textures, acquired_bytes only the
+ * acquired ones, peak_bytes is the highest current_bytes since Unload().
+ * allocations and reuses count the AcquireTexture() calls that created a
+ * texture and those served from the free list.
+ */
+struct RENDER_TARGET_POOL_STATS {
+  int64_t current_bytes;
+  int64_t acquired_bytes;
+  int64_t peak_bytes;
+  int32_t num_textures;
+  int32_t num_acquired;
+  int32_t allocations;
+  int32_t reuses;
+};
+
+/******************************************************************
+ * GetFormatBytesPerPixel()
+ * Size of a texel of a sized internal format, 0 for unknown formats.
+ * Depth formats count what the driver typically stores, DEPTH_COMPONENT24
+ * takes 4 bytes.
+ */
+int32_t GetFormatBytesPerPixel(const GLenum internal_format);
+
+/******************************************************************
+ * Pool of render target textures, shared by the renderers and the
+ * leia_helper targets on the GL thread. Renderbuffers are pooled the same
+ * way. Texture and renderbuffer names come from separate GL namespaces and
+ * the same number can name one of each, so they are released with
+ * ReleaseTexture() and ReleaseRenderbuffer() respectively, each only
+ * matches its own kind.
+ * AcquireTexture() hands out a free texture with the same
+ * RENDER_TARGET_DESC, or creates one with glTexStorage, nearest filtering
+ * and edge clamping. ReleaseTexture() puts it back on the free list.
+ * Framebuffers stay with their owners: they hold no memory and attachments
+ * differ per owner.
+ *
+ * Rebuilding targets on a viewport change is release all, acquire all,
+ * then Trim(): targets that kept their size come back from the free list
+ * without an allocation, those that changed are freed by Trim().
+ * Unload() deletes every texture, acquired ones included, when the
+ * context goes away.
+ */
+class RenderTargetPool {
+ private:
+  struct ENTRY {
+    RENDER_TARGET_DESC desc;
+    GLuint texture;
+    int64_t bytes;
+    bool acquired;
+  };
+  std::vector<ENTRY> entries_;
+  RENDER_TARGET_POOL_STATS stats_;
+
+  RenderTargetPool();
+  ~RenderTargetPool();
+  RenderTargetPool(const RenderTargetPool&);
+  RenderTargetPool& operator=(const RenderTargetPool&);
+
+  void Release(const GLuint name, const bool renderbuffer);
+
+ public:
+  static RenderTargetPool* GetInstance();
+
+  GLuint AcquireTexture(const RENDER_TARGET_DESC& desc);
+  GLuint AcquireTexture(const int32_t width, const int32_t height,
+                        const GLenum internal_format) {
+    RENDER_TARGET_DESC desc = {width, height, 1, internal_format,
+                               RENDER_TARGET_USAGE_TEXTURE};
+    return AcquireTexture(desc);
+  }
+  // Take 0 and names the pool did not create without complaint
+  void ReleaseTexture(const GLuint texture) { Release(texture, false); }
+  void ReleaseRenderbuffer(const GLuint renderbuffer) {
+    Release(renderbuffer, true);
+  }
+
+  // Deletes the free textures
+  void Trim();
+  void Unload();
+
+  RENDER_TARGET_POOL_STATS GetStats() const { return stats_; }
+};
+
+}  // namespace leia_helper
+#endif /* LEIA_HELPER_RENDERTARGETPOOL_H_ */
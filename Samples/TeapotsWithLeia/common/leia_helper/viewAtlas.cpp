@@ -0,0 +1,202 @@
+/*
+ * Copyright 2018 Leia Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//--------------------------------------------------------------------------------
+// viewAtlas.cpp
+// All views in the regions of a single render target
+//--------------------------------------------------------------------------------
+#include "JNIHelper.h"
+#include "renderContext.h"
+#include "renderTargetPool.h"
+#include "viewAtlas.h"
+
+namespace leia_helper {
+
+static int64_t ResolveBytes(int32_t width, int32_t height,
+                            int32_t bytes_per_pixel) {
+  int64_t tiles_x = (width + RESOLVE_TILE_SIZE - 1) / RESOLVE_TILE_SIZE;
+  int64_t tiles_y = (height + RESOLVE_TILE_SIZE - 1) / RESOLVE_TILE_SIZE;
+  return tiles_x * tiles_y * RESOLVE_TILE_SIZE * RESOLVE_TILE_SIZE *
+         bytes_per_pixel;
+}
+
+// Scene pass (colour + depth when sampled) then depth of field pass (colour)
+static int64_t SceneAndDOFResolveBytes(int32_t width, int32_t height,
+                                       const ATTACHMENT_POLICY& policy) {
+  int32_t color = GetFormatBytesPerPixel(policy.color_format);
+  int32_t depth =
+      policy.depth_sampled ? GetFormatBytesPerPixel(policy.depth_format) : 0;
+  return ResolveBytes(width, height, color + depth) +
+         ResolveBytes(width, height, color);
+}
+
+RENDER_TARGET_STATS EstimateSeparateTargetStats(
+    const int32_t view_width, const int32_t view_height,
+    const int32_t num_views, const ATTACHMENT_POLICY& policy) {
+  RENDER_TARGET_STATS stats;
+  stats.framebuffer_binds = 2 * num_views;
+  stats.clears = num_views;
+  stats.resolve_bytes =
+      num_views * SceneAndDOFResolveBytes(view_width, view_height, policy);
+  return stats;
+}
+
+//--------------------------------------------------------------------------------
+// ViewAtlas
+//--------------------------------------------------------------------------------
+ViewAtlas::ViewAtlas()
+    : fbo_(0),
+      color_texture_(0),
+      depth_texture_(0),
+      fbo_dof_(0),
+      texture_dof_(0),
+      policy_(DEFAULT_ATTACHMENT_POLICY),
+      width_(0),
+      height_(0) {}
+
+ViewAtlas::~ViewAtlas() { Unload(); }
+
+bool ViewAtlas::Init(const int32_t view_width, const int32_t view_height,
+                     const int32_t num_views,
+                     const ATTACHMENT_POLICY& policy) {
+  Unload();
+  policy_ = policy;
+  if (view_width <= 0 || view_height <= 0 || num_views <= 0) return false;
+
+  // Grid that fits the texture size limit with the fewest resolve tiles,
+  // partially covered tiles cost as much as full ones
+  GLint max_size = 0;
+  glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
+  int32_t columns = 0;
+  int64_t best_bytes = 0;
+  for (int32_t c = num_views; c >= 1; --c) {
+    int32_t w = c * view_width;
+    int32_t h = (num_views + c - 1) / c * view_height;
+    if (w > max_size || h > max_size) continue;
+    int64_t bytes = ResolveBytes(w, h, 1);
+    if (!columns || bytes < best_bytes) {
+      columns = c;
+      best_bytes = bytes;
+    }
+  }
+  if (!columns) {
+    LOGE("%d views of %dx%d do not fit a %d texture", num_views, view_width,
+         view_height, max_size);
+    return false;
+  }
+  width_ = columns * view_width;
+  height_ = (num_views + columns - 1) / columns * view_height;
+
+  view_rects_.resize(num_views);
+  view_rect_table_.resize(num_views * 4);
+  for (int32_t i = 0; i < num_views; ++i) {
+    VIEW_RECT& rect = view_rects_[i];
+    rect.x = (i % columns) * view_width;
+    rect.y = (i / columns) * view_height;
+    rect.width = view_width;
+    rect.height = view_height;
+    view_rect_table_[i * 4 + 0] = (GLfloat)rect.x / width_;
+    view_rect_table_[i * 4 + 1] = (GLfloat)rect.y / height_;
+    view_rect_table_[i * 4 + 2] = (GLfloat)rect.width / width_;
+    view_rect_table_[i * 4 + 3] = (GLfloat)rect.height / height_;
+  }
+
+  color_texture_ = AcquireColorAttachment(policy_, width_, height_);
+  depth_texture_ = AcquireDepthAttachment(policy_, width_, height_);
+  texture_dof_ = AcquireColorAttachment(policy_, width_, height_);
+
+  GLenum attachment = GL_COLOR_ATTACHMENT0;
+  glGenFramebuffers(1, &fbo_);
+  glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                         color_texture_, 0);
+  AttachDepth(policy_, depth_texture_);
+  glDrawBuffers(1, &attachment);
+  GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+  if (status != GL_FRAMEBUFFER_COMPLETE) {
+    LOGE("Atlas scene FBO is incomplete: 0x%x", status);
+    Unload();
+    return false;
+  }
+
+  glGenFramebuffers(1, &fbo_dof_);
+  glBindFramebuffer(GL_FRAMEBUFFER, fbo_dof_);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                         texture_dof_, 0);
+  glDrawBuffers(1, &attachment);
+  status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+  if (status != GL_FRAMEBUFFER_COMPLETE) {
+    LOGE("Atlas DOF FBO is incomplete: 0x%x", status);
+    Unload();
+    return false;
+  }
+
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  return true;
+}
+
+void ViewAtlas::Unload() {
+  if (fbo_) {
+    glDeleteFramebuffers(1, &fbo_);
+    fbo_ = 0;
+  }
+  if (fbo_dof_) {
+    glDeleteFramebuffers(1, &fbo_dof_);
+    fbo_dof_ = 0;
+  }
+  RenderTargetPool* pool = RenderTargetPool::GetInstance();
+  pool->ReleaseTexture(color_texture_);
+  ReleaseDepthAttachment(policy_, depth_texture_);
+  pool->ReleaseTexture(texture_dof_);
+  color_texture_ = 0;
+  depth_texture_ = 0;
+  texture_dof_ = 0;
+  view_rects_.clear();
+  view_rect_table_.clear();
+}
+
+void ViewAtlas::BindScene() {
+  LeiaRenderContext::GetInstance()->BindFramebuffer(fbo_);
+  glDisable(GL_SCISSOR_TEST);
+  glViewport(0, 0, width_, height_);
+}
+
+void ViewAtlas::BindView(const int32_t index) {
+  const VIEW_RECT& rect = view_rects_[index];
+  glViewport(rect.x, rect.y, rect.width, rect.height);
+  glScissor(rect.x, rect.y, rect.width, rect.height);
+  glEnable(GL_SCISSOR_TEST);
+}
+
+void ViewAtlas::FinishScene() {
+  glDisable(GL_SCISSOR_TEST);
+  DiscardTransientDepth(policy_);
+}
+
+void ViewAtlas::BindDOF() {
+  LeiaRenderContext::GetInstance()->BindFramebuffer(fbo_dof_);
+  DiscardColor(policy_);
+}
+
+RENDER_TARGET_STATS ViewAtlas::EstimateStats() const {
+  RENDER_TARGET_STATS stats;
+  stats.framebuffer_binds = 2;
+  stats.clears = 1;
+  stats.resolve_bytes = SceneAndDOFResolveBytes(width_, height_, policy_);
+  return stats;
+}
+
+}  // namespace leia_helper
@@ -0,0 +1,137 @@
+/*
+ * Copyright 2018 Leia Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//--------------------------------------------------------------------------------
+// viewAtlas.h
+//--------------------------------------------------------------------------------
+#ifndef LEIA_HELPER_VIEWATLAS_H_
+#define LEIA_HELPER_VIEWATLAS_H_
+
+#include <vector>
+
+#include "attachmentPolicy.h"
+#include "gl3stub.h"
+
+namespace leia_helper {
+
+/******************************************************************
+ * Region of a view in the atlas, in pixels
+ */
+struct VIEW_RECT {
+  int32_t x;
+  int32_t y;
+  int32_t width;
+  int32_t height;
+};
+
+/******************************************************************
+ * Per frame framebuffer work of the scene and depth of field passes
+ * resolve_bytes is what a tiled GPU writes back to memory at the end of each
+ * render pass: colour and sampled depth for the scene, colour for the depth
+ * of field, on whole RESOLVE_TILE_SIZE tiles, in the formats of the
+ * ATTACHMENT_POLICY.
+ */
+struct RENDER_TARGET_STATS {
+  int32_t framebuffer_binds;
+  int32_t clears;
+  int64_t resolve_bytes;
+};
+
+const int32_t RESOLVE_TILE_SIZE = 16;
+
+/******************************************************************
+ * EstimateSeparateTargetStats()
+ * Cost of giving every view its own scene and depth of field framebuffers,
+ * like the per view loop does.
+ */
+RENDER_TARGET_STATS EstimateSeparateTargetStats(
+    const int32_t view_width, const int32_t view_height,
+    const int32_t num_views,
+    const ATTACHMENT_POLICY& policy = DEFAULT_ATTACHMENT_POLICY);
+
+/******************************************************************
+ * Render target holding every view as a region of one texture
+ * All views are drawn into one framebuffer: BindScene() binds it for a
+ * single clear, then BindView() restricts viewport and scissor to each view
+ * in turn. A second atlas of the same layout receives the depth of field
+ * result. On tiled GPUs this replaces one render pass per view, each with
+ * its own flush and resolve, with a single pass.
+ *
+ * GetViewRectTable() gives each view as vec4(offset, scale) in atlas UV
+ * space, the table the ATLAS post processing programs take.
+ *
+ * Formats follow the ATTACHMENT_POLICY given to Init(). Without
+ * depth_sampled the depth is a renderbuffer and GetDepthTexture() is 0:
+ * neither depth of field pass can run, the DOF atlas is still allocated for
+ * the caller's own passes.
+ */
+class ViewAtlas {
+ private:
+  GLuint fbo_;
+  GLuint color_texture_;
+  GLuint depth_texture_;
+
+  GLuint fbo_dof_;
+  GLuint texture_dof_;
+
+  ATTACHMENT_POLICY policy_;
+
+  int32_t width_;
+  int32_t height_;
+  std::vector<VIEW_RECT> view_rects_;
+  std::vector<GLfloat> view_rect_table_;
+
+ public:
+  ViewAtlas();
+  virtual ~ViewAtlas();
+
+  bool Init(const int32_t view_width, const int32_t view_height,
+            const int32_t num_views,
+            const ATTACHMENT_POLICY& policy = DEFAULT_ATTACHMENT_POLICY);
+  void Unload();
+
+  // Binds the framebuffer over the whole atlas, scissor test disabled
+  void BindScene();
+  // Viewport and scissor on one view, scissor test enabled
+  void BindView(const int32_t index);
+  // After the scene pass: discards a transient depth buffer
+  void FinishScene();
+  // Binds the DOF framebuffer, its colour discarded when the policy says so
+  void BindDOF();
+
+  RENDER_TARGET_STATS EstimateStats() const;
+
+  GLuint GetFramebuffer() const { return fbo_; }
+  GLuint GetColorTexture() const { return color_texture_; }
+  GLuint GetDepthTexture() const {
+    return policy_.depth_sampled ? depth_texture_ : 0;
+  }
+  GLuint GetDOFTexture() const { return texture_dof_; }
+  GLuint GetDOFFramebuffer() const { return fbo_dof_; }
+  int32_t GetWidth() const { return width_; }
+  int32_t GetHeight() const { return height_; }
+  const ATTACHMENT_POLICY& GetAttachmentPolicy() const { return policy_; }
+  int32_t GetNumViews() const { return (int32_t)view_rects_.size(); }
+  const VIEW_RECT& GetViewRect(const int32_t index) const {
+    return view_rects_[index];
+  }
+  const GLfloat* GetViewRectTable() const {
+    return view_rect_table_.empty() ? NULL : &view_rect_table_[0];
+  }
+};
+
+}  // namespace leia_helper
+#endif /* LEIA_HELPER_VIEWATLAS_H_ */
@@ -0,0 +1,143 @@
+/*
+ * Copyright 2018 Leia Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//--------------------------------------------------------------------------------
+// viewIndexMap.cpp
+// Periodic view index lookup texture for interlacing
+//--------------------------------------------------------------------------------
+#include "JNIHelper.h"
+#include "renderContext.h"
+#include "viewIndexMap.h"
+
+namespace leia_helper {
+
+static int32_t PositiveModulo(int32_t value, int32_t divisor) {
+  int32_t m = value % divisor;
+  return m < 0 ? m + divisor : m;
+}
+
+static int32_t FloorDivide(int32_t value, int32_t divisor) {
+  return (value - PositiveModulo(value, divisor)) / divisor;
+}
+
+static int32_t GreatestCommonDivisor(int32_t a, int32_t b) {
+  while (b) {
+    int32_t t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+void BuildViewIndexMap(const LeiaCameraData* data,
+                       const VIEW_INDEX_CALIBRATION& calibration,
+                       int32_t* width, int32_t* height,
+                       std::vector<uint8_t>* texels) {
+  const int32_t num_h = data->mNumViewsHorizontal > 0
+                            ? (int32_t)data->mNumViewsHorizontal
+                            : 1;
+  const int32_t num_v =
+      data->mNumViewsVertical > 0 ? (int32_t)data->mNumViewsVertical : 1;
+  const int32_t slant_den =
+      calibration.slant_denominator > 0 ? calibration.slant_denominator : 1;
+  const int32_t units_per_pixel = calibration.subpixel ? 3 : 1;
+
+  // The pattern repeats every num_h pixels, whatever the unit. Vertically it
+  // needs a whole number of slant steps, a multiple of num_v rows and a total
+  // shift that is a multiple of num_h
+  *width = num_h;
+  int32_t rows = slant_den / GreatestCommonDivisor(slant_den, num_v) * num_v;
+  int32_t period_shift = PositiveModulo(
+      calibration.slant_numerator * (rows / slant_den), num_h);
+  *height = rows * (num_h / GreatestCommonDivisor(num_h, period_shift));
+  texels->resize(*width * *height * 4);
+
+  for (int32_t y = 0; y < *height; ++y) {
+    int32_t shift = calibration.alignment_offset +
+                    FloorDivide(calibration.slant_numerator * y, slant_den);
+    int32_t row = (y % num_v) * num_h;
+    for (int32_t x = 0; x < *width; ++x) {
+      uint8_t* texel = &(*texels)[(y * *width + x) * 4];
+      for (int32_t c = 0; c < 3; ++c) {
+        int32_t unit =
+            x * units_per_pixel + (calibration.subpixel ? c : 0) + shift;
+        texel[c] = (uint8_t)(row + PositiveModulo(unit, num_h));
+      }
+      texel[3] = 0;
+    }
+  }
+}
+
+//--------------------------------------------------------------------------------
+// ViewIndexMap
+//--------------------------------------------------------------------------------
+ViewIndexMap::ViewIndexMap()
+    : texture_(0), num_views_horizontal_(0), num_views_vertical_(0) {
+  calibration_.alignment_offset = 0;
+  calibration_.slant_numerator = 0;
+  calibration_.slant_denominator = 1;
+  calibration_.subpixel = false;
+}
+
+ViewIndexMap::~ViewIndexMap() { Unload(); }
+
+bool ViewIndexMap::Update(const LeiaCameraData* data,
+                          const VIEW_INDEX_CALIBRATION& calibration) {
+  if (texture_ &&
+      num_views_horizontal_ == (int32_t)data->mNumViewsHorizontal &&
+      num_views_vertical_ == (int32_t)data->mNumViewsVertical &&
+      calibration_.alignment_offset == calibration.alignment_offset &&
+      calibration_.slant_numerator == calibration.slant_numerator &&
+      calibration_.slant_denominator == calibration.slant_denominator &&
+      calibration_.subpixel == calibration.subpixel)
+    return false;
+
+  num_views_horizontal_ = (int32_t)data->mNumViewsHorizontal;
+  num_views_vertical_ = (int32_t)data->mNumViewsVertical;
+  calibration_ = calibration;
+
+  int32_t width, height;
+  std::vector<uint8_t> texels;
+  BuildViewIndexMap(data, calibration, &width, &height, &texels);
+  LOGI("View index map %dx%d, offset %d, slant %d/%d, %s", width, height,
+       calibration.alignment_offset, calibration.slant_numerator,
+       calibration.slant_denominator,
+       calibration.subpixel ? "sub pixel" : "pixel");
+
+  Unload();
+  glGenTextures(1, &texture_);
+  glBindTexture(GL_TEXTURE_2D, texture_);
+  glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8UI, width, height);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA_INTEGER,
+                  GL_UNSIGNED_BYTE, &texels[0]);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  // Runs between passes, the old texture may have been bound on any unit
+  LeiaRenderContext::GetInstance()->Invalidate();
+  return true;
+}
+
+void ViewIndexMap::Unload() {
+  if (texture_) {
+    glDeleteTextures(1, &texture_);
+    texture_ = 0;
+  }
+}
+
+}  // namespace leia_helper
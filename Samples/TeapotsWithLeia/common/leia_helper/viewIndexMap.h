@@ -0,0 +1,90 @@
+/*
+ * Copyright 2018 Leia Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//--------------------------------------------------------------------------------
+// viewIndexMap.h
+//--------------------------------------------------------------------------------
+#ifndef LEIA_HELPER_VIEWINDEXMAP_H_
+#define LEIA_HELPER_VIEWINDEXMAP_H_
+
+#include <vector>
+
+#include "gl3stub.h"
+#include "LeiaCameraViews.h"
+
+namespace leia_helper {
+
+/******************************************************************
+ * Panel calibration the view index map is built from
+ *
+ * alignment_offset: shift of the view pattern, in pixels, or in sub pixels
+ *                   when subpixel is set
+ * slant_numerator / slant_denominator: horizontal shift of the pattern per
+ *                   screen row, in the same unit. 0 / 1 for vertical lenses
+ * subpixel: assign a view to each R, G and B stripe instead of whole pixels
+ */
+struct VIEW_INDEX_CALIBRATION {
+  int32_t alignment_offset;
+  int32_t slant_numerator;
+  int32_t slant_denominator;
+  bool subpixel;
+};
+
+/******************************************************************
+ * BuildViewIndexMap()
+ * Fills the periodic tile of view array layers, RGBA8 per pixel, one layer
+ * per colour channel. The tile is mNumViewsHorizontal pixels wide and as
+ * many rows as the slant and mNumViewsVertical need to repeat, pixel (x, y)
+ * of the screen uses texel (x mod width, y mod height).
+ *
+ * arguments:
+ *  in: data, view layout
+ *  in: calibration, panel calibration
+ *  out: width, height, tile size
+ *  out: texels, width * height * 4 layer indices
+ */
+void BuildViewIndexMap(const LeiaCameraData* data,
+                       const VIEW_INDEX_CALIBRATION& calibration,
+                       int32_t* width, int32_t* height,
+                       std::vector<uint8_t>* texels);
+
+/******************************************************************
+ * View index lookup texture (GL_RGBA8UI) for the indexed interlacing passes
+ * Update() is cheap when nothing changed, it can be called every frame, the
+ * texture is only rebuilt when the view layout or calibration changes. No
+ * program needs to be rebuilt on recalibration.
+ */
+class ViewIndexMap {
+ private:
+  GLuint texture_;
+  int32_t num_views_horizontal_;
+  int32_t num_views_vertical_;
+  VIEW_INDEX_CALIBRATION calibration_;
+
+ public:
+  ViewIndexMap();
+  virtual ~ViewIndexMap();
+
+  // Returns true when the texture has been (re)built
+  bool Update(const LeiaCameraData* data,
+              const VIEW_INDEX_CALIBRATION& calibration);
+  void Unload();
+
+  GLuint GetTexture() const { return texture_; }
+};
+
+}  // namespace leia_helper
+#endif /* LEIA_HELPER_VIEWINDEXMAP_H_ */
@@ -0,0 +1,106 @@
+/*
+ * Copyright 2018 Leia Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//--------------------------------------------------------------------------------
+// viewSynthesis.cpp
+// Source views of the depth image based view synthesis
+//--------------------------------------------------------------------------------
+#include <math.h>
+
+#include "JNIHelper.h"
+#include "renderContext.h"
+#include "renderTargetPool.h"
+#include "viewSynthesis.h"
+
+namespace leia_helper {
+
+void InterpolateViewMatrix(const LeiaCameraView* views, const int32_t num_views,
+                           const float position, GLfloat* matrix) {
+  float clamped = fminf(fmaxf(position, 0.0f), (float)(num_views - 1));
+  int32_t left = (int32_t)floorf(clamped);
+  int32_t right = left + 1 < num_views ? left + 1 : left;
+  float t = clamped - left;
+  for (int32_t i = 0; i < 16; ++i) {
+    matrix[i] = views[left].matrix[i] +
+                t * (views[right].matrix[i] - views[left].matrix[i]);
+  }
+}
+
+//--------------------------------------------------------------------------------
+// ViewSynthesisTarget
+//--------------------------------------------------------------------------------
+ViewSynthesisTarget::ViewSynthesisTarget()
+    : color_texture_(0), depth_texture_(0), width_(0), height_(0) {
+  for (int32_t i = 0; i < VIEW_SYNTHESIS_MAX_SOURCES; ++i) fbos_[i] = 0;
+}
+
+ViewSynthesisTarget::~ViewSynthesisTarget() { Unload(); }
+
+static GLuint CreateSourceArray(int32_t width, int32_t height,
+                                GLenum internal_format) {
+  RENDER_TARGET_DESC desc = {width, height, VIEW_SYNTHESIS_MAX_SOURCES,
+                             internal_format,
+                             RENDER_TARGET_USAGE_TEXTURE_ARRAY};
+  return RenderTargetPool::GetInstance()->AcquireTexture(desc);
+}
+
+bool ViewSynthesisTarget::Init(const int32_t width, const int32_t height) {
+  Unload();
+  width_ = width;
+  height_ = height;
+
+  color_texture_ = CreateSourceArray(width, height, GL_RGBA8);
+  depth_texture_ = CreateSourceArray(width, height, GL_DEPTH_COMPONENT32F);
+
+  GLenum attachment = GL_COLOR_ATTACHMENT0;
+  glGenFramebuffers(VIEW_SYNTHESIS_MAX_SOURCES, fbos_);
+  for (int32_t i = 0; i < VIEW_SYNTHESIS_MAX_SOURCES; ++i) {
+    glBindFramebuffer(GL_FRAMEBUFFER, fbos_[i]);
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                              color_texture_, 0, i);
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                              depth_texture_, 0, i);
+    glDrawBuffers(1, &attachment);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+      LOGE("View synthesis source FBO %d is incomplete: 0x%x", i, status);
+      Unload();
+      return false;
+    }
+  }
+
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  return true;
+}
+
+void ViewSynthesisTarget::Unload() {
+  if (fbos_[0]) {
+    glDeleteFramebuffers(VIEW_SYNTHESIS_MAX_SOURCES, fbos_);
+    for (int32_t i = 0; i < VIEW_SYNTHESIS_MAX_SOURCES; ++i) fbos_[i] = 0;
+  }
+  RenderTargetPool* pool = RenderTargetPool::GetInstance();
+  pool->ReleaseTexture(color_texture_);
+  pool->ReleaseTexture(depth_texture_);
+  color_texture_ = 0;
+  depth_texture_ = 0;
+}
+
+void ViewSynthesisTarget::BindSource(const int32_t index) {
+  LeiaRenderContext::GetInstance()->BindFramebuffer(fbos_[index]);
+  glViewport(0, 0, width_, height_);
+}
+
+}  // namespace leia_helper
@@ -0,0 +1,76 @@
+/*
+ * Copyright 2018 Leia Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//--------------------------------------------------------------------------------
+// viewSynthesis.h
+//--------------------------------------------------------------------------------
+#ifndef LEIA_HELPER_VIEWSYNTHESIS_H_
+#define LEIA_HELPER_VIEWSYNTHESIS_H_
+
+#include "gl3stub.h"
+#include "LeiaCameraViews.h"
+#include "cpuViewSynthesis.h"
+
+namespace leia_helper {
+
+/******************************************************************
+ * InterpolateViewMatrix()
+ * Projection of a camera at a fractional view position in a row of views,
+ * e.g. 1.5 for the centre of 4 views. Leia views only differ by a horizontal
+ * offset and the matching shear, both linear in the position, so the blend of
+ * the two neighbouring matrices is exact.
+ *
+ * arguments:
+ *  in: views, row of num_views views from leiaCalculateViews()
+ *  in: position, in [0, num_views - 1]
+ *  out: matrix, 16 floats
+ */
+void InterpolateViewMatrix(const LeiaCameraView* views, const int32_t num_views,
+                           const float position, GLfloat* matrix);
+
+/******************************************************************
+ * Render target of the view synthesis source views
+ * Colour and depth of up to VIEW_SYNTHESIS_MAX_SOURCES views in the layers of
+ * two GL_TEXTURE_2D_ARRAY, one framebuffer per layer. Render source i after
+ * BindSource(i) with the projection from InterpolateViewMatrix() at
+ * VIEW_SYNTHESIS_PARAMS::source_positions[i], then run ViewSynthesisAtlas().
+ */
+class ViewSynthesisTarget {
+ private:
+  GLuint fbos_[VIEW_SYNTHESIS_MAX_SOURCES];
+  GLuint color_texture_;
+  GLuint depth_texture_;
+
+  int32_t width_;
+  int32_t height_;
+
+ public:
+  ViewSynthesisTarget();
+  virtual ~ViewSynthesisTarget();
+
+  bool Init(const int32_t width, const int32_t height);
+  void Unload();
+
+  void BindSource(const int32_t index);
+
+  GLuint GetColorTexture() const { return color_texture_; }
+  GLuint GetDepthTexture() const { return depth_texture_; }
+  int32_t GetWidth() const { return width_; }
+  int32_t GetHeight() const { return height_; }
+};
+
+}  // namespace leia_helper
+#endif /* LEIA_HELPER_VIEWSYNTHESIS_H_ */
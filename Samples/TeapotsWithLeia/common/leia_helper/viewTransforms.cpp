@@ -0,0 +1,260 @@
+/*
+ * Copyright 2018 Leia Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//--------------------------------------------------------------------------------
+// viewTransforms.cpp
+// Batched per view model view projection matrices and instance transforms
+//--------------------------------------------------------------------------------
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define LEIA_HELPER_X86 1
+#endif
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#define LEIA_HELPER_NEON 1
+#endif
+
+#include "cpuParallel.h"
+#include "viewTransforms.h"
+
+namespace leia_helper {
+
+// Models per chunk, a chunk of model views stays in L1 across the views
+static const int32_t MODEL_CHUNK = 128;
+// Threads are only started for this many models each
+static const int32_t MIN_MODELS_PER_THREAD = 2048;
+
+//--------------------------------------------------------------------------------
+// MatrixBuffer
+//--------------------------------------------------------------------------------
+MatrixBuffer::MatrixBuffer() : matrices_(NULL), count_(0), capacity_(0) {}
+
+MatrixBuffer::~MatrixBuffer() { Unload(); }
+
+bool MatrixBuffer::Resize(const int32_t count) {
+  if (count > capacity_) {
+    void* matrices = NULL;
+    if (posix_memalign(&matrices, MATRIX_ALIGNMENT,
+                       (size_t)count * 16 * sizeof(float)) != 0)
+      return false;
+    if (matrices_) {
+      memcpy(matrices, matrices_, (size_t)count_ * 16 * sizeof(float));
+      free(matrices_);
+    }
+    matrices_ = (float*)matrices;
+    capacity_ = count;
+  }
+  count_ = count;
+  return true;
+}
+
+void MatrixBuffer::Unload() {
+  free(matrices_);
+  matrices_ = NULL;
+  count_ = 0;
+  capacity_ = 0;
+}
+
+//--------------------------------------------------------------------------------
+// Kernels
+// Column c of the product is p[0] * m[c][0] + p[1] * m[c][1] + p[2] * m[c][2]
+// + p[3] * m[c][3], p[k] being column k of the projection, summed left to
+// right like Mat4::operator*
+//--------------------------------------------------------------------------------
+static void MultiplyScalar(const float* p, const float* m, int32_t count,
+                           float* out) {
+  for (int32_t i = 0; i < count; ++i, m += 16, out += 16) {
+    for (int32_t c = 0; c < 4; ++c) {
+      for (int32_t r = 0; r < 4; ++r) {
+        out[c * 4 + r] = p[r] * m[c * 4] + p[4 + r] * m[c * 4 + 1] +
+                         p[8 + r] * m[c * 4 + 2] + p[12 + r] * m[c * 4 + 3];
+      }
+    }
+  }
+}
+
+#if defined(LEIA_HELPER_X86)
+static void MultiplySse2(const float* p, const float* m, int32_t count,
+                         float* out) {
+  const __m128 p0 = _mm_loadu_ps(p);
+  const __m128 p1 = _mm_loadu_ps(p + 4);
+  const __m128 p2 = _mm_loadu_ps(p + 8);
+  const __m128 p3 = _mm_loadu_ps(p + 12);
+  for (int32_t i = 0; i < count; ++i, m += 16, out += 16) {
+    for (int32_t c = 0; c < 4; ++c) {
+      const __m128 v = _mm_loadu_ps(m + c * 4);
+      __m128 col = _mm_mul_ps(p0, _mm_shuffle_ps(v, v, 0x00));
+      col = _mm_add_ps(col, _mm_mul_ps(p1, _mm_shuffle_ps(v, v, 0x55)));
+      col = _mm_add_ps(col, _mm_mul_ps(p2, _mm_shuffle_ps(v, v, 0xaa)));
+      col = _mm_add_ps(col, _mm_mul_ps(p3, _mm_shuffle_ps(v, v, 0xff)));
+      _mm_store_ps(out + c * 4, col);
+    }
+  }
+}
+#endif
+
+#if defined(LEIA_HELPER_NEON)
+static void MultiplyNeon(const float* p, const float* m, int32_t count,
+                         float* out) {
+  const float32x4_t p0 = vld1q_f32(p);
+  const float32x4_t p1 = vld1q_f32(p + 4);
+  const float32x4_t p2 = vld1q_f32(p + 8);
+  const float32x4_t p3 = vld1q_f32(p + 12);
+  for (int32_t i = 0; i < count; ++i, m += 16, out += 16) {
+    for (int32_t c = 0; c < 4; ++c) {
+      // Separate multiply and add, vfmaq would round differently
+      const float32x4_t v = vld1q_f32(m + c * 4);
+      float32x4_t col = vmulq_laneq_f32(p0, v, 0);
+      col = vaddq_f32(col, vmulq_laneq_f32(p1, v, 1));
+      col = vaddq_f32(col, vmulq_laneq_f32(p2, v, 2));
+      col = vaddq_f32(col, vmulq_laneq_f32(p3, v, 3));
+      vst1q_f32(out + c * 4, col);
+    }
+  }
+}
+#endif
+
+typedef void (*MULTIPLY_KERNEL)(const float*, const float*, int32_t, float*);
+
+static MULTIPLY_KERNEL GetKernel(const CPU_ISA isa) {
+  switch (isa) {
+#if defined(LEIA_HELPER_X86)
+    case CPU_ISA_SSE2:
+    case CPU_ISA_AVX2:
+      return MultiplySse2;
+#endif
+#if defined(LEIA_HELPER_NEON)
+    case CPU_ISA_NEON:
+      return MultiplyNeon;
+#endif
+    default:
+      return MultiplyScalar;
+  }
+}
+
+//--------------------------------------------------------------------------------
+// Batches
+//--------------------------------------------------------------------------------
+void MultiplyViewMatrices(const float* projections,
+                          const int32_t projection_stride,
+                          const int32_t num_views, const float* model_views,
+                          const int32_t num_models, float* mvps,
+                          const CPU_ISA isa, int32_t num_threads) {
+  const MULTIPLY_KERNEL kernel = GetKernel(isa);
+  ParallelRanges(num_models, num_threads, MIN_MODELS_PER_THREAD,
+                 [&](int32_t begin, int32_t end) {
+    for (int32_t chunk = begin; chunk < end; chunk += MODEL_CHUNK) {
+      int32_t count = end - chunk < MODEL_CHUNK ? end - chunk : MODEL_CHUNK;
+      for (int32_t view = 0; view < num_views; ++view) {
+        kernel(projections + view * projection_stride,
+               model_views + (size_t)chunk * 16, count,
+               mvps + ((size_t)view * num_models + chunk) * 16);
+      }
+    }
+  });
+}
+
+void MultiplyViewMatrices(const LeiaCameraView* views, const int32_t num_views,
+                          const float* model_views, const int32_t num_models,
+                          float* mvps, const CPU_ISA isa, int32_t num_threads) {
+  MultiplyViewMatrices(views[0].matrix,
+                       sizeof(LeiaCameraView) / sizeof(views[0].matrix[0]),
+                       num_views, model_views, num_models, mvps, isa,
+                       num_threads);
+}
+
+//--------------------------------------------------------------------------------
+// InstanceTransforms
+//--------------------------------------------------------------------------------
+InstanceTransforms::InstanceTransforms() {}
+
+InstanceTransforms::~InstanceTransforms() {}
+
+void InstanceTransforms::Resize(const int32_t count) {
+  position_x_.resize(count, 0.0f);
+  position_y_.resize(count, 0.0f);
+  position_z_.resize(count, 0.0f);
+  angle_x_.resize(count, 0.0f);
+  angle_y_.resize(count, 0.0f);
+  speed_x_.resize(count, 0.0f);
+  speed_y_.resize(count, 0.0f);
+}
+
+void InstanceTransforms::Set(const int32_t index, const float x, const float y,
+                             const float z, const float angle_x,
+                             const float angle_y, const float speed_x,
+                             const float speed_y) {
+  position_x_[index] = x;
+  position_y_[index] = y;
+  position_z_[index] = z;
+  angle_x_[index] = angle_x;
+  angle_y_[index] = angle_y;
+  speed_x_[index] = speed_x;
+  speed_y_[index] = speed_y;
+}
+
+void InstanceTransforms::Update(const float* view, const float steps,
+                                MatrixBuffer* model_views,
+                                int32_t num_threads) {
+  const int32_t count = GetCount();
+  model_views->Resize(count);
+  if (!count) return;
+  float v[16];
+  memcpy(v, view, sizeof(v));
+  float* angle_x = &angle_x_[0];
+  float* angle_y = &angle_y_[0];
+  const float* speed_x = &speed_x_[0];
+  const float* speed_y = &speed_y_[0];
+  const float* position_x = &position_x_[0];
+  const float* position_y = &position_y_[0];
+  const float* position_z = &position_z_[0];
+  float* out = model_views->Get(0);
+
+  ParallelRanges(count, num_threads, MIN_MODELS_PER_THREAD,
+                 [&](int32_t begin, int32_t end) {
+    for (int32_t chunk = begin; chunk < end; chunk += MODEL_CHUNK) {
+      int32_t chunk_end = end - chunk < MODEL_CHUNK ? end : chunk + MODEL_CHUNK;
+      for (int32_t i = chunk; i < chunk_end; ++i) {
+        angle_x[i] += steps * speed_x[i];
+        angle_y[i] += steps * speed_y[i];
+      }
+      for (int32_t i = chunk; i < chunk_end; ++i) {
+        const float cx = cosf(angle_x[i]), sx = sinf(angle_x[i]);
+        const float cy = cosf(angle_y[i]), sy = sinf(angle_y[i]);
+        // Columns of Mat4::RotationX(x) * Mat4::RotationY(y)
+        const float r[9] = {cy, sx * sy, cx * sy, 0.0f, cx, -sx,
+                            -sy, sx * cy, cx * cy};
+        float* m = out + (size_t)i * 16;
+        for (int32_t c = 0; c < 3; ++c) {
+          for (int32_t row = 0; row < 4; ++row) {
+            m[c * 4 + row] = v[row] * r[c * 3] + v[4 + row] * r[c * 3 + 1] +
+                             v[8 + row] * r[c * 3 + 2];
+          }
+        }
+        for (int32_t row = 0; row < 4; ++row) {
+          m[12 + row] = v[row] * position_x[i] + v[4 + row] * position_y[i] +
+                        v[8 + row] * position_z[i] + v[12 + row];
+        }
+      }
+    }
+  });
+}
+
+}  // namespace leia_helper
@@ -0,0 +1,141 @@
+/*
+ * Copyright 2018 Leia Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//--------------------------------------------------------------------------------
+// viewTransforms.h
+//--------------------------------------------------------------------------------
+#ifndef LEIA_HELPER_VIEWTRANSFORMS_H_
+#define LEIA_HELPER_VIEWTRANSFORMS_H_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "LeiaCameraViews.h"
+#include "cpuInterlacer.h"
+
+namespace leia_helper {
+
+// Alignment of MatrixBuffer and of the output of MultiplyViewMatrices()
+const int32_t MATRIX_ALIGNMENT = 16;
+
+/******************************************************************
+ * Array of 4x4 column major matrices, MATRIX_ALIGNMENT aligned
+ * Contents are kept when growing, the storage is only reallocated when the
+ * count goes over the capacity.
+ */
+class MatrixBuffer {
+ private:
+  float* matrices_;
+  int32_t count_;
+  int32_t capacity_;
+
+  MatrixBuffer(const MatrixBuffer&);
+  MatrixBuffer& operator=(const MatrixBuffer&);
+
+ public:
+  MatrixBuffer();
+  virtual ~MatrixBuffer();
+
+  bool Resize(const int32_t count);
+  void Unload();
+
+  float* Get(const int32_t index) { return matrices_ + index * 16; }
+  const float* Get(const int32_t index) const { return matrices_ + index * 16; }
+  int32_t GetCount() const { return count_; }
+};
+
+/******************************************************************
+ * MultiplyViewMatrices()
+ * projection * model_view for every view and every model in one call:
+ *   mvps[(view * num_models + model) * 16] =
+ *       projections[view * projection_stride] * model_views[model * 16]
+ * The matrices of one view are contiguous, ready for a single upload.
+ *
+ * Every ISA gives the same bits as ndk_helper::Mat4::operator*, the sums
+ * run in the same order and nothing is fused. CPU_ISA_AVX2 runs the SSE2
+ * kernel, a 4x4 product has no 8 wide dimension.
+ *
+ * arguments:
+ *  in: projections, num_views matrices, projection_stride floats apart
+ *  in: model_views, num_models matrices, tightly packed, any alignment
+ *  out: mvps, num_views * num_models matrices, MATRIX_ALIGNMENT aligned
+ *  in: isa, instruction set, must be supported
+ *  in: num_threads, models are split across threads, 0 picks the core
+ *      count. Small batches stay on the calling thread.
+ */
+void MultiplyViewMatrices(const float* projections,
+                          const int32_t projection_stride,
+                          const int32_t num_views, const float* model_views,
+                          const int32_t num_models, float* mvps,
+                          const CPU_ISA isa, int32_t num_threads);
+
+/******************************************************************
+ * MultiplyViewMatrices()
+ * Same, with the projections of leiaCalculateViews(), views is the
+ * num_views long camera array in row order.
+ */
+void MultiplyViewMatrices(const LeiaCameraView* views, const int32_t num_views,
+                          const float* model_views, const int32_t num_models,
+                          float* mvps, const CPU_ISA isa, int32_t num_threads);
+
+/******************************************************************
+ * Spinning instances, a position, two angles and their speeds each, kept as
+ * structure of arrays
+ *
+ * Update() advances the angles by steps times their speed and writes the
+ * model view of every instance,
+ *   view * Mat4::Translation(position) * Mat4::RotationX(angle_x) *
+ *       Mat4::RotationY(angle_y)
+ * in chunks split across threads. The matrices are meant to be computed once
+ * per frame and read by every view.
+ */
+class InstanceTransforms {
+ private:
+  std::vector<float> position_x_;
+  std::vector<float> position_y_;
+  std::vector<float> position_z_;
+  std::vector<float> angle_x_;
+  std::vector<float> angle_y_;
+  std::vector<float> speed_x_;
+  std::vector<float> speed_y_;
+
+ public:
+  InstanceTransforms();
+  virtual ~InstanceTransforms();
+
+  // New instances are at the origin, still
+  void Resize(const int32_t count);
+  void Set(const int32_t index, const float x, const float y, const float z,
+           const float angle_x, const float angle_y, const float speed_x,
+           const float speed_y);
+
+  /******************************************************************
+   * arguments:
+   *  in: view, column major 4x4
+   *  in: steps, angle updates to apply, fractions allowed
+   *  out: model_views, resized to the instance count
+   *  in: num_threads, 0 picks the core count. Small counts stay on the
+   *      calling thread.
+   */
+  void Update(const float* view, const float steps, MatrixBuffer* model_views,
+              int32_t num_threads);
+
+  int32_t GetCount() const { return (int32_t)position_x_.size(); }
+};
+
+}  // namespace leia_helper
+#endif /* LEIA_HELPER_VIEWTRANSFORMS_H_ */
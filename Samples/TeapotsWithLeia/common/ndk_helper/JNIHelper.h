@@ -16,6 +16,18 @@
 
 #pragma once
 
+#if !defined(__ANDROID__)
+// Desktop builds of the math code only need the logging, see host/
+#include <stdio.h>
+
+#define LOGI(...) \
+  ((void)(fprintf(stderr, "I: " __VA_ARGS__), fputc('\n', stderr)))
+#define LOGW(...) \
+  ((void)(fprintf(stderr, "W: " __VA_ARGS__), fputc('\n', stderr)))
+#define LOGE(...) \
+  ((void)(fprintf(stderr, "E: " __VA_ARGS__), fputc('\n', stderr)))
+#else
+
 #include <jni.h>
 #include <vector>
 #include <string>
@@ -328,3 +340,5 @@ class JNIHelper {
 };
 
 }  // namespace ndkHelper
+
+#endif  // !defined(__ANDROID__)
@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+#define GL3STUB_IMPLEMENTATION
 #include <EGL/egl.h>
 #include "gl3stub.h"
 
@@ -419,3 +420,11 @@ GL_APICALL void (*GL_APIENTRY glGetInternalformativ)(GLenum target,
                                                      GLenum pname,
                                                      GLsizei bufSize,
                                                      GLint* params);
+
+#ifdef GL3STUB_CAPTURE
+/* The OpenGL ES 2.0 pointers of gl3stubProcs.h, libGLESv2 until wrapped */
+#define GL3STUB_DEFINE_PROC(op, ret, name, params, args) \
+  GL_APICALL ret(*GL_APIENTRY gl3stub_gl##name) params = gl##name;
+GL3STUB_ES2_CAPTURE_PROCS(GL3STUB_DEFINE_PROC)
+#undef GL3STUB_DEFINE_PROC
+#endif
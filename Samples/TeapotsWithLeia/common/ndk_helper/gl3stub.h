@@ -654,6 +654,80 @@ extern GL_APICALL void (*GL_APIENTRY glGetInternalformativ)(
     GLenum target, GLenum internalformat, GLenum pname, GLsizei bufSize,
     GLint* params);
 
+/* GL3STUB_CAPTURE builds call the OpenGL ES 2.0 entry points of
+ * gl3stubProcs.h through pointers too, see leia_helper/glCapture.h. They
+ * point to the libGLESv2 functions until a capture wraps them. */
+#ifdef GL3STUB_CAPTURE
+#include "gl3stubProcs.h"
+
+#define GL3STUB_ES3_POINTER(name) gl##name
+#define GL3STUB_DECLARE_PROC(op, ret, name, params, args) \
+  extern GL_APICALL ret(*GL_APIENTRY gl3stub_gl##name) params;
+GL3STUB_ES2_CAPTURE_PROCS(GL3STUB_DECLARE_PROC)
+#undef GL3STUB_DECLARE_PROC
+
+/* gl3stub.cpp defines the pointers with the names of the functions */
+#ifndef GL3STUB_IMPLEMENTATION
+#define glActiveTexture gl3stub_glActiveTexture
+#define glAttachShader gl3stub_glAttachShader
+#define glBindAttribLocation gl3stub_glBindAttribLocation
+#define glBindBuffer gl3stub_glBindBuffer
+#define glBindFramebuffer gl3stub_glBindFramebuffer
+#define glBindRenderbuffer gl3stub_glBindRenderbuffer
+#define glBindTexture gl3stub_glBindTexture
+#define glBufferData gl3stub_glBufferData
+#define glBufferSubData gl3stub_glBufferSubData
+#define glClear gl3stub_glClear
+#define glClearColor gl3stub_glClearColor
+#define glClearDepthf gl3stub_glClearDepthf
+#define glCompileShader gl3stub_glCompileShader
+#define glCreateProgram gl3stub_glCreateProgram
+#define glCreateShader gl3stub_glCreateShader
+#define glDeleteBuffers gl3stub_glDeleteBuffers
+#define glDeleteFramebuffers gl3stub_glDeleteFramebuffers
+#define glDeleteProgram gl3stub_glDeleteProgram
+#define glDeleteRenderbuffers gl3stub_glDeleteRenderbuffers
+#define glDeleteShader gl3stub_glDeleteShader
+#define glDeleteTextures gl3stub_glDeleteTextures
+#define glDepthFunc gl3stub_glDepthFunc
+#define glDepthMask gl3stub_glDepthMask
+#define glDisable gl3stub_glDisable
+#define glDisableVertexAttribArray gl3stub_glDisableVertexAttribArray
+#define glDrawArrays gl3stub_glDrawArrays
+#define glDrawElements gl3stub_glDrawElements
+#define glEnable gl3stub_glEnable
+#define glEnableVertexAttribArray gl3stub_glEnableVertexAttribArray
+#define glFramebufferRenderbuffer gl3stub_glFramebufferRenderbuffer
+#define glFramebufferTexture2D gl3stub_glFramebufferTexture2D
+#define glFrontFace gl3stub_glFrontFace
+#define glGenBuffers gl3stub_glGenBuffers
+#define glGenFramebuffers gl3stub_glGenFramebuffers
+#define glGenRenderbuffers gl3stub_glGenRenderbuffers
+#define glGenTextures gl3stub_glGenTextures
+#define glGenerateMipmap gl3stub_glGenerateMipmap
+#define glGetUniformLocation gl3stub_glGetUniformLocation
+#define glLinkProgram gl3stub_glLinkProgram
+#define glPixelStorei gl3stub_glPixelStorei
+#define glRenderbufferStorage gl3stub_glRenderbufferStorage
+#define glScissor gl3stub_glScissor
+#define glShaderSource gl3stub_glShaderSource
+#define glTexParameterf gl3stub_glTexParameterf
+#define glTexParameteri gl3stub_glTexParameteri
+#define glTexSubImage2D gl3stub_glTexSubImage2D
+#define glUniform1f gl3stub_glUniform1f
+#define glUniform1fv gl3stub_glUniform1fv
+#define glUniform1i gl3stub_glUniform1i
+#define glUniform2f gl3stub_glUniform2f
+#define glUniform3f gl3stub_glUniform3f
+#define glUniform4f gl3stub_glUniform4f
+#define glUniform4fv gl3stub_glUniform4fv
+#define glUniformMatrix4fv gl3stub_glUniformMatrix4fv
+#define glUseProgram gl3stub_glUseProgram
+#define glVertexAttribPointer gl3stub_glVertexAttribPointer
+#define glViewport gl3stub_glViewport
+#endif
+#endif
+
 #ifdef __cplusplus
 }
 #endif
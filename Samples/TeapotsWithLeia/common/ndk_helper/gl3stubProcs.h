@@ -0,0 +1,206 @@
+/*
+ * Copyright 2018 Leia Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Entry points GL3STUB_CAPTURE builds call through gl3stub pointers, so that
+ * leia_helper::StartGlCapture() can wrap them. These are the calls the
+ * samples and leia_helper make, queries that create nothing are left out.
+ *
+ *   X(OP, return type, name without gl, (parameters), (arguments))
+ *
+ * The OpenGL ES 3.0 entry points are the pointers gl3stubInit() loads,
+ * GL3STUB_ES3_POINTER(name) names them. The OpenGL ES 2.0 ones get the
+ * gl3stub_gl<name> pointers gl3stub.cpp defines, gl3stub.h redirects the
+ * calls to them.
+ */
+#ifndef GL3STUB_PROCS_H_
+#define GL3STUB_PROCS_H_
+
+#define GL3STUB_ES2_CAPTURE_PROCS(X)                                          \
+  X(ACTIVE_TEXTURE, void, ActiveTexture, (GLenum texture), (texture))        \
+  X(ATTACH_SHADER, void, AttachShader, (GLuint program, GLuint shader),      \
+    (program, shader))                                                       \
+  X(BIND_ATTRIB_LOCATION, void, BindAttribLocation,                          \
+    (GLuint program, GLuint index, const GLchar* name),                      \
+    (program, index, name))                                                  \
+  X(BIND_BUFFER, void, BindBuffer, (GLenum target, GLuint buffer),           \
+    (target, buffer))                                                        \
+  X(BIND_FRAMEBUFFER, void, BindFramebuffer,                                 \
+    (GLenum target, GLuint framebuffer), (target, framebuffer))              \
+  X(BIND_RENDERBUFFER, void, BindRenderbuffer,                               \
+    (GLenum target, GLuint renderbuffer), (target, renderbuffer))            \
+  X(BIND_TEXTURE, void, BindTexture, (GLenum target, GLuint texture),        \
+    (target, texture))                                                       \
+  X(BUFFER_DATA, void, BufferData,                                           \
+    (GLenum target, GLsizeiptr size, const void* data, GLenum usage),        \
+    (target, size, data, usage))                                             \
+  X(BUFFER_SUB_DATA, void, BufferSubData,                                    \
+    (GLenum target, GLintptr offset, GLsizeiptr size, const void* data),     \
+    (target, offset, size, data))                                            \
+  X(CLEAR, void, Clear, (GLbitfield mask), (mask))                           \
+  X(CLEAR_COLOR, void, ClearColor,                                           \
+    (GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha),               \
+    (red, green, blue, alpha))                                               \
+  X(CLEAR_DEPTHF, void, ClearDepthf, (GLfloat depth), (depth))               \
+  X(COMPILE_SHADER, void, CompileShader, (GLuint shader), (shader))          \
+  X(CREATE_PROGRAM, GLuint, CreateProgram, (void), ())                       \
+  X(CREATE_SHADER, GLuint, CreateShader, (GLenum type), (type))              \
+  X(DELETE_BUFFERS, void, DeleteBuffers, (GLsizei n, const GLuint* buffers), \
+    (n, buffers))                                                            \
+  X(DELETE_FRAMEBUFFERS, void, DeleteFramebuffers,                           \
+    (GLsizei n, const GLuint* framebuffers), (n, framebuffers))              \
+  X(DELETE_PROGRAM, void, DeleteProgram, (GLuint program), (program))        \
+  X(DELETE_RENDERBUFFERS, void, DeleteRenderbuffers,                         \
+    (GLsizei n, const GLuint* renderbuffers), (n, renderbuffers))            \
+  X(DELETE_SHADER, void, DeleteShader, (GLuint shader), (shader))            \
+  X(DELETE_TEXTURES, void, DeleteTextures,                                   \
+    (GLsizei n, const GLuint* textures), (n, textures))                      \
+  X(DEPTH_FUNC, void, DepthFunc, (GLenum func), (func))                      \
+  X(DEPTH_MASK, void, DepthMask, (GLboolean flag), (flag))                   \
+  X(DISABLE, void, Disable, (GLenum cap), (cap))                             \
+  X(DISABLE_VERTEX_ATTRIB_ARRAY, void, DisableVertexAttribArray,             \
+    (GLuint index), (index))                                                 \
+  X(DRAW_ARRAYS, void, DrawArrays, (GLenum mode, GLint first, GLsizei count), \
+    (mode, first, count))                                                    \
+  X(DRAW_ELEMENTS, void, DrawElements,                                       \
+    (GLenum mode, GLsizei count, GLenum type, const void* indices),          \
+    (mode, count, type, indices))                                            \
+  X(ENABLE, void, Enable, (GLenum cap), (cap))                               \
+  X(ENABLE_VERTEX_ATTRIB_ARRAY, void, EnableVertexAttribArray,               \
+    (GLuint index), (index))                                                 \
+  X(FRAMEBUFFER_RENDERBUFFER, void, FramebufferRenderbuffer,                 \
+    (GLenum target, GLenum attachment, GLenum renderbuffertarget,            \
+     GLuint renderbuffer),                                                   \
+    (target, attachment, renderbuffertarget, renderbuffer))                  \
+  X(FRAMEBUFFER_TEXTURE_2D, void, FramebufferTexture2D,                      \
+    (GLenum target, GLenum attachment, GLenum textarget, GLuint texture,     \
+     GLint level),                                                           \
+    (target, attachment, textarget, texture, level))                         \
+  X(FRONT_FACE, void, FrontFace, (GLenum mode), (mode))                      \
+  X(GEN_BUFFERS, void, GenBuffers, (GLsizei n, GLuint* buffers),             \
+    (n, buffers))                                                            \
+  X(GEN_FRAMEBUFFERS, void, GenFramebuffers,                                 \
+    (GLsizei n, GLuint* framebuffers), (n, framebuffers))                    \
+  X(GEN_RENDERBUFFERS, void, GenRenderbuffers,                               \
+    (GLsizei n, GLuint* renderbuffers), (n, renderbuffers))                  \
+  X(GEN_TEXTURES, void, GenTextures, (GLsizei n, GLuint* textures),          \
+    (n, textures))                                                           \
+  X(GENERATE_MIPMAP, void, GenerateMipmap, (GLenum target), (target))        \
+  X(GET_UNIFORM_LOCATION, GLint, GetUniformLocation,                         \
+    (GLuint program, const GLchar* name), (program, name))                   \
+  X(LINK_PROGRAM, void, LinkProgram, (GLuint program), (program))            \
+  X(PIXEL_STOREI, void, PixelStorei, (GLenum pname, GLint param),            \
+    (pname, param))                                                          \
+  X(RENDERBUFFER_STORAGE, void, RenderbufferStorage,                         \
+    (GLenum target, GLenum internalformat, GLsizei width, GLsizei height),   \
+    (target, internalformat, width, height))                                 \
+  X(SCISSOR, void, Scissor,                                                  \
+    (GLint x, GLint y, GLsizei width, GLsizei height),                       \
+    (x, y, width, height))                                                   \
+  X(SHADER_SOURCE, void, ShaderSource,                                       \
+    (GLuint shader, GLsizei count, const GLchar* const* string,              \
+     const GLint* length),                                                   \
+    (shader, count, string, length))                                         \
+  X(TEX_PARAMETERF, void, TexParameterf,                                     \
+    (GLenum target, GLenum pname, GLfloat param), (target, pname, param))    \
+  X(TEX_PARAMETERI, void, TexParameteri,                                     \
+    (GLenum target, GLenum pname, GLint param), (target, pname, param))      \
+  X(TEX_SUB_IMAGE_2D, void, TexSubImage2D,                                   \
+    (GLenum target, GLint level, GLint xoffset, GLint yoffset,               \
+     GLsizei width, GLsizei height, GLenum format, GLenum type,              \
+     const void* pixels),                                                    \
+    (target, level, xoffset, yoffset, width, height, format, type, pixels))  \
+  X(UNIFORM_1F, void, Uniform1f, (GLint location, GLfloat v0),               \
+    (location, v0))                                                          \
+  X(UNIFORM_1FV, void, Uniform1fv,                                           \
+    (GLint location, GLsizei count, const GLfloat* value),                   \
+    (location, count, value))                                                \
+  X(UNIFORM_1I, void, Uniform1i, (GLint location, GLint v0), (location, v0)) \
+  X(UNIFORM_2F, void, Uniform2f, (GLint location, GLfloat v0, GLfloat v1),   \
+    (location, v0, v1))                                                      \
+  X(UNIFORM_3F, void, Uniform3f,                                             \
+    (GLint location, GLfloat v0, GLfloat v1, GLfloat v2),                    \
+    (location, v0, v1, v2))                                                  \
+  X(UNIFORM_4F, void, Uniform4f,                                             \
+    (GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3),        \
+    (location, v0, v1, v2, v3))                                              \
+  X(UNIFORM_4FV, void, Uniform4fv,                                           \
+    (GLint location, GLsizei count, const GLfloat* value),                   \
+    (location, count, value))                                                \
+  X(UNIFORM_MATRIX_4FV, void, UniformMatrix4fv,                              \
+    (GLint location, GLsizei count, GLboolean transpose,                     \
+     const GLfloat* value),                                                  \
+    (location, count, transpose, value))                                     \
+  X(USE_PROGRAM, void, UseProgram, (GLuint program), (program))              \
+  X(VERTEX_ATTRIB_POINTER, void, VertexAttribPointer,                        \
+    (GLuint index, GLint size, GLenum type, GLboolean normalized,            \
+     GLsizei stride, const void* pointer),                                   \
+    (index, size, type, normalized, stride, pointer))                        \
+  X(VIEWPORT, void, Viewport,                                                \
+    (GLint x, GLint y, GLsizei width, GLsizei height),                       \
+    (x, y, width, height))
+
+#define GL3STUB_ES3_CAPTURE_PROCS(X)                                          \
+  X(BIND_BUFFER_RANGE, void, BindBufferRange,                                \
+    (GLenum target, GLuint index, GLuint buffer, GLintptr offset,            \
+     GLsizeiptr size),                                                       \
+    (target, index, buffer, offset, size))                                   \
+  X(BIND_VERTEX_ARRAY, void, BindVertexArray, (GLuint array), (array))       \
+  X(DELETE_VERTEX_ARRAYS, void, DeleteVertexArrays,                          \
+    (GLsizei n, const GLuint* arrays), (n, arrays))                          \
+  X(DRAW_BUFFERS, void, DrawBuffers, (GLsizei n, const GLenum* bufs),        \
+    (n, bufs))                                                               \
+  X(DRAW_ELEMENTS_INSTANCED, void, DrawElementsInstanced,                    \
+    (GLenum mode, GLsizei count, GLenum type, const void* indices,           \
+     GLsizei instancecount),                                                 \
+    (mode, count, type, indices, instancecount))                             \
+  X(FRAMEBUFFER_TEXTURE_LAYER, void, FramebufferTextureLayer,                \
+    (GLenum target, GLenum attachment, GLuint texture, GLint level,          \
+     GLint layer),                                                           \
+    (target, attachment, texture, level, layer))                             \
+  X(GEN_VERTEX_ARRAYS, void, GenVertexArrays, (GLsizei n, GLuint* arrays),   \
+    (n, arrays))                                                             \
+  X(GET_UNIFORM_BLOCK_INDEX, GLuint, GetUniformBlockIndex,                   \
+    (GLuint program, const GLchar* uniformBlockName),                        \
+    (program, uniformBlockName))                                             \
+  X(INVALIDATE_FRAMEBUFFER, void, InvalidateFramebuffer,                     \
+    (GLenum target, GLsizei numAttachments, const GLenum* attachments),      \
+    (target, numAttachments, attachments))                                   \
+  X(MAP_BUFFER_RANGE, void*, MapBufferRange,                                 \
+    (GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access),  \
+    (target, offset, length, access))                                        \
+  X(PROGRAM_BINARY, void, ProgramBinary,                                     \
+    (GLuint program, GLenum binaryFormat, const void* binary,                \
+     GLsizei length),                                                        \
+    (program, binaryFormat, binary, length))                                 \
+  X(PROGRAM_PARAMETERI, void, ProgramParameteri,                             \
+    (GLuint program, GLenum pname, GLint value), (program, pname, value))    \
+  X(TEX_STORAGE_2D, void, TexStorage2D,                                      \
+    (GLenum target, GLsizei levels, GLenum internalformat, GLsizei width,    \
+     GLsizei height),                                                        \
+    (target, levels, internalformat, width, height))                         \
+  X(TEX_STORAGE_3D, void, TexStorage3D,                                      \
+    (GLenum target, GLsizei levels, GLenum internalformat, GLsizei width,    \
+     GLsizei height, GLsizei depth),                                         \
+    (target, levels, internalformat, width, height, depth))                  \
+  X(UNIFORM_BLOCK_BINDING, void, UniformBlockBinding,                        \
+    (GLuint program, GLuint uniformBlockIndex, GLuint uniformBlockBinding),  \
+    (program, uniformBlockIndex, uniformBlockBinding))                       \
+  X(UNMAP_BUFFER, GLboolean, UnmapBuffer, (GLenum target), (target))         \
+  X(VERTEX_ATTRIB_DIVISOR, void, VertexAttribDivisor,                        \
+    (GLuint index, GLuint divisor), (index, divisor))
+
+#endif /* GL3STUB_PROCS_H_ */
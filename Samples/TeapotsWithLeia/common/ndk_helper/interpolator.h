@@ -17,7 +17,6 @@
 #ifndef INTERPOLATOR_H_
 #define INTERPOLATOR_H_
 
-#include <jni.h>
 #include <errno.h>
 #include <time.h>
 #include "JNIHelper.h"
@@ -17,8 +17,9 @@
 #ifndef PERFMONITOR_H_
 #define PERFMONITOR_H_
 
-#include <jni.h>
 #include <errno.h>
+#include <stdint.h>
+#include <sys/time.h>
 #include <time.h>
 #include "JNIHelper.h"
 
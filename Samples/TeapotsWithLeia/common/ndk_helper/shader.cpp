@@ -24,9 +24,10 @@ namespace ndk_helper {
 
 #define DEBUG (1)
 
-bool shader::CompileShader(
-    GLuint *shader, const GLenum type, const char *str_file_name,
-    const std::map<std::string, std::string> &map_parameters) {
+bool shader::ReadShader(
+    const char *str_file_name,
+    const std::map<std::string, std::string> *map_parameters,
+    std::string *source) {
   std::vector<uint8_t> data;
   if (!JNIHelper::GetInstance()->ReadFile(str_file_name, &data)) {
     LOGI("Can not open a file:%s", str_file_name);
@@ -35,13 +36,15 @@ bool shader::CompileShader(
 
   const char REPLACEMENT_TAG = '*';
   // Fill-in parameters
-  std::string str(data.begin(), data.end());
+  std::string &str = *source;
+  str.assign(data.begin(), data.end());
+  if (!map_parameters) return true;
   std::string str_replacement_map(data.size(), ' ');
 
   std::map<std::string, std::string>::const_iterator it =
-      map_parameters.begin();
+      map_parameters->begin();
   std::map<std::string, std::string>::const_iterator itEnd =
-      map_parameters.end();
+      map_parameters->end();
   while (it != itEnd) {
     size_t pos = 0;
     while ((pos = str.find(it->first, pos)) != std::string::npos) {
@@ -60,6 +63,14 @@ bool shader::CompileShader(
     }
     it++;
   }
+  return true;
+}
+
+bool shader::CompileShader(
+    GLuint *shader, const GLenum type, const char *str_file_name,
+    const std::map<std::string, std::string> &map_parameters) {
+  std::string str;
+  if (!ReadShader(str_file_name, &map_parameters, &str)) return false;
 
   LOGI("Patched Shdader:\n%s", str.c_str());
 
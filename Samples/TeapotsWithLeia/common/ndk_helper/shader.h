@@ -95,6 +95,21 @@ bool CompileShader(GLuint *shader, const GLenum type, const char *strFileName);
 bool CompileShader(GLuint *shader, const GLenum type, const char *str_file_name,
                    const std::map<std::string, std::string> &map_parameters);
 
+/******************************************************************
+ * ReadShader() reads a shader source, patched like CompileShader() with
+ * std::map does, without compiling it.
+ *
+ * arguments:
+ *  in: str_file_name, filename
+ *  in: map_parameters, %KEY% -> %VALUE% replacements, or NULL
+ *  out: source, patched source
+ * return: true if the file could be read
+ *
+ */
+bool ReadShader(const char *str_file_name,
+                const std::map<std::string, std::string> *map_parameters,
+                std::string *source);
+
 /******************************************************************
  * LinkProgram()
  *
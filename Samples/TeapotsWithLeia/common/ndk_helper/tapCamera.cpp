@@ -119,7 +119,7 @@ void TapCamera::Update() {
 
   vec *= vec_tmp * vec_pinch_transform_factor_;
 
-  mat_transform_ = Mat4::Translation(vec);
+  mat_transform_ = Affine::Translation(vec);
 }
 
 void TapCamera::Update(const double time) {
@@ -163,11 +163,11 @@ void TapCamera::Update(const double time) {
 
   vec *= vec_tmp * vec_pinch_transform_factor_;
 
-  mat_transform_ = Mat4::Translation(vec);
+  mat_transform_ = Affine::Translation(vec);
 }
-Mat4& TapCamera::GetRotationMatrix() { return mat_rotation_; }
+Affine& TapCamera::GetRotationMatrix() { return mat_rotation_; }
 
-Mat4& TapCamera::GetTransformMatrix() { return mat_transform_; }
+Affine& TapCamera::GetTransformMatrix() { return mat_transform_; }
 
 void TapCamera::Reset(const bool bAnimate) {
   InitParameters();
@@ -203,7 +203,6 @@ void TapCamera::EndDrag() {
 
 void TapCamera::Drag(const Vec2& v) {
   if (!dragging_) return;
-  Vec2 checker = v;
 
   Vec2 vec = v * vec_flip_;
   vec_ball_now_ = vec;
@@ -17,7 +17,6 @@
 #pragma once
 #include <vector>
 #include <string>
-#include <GLES2/gl2.h>
 
 #include "JNIHelper.h"
 #include "vecmath.h"
@@ -70,8 +69,8 @@ class TapCamera {
   Vec2 vec_flip_;
   float flip_z_;
 
-  Mat4 mat_rotation_;
-  Mat4 mat_transform_;
+  Affine mat_rotation_;
+  Affine mat_transform_;
 
   Vec3 vec_pinch_transform_factor_;
 
@@ -88,8 +87,8 @@ class TapCamera {
   void Update();
   void Update(const double time);
 
-  Mat4& GetRotationMatrix();
-  Mat4& GetTransformMatrix();
+  Affine& GetRotationMatrix();
+  Affine& GetTransformMatrix();
 
   void BeginPinch(const Vec2& v1, const Vec2& v2);
   void EndPinch();
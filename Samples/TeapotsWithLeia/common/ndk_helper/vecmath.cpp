@@ -19,8 +19,157 @@
 //--------------------------------------------------------------------------------
 #include "vecmath.h"
 
+#if defined(VECMATH_SCALAR)
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define VECMATH_X86 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define VECMATH_NEON 1
+#endif
+
 namespace ndk_helper {
 
+//--------------------------------------------------------------------------------
+// Kernels
+// The SIMD versions sum in the order of the scalar ones and CMakeLists.txt
+// keeps the compiler from fusing multiply and add, every build gives the same
+// bits. Loads and stores are unaligned, see Mat4::f_.
+//--------------------------------------------------------------------------------
+#if defined(VECMATH_X86)
+// a * b, column c is a0 * b[c][0] + a1 * b[c][1] + a2 * b[c][2] +
+// a3 * b[c][3], ak being column k of a
+static void MultiplyMat4(const float* a, const float* b, float* out) {
+  const __m128 a0 = _mm_loadu_ps(a);
+  const __m128 a1 = _mm_loadu_ps(a + 4);
+  const __m128 a2 = _mm_loadu_ps(a + 8);
+  const __m128 a3 = _mm_loadu_ps(a + 12);
+  for (int32_t c = 0; c < 4; ++c) {
+    const __m128 v = _mm_loadu_ps(b + c * 4);
+    __m128 col = _mm_mul_ps(a0, _mm_shuffle_ps(v, v, 0x00));
+    col = _mm_add_ps(col, _mm_mul_ps(a1, _mm_shuffle_ps(v, v, 0x55)));
+    col = _mm_add_ps(col, _mm_mul_ps(a2, _mm_shuffle_ps(v, v, 0xaa)));
+    col = _mm_add_ps(col, _mm_mul_ps(a3, _mm_shuffle_ps(v, v, 0xff)));
+    _mm_storeu_ps(out + c * 4, col);
+  }
+}
+
+// 4 points m * (x, y, z, 1), x, y and z out
+static void TransformPoints4(const float* m, const float* x, const float* y,
+                             const float* z, float* const* out) {
+  const __m128 px = _mm_loadu_ps(x);
+  const __m128 py = _mm_loadu_ps(y);
+  const __m128 pz = _mm_loadu_ps(z);
+  for (int32_t r = 0; r < 3; ++r) {
+    __m128 v = _mm_mul_ps(px, _mm_set1_ps(m[r]));
+    v = _mm_add_ps(v, _mm_mul_ps(py, _mm_set1_ps(m[4 + r])));
+    v = _mm_add_ps(v, _mm_mul_ps(pz, _mm_set1_ps(m[8 + r])));
+    _mm_storeu_ps(out[r], _mm_add_ps(v, _mm_set1_ps(m[12 + r])));
+  }
+}
+
+#elif defined(VECMATH_NEON)
+// Separate multiply and add throughout, vmlaq and vfmaq would round
+// differently on some cores
+static void MultiplyMat4(const float* a, const float* b, float* out) {
+  const float32x4_t a0 = vld1q_f32(a);
+  const float32x4_t a1 = vld1q_f32(a + 4);
+  const float32x4_t a2 = vld1q_f32(a + 8);
+  const float32x4_t a3 = vld1q_f32(a + 12);
+  for (int32_t c = 0; c < 4; ++c) {
+    const float32x4_t v = vld1q_f32(b + c * 4);
+    const float32x2_t v01 = vget_low_f32(v);
+    const float32x2_t v23 = vget_high_f32(v);
+    float32x4_t col = vmulq_lane_f32(a0, v01, 0);
+    col = vaddq_f32(col, vmulq_lane_f32(a1, v01, 1));
+    col = vaddq_f32(col, vmulq_lane_f32(a2, v23, 0));
+    col = vaddq_f32(col, vmulq_lane_f32(a3, v23, 1));
+    vst1q_f32(out + c * 4, col);
+  }
+}
+
+static void TransformPoints4(const float* m, const float* x, const float* y,
+                             const float* z, float* const* out) {
+  const float32x4_t px = vld1q_f32(x);
+  const float32x4_t py = vld1q_f32(y);
+  const float32x4_t pz = vld1q_f32(z);
+  for (int32_t r = 0; r < 3; ++r) {
+    float32x4_t v = vmulq_n_f32(px, m[r]);
+    v = vaddq_f32(v, vmulq_n_f32(py, m[4 + r]));
+    v = vaddq_f32(v, vmulq_n_f32(pz, m[8 + r]));
+    vst1q_f32(out[r], vaddq_f32(v, vdupq_n_f32(m[12 + r])));
+  }
+}
+
+#else
+static void MultiplyMat4(const float* a, const float* b, float* out) {
+  for (int32_t c = 0; c < 4; ++c) {
+    for (int32_t r = 0; r < 4; ++r) {
+      out[c * 4 + r] = a[r] * b[c * 4] + a[4 + r] * b[c * 4 + 1] +
+                       a[8 + r] * b[c * 4 + 2] + a[12 + r] * b[c * 4 + 3];
+    }
+  }
+}
+
+static void TransformPoints4(const float* m, const float* x, const float* y,
+                             const float* z, float* const* out) {
+  for (int32_t k = 0; k < 4; ++k) {
+    for (int32_t r = 0; r < 3; ++r) {
+      out[r][k] = x[k] * m[r] + y[k] * m[4 + r] + z[k] * m[8 + r] + m[12 + r];
+    }
+  }
+}
+#endif
+
+// Scalar on every target: SSE2 versions measured no faster than what GCC -O3
+// makes of these loops, and LookAt slower, see host/vecmathBench.cpp
+// m * v
+static void TransformVec4(const float* m, const float* v, float* out) {
+  for (int32_t r = 0; r < 4; ++r) {
+    out[r] = v[0] * m[r] + v[1] * m[4 + r] + v[2] * m[8 + r] +
+             v[3] * m[12 + r];
+  }
+}
+
+// v * m
+static void TransformVec4Row(const float* v, const float* m, float* out) {
+  for (int32_t c = 0; c < 4; ++c) {
+    out[c] = v[0] * m[c * 4] + v[1] * m[c * 4 + 1] + v[2] * m[c * 4 + 2] +
+             v[3] * m[c * 4 + 3];
+  }
+}
+
+// m[12..15] += tx * m0 + ty * m1 + tz * m2
+static void PostTranslateMat4(float* m, const float tx, const float ty,
+                              const float tz) {
+  for (int32_t r = 0; r < 4; ++r) {
+    m[12 + r] += (tx * m[r]) + (ty * m[4 + r]) + (tz * m[8 + r]);
+  }
+}
+
+// Inverse of an affine m, det_1 is 1 / det of the upper 3x3
+static void InverseAffine(const float* m, const float det_1, float* out) {
+  out[0] = (m[5] * m[10] - m[9] * m[6]) * det_1;
+  out[1] = -(m[1] * m[10] - m[9] * m[2]) * det_1;
+  out[2] = (m[1] * m[6] - m[5] * m[2]) * det_1;
+  out[4] = -(m[4] * m[10] - m[8] * m[6]) * det_1;
+  out[5] = (m[0] * m[10] - m[8] * m[2]) * det_1;
+  out[6] = -(m[0] * m[6] - m[4] * m[2]) * det_1;
+  out[8] = (m[4] * m[9] - m[8] * m[5]) * det_1;
+  out[9] = -(m[0] * m[9] - m[8] * m[1]) * det_1;
+  out[10] = (m[0] * m[5] - m[4] * m[1]) * det_1;
+
+  /* Calculate -C * inverse(A) */
+  out[12] = -(m[12] * out[0] + m[13] * out[4] + m[14] * out[8]);
+  out[13] = -(m[12] * out[1] + m[13] * out[5] + m[14] * out[9]);
+  out[14] = -(m[12] * out[2] + m[13] * out[6] + m[14] * out[10]);
+
+  out[3] = 0.0f;
+  out[7] = 0.0f;
+  out[11] = 0.0f;
+  out[15] = 1.0f;
+}
+
 //--------------------------------------------------------------------------------
 // vec3
 //--------------------------------------------------------------------------------
@@ -34,13 +183,10 @@ Vec3::Vec3(const Vec4& vec) {
 // vec4
 //--------------------------------------------------------------------------------
 Vec4 Vec4::operator*(const Mat4& rhs) const {
-  Vec4 out;
-  out.x_ = x_ * rhs.f_[0] + y_ * rhs.f_[1] + z_ * rhs.f_[2] + w_ * rhs.f_[3];
-  out.y_ = x_ * rhs.f_[4] + y_ * rhs.f_[5] + z_ * rhs.f_[6] + w_ * rhs.f_[7];
-  out.z_ = x_ * rhs.f_[8] + y_ * rhs.f_[9] + z_ * rhs.f_[10] + w_ * rhs.f_[11];
-  out.w_ =
-      x_ * rhs.f_[12] + y_ * rhs.f_[13] + z_ * rhs.f_[14] + w_ * rhs.f_[15];
-  return out;
+  const float v[4] = {x_, y_, z_, w_};
+  float ret[4];
+  TransformVec4Row(v, rhs.f_, ret);
+  return Vec4(ret[0], ret[1], ret[2], ret[3]);
 }
 
 //--------------------------------------------------------------------------------
@@ -58,52 +204,22 @@ Mat4::Mat4(const float* mIn) {
 
 Mat4 Mat4::operator*(const Mat4& rhs) const {
   Mat4 ret;
-  ret.f_[0] = f_[0] * rhs.f_[0] + f_[4] * rhs.f_[1] + f_[8] * rhs.f_[2] +
-              f_[12] * rhs.f_[3];
-  ret.f_[1] = f_[1] * rhs.f_[0] + f_[5] * rhs.f_[1] + f_[9] * rhs.f_[2] +
-              f_[13] * rhs.f_[3];
-  ret.f_[2] = f_[2] * rhs.f_[0] + f_[6] * rhs.f_[1] + f_[10] * rhs.f_[2] +
-              f_[14] * rhs.f_[3];
-  ret.f_[3] = f_[3] * rhs.f_[0] + f_[7] * rhs.f_[1] + f_[11] * rhs.f_[2] +
-              f_[15] * rhs.f_[3];
-
-  ret.f_[4] = f_[0] * rhs.f_[4] + f_[4] * rhs.f_[5] + f_[8] * rhs.f_[6] +
-              f_[12] * rhs.f_[7];
-  ret.f_[5] = f_[1] * rhs.f_[4] + f_[5] * rhs.f_[5] + f_[9] * rhs.f_[6] +
-              f_[13] * rhs.f_[7];
-  ret.f_[6] = f_[2] * rhs.f_[4] + f_[6] * rhs.f_[5] + f_[10] * rhs.f_[6] +
-              f_[14] * rhs.f_[7];
-  ret.f_[7] = f_[3] * rhs.f_[4] + f_[7] * rhs.f_[5] + f_[11] * rhs.f_[6] +
-              f_[15] * rhs.f_[7];
-
-  ret.f_[8] = f_[0] * rhs.f_[8] + f_[4] * rhs.f_[9] + f_[8] * rhs.f_[10] +
-              f_[12] * rhs.f_[11];
-  ret.f_[9] = f_[1] * rhs.f_[8] + f_[5] * rhs.f_[9] + f_[9] * rhs.f_[10] +
-              f_[13] * rhs.f_[11];
-  ret.f_[10] = f_[2] * rhs.f_[8] + f_[6] * rhs.f_[9] + f_[10] * rhs.f_[10] +
-               f_[14] * rhs.f_[11];
-  ret.f_[11] = f_[3] * rhs.f_[8] + f_[7] * rhs.f_[9] + f_[11] * rhs.f_[10] +
-               f_[15] * rhs.f_[11];
-
-  ret.f_[12] = f_[0] * rhs.f_[12] + f_[4] * rhs.f_[13] + f_[8] * rhs.f_[14] +
-               f_[12] * rhs.f_[15];
-  ret.f_[13] = f_[1] * rhs.f_[12] + f_[5] * rhs.f_[13] + f_[9] * rhs.f_[14] +
-               f_[13] * rhs.f_[15];
-  ret.f_[14] = f_[2] * rhs.f_[12] + f_[6] * rhs.f_[13] + f_[10] * rhs.f_[14] +
-               f_[14] * rhs.f_[15];
-  ret.f_[15] = f_[3] * rhs.f_[12] + f_[7] * rhs.f_[13] + f_[11] * rhs.f_[14] +
-               f_[15] * rhs.f_[15];
-
+  MultiplyMat4(f_, rhs.f_, ret.f_);
   return ret;
 }
 
+Mat4& Mat4::operator*=(const Mat4& rhs) {
+  float ret[16];
+  MultiplyMat4(f_, rhs.f_, ret);
+  for (int32_t i = 0; i < 16; ++i) f_[i] = ret[i];
+  return *this;
+}
+
 Vec4 Mat4::operator*(const Vec4& rhs) const {
-  Vec4 ret;
-  ret.x_ = rhs.x_ * f_[0] + rhs.y_ * f_[4] + rhs.z_ * f_[8] + rhs.w_ * f_[12];
-  ret.y_ = rhs.x_ * f_[1] + rhs.y_ * f_[5] + rhs.z_ * f_[9] + rhs.w_ * f_[13];
-  ret.z_ = rhs.x_ * f_[2] + rhs.y_ * f_[6] + rhs.z_ * f_[10] + rhs.w_ * f_[14];
-  ret.w_ = rhs.x_ * f_[3] + rhs.y_ * f_[7] + rhs.z_ * f_[11] + rhs.w_ * f_[15];
-  return ret;
+  const float v[4] = {rhs.x_, rhs.y_, rhs.z_, rhs.w_};
+  float ret[4];
+  TransformVec4(f_, v, ret);
+  return Vec4(ret[0], ret[1], ret[2], ret[3]);
 }
 
 Mat4 Mat4::Inverse() {
@@ -149,34 +265,76 @@ Mat4 Mat4::Inverse() {
     // Error
   } else {
     det_1 = 1.0f / det_1;
-    ret.f_[0] = (f_[5] * f_[10] - f_[9] * f_[6]) * det_1;
-    ret.f_[1] = -(f_[1] * f_[10] - f_[9] * f_[2]) * det_1;
-    ret.f_[2] = (f_[1] * f_[6] - f_[5] * f_[2]) * det_1;
-    ret.f_[4] = -(f_[4] * f_[10] - f_[8] * f_[6]) * det_1;
-    ret.f_[5] = (f_[0] * f_[10] - f_[8] * f_[2]) * det_1;
-    ret.f_[6] = -(f_[0] * f_[6] - f_[4] * f_[2]) * det_1;
-    ret.f_[8] = (f_[4] * f_[9] - f_[8] * f_[5]) * det_1;
-    ret.f_[9] = -(f_[0] * f_[9] - f_[8] * f_[1]) * det_1;
-    ret.f_[10] = (f_[0] * f_[5] - f_[4] * f_[1]) * det_1;
-
-    /* Calculate -C * inverse(A) */
-    ret.f_[12] =
-        -(f_[12] * ret.f_[0] + f_[13] * ret.f_[4] + f_[14] * ret.f_[8]);
-    ret.f_[13] =
-        -(f_[12] * ret.f_[1] + f_[13] * ret.f_[5] + f_[14] * ret.f_[9]);
-    ret.f_[14] =
-        -(f_[12] * ret.f_[2] + f_[13] * ret.f_[6] + f_[14] * ret.f_[10]);
-
-    ret.f_[3] = 0.0f;
-    ret.f_[7] = 0.0f;
-    ret.f_[11] = 0.0f;
-    ret.f_[15] = 1.0f;
+    InverseAffine(f_, det_1, ret.f_);
   }
 
   *this = ret;
   return *this;
 }
 
+Mat4& Mat4::PostTranslate(float tx, float ty, float tz) {
+  PostTranslateMat4(f_, tx, ty, tz);
+  return *this;
+}
+
+//--------------------------------------------------------------------------------
+// Batches
+//--------------------------------------------------------------------------------
+void Mat4::Multiply(const Mat4* lhs, const Mat4& rhs, const int32_t count,
+                    Mat4* out) {
+  for (int32_t i = 0; i < count; ++i)
+    MultiplyMat4(lhs[i].f_, rhs.f_, out[i].f_);
+}
+
+void Mat4::Multiply(const Mat4& lhs, const Mat4* rhs, const int32_t count,
+                    Mat4* out) {
+  for (int32_t i = 0; i < count; ++i)
+    MultiplyMat4(lhs.f_, rhs[i].f_, out[i].f_);
+}
+
+void Mat4::Multiply(const Mat4* lhs, const Mat4* rhs, const int32_t count,
+                    Mat4* out) {
+  for (int32_t i = 0; i < count; ++i)
+    MultiplyMat4(lhs[i].f_, rhs[i].f_, out[i].f_);
+}
+
+void Mat4::TransformPoints(const Vec3Soa& in, const int32_t count,
+                           const Vec3Soa& out) const {
+  // Blocks are multiples of 4 wide, every 4 points are contiguous
+  int32_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    const int32_t src = in.Offset(i);
+    const int32_t dst = out.Offset(i);
+    float* const out_xyz[3] = {out.x + dst, out.y + dst, out.z + dst};
+    TransformPoints4(f_, in.x + src, in.y + src, in.z + src, out_xyz);
+  }
+  for (; i < count; ++i) {
+    const int32_t src = in.Offset(i);
+    const int32_t dst = out.Offset(i);
+    const float x = in.x[src];
+    const float y = in.y[src];
+    const float z = in.z[src];
+    out.x[dst] = x * f_[0] + y * f_[4] + z * f_[8] + f_[12];
+    out.y[dst] = x * f_[1] + y * f_[5] + z * f_[9] + f_[13];
+    out.z[dst] = x * f_[2] + y * f_[6] + z * f_[10] + f_[14];
+  }
+}
+
+void Mat4::TransformSpheres(const Vec3Soa& in, const int32_t count,
+                            const Vec3Soa& out) const {
+  TransformPoints(in, count, out);
+  float scale = 0.0f;
+  for (int32_t c = 0; c < 3; ++c) {
+    const float* axis = f_ + c * 4;
+    const float length =
+        axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+    if (length > scale) scale = length;
+  }
+  scale = sqrtf(scale);
+  for (int32_t i = 0; i < count; ++i)
+    out.radius[out.Offset(i)] = in.radius[in.Offset(i)] * scale;
+}
+
 //--------------------------------------------------------------------------------
 // Misc
 //--------------------------------------------------------------------------------
@@ -403,4 +561,89 @@ Mat4 Mat4::LookAt(const Vec3& vec_eye, const Vec3& vec_at, const Vec3& vec_up) {
   return result;
 }
 
+//--------------------------------------------------------------------------------
+// Affine
+//--------------------------------------------------------------------------------
+Affine::Affine(const Mat4& mat) {
+  for (int32_t c = 0; c < 4; ++c) {
+    for (int32_t r = 0; r < 3; ++r) f_[c * 3 + r] = mat.f_[c * 4 + r];
+  }
+}
+
+void Affine::NormalMatrix(float* mat3) const {
+  Affine inverse = *this;
+  inverse.Inverse();
+  for (int32_t c = 0; c < 3; ++c) {
+    for (int32_t r = 0; r < 3; ++r) mat3[c * 3 + r] = inverse.f_[r * 3 + c];
+  }
+}
+
+Mat4 Affine::ToMat4() const {
+  Mat4 ret;
+  for (int32_t c = 0; c < 4; ++c) {
+    for (int32_t r = 0; r < 3; ++r) ret.f_[c * 4 + r] = f_[c * 3 + r];
+    ret.f_[c * 4 + 3] = c == 3 ? 1.0f : 0.0f;
+  }
+  return ret;
+}
+
+Affine Affine::LookAt(const Vec3& vec_eye, const Vec3& vec_at,
+                      const Vec3& vec_up) {
+  return Affine(Mat4::LookAt(vec_eye, vec_at, vec_up));
+}
+
+Affine Affine::Translation(const float fX, const float fY, const float fZ) {
+  Affine ret;
+  ret.f_[9] = fX;
+  ret.f_[10] = fY;
+  ret.f_[11] = fZ;
+  return ret;
+}
+
+Affine Affine::Translation(const Vec3 vec) {
+  return Translation(vec.x_, vec.y_, vec.z_);
+}
+
+Affine Affine::RotationX(const float fAngle) {
+  Affine ret;
+  float fCosine = cosf(fAngle);
+  float fSine = sinf(fAngle);
+  ret.f_[4] = fCosine;
+  ret.f_[5] = -fSine;
+  ret.f_[7] = fSine;
+  ret.f_[8] = fCosine;
+  return ret;
+}
+
+Affine Affine::RotationY(const float fAngle) {
+  Affine ret;
+  float fCosine = cosf(fAngle);
+  float fSine = sinf(fAngle);
+  ret.f_[0] = fCosine;
+  ret.f_[2] = fSine;
+  ret.f_[6] = -fSine;
+  ret.f_[8] = fCosine;
+  return ret;
+}
+
+Affine Affine::RotationZ(const float fAngle) {
+  Affine ret;
+  float fCosine = cosf(fAngle);
+  float fSine = sinf(fAngle);
+  ret.f_[0] = fCosine;
+  ret.f_[1] = -fSine;
+  ret.f_[3] = fSine;
+  ret.f_[4] = fCosine;
+  return ret;
+}
+
+Affine Affine::Scale(const float scaleX, const float scaleY,
+                     const float scaleZ) {
+  Affine ret;
+  ret.f_[0] = scaleX;
+  ret.f_[4] = scaleY;
+  ret.f_[8] = scaleZ;
+  return ret;
+}
+
 }  // namespace ndkHelper
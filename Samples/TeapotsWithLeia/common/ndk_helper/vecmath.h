@@ -18,13 +18,16 @@
 #define VECMATH_H_
 
 #include <cmath>
+#include <cstddef>
 #include "JNIHelper.h"
 
 namespace ndk_helper {
 
 /******************************************************************
  * Helper class for vector math operations
- * Currently all implementations are in pure C++.
+ * Matrix products use SSE2 or NEON when the target has them, chosen at
+ * compile time. VECMATH_SCALAR forces the plain C++ implementation, both
+ * give the same results.
  * Each class is an opaque class so caller does not have a direct access
  * to each element. This is for an ease of future optimization to use vector
  *operations.
@@ -35,6 +38,7 @@ class Vec2;
 class Vec3;
 class Vec4;
 class Mat4;
+class Affine;
 
 /******************************************************************
  * 2 elements vector class
@@ -212,6 +216,7 @@ class Vec3 {
  public:
   friend class Vec4;
   friend class Mat4;
+  friend class Affine;
   friend class Quaternion;
 
   Vec3() { x_ = y_ = z_ = 0.f; }
@@ -619,17 +624,53 @@ class Vec4 {
   }
 };
 
+/******************************************************************
+ * Points, or bounding spheres with radius set, as structure of arrays or
+ * array of structures of arrays. Component c of element i is at
+ *   c[(i / width) * stride + i % width]
+ * Separate arrays are one block, Blocks() lays out width x, then width y,
+ * width z (and width radii) per block. width is a multiple of 4.
+ *
+ */
+struct Vec3Soa {
+  float* x;
+  float* y;
+  float* z;
+  float* radius;
+  int32_t width;
+  int32_t stride;
+
+  static Vec3Soa Arrays(float* x, float* y, float* z, float* radius = NULL) {
+    Vec3Soa ret = {x, y, z, radius, 4, 4};
+    return ret;
+  }
+
+  static Vec3Soa Blocks(float* base, const int32_t width, const bool spheres) {
+    Vec3Soa ret = {base, base + width, base + 2 * width,
+                   spheres ? base + 3 * width : NULL, width,
+                   (spheres ? 4 : 3) * width};
+    return ret;
+  }
+
+  int32_t Offset(const int32_t i) const {
+    return (i / width) * stride + i % width;
+  }
+};
+
 /******************************************************************
  * 4x4 matrix
  *
  */
 class Mat4 {
  private:
-  float f_[16];
+  // The kernels of vecmath.cpp still load unaligned, operator new only
+  // guarantees 8 bytes on 32 bit ABIs
+  alignas(16) float f_[16];
 
  public:
   friend class Vec3;
   friend class Vec4;
+  friend class Affine;
   friend class Quaternion;
 
   Mat4();
@@ -668,47 +709,7 @@ class Mat4 {
     return *this;
   }
 
-  Mat4& operator*=(const Mat4& rhs) {
-    Mat4 ret;
-    ret.f_[0] = f_[0] * rhs.f_[0] + f_[4] * rhs.f_[1] + f_[8] * rhs.f_[2] +
-                f_[12] * rhs.f_[3];
-    ret.f_[1] = f_[1] * rhs.f_[0] + f_[5] * rhs.f_[1] + f_[9] * rhs.f_[2] +
-                f_[13] * rhs.f_[3];
-    ret.f_[2] = f_[2] * rhs.f_[0] + f_[6] * rhs.f_[1] + f_[10] * rhs.f_[2] +
-                f_[14] * rhs.f_[3];
-    ret.f_[3] = f_[3] * rhs.f_[0] + f_[7] * rhs.f_[1] + f_[11] * rhs.f_[2] +
-                f_[15] * rhs.f_[3];
-
-    ret.f_[4] = f_[0] * rhs.f_[4] + f_[4] * rhs.f_[5] + f_[8] * rhs.f_[6] +
-                f_[12] * rhs.f_[7];
-    ret.f_[5] = f_[1] * rhs.f_[4] + f_[5] * rhs.f_[5] + f_[9] * rhs.f_[6] +
-                f_[13] * rhs.f_[7];
-    ret.f_[6] = f_[2] * rhs.f_[4] + f_[6] * rhs.f_[5] + f_[10] * rhs.f_[6] +
-                f_[14] * rhs.f_[7];
-    ret.f_[7] = f_[3] * rhs.f_[4] + f_[7] * rhs.f_[5] + f_[11] * rhs.f_[6] +
-                f_[15] * rhs.f_[7];
-
-    ret.f_[8] = f_[0] * rhs.f_[8] + f_[4] * rhs.f_[9] + f_[8] * rhs.f_[10] +
-                f_[12] * rhs.f_[11];
-    ret.f_[9] = f_[1] * rhs.f_[8] + f_[5] * rhs.f_[9] + f_[9] * rhs.f_[10] +
-                f_[13] * rhs.f_[11];
-    ret.f_[10] = f_[2] * rhs.f_[8] + f_[6] * rhs.f_[9] + f_[10] * rhs.f_[10] +
-                 f_[14] * rhs.f_[11];
-    ret.f_[11] = f_[3] * rhs.f_[8] + f_[7] * rhs.f_[9] + f_[11] * rhs.f_[10] +
-                 f_[15] * rhs.f_[11];
-
-    ret.f_[12] = f_[0] * rhs.f_[12] + f_[4] * rhs.f_[13] + f_[8] * rhs.f_[14] +
-                 f_[12] * rhs.f_[15];
-    ret.f_[13] = f_[1] * rhs.f_[12] + f_[5] * rhs.f_[13] + f_[9] * rhs.f_[14] +
-                 f_[13] * rhs.f_[15];
-    ret.f_[14] = f_[2] * rhs.f_[12] + f_[6] * rhs.f_[13] + f_[10] * rhs.f_[14] +
-                 f_[14] * rhs.f_[15];
-    ret.f_[15] = f_[3] * rhs.f_[12] + f_[7] * rhs.f_[13] + f_[11] * rhs.f_[14] +
-                 f_[15] * rhs.f_[15];
-
-    *this = ret;
-    return *this;
-  }
+  Mat4& operator*=(const Mat4& rhs);
 
   Mat4 operator*(const float rhs) {
     Mat4 ret;
@@ -756,13 +757,7 @@ class Mat4 {
     return *this;
   }
 
-  Mat4& PostTranslate(float tx, float ty, float tz) {
-    f_[12] += (tx * f_[0]) + (ty * f_[4]) + (tz * f_[8]);
-    f_[13] += (tx * f_[1]) + (ty * f_[5]) + (tz * f_[9]);
-    f_[14] += (tx * f_[2]) + (ty * f_[6]) + (tz * f_[10]);
-    f_[15] += (tx * f_[3]) + (ty * f_[7]) + (tz * f_[11]);
-    return *this;
-  }
+  Mat4& PostTranslate(float tx, float ty, float tz);
 
   float* Ptr() { return f_; }
 
@@ -786,6 +781,28 @@ class Mat4 {
 
   static Mat4 Scale(const float scaleX, const float scaleY, const float scaleZ);
 
+  //--------------------------------------------------------------------------------
+  // Batches
+  // Into caller provided arrays, out must not overlap the inputs. Each result
+  // has the bits of the matching single operation.
+  //--------------------------------------------------------------------------------
+  // out[i] = lhs[i] * rhs
+  static void Multiply(const Mat4* lhs, const Mat4& rhs, const int32_t count,
+                       Mat4* out);
+  // out[i] = lhs * rhs[i]
+  static void Multiply(const Mat4& lhs, const Mat4* rhs, const int32_t count,
+                       Mat4* out);
+  // out[i] = lhs[i] * rhs[i]
+  static void Multiply(const Mat4* lhs, const Mat4* rhs, const int32_t count,
+                       Mat4* out);
+
+  // out[i] = *this * Vec4(in[i], 1) without w
+  void TransformPoints(const Vec3Soa& in, const int32_t count,
+                       const Vec3Soa& out) const;
+  // Centers as TransformPoints(), radii scaled by the longest axis
+  void TransformSpheres(const Vec3Soa& in, const int32_t count,
+                        const Vec3Soa& out) const;
+
   static Mat4 Identity() {
     Mat4 ret;
     ret.f_[0] = 1.f;
@@ -815,6 +832,152 @@ class Mat4 {
   }
 };
 
+/******************************************************************
+ * Affine transform, a 4x4 matrix whose last row is 0, 0, 0, 1
+ * Rotation, scale and translation as 4 columns of 3, products and inverses
+ * skip the work on the constant row. Results match Mat4 on the same
+ * transform except for the sign of zeros.
+ *
+ */
+class Affine {
+ private:
+  float f_[12];
+
+ public:
+  friend class Quaternion;
+
+  Affine() {
+    f_[0] = f_[4] = f_[8] = 1.0f;
+    f_[1] = f_[2] = f_[3] = f_[5] = f_[6] = f_[7] = f_[9] = f_[10] = f_[11] =
+        0.0f;
+  }
+
+  // Drops the last row of mat
+  explicit Affine(const Mat4& mat);
+
+  // Mat4 products summed in the same order, less the terms of the last row
+  Affine operator*(const Affine& rhs) const {
+    Affine ret;
+    const float* b = rhs.f_;
+    for (int32_t c = 0; c < 4; ++c) {
+      for (int32_t r = 0; r < 3; ++r) {
+        ret.f_[c * 3 + r] = f_[r] * b[c * 3] + f_[3 + r] * b[c * 3 + 1] +
+                            f_[6 + r] * b[c * 3 + 2];
+      }
+    }
+    ret.f_[9] += f_[9];
+    ret.f_[10] += f_[10];
+    ret.f_[11] += f_[11];
+    return ret;
+  }
+
+  // rhs as a point, w = 1
+  Vec3 operator*(const Vec3& rhs) const {
+    return Vec3(rhs.x_ * f_[0] + rhs.y_ * f_[3] + rhs.z_ * f_[6] + f_[9],
+                rhs.x_ * f_[1] + rhs.y_ * f_[4] + rhs.z_ * f_[7] + f_[10],
+                rhs.x_ * f_[2] + rhs.y_ * f_[5] + rhs.z_ * f_[8] + f_[11]);
+  }
+
+  Affine& operator*=(const Affine& rhs) {
+    *this = *this * rhs;
+    return *this;
+  }
+
+  // Any invertible transform, Mat4::Inverse() on the 3x4 part. Returns
+  // identity when there is no inverse.
+  Affine Inverse() {
+    const float products[6] = {
+        f_[0] * f_[4] * f_[8],  f_[3] * f_[7] * f_[2],
+        f_[6] * f_[1] * f_[5],  -f_[6] * f_[4] * f_[2],
+        -f_[3] * f_[1] * f_[8], -f_[0] * f_[7] * f_[5]};
+    float pos = 0;
+    float neg = 0;
+    for (int32_t i = 0; i < 6; ++i) {
+      if (products[i] >= 0)
+        pos += products[i];
+      else
+        neg += products[i];
+    }
+    float det_1 = pos + neg;
+
+    if (det_1 == 0.0) {
+      // Error
+      *this = Affine();
+      return *this;
+    }
+
+    det_1 = 1.0f / det_1;
+    float out[12];
+    out[0] = (f_[4] * f_[8] - f_[7] * f_[5]) * det_1;
+    out[1] = -(f_[1] * f_[8] - f_[7] * f_[2]) * det_1;
+    out[2] = (f_[1] * f_[5] - f_[4] * f_[2]) * det_1;
+    out[3] = -(f_[3] * f_[8] - f_[6] * f_[5]) * det_1;
+    out[4] = (f_[0] * f_[8] - f_[6] * f_[2]) * det_1;
+    out[5] = -(f_[0] * f_[5] - f_[3] * f_[2]) * det_1;
+    out[6] = (f_[3] * f_[7] - f_[6] * f_[4]) * det_1;
+    out[7] = -(f_[0] * f_[7] - f_[6] * f_[1]) * det_1;
+    out[8] = (f_[0] * f_[4] - f_[3] * f_[1]) * det_1;
+
+    /* Calculate -C * inverse(A) */
+    out[9] = -(f_[9] * out[0] + f_[10] * out[3] + f_[11] * out[6]);
+    out[10] = -(f_[9] * out[1] + f_[10] * out[4] + f_[11] * out[7]);
+    out[11] = -(f_[9] * out[2] + f_[10] * out[5] + f_[11] * out[8]);
+
+    for (int32_t i = 0; i < 12; ++i) f_[i] = out[i];
+    return *this;
+  }
+
+  // Rotation and translation only, transposes the rotation
+  Affine InverseRigid() {
+    const float t[3] = {-(f_[9] * f_[0] + f_[10] * f_[1] + f_[11] * f_[2]),
+                        -(f_[9] * f_[3] + f_[10] * f_[4] + f_[11] * f_[5]),
+                        -(f_[9] * f_[6] + f_[10] * f_[7] + f_[11] * f_[8])};
+    float temp = f_[1];
+    f_[1] = f_[3];
+    f_[3] = temp;
+    temp = f_[2];
+    f_[2] = f_[6];
+    f_[6] = temp;
+    temp = f_[5];
+    f_[5] = f_[7];
+    f_[7] = temp;
+    f_[9] = t[0];
+    f_[10] = t[1];
+    f_[11] = t[2];
+    return *this;
+  }
+
+  // Inverse transpose of the 3x3 part, column major for glUniformMatrix3fv
+  void NormalMatrix(float* mat3) const;
+
+  Mat4 ToMat4() const;
+
+  float* Ptr() { return f_; }
+
+  static Affine LookAt(const Vec3& vEye, const Vec3& vAt, const Vec3& vUp);
+
+  static Affine Translation(const float fX, const float fY, const float fZ);
+  static Affine Translation(const Vec3 vec);
+
+  static Affine RotationX(const float angle);
+
+  static Affine RotationY(const float angle);
+
+  static Affine RotationZ(const float angle);
+
+  static Affine Scale(const float scaleX, const float scaleY,
+                      const float scaleZ);
+
+  static Affine Identity() { return Affine(); }
+
+  void Dump() {
+    LOGI("%f %f %f", f_[0], f_[1], f_[2]);
+    LOGI("%f %f %f", f_[3], f_[4], f_[5]);
+    LOGI("%f %f %f", f_[6], f_[7], f_[8]);
+    LOGI("%f %f %f", f_[9], f_[10], f_[11]);
+  }
+};
+
 /******************************************************************
  * Quaternion class
  *
@@ -827,6 +990,7 @@ class Quaternion {
   friend class Vec3;
   friend class Vec4;
   friend class Mat4;
+  friend class Affine;
 
   Quaternion() {
     x_ = 0.f;
@@ -918,6 +1082,30 @@ class Quaternion {
     mat.f_[15] = 1.0f;
   }
 
+  void ToMatrix(Affine& mat) {
+    float x2 = x_ * x_ * 2.0f;
+    float y2 = y_ * y_ * 2.0f;
+    float z2 = z_ * z_ * 2.0f;
+    float xy = x_ * y_ * 2.0f;
+    float yz = y_ * z_ * 2.0f;
+    float zx = z_ * x_ * 2.0f;
+    float xw = x_ * w_ * 2.0f;
+    float yw = y_ * w_ * 2.0f;
+    float zw = z_ * w_ * 2.0f;
+
+    mat.f_[0] = 1.0f - y2 - z2;
+    mat.f_[1] = xy + zw;
+    mat.f_[2] = zx - yw;
+    mat.f_[3] = xy - zw;
+    mat.f_[4] = 1.0f - z2 - x2;
+    mat.f_[5] = yz + xw;
+    mat.f_[6] = zx + yw;
+    mat.f_[7] = yz - xw;
+    mat.f_[8] = 1.0f - x2 - y2;
+
+    mat.f_[9] = mat.f_[10] = mat.f_[11] = 0.0f;
+  }
+
   void ToMatrixPreserveTranslate(Mat4& mat) {
     float x2 = x_ * x_ * 2.0f;
     float y2 = y_ * y_ * 2.0f;
@@ -0,0 +1,1087 @@
+/*
+ * Copyright 2018 Leia Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VECMATH2_H_
+#define VECMATH2_H_
+
+#include <cmath>
+#include <cstddef>
+#include "JNIHelper.h"
+
+namespace ndk_helper {
+namespace v2 {
+
+/******************************************************************
+ * Header only vecmath.h
+ * Same classes and members as ndk_helper::Vec2, Vec3, Vec4, Mat4, Affine,
+ * Quaternion and Vec3Soa, code written against them compiles against
+ * ndk_helper::v2 unchanged:
+ *
+ *   #include "vecmath2.h"
+ *   using namespace ndk_helper::v2;
+ *
+ * The two sets of classes have the same layout and convert through Ptr() and
+ * the float pointer constructors, both can live in one file.
+ *
+ * Everything is inline, a chain like view * trans * rot * model compiles to
+ * one run of arithmetic without a Mat4 in memory per product, Mat4::Product()
+ * spells it out. Constructors, the products and the factories that need no
+ * trigonometry are constexpr, constant matrices are folded at compile time:
+ *
+ *   constexpr Mat4 MODEL = Mat4::Translation(0.f, 50.f, -200.f) *
+ *                          Mat4::Scale(50.f, 50.f, 1.f);
+ *
+ * Results have the bits of vecmath.h unless the compiler fuses multiply and
+ * add, which vecmath.cpp is built to avoid. Unlike vecmath.h, the Vec4
+ * operators compute w from w, Vec4(const float*) reads w and != compares
+ * every element.
+ */
+
+class Vec2;
+class Vec3;
+class Vec4;
+class Mat4;
+class Affine;
+
+/******************************************************************
+ * 2 elements vector class
+ *
+ */
+class Vec2 {
+ private:
+  float x_;
+  float y_;
+
+ public:
+  friend class Vec3;
+  friend class Vec4;
+  friend class Mat4;
+  friend class Quaternion;
+
+  constexpr Vec2() : x_(0.f), y_(0.f) {}
+  constexpr Vec2(const float fX, const float fY) : x_(fX), y_(fY) {}
+  Vec2(const float* pVec) : x_(pVec[0]), y_(pVec[1]) {}
+
+  // Operators
+  constexpr Vec2 operator*(const Vec2& rhs) const {
+    return Vec2(x_ * rhs.x_, y_ * rhs.y_);
+  }
+
+  constexpr Vec2 operator/(const Vec2& rhs) const {
+    return Vec2(x_ / rhs.x_, y_ / rhs.y_);
+  }
+
+  constexpr Vec2 operator+(const Vec2& rhs) const {
+    return Vec2(x_ + rhs.x_, y_ + rhs.y_);
+  }
+
+  constexpr Vec2 operator-(const Vec2& rhs) const {
+    return Vec2(x_ - rhs.x_, y_ - rhs.y_);
+  }
+
+  Vec2& operator+=(const Vec2& rhs) {
+    x_ += rhs.x_;
+    y_ += rhs.y_;
+    return *this;
+  }
+
+  Vec2& operator-=(const Vec2& rhs) {
+    x_ -= rhs.x_;
+    y_ -= rhs.y_;
+    return *this;
+  }
+
+  Vec2& operator*=(const Vec2& rhs) {
+    x_ *= rhs.x_;
+    y_ *= rhs.y_;
+    return *this;
+  }
+
+  Vec2& operator/=(const Vec2& rhs) {
+    x_ /= rhs.x_;
+    y_ /= rhs.y_;
+    return *this;
+  }
+
+  // External operators
+  friend constexpr Vec2 operator-(const Vec2& rhs) {
+    return Vec2(rhs.x_ * -1, rhs.y_ * -1);
+  }
+
+  friend constexpr Vec2 operator*(const float lhs, const Vec2& rhs) {
+    return Vec2(lhs * rhs.x_, lhs * rhs.y_);
+  }
+
+  friend constexpr Vec2 operator/(const float lhs, const Vec2& rhs) {
+    return Vec2(lhs / rhs.x_, lhs / rhs.y_);
+  }
+
+  // Operators with float
+  constexpr Vec2 operator*(const float& rhs) const {
+    return Vec2(x_ * rhs, y_ * rhs);
+  }
+
+  Vec2& operator*=(const float& rhs) {
+    x_ = x_ * rhs;
+    y_ = y_ * rhs;
+    return *this;
+  }
+
+  constexpr Vec2 operator/(const float& rhs) const {
+    return Vec2(x_ / rhs, y_ / rhs);
+  }
+
+  Vec2& operator/=(const float& rhs) {
+    x_ = x_ / rhs;
+    y_ = y_ / rhs;
+    return *this;
+  }
+
+  // Compare
+  constexpr bool operator==(const Vec2& rhs) const {
+    return x_ == rhs.x_ && y_ == rhs.y_;
+  }
+
+  constexpr bool operator!=(const Vec2& rhs) const { return !(*this == rhs); }
+
+  float Length() const { return sqrtf(x_ * x_ + y_ * y_); }
+
+  Vec2 Normalize() {
+    float len = Length();
+    x_ = x_ / len;
+    y_ = y_ / len;
+    return *this;
+  }
+
+  constexpr float Dot(const Vec2& rhs) const {
+    return x_ * rhs.x_ + y_ * rhs.y_;
+  }
+
+  bool Validate() const { return !std::isnan(x_) && !std::isnan(y_); }
+
+  void Value(float& fX, float& fY) const {
+    fX = x_;
+    fY = y_;
+  }
+
+  void Dump() const { LOGI("Vec2 %f %f", x_, y_); }
+};
+
+/******************************************************************
+ * 3 elements vector class
+ *
+ */
+class Vec3 {
+ private:
+  float x_, y_, z_;
+
+ public:
+  friend class Vec4;
+  friend class Mat4;
+  friend class Affine;
+  friend class Quaternion;
+
+  constexpr Vec3() : x_(0.f), y_(0.f), z_(0.f) {}
+  constexpr Vec3(const float fX, const float fY, const float fZ)
+      : x_(fX), y_(fY), z_(fZ) {}
+  Vec3(const float* pVec) : x_(pVec[0]), y_(pVec[1]), z_(pVec[2]) {}
+  constexpr Vec3(const Vec2& vec, float f) : x_(vec.x_), y_(vec.y_), z_(f) {}
+  constexpr Vec3(const Vec4& vec);
+
+  // Operators
+  constexpr Vec3 operator*(const Vec3& rhs) const {
+    return Vec3(x_ * rhs.x_, y_ * rhs.y_, z_ * rhs.z_);
+  }
+
+  constexpr Vec3 operator/(const Vec3& rhs) const {
+    return Vec3(x_ / rhs.x_, y_ / rhs.y_, z_ / rhs.z_);
+  }
+
+  constexpr Vec3 operator+(const Vec3& rhs) const {
+    return Vec3(x_ + rhs.x_, y_ + rhs.y_, z_ + rhs.z_);
+  }
+
+  constexpr Vec3 operator-(const Vec3& rhs) const {
+    return Vec3(x_ - rhs.x_, y_ - rhs.y_, z_ - rhs.z_);
+  }
+
+  Vec3& operator+=(const Vec3& rhs) {
+    x_ += rhs.x_;
+    y_ += rhs.y_;
+    z_ += rhs.z_;
+    return *this;
+  }
+
+  Vec3& operator-=(const Vec3& rhs) {
+    x_ -= rhs.x_;
+    y_ -= rhs.y_;
+    z_ -= rhs.z_;
+    return *this;
+  }
+
+  Vec3& operator*=(const Vec3& rhs) {
+    x_ *= rhs.x_;
+    y_ *= rhs.y_;
+    z_ *= rhs.z_;
+    return *this;
+  }
+
+  Vec3& operator/=(const Vec3& rhs) {
+    x_ /= rhs.x_;
+    y_ /= rhs.y_;
+    z_ /= rhs.z_;
+    return *this;
+  }
+
+  // External operators
+  friend constexpr Vec3 operator-(const Vec3& rhs) {
+    return Vec3(rhs.x_ * -1, rhs.y_ * -1, rhs.z_ * -1);
+  }
+
+  friend constexpr Vec3 operator*(const float lhs, const Vec3& rhs) {
+    return Vec3(lhs * rhs.x_, lhs * rhs.y_, lhs * rhs.z_);
+  }
+
+  friend constexpr Vec3 operator/(const float lhs, const Vec3& rhs) {
+    return Vec3(lhs / rhs.x_, lhs / rhs.y_, lhs / rhs.z_);
+  }
+
+  // Operators with float
+  constexpr Vec3 operator*(const float& rhs) const {
+    return Vec3(x_ * rhs, y_ * rhs, z_ * rhs);
+  }
+
+  Vec3& operator*=(const float& rhs) {
+    x_ = x_ * rhs;
+    y_ = y_ * rhs;
+    z_ = z_ * rhs;
+    return *this;
+  }
+
+  constexpr Vec3 operator/(const float& rhs) const {
+    return Vec3(x_ / rhs, y_ / rhs, z_ / rhs);
+  }
+
+  Vec3& operator/=(const float& rhs) {
+    x_ = x_ / rhs;
+    y_ = y_ / rhs;
+    z_ = z_ / rhs;
+    return *this;
+  }
+
+  // Compare
+  constexpr bool operator==(const Vec3& rhs) const {
+    return x_ == rhs.x_ && y_ == rhs.y_ && z_ == rhs.z_;
+  }
+
+  constexpr bool operator!=(const Vec3& rhs) const { return !(*this == rhs); }
+
+  float Length() const { return sqrtf(x_ * x_ + y_ * y_ + z_ * z_); }
+
+  Vec3 Normalize() {
+    float len = Length();
+    x_ = x_ / len;
+    y_ = y_ / len;
+    z_ = z_ / len;
+    return *this;
+  }
+
+  constexpr float Dot(const Vec3& rhs) const {
+    return x_ * rhs.x_ + y_ * rhs.y_ + z_ * rhs.z_;
+  }
+
+  constexpr Vec3 Cross(const Vec3& rhs) const {
+    return Vec3(y_ * rhs.z_ - z_ * rhs.y_, z_ * rhs.x_ - x_ * rhs.z_,
+                x_ * rhs.y_ - y_ * rhs.x_);
+  }
+
+  bool Validate() const {
+    return !std::isnan(x_) && !std::isnan(y_) && !std::isnan(z_);
+  }
+
+  void Value(float& fX, float& fY, float& fZ) const {
+    fX = x_;
+    fY = y_;
+    fZ = z_;
+  }
+
+  void Dump() const { LOGI("Vec3 %f %f %f", x_, y_, z_); }
+};
+
+/******************************************************************
+ * 4 elements vector class
+ *
+ */
+class Vec4 {
+ private:
+  float x_, y_, z_, w_;
+
+ public:
+  friend class Vec3;
+  friend class Mat4;
+  friend class Quaternion;
+
+  constexpr Vec4() : x_(0.f), y_(0.f), z_(0.f), w_(0.f) {}
+  constexpr Vec4(const float fX, const float fY, const float fZ,
+                 const float fW)
+      : x_(fX), y_(fY), z_(fZ), w_(fW) {}
+  constexpr Vec4(const Vec3& vec, const float fW)
+      : x_(vec.x_), y_(vec.y_), z_(vec.z_), w_(fW) {}
+  Vec4(const float* pVec)
+      : x_(pVec[0]), y_(pVec[1]), z_(pVec[2]), w_(pVec[3]) {}
+
+  // Operators
+  constexpr Vec4 operator*(const Vec4& rhs) const {
+    return Vec4(x_ * rhs.x_, y_ * rhs.y_, z_ * rhs.z_, w_ * rhs.w_);
+  }
+
+  constexpr Vec4 operator/(const Vec4& rhs) const {
+    return Vec4(x_ / rhs.x_, y_ / rhs.y_, z_ / rhs.z_, w_ / rhs.w_);
+  }
+
+  constexpr Vec4 operator+(const Vec4& rhs) const {
+    return Vec4(x_ + rhs.x_, y_ + rhs.y_, z_ + rhs.z_, w_ + rhs.w_);
+  }
+
+  constexpr Vec4 operator-(const Vec4& rhs) const {
+    return Vec4(x_ - rhs.x_, y_ - rhs.y_, z_ - rhs.z_, w_ - rhs.w_);
+  }
+
+  Vec4& operator+=(const Vec4& rhs) {
+    x_ += rhs.x_;
+    y_ += rhs.y_;
+    z_ += rhs.z_;
+    w_ += rhs.w_;
+    return *this;
+  }
+
+  Vec4& operator-=(const Vec4& rhs) {
+    x_ -= rhs.x_;
+    y_ -= rhs.y_;
+    z_ -= rhs.z_;
+    w_ -= rhs.w_;
+    return *this;
+  }
+
+  Vec4& operator*=(const Vec4& rhs) {
+    x_ *= rhs.x_;
+    y_ *= rhs.y_;
+    z_ *= rhs.z_;
+    w_ *= rhs.w_;
+    return *this;
+  }
+
+  Vec4& operator/=(const Vec4& rhs) {
+    x_ /= rhs.x_;
+    y_ /= rhs.y_;
+    z_ /= rhs.z_;
+    w_ /= rhs.w_;
+    return *this;
+  }
+
+  // External operators
+  friend constexpr Vec4 operator-(const Vec4& rhs) {
+    return Vec4(rhs.x_ * -1, rhs.y_ * -1, rhs.z_ * -1, rhs.w_ * -1);
+  }
+
+  friend constexpr Vec4 operator*(const float lhs, const Vec4& rhs) {
+    return Vec4(lhs * rhs.x_, lhs * rhs.y_, lhs * rhs.z_, lhs * rhs.w_);
+  }
+
+  friend constexpr Vec4 operator/(const float lhs, const Vec4& rhs) {
+    return Vec4(lhs / rhs.x_, lhs / rhs.y_, lhs / rhs.z_, lhs / rhs.w_);
+  }
+
+  // Operators with float
+  constexpr Vec4 operator*(const float& rhs) const {
+    return Vec4(x_ * rhs, y_ * rhs, z_ * rhs, w_ * rhs);
+  }
+
+  Vec4& operator*=(const float& rhs) {
+    x_ = x_ * rhs;
+    y_ = y_ * rhs;
+    z_ = z_ * rhs;
+    w_ = w_ * rhs;
+    return *this;
+  }
+
+  constexpr Vec4 operator/(const float& rhs) const {
+    return Vec4(x_ / rhs, y_ / rhs, z_ / rhs, w_ / rhs);
+  }
+
+  Vec4& operator/=(const float& rhs) {
+    x_ = x_ / rhs;
+    y_ = y_ / rhs;
+    z_ = z_ / rhs;
+    w_ = w_ / rhs;
+    return *this;
+  }
+
+  // Compare
+  constexpr bool operator==(const Vec4& rhs) const {
+    return x_ == rhs.x_ && y_ == rhs.y_ && z_ == rhs.z_ && w_ == rhs.w_;
+  }
+
+  constexpr bool operator!=(const Vec4& rhs) const { return !(*this == rhs); }
+
+  constexpr Vec4 operator*(const Mat4& rhs) const;
+
+  float Length() const { return sqrtf(x_ * x_ + y_ * y_ + z_ * z_ + w_ * w_); }
+
+  Vec4 Normalize() {
+    float len = Length();
+    x_ = x_ / len;
+    y_ = y_ / len;
+    z_ = z_ / len;
+    w_ = w_ / len;
+    return *this;
+  }
+
+  constexpr float Dot(const Vec3& rhs) const {
+    return x_ * rhs.x_ + y_ * rhs.y_ + z_ * rhs.z_;
+  }
+
+  constexpr Vec3 Cross(const Vec3& rhs) const {
+    return Vec3(y_ * rhs.z_ - z_ * rhs.y_, z_ * rhs.x_ - x_ * rhs.z_,
+                x_ * rhs.y_ - y_ * rhs.x_);
+  }
+
+  bool Validate() const {
+    return !std::isnan(x_) && !std::isnan(y_) && !std::isnan(z_) &&
+           !std::isnan(w_);
+  }
+
+  void Value(float& fX, float& fY, float& fZ, float& fW) const {
+    fX = x_;
+    fY = y_;
+    fZ = z_;
+    fW = w_;
+  }
+};
+
+constexpr Vec3::Vec3(const Vec4& vec) : x_(vec.x_), y_(vec.y_), z_(vec.z_) {}
+
+/******************************************************************
+ * Points, or bounding spheres with radius set, as structure of arrays or
+ * array of structures of arrays, see ndk_helper::Vec3Soa
+ *
+ */
+struct Vec3Soa {
+  float* x;
+  float* y;
+  float* z;
+  float* radius;
+  int32_t width;
+  int32_t stride;
+
+  static Vec3Soa Arrays(float* x, float* y, float* z, float* radius = NULL) {
+    Vec3Soa ret = {x, y, z, radius, 4, 4};
+    return ret;
+  }
+
+  static Vec3Soa Blocks(float* base, const int32_t width, const bool spheres) {
+    Vec3Soa ret = {base, base + width, base + 2 * width,
+                   spheres ? base + 3 * width : NULL, width,
+                   (spheres ? 4 : 3) * width};
+    return ret;
+  }
+
+  int32_t Offset(const int32_t i) const {
+    return (i / width) * stride + i % width;
+  }
+};
+
+/******************************************************************
+ * 4x4 matrix
+ *
+ */
+class Mat4 {
+ private:
+  alignas(16) float f_[16];
+
+  // Column major
+  constexpr Mat4(float f0, float f1, float f2, float f3, float f4, float f5,
+                 float f6, float f7, float f8, float f9, float f10, float f11,
+                 float f12, float f13, float f14, float f15)
+      : f_{f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14,
+           f15} {}
+
+  // Element r, c of a * b, summed like vecmath.cpp
+  static constexpr float Dot(const Mat4& a, const Mat4& b, const int32_t r,
+                             const int32_t c) {
+    return a.f_[r] * b.f_[c * 4] + a.f_[4 + r] * b.f_[c * 4 + 1] +
+           a.f_[8 + r] * b.f_[c * 4 + 2] + a.f_[12 + r] * b.f_[c * 4 + 3];
+  }
+
+  static constexpr Mat4 Perspective(float width, float height, float n2,
+                                    float rcpnmf, float farPlane,
+                                    float nearPlane) {
+    return Mat4(n2 / width, 0, 0, 0, 0, n2 / height, 0, 0, 0, 0,
+                (farPlane + nearPlane) * rcpnmf, -1.0f, 0, 0,
+                farPlane * rcpnmf * n2, 0);
+  }
+
+  static constexpr Mat4 Ortho2D(float left, float top, float right,
+                                float bottom, float inv_x, float inv_y,
+                                float inv_z) {
+    return Mat4(2.0f * inv_x, 0.0f, 0.0f, 0.0f, 0.0f, 2.0 * inv_y, 0.0f, 0.0f,
+                0.0f, 0.0f, -2.0f * inv_z, 0.0f, -(right + left) * inv_x,
+                (top + bottom) * inv_y, -(1.0f + -1.0f) * inv_z, 1.0f);
+  }
+
+ public:
+  friend class Vec3;
+  friend class Vec4;
+  friend class Affine;
+  friend class Quaternion;
+
+  constexpr Mat4()
+      : f_{1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f,
+           0.0f, 0.0f, 0.0f, 0.0f, 1.0f} {}
+
+  Mat4(const float* mIn) {
+    for (int32_t i = 0; i < 16; ++i) f_[i] = mIn[i];
+  }
+
+  constexpr Mat4 operator*(const Mat4& rhs) const {
+    return Mat4(Dot(*this, rhs, 0, 0), Dot(*this, rhs, 1, 0),
+                Dot(*this, rhs, 2, 0), Dot(*this, rhs, 3, 0),
+                Dot(*this, rhs, 0, 1), Dot(*this, rhs, 1, 1),
+                Dot(*this, rhs, 2, 1), Dot(*this, rhs, 3, 1),
+                Dot(*this, rhs, 0, 2), Dot(*this, rhs, 1, 2),
+                Dot(*this, rhs, 2, 2), Dot(*this, rhs, 3, 2),
+                Dot(*this, rhs, 0, 3), Dot(*this, rhs, 1, 3),
+                Dot(*this, rhs, 2, 3), Dot(*this, rhs, 3, 3));
+  }
+
+  constexpr Vec4 operator*(const Vec4& rhs) const {
+    return Vec4(
+        rhs.x_ * f_[0] + rhs.y_ * f_[4] + rhs.z_ * f_[8] + rhs.w_ * f_[12],
+        rhs.x_ * f_[1] + rhs.y_ * f_[5] + rhs.z_ * f_[9] + rhs.w_ * f_[13],
+        rhs.x_ * f_[2] + rhs.y_ * f_[6] + rhs.z_ * f_[10] + rhs.w_ * f_[14],
+        rhs.x_ * f_[3] + rhs.y_ * f_[7] + rhs.z_ * f_[11] + rhs.w_ * f_[15]);
+  }
+
+  // a * b * ..., left to right like the operators
+  static constexpr Mat4 Product(const Mat4& a) { return a; }
+
+  template <typename... REST>
+  static constexpr Mat4 Product(const Mat4& a, const Mat4& b,
+                                const REST&... rest) {
+    return Product(a * b, rest...);
+  }
+
+  Mat4 operator+(const Mat4& rhs) const {
+    Mat4 ret;
+    for (int32_t i = 0; i < 16; ++i) {
+      ret.f_[i] = f_[i] + rhs.f_[i];
+    }
+    return ret;
+  }
+
+  Mat4 operator-(const Mat4& rhs) const {
+    Mat4 ret;
+    for (int32_t i = 0; i < 16; ++i) {
+      ret.f_[i] = f_[i] - rhs.f_[i];
+    }
+    return ret;
+  }
+
+  Mat4& operator+=(const Mat4& rhs) {
+    for (int32_t i = 0; i < 16; ++i) {
+      f_[i] += rhs.f_[i];
+    }
+    return *this;
+  }
+
+  Mat4& operator-=(const Mat4& rhs) {
+    for (int32_t i = 0; i < 16; ++i) {
+      f_[i] -= rhs.f_[i];
+    }
+    return *this;
+  }
+
+  Mat4& operator*=(const Mat4& rhs) {
+    *this = *this * rhs;
+    return *this;
+  }
+
+  Mat4 operator*(const float rhs) const {
+    Mat4 ret;
+    for (int32_t i = 0; i < 16; ++i) {
+      ret.f_[i] = f_[i] * rhs;
+    }
+    return ret;
+  }
+
+  Mat4& operator*=(const float rhs) {
+    for (int32_t i = 0; i < 16; ++i) {
+      f_[i] *= rhs;
+    }
+    return *this;
+  }
+
+  Mat4 Inverse() {
+    Mat4 ret;
+    const float products[6] = {
+        f_[0] * f_[5] * f_[10],  f_[4] * f_[9] * f_[2],
+        f_[8] * f_[1] * f_[6],   -f_[8] * f_[5] * f_[2],
+        -f_[4] * f_[1] * f_[10], -f_[0] * f_[9] * f_[6]};
+    float pos = 0;
+    float neg = 0;
+    for (int32_t i = 0; i < 6; ++i) {
+      if (products[i] >= 0)
+        pos += products[i];
+      else
+        neg += products[i];
+    }
+    float det_1 = pos + neg;
+
+    if (det_1 != 0.0) {
+      det_1 = 1.0f / det_1;
+      ret.f_[0] = (f_[5] * f_[10] - f_[9] * f_[6]) * det_1;
+      ret.f_[1] = -(f_[1] * f_[10] - f_[9] * f_[2]) * det_1;
+      ret.f_[2] = (f_[1] * f_[6] - f_[5] * f_[2]) * det_1;
+      ret.f_[4] = -(f_[4] * f_[10] - f_[8] * f_[6]) * det_1;
+      ret.f_[5] = (f_[0] * f_[10] - f_[8] * f_[2]) * det_1;
+      ret.f_[6] = -(f_[0] * f_[6] - f_[4] * f_[2]) * det_1;
+      ret.f_[8] = (f_[4] * f_[9] - f_[8] * f_[5]) * det_1;
+      ret.f_[9] = -(f_[0] * f_[9] - f_[8] * f_[1]) * det_1;
+      ret.f_[10] = (f_[0] * f_[5] - f_[4] * f_[1]) * det_1;
+
+      /* Calculate -C * inverse(A) */
+      ret.f_[12] =
+          -(f_[12] * ret.f_[0] + f_[13] * ret.f_[4] + f_[14] * ret.f_[8]);
+      ret.f_[13] =
+          -(f_[12] * ret.f_[1] + f_[13] * ret.f_[5] + f_[14] * ret.f_[9]);
+      ret.f_[14] =
+          -(f_[12] * ret.f_[2] + f_[13] * ret.f_[6] + f_[14] * ret.f_[10]);
+    }
+
+    *this = ret;
+    return *this;
+  }
+
+  Mat4 Transpose() {
+    *this = Mat4(f_[0], f_[4], f_[8], f_[12], f_[1], f_[5], f_[9], f_[13],
+                 f_[2], f_[6], f_[10], f_[14], f_[3], f_[7], f_[11], f_[15]);
+    return *this;
+  }
+
+  Mat4& PostTranslate(float tx, float ty, float tz) {
+    f_[12] += (tx * f_[0]) + (ty * f_[4]) + (tz * f_[8]);
+    f_[13] += (tx * f_[1]) + (ty * f_[5]) + (tz * f_[9]);
+    f_[14] += (tx * f_[2]) + (ty * f_[6]) + (tz * f_[10]);
+    f_[15] += (tx * f_[3]) + (ty * f_[7]) + (tz * f_[11]);
+    return *this;
+  }
+
+  float* Ptr() { return f_; }
+
+  //--------------------------------------------------------------------------------
+  // Misc
+  //--------------------------------------------------------------------------------
+  static constexpr Mat4 Perspective(float width, float height,
+                                    float nearPlane, float farPlane) {
+    return Perspective(width, height, 2.0f * nearPlane,
+                       1.f / (nearPlane - farPlane), farPlane, nearPlane);
+  }
+
+  static constexpr Mat4 Ortho2D(float left, float top, float right,
+                                float bottom) {
+    return Ortho2D(left, top, right, bottom, 1.0f / (right - left),
+                   1.0f / (-top + bottom), 1.0f / (1.0f - -1.0f));
+  }
+
+  static Mat4 LookAt(const Vec3& vec_eye, const Vec3& vec_at,
+                     const Vec3& vec_up) {
+    Vec3 vec_forward = vec_eye - vec_at;
+    vec_forward.Normalize();
+    Vec3 vec_up_norm = vec_up;
+    vec_up_norm.Normalize();
+    Vec3 vec_side = vec_up_norm.Cross(vec_forward);
+    vec_up_norm = vec_forward.Cross(vec_side);
+
+    Mat4 result(vec_side.x_, vec_up_norm.x_, vec_forward.x_, 0, vec_side.y_,
+                vec_up_norm.y_, vec_forward.y_, 0, vec_side.z_,
+                vec_up_norm.z_, vec_forward.z_, 0, 0, 0, 0, 1.0f);
+    result.PostTranslate(-vec_eye.x_, -vec_eye.y_, -vec_eye.z_);
+    return result;
+  }
+
+  static constexpr Mat4 Translation(const float fX, const float fY,
+                                    const float fZ) {
+    return Mat4(1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f,
+                1.0f, 0.0f, fX, fY, fZ, 1.0f);
+  }
+
+  static constexpr Mat4 Translation(const Vec3 vec) {
+    return Translation(vec.x_, vec.y_, vec.z_);
+  }
+
+  static Mat4 RotationX(const float angle) {
+    const float c = cosf(angle);
+    const float s = sinf(angle);
+    return Mat4(1.0f, 0.0f, 0.0f, 0.0f, 0.0f, c, -s, 0.0f, 0.0f, s, c, 0.0f,
+                0.0f, 0.0f, 0.0f, 1.0f);
+  }
+
+  static Mat4 RotationY(const float angle) {
+    const float c = cosf(angle);
+    const float s = sinf(angle);
+    return Mat4(c, 0.0f, s, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, -s, 0.0f, c, 0.0f,
+                0.0f, 0.0f, 0.0f, 1.0f);
+  }
+
+  static Mat4 RotationZ(const float angle) {
+    const float c = cosf(angle);
+    const float s = sinf(angle);
+    return Mat4(c, -s, 0.0f, 0.0f, s, c, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f,
+                0.0f, 0.0f, 0.0f, 1.0f);
+  }
+
+  static constexpr Mat4 Scale(const float scaleX, const float scaleY,
+                              const float scaleZ) {
+    return Mat4(scaleX, 0.f, 0.f, 0.f, 0.f, scaleY, 0.f, 0.f, 0.f, 0.f,
+                scaleZ, 0.f, 0.f, 0.f, 0.f, 1.0f);
+  }
+
+  //--------------------------------------------------------------------------------
+  // Batches, see ndk_helper::Mat4
+  //--------------------------------------------------------------------------------
+  static void Multiply(const Mat4* lhs, const Mat4& rhs, const int32_t count,
+                       Mat4* out) {
+    for (int32_t i = 0; i < count; ++i) out[i] = lhs[i] * rhs;
+  }
+
+  static void Multiply(const Mat4& lhs, const Mat4* rhs, const int32_t count,
+                       Mat4* out) {
+    for (int32_t i = 0; i < count; ++i) out[i] = lhs * rhs[i];
+  }
+
+  static void Multiply(const Mat4* lhs, const Mat4* rhs, const int32_t count,
+                       Mat4* out) {
+    for (int32_t i = 0; i < count; ++i) out[i] = lhs[i] * rhs[i];
+  }
+
+  void TransformPoints(const Vec3Soa& in, const int32_t count,
+                       const Vec3Soa& out) const {
+    for (int32_t i = 0; i < count; ++i) {
+      const int32_t src = in.Offset(i);
+      const int32_t dst = out.Offset(i);
+      const float x = in.x[src];
+      const float y = in.y[src];
+      const float z = in.z[src];
+      out.x[dst] = x * f_[0] + y * f_[4] + z * f_[8] + f_[12];
+      out.y[dst] = x * f_[1] + y * f_[5] + z * f_[9] + f_[13];
+      out.z[dst] = x * f_[2] + y * f_[6] + z * f_[10] + f_[14];
+    }
+  }
+
+  void TransformSpheres(const Vec3Soa& in, const int32_t count,
+                        const Vec3Soa& out) const {
+    TransformPoints(in, count, out);
+    float scale = 0.0f;
+    for (int32_t c = 0; c < 3; ++c) {
+      const float* axis = f_ + c * 4;
+      const float length =
+          axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+      if (length > scale) scale = length;
+    }
+    scale = sqrtf(scale);
+    for (int32_t i = 0; i < count; ++i)
+      out.radius[out.Offset(i)] = in.radius[in.Offset(i)] * scale;
+  }
+
+  static constexpr Mat4 Identity() { return Mat4(); }
+
+  void Dump() const {
+    LOGI("%f %f %f %f", f_[0], f_[1], f_[2], f_[3]);
+    LOGI("%f %f %f %f", f_[4], f_[5], f_[6], f_[7]);
+    LOGI("%f %f %f %f", f_[8], f_[9], f_[10], f_[11]);
+    LOGI("%f %f %f %f", f_[12], f_[13], f_[14], f_[15]);
+  }
+};
+
+constexpr Vec4 Vec4::operator*(const Mat4& rhs) const {
+  return Vec4(
+      x_ * rhs.f_[0] + y_ * rhs.f_[1] + z_ * rhs.f_[2] + w_ * rhs.f_[3],
+      x_ * rhs.f_[4] + y_ * rhs.f_[5] + z_ * rhs.f_[6] + w_ * rhs.f_[7],
+      x_ * rhs.f_[8] + y_ * rhs.f_[9] + z_ * rhs.f_[10] + w_ * rhs.f_[11],
+      x_ * rhs.f_[12] + y_ * rhs.f_[13] + z_ * rhs.f_[14] + w_ * rhs.f_[15]);
+}
+
+/******************************************************************
+ * Affine transform, see ndk_helper::Affine
+ *
+ */
+class Affine {
+ private:
+  float f_[12];
+
+  constexpr Affine(float f0, float f1, float f2, float f3, float f4, float f5,
+                   float f6, float f7, float f8, float f9, float f10,
+                   float f11)
+      : f_{f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11} {}
+
+  // Element r, c of the 3x3 part of a * b, summed like vecmath.cpp
+  static constexpr float Dot(const Affine& a, const Affine& b,
+                             const int32_t r, const int32_t c) {
+    return a.f_[r] * b.f_[c * 3] + a.f_[3 + r] * b.f_[c * 3 + 1] +
+           a.f_[6 + r] * b.f_[c * 3 + 2];
+  }
+
+ public:
+  friend class Quaternion;
+
+  constexpr Affine()
+      : f_{1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f,
+           0.0f} {}
+
+  // Drops the last row of mat
+  constexpr explicit Affine(const Mat4& mat)
+      : f_{mat.f_[0], mat.f_[1],  mat.f_[2],  mat.f_[4],
+           mat.f_[5], mat.f_[6],  mat.f_[8],  mat.f_[9],
+           mat.f_[10], mat.f_[12], mat.f_[13], mat.f_[14]} {}
+
+  constexpr Affine operator*(const Affine& rhs) const {
+    return Affine(Dot(*this, rhs, 0, 0), Dot(*this, rhs, 1, 0),
+                  Dot(*this, rhs, 2, 0), Dot(*this, rhs, 0, 1),
+                  Dot(*this, rhs, 1, 1), Dot(*this, rhs, 2, 1),
+                  Dot(*this, rhs, 0, 2), Dot(*this, rhs, 1, 2),
+                  Dot(*this, rhs, 2, 2), Dot(*this, rhs, 0, 3) + f_[9],
+                  Dot(*this, rhs, 1, 3) + f_[10],
+                  Dot(*this, rhs, 2, 3) + f_[11]);
+  }
+
+  // rhs as a point, w = 1
+  constexpr Vec3 operator*(const Vec3& rhs) const {
+    return Vec3(rhs.x_ * f_[0] + rhs.y_ * f_[3] + rhs.z_ * f_[6] + f_[9],
+                rhs.x_ * f_[1] + rhs.y_ * f_[4] + rhs.z_ * f_[7] + f_[10],
+                rhs.x_ * f_[2] + rhs.y_ * f_[5] + rhs.z_ * f_[8] + f_[11]);
+  }
+
+  Affine& operator*=(const Affine& rhs) {
+    *this = *this * rhs;
+    return *this;
+  }
+
+  Affine Inverse() {
+    Affine ret;
+    const float products[6] = {
+        f_[0] * f_[4] * f_[8],  f_[3] * f_[7] * f_[2],
+        f_[6] * f_[1] * f_[5],  -f_[6] * f_[4] * f_[2],
+        -f_[3] * f_[1] * f_[8], -f_[0] * f_[7] * f_[5]};
+    float pos = 0;
+    float neg = 0;
+    for (int32_t i = 0; i < 6; ++i) {
+      if (products[i] >= 0)
+        pos += products[i];
+      else
+        neg += products[i];
+    }
+    float det_1 = pos + neg;
+
+    if (det_1 != 0.0) {
+      det_1 = 1.0f / det_1;
+      float* out = ret.f_;
+      out[0] = (f_[4] * f_[8] - f_[7] * f_[5]) * det_1;
+      out[1] = -(f_[1] * f_[8] - f_[7] * f_[2]) * det_1;
+      out[2] = (f_[1] * f_[5] - f_[4] * f_[2]) * det_1;
+      out[3] = -(f_[3] * f_[8] - f_[6] * f_[5]) * det_1;
+      out[4] = (f_[0] * f_[8] - f_[6] * f_[2]) * det_1;
+      out[5] = -(f_[0] * f_[5] - f_[3] * f_[2]) * det_1;
+      out[6] = (f_[3] * f_[7] - f_[6] * f_[4]) * det_1;
+      out[7] = -(f_[0] * f_[7] - f_[6] * f_[1]) * det_1;
+      out[8] = (f_[0] * f_[4] - f_[3] * f_[1]) * det_1;
+
+      /* Calculate -C * inverse(A) */
+      out[9] = -(f_[9] * out[0] + f_[10] * out[3] + f_[11] * out[6]);
+      out[10] = -(f_[9] * out[1] + f_[10] * out[4] + f_[11] * out[7]);
+      out[11] = -(f_[9] * out[2] + f_[10] * out[5] + f_[11] * out[8]);
+    }
+
+    *this = ret;
+    return *this;
+  }
+
+  Affine InverseRigid() {
+    const float t[3] = {
+        -(f_[9] * f_[0] + f_[10] * f_[1] + f_[11] * f_[2]),
+        -(f_[9] * f_[3] + f_[10] * f_[4] + f_[11] * f_[5]),
+        -(f_[9] * f_[6] + f_[10] * f_[7] + f_[11] * f_[8])};
+    *this = Affine(f_[0], f_[3], f_[6], f_[1], f_[4], f_[7], f_[2], f_[5],
+                   f_[8], t[0], t[1], t[2]);
+    return *this;
+  }
+
+  // Inverse transpose of the 3x3 part, column major for glUniformMatrix3fv
+  void NormalMatrix(float* mat3) const {
+    Affine inverse = *this;
+    inverse.Inverse();
+    for (int32_t c = 0; c < 3; ++c) {
+      for (int32_t r = 0; r < 3; ++r) mat3[c * 3 + r] = inverse.f_[r * 3 + c];
+    }
+  }
+
+  constexpr Mat4 ToMat4() const {
+    return Mat4(f_[0], f_[1], f_[2], 0.0f, f_[3], f_[4], f_[5], 0.0f, f_[6],
+                f_[7], f_[8], 0.0f, f_[9], f_[10], f_[11], 1.0f);
+  }
+
+  float* Ptr() { return f_; }
+
+  static Affine LookAt(const Vec3& vec_eye, const Vec3& vec_at,
+                       const Vec3& vec_up) {
+    return Affine(Mat4::LookAt(vec_eye, vec_at, vec_up));
+  }
+
+  static constexpr Affine Translation(const float fX, const float fY,
+                                      const float fZ) {
+    return Affine(1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, fX,
+                  fY, fZ);
+  }
+
+  static constexpr Affine Translation(const Vec3 vec) {
+    return Translation(vec.x_, vec.y_, vec.z_);
+  }
+
+  static Affine RotationX(const float angle) {
+    return Affine(Mat4::RotationX(angle));
+  }
+
+  static Affine RotationY(const float angle) {
+    return Affine(Mat4::RotationY(angle));
+  }
+
+  static Affine RotationZ(const float angle) {
+    return Affine(Mat4::RotationZ(angle));
+  }
+
+  static constexpr Affine Scale(const float scaleX, const float scaleY,
+                                const float scaleZ) {
+    return Affine(scaleX, 0.0f, 0.0f, 0.0f, scaleY, 0.0f, 0.0f, 0.0f, scaleZ,
+                  0.0f, 0.0f, 0.0f);
+  }
+
+  static constexpr Affine Identity() { return Affine(); }
+
+  void Dump() const {
+    LOGI("%f %f %f", f_[0], f_[1], f_[2]);
+    LOGI("%f %f %f", f_[3], f_[4], f_[5]);
+    LOGI("%f %f %f", f_[6], f_[7], f_[8]);
+    LOGI("%f %f %f", f_[9], f_[10], f_[11]);
+  }
+};
+
+/******************************************************************
+ * Quaternion class
+ *
+ */
+class Quaternion {
+ private:
+  float x_, y_, z_, w_;
+
+ public:
+  friend class Vec3;
+  friend class Vec4;
+  friend class Mat4;
+  friend class Affine;
+
+  constexpr Quaternion() : x_(0.f), y_(0.f), z_(0.f), w_(1.f) {}
+  constexpr Quaternion(const float fX, const float fY, const float fZ,
+                       const float fW)
+      : x_(fX), y_(fY), z_(fZ), w_(fW) {}
+  constexpr Quaternion(const Vec3 vec, const float fW)
+      : x_(vec.x_), y_(vec.y_), z_(vec.z_), w_(fW) {}
+  Quaternion(const float* p) : x_(p[0]), y_(p[1]), z_(p[2]), w_(p[3]) {}
+
+  constexpr Quaternion operator*(const Quaternion rhs) const {
+    return Quaternion(x_ * rhs.w_ + y_ * rhs.z_ - z_ * rhs.y_ + w_ * rhs.x_,
+                      -x_ * rhs.z_ + y_ * rhs.w_ + z_ * rhs.x_ + w_ * rhs.y_,
+                      x_ * rhs.y_ - y_ * rhs.x_ + z_ * rhs.w_ + w_ * rhs.z_,
+                      -x_ * rhs.x_ - y_ * rhs.y_ - z_ * rhs.z_ + w_ * rhs.w_);
+  }
+
+  Quaternion& operator*=(const Quaternion rhs) {
+    *this = *this * rhs;
+    return *this;
+  }
+
+  Quaternion Conjugate() {
+    x_ = -x_;
+    y_ = -y_;
+    z_ = -z_;
+    return *this;
+  }
+
+  // Non destuctive version
+  constexpr Quaternion Conjugated() const {
+    return Quaternion(-x_, -y_, -z_, w_);
+  }
+
+  void ToMatrix(Mat4& mat) const {
+    mat.f_[12] = mat.f_[13] = mat.f_[14] = 0.0f;
+    ToMatrixPreserveTranslate(mat);
+  }
+
+  void ToMatrix(Affine& mat) const {
+    Mat4 rotation;
+    ToMatrix(rotation);
+    mat = Affine(rotation);
+  }
+
+  void ToMatrixPreserveTranslate(Mat4& mat) const {
+    float x2 = x_ * x_ * 2.0f;
+    float y2 = y_ * y_ * 2.0f;
+    float z2 = z_ * z_ * 2.0f;
+    float xy = x_ * y_ * 2.0f;
+    float yz = y_ * z_ * 2.0f;
+    float zx = z_ * x_ * 2.0f;
+    float xw = x_ * w_ * 2.0f;
+    float yw = y_ * w_ * 2.0f;
+    float zw = z_ * w_ * 2.0f;
+
+    mat.f_[0] = 1.0f - y2 - z2;
+    mat.f_[1] = xy + zw;
+    mat.f_[2] = zx - yw;
+    mat.f_[4] = xy - zw;
+    mat.f_[5] = 1.0f - z2 - x2;
+    mat.f_[6] = yz + xw;
+    mat.f_[8] = zx + yw;
+    mat.f_[9] = yz - xw;
+    mat.f_[10] = 1.0f - x2 - y2;
+
+    mat.f_[3] = mat.f_[7] = mat.f_[11] = 0.0f;
+    mat.f_[15] = 1.0f;
+  }
+
+  static Quaternion RotationAxis(const Vec3 axis, const float angle) {
+    const float s = sinf(angle / 2);
+    return Quaternion(s * axis.x_, s * axis.y_, s * axis.z_, cosf(angle / 2));
+  }
+
+  void Value(float& fX, float& fY, float& fZ, float& fW) const {
+    fX = x_;
+    fY = y_;
+    fZ = z_;
+    fW = w_;
+  }
+};
+
+}  // namespace v2
+}  // namespace ndk_helper
+#endif /* VECMATH2_H_ */
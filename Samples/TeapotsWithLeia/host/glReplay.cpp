@@ -0,0 +1,1194 @@
+/*
+ * Copyright 2018 Leia Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//--------------------------------------------------------------------------------
+// glReplay.cpp
+// Replays a trace of leia_helper::StartGlCapture() in a headless EGL context,
+// to time a captured workload on another driver and to try submission
+// changes without rebuilding the apps. Objects get new names, the default
+// framebuffer of the trace is a framebuffer object of the header size.
+//
+// Per frame: CPU time of the frame in the capture, CPU time of the replay
+// submission, time until glFinish() returns, GPU time from
+// GL_EXT_disjoint_timer_query when the driver has it, calls replayed, calls
+// dropped or merged and draw calls. Frame 0 holds every call before the
+// first end of frame, resource loading included, the mean leaves it out.
+//
+// What-ifs, each may change what is rendered:
+//   --skip=glA,glB    drop every call of these entry points
+//   --skip-redundant  drop binds and state calls that set what is set
+//   --batch-uploads   merge glBufferSubData() calls that continue the last
+//                     one into one upload
+//   --uploads-first   move the uploads of a frame to buffers that existed
+//                     before it, index buffers aside, ahead of its draws
+// --per-call adds the CPU time of each entry point, summed over the trace.
+//
+// Not replayed: client side vertex and index arrays, pixels of
+// glTexSubImage2D() the capture could not size.
+//
+// usage: gl-replay TRACE [--skip=glA,glB] [--skip-redundant]
+//                  [--batch-uploads] [--uploads-first] [--per-call]
+//                  [--json=PATH|-]
+//--------------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "gl3stub.h"
+#include "glTrace.h"
+#include "hostContext.h"
+
+using namespace leia_helper;
+
+// Size of the default framebuffer when the trace has none
+static const int32_t DEFAULT_SIZE = 16;
+
+//--------------------------------------------------------------------------------
+// Options
+//--------------------------------------------------------------------------------
+struct OPTIONS {
+  std::string trace;
+  std::vector<bool> skip;
+  std::string skip_names;
+  bool skip_redundant;
+  bool batch_uploads;
+  bool uploads_first;
+  bool per_call;
+  std::string json;
+};
+
+static bool ParseSkip(const char* value, OPTIONS* options) {
+  std::string names = value;
+  for (size_t start = 0; start <= names.size();) {
+    size_t end = names.find(',', start);
+    if (end == std::string::npos) end = names.size();
+    std::string name = names.substr(start, end - start);
+    GL_TRACE_OP op = FindGlTraceOp(name.c_str());
+    if (op == GL_TRACE_OP_COUNT || op == GL_TRACE_FRAME) {
+      fprintf(stderr, "Unknown entry point %s\n", name.c_str());
+      return false;
+    }
+    options->skip[op] = true;
+    start = end + 1;
+  }
+  options->skip_names = names;
+  return true;
+}
+
+static bool ParseOptions(int argc, char** argv, OPTIONS* options) {
+  options->skip.assign(GL_TRACE_OP_COUNT, false);
+  options->skip_redundant = false;
+  options->batch_uploads = false;
+  options->uploads_first = false;
+  options->per_call = false;
+  for (int i = 1; i < argc; ++i) {
+    const char* arg = argv[i];
+    const char* value = strchr(arg, '=');
+    value = value ? value + 1 : "";
+    bool ok = true;
+    if (arg[0] != '-') {
+      ok = options->trace.empty();
+      options->trace = arg;
+    } else if (!strncmp(arg, "--skip=", 7)) {
+      if (!ParseSkip(value, options)) return false;
+    } else if (!strcmp(arg, "--skip-redundant")) {
+      options->skip_redundant = true;
+    } else if (!strcmp(arg, "--batch-uploads")) {
+      options->batch_uploads = true;
+    } else if (!strcmp(arg, "--uploads-first")) {
+      options->uploads_first = true;
+    } else if (!strcmp(arg, "--per-call")) {
+      options->per_call = true;
+    } else if (!strncmp(arg, "--json=", 7)) {
+      options->json = value;
+    } else {
+      ok = false;
+    }
+    if (!ok) {
+      fprintf(stderr, "Bad argument %s\n", arg);
+      return false;
+    }
+  }
+  if (options->trace.empty()) {
+    fprintf(stderr,
+            "usage: gl-replay TRACE [--skip=glA,glB] [--skip-redundant]\n"
+            "                 [--batch-uploads] [--uploads-first] "
+            "[--per-call]\n"
+            "                 [--json=PATH|-]\n");
+    return false;
+  }
+  return true;
+}
+
+//--------------------------------------------------------------------------------
+// Frames
+//--------------------------------------------------------------------------------
+struct FRAME {
+  std::vector<GL_TRACE_CALL> calls;
+  // CPU time in the capture, negative for the calls after the last frame
+  double captured_ms;
+};
+
+static bool LoadFrames(GlTraceReader* reader, std::vector<FRAME>* frames) {
+  frames->clear();
+  frames->push_back(FRAME());
+  frames->back().captured_ms = -1.0;
+  GL_TRACE_CALL call;
+  while (reader->Next(&call)) {
+    if (call.op != GL_TRACE_FRAME) {
+      frames->back().calls.push_back(call);
+      continue;
+    }
+    frames->back().captured_ms = call.num_args > 1 ? call.args[1] / 1000.0 : 0;
+    frames->push_back(FRAME());
+    frames->back().captured_ms = -1.0;
+  }
+  if (frames->back().calls.empty()) frames->pop_back();
+  return reader->IsComplete();
+}
+
+//--------------------------------------------------------------------------------
+// Replay state
+//--------------------------------------------------------------------------------
+typedef std::map<uint32_t, GLuint> NAME_MAP;
+
+// glBufferSubData() calls merged by --batch-uploads
+struct PENDING_UPLOAD {
+  GLenum target;
+  uint32_t offset;
+  std::vector<uint8_t> data;
+  int32_t calls;
+};
+
+struct REPLAY {
+  const OPTIONS* options;
+
+  // Names of the trace to names of the replay
+  NAME_MAP buffers;
+  NAME_MAP textures;
+  NAME_MAP framebuffers;
+  NAME_MAP renderbuffers;
+  NAME_MAP vertex_arrays;
+  NAME_MAP programs;
+  NAME_MAP shaders;
+  // Keyed by program << 32 | location of the trace
+  std::map<uint64_t, GLint> uniform_locations;
+  std::map<uint64_t, GLuint> block_indices;
+
+  // Bindings of the trace, by names of the trace
+  std::map<GLenum, uint32_t> bound_buffers;
+  std::map<uint32_t, uint32_t> element_buffers;
+  uint32_t vertex_array;
+  uint32_t program;
+  uint32_t draw_framebuffer;
+  uint32_t read_framebuffer;
+  GLenum active_texture;
+  std::map<GLenum, void*> mapped;
+
+  // Arguments of the last bind or state call, --skip-redundant
+  std::map<uint64_t, std::vector<uint32_t> > state;
+  PENDING_UPLOAD pending;
+
+  // Framebuffer 0 of the trace
+  GLuint framebuffer;
+  GLuint color;
+  GLuint depth;
+
+  std::set<uint32_t> linked_programs;
+  int64_t calls;
+  int64_t unsupported;
+  std::vector<double> op_ms;
+  std::vector<int64_t> op_calls;
+};
+
+static GLuint Find(const NAME_MAP& names, const uint32_t name) {
+  if (!name) return 0;
+  NAME_MAP::const_iterator it = names.find(name);
+  return it != names.end() ? it->second : 0;
+}
+
+static GLuint FindFramebuffer(const REPLAY& r, const uint32_t name) {
+  return name ? Find(r.framebuffers, name) : r.framebuffer;
+}
+
+static uint32_t BoundBuffer(const REPLAY& r, const GLenum target) {
+  std::map<GLenum, uint32_t>::const_iterator it;
+  if (target == GL_ELEMENT_ARRAY_BUFFER) {
+    std::map<uint32_t, uint32_t>::const_iterator element =
+        r.element_buffers.find(r.vertex_array);
+    return element != r.element_buffers.end() ? element->second : 0;
+  }
+  it = r.bound_buffers.find(target);
+  return it != r.bound_buffers.end() ? it->second : 0;
+}
+
+static GLint FindLocation(const REPLAY& r, const uint32_t location) {
+  if ((GLint)location < 0) return -1;
+  std::map<uint64_t, GLint>::const_iterator it =
+      r.uniform_locations.find((uint64_t)r.program << 32 | location);
+  // Locations the trace did not query are kept as they are
+  return it != r.uniform_locations.end() ? it->second : (GLint)location;
+}
+
+static GLuint FindBlockIndex(const REPLAY& r, const uint32_t program,
+                             const uint32_t index) {
+  std::map<uint64_t, GLuint>::const_iterator it =
+      r.block_indices.find((uint64_t)program << 32 | index);
+  return it != r.block_indices.end() ? it->second : index;
+}
+
+static void GenNames(NAME_MAP* names, const GL_TRACE_CALL& call,
+                     void(GL_APIENTRY* gen)(GLsizei, GLuint*)) {
+  const GLsizei n = call.args[0];
+  std::vector<GLuint> created(n);
+  gen(n, created.data());
+  const uint32_t* traced = (const uint32_t*)call.data;
+  for (GLsizei i = 0; i < n && (i + 1) * 4 <= (GLsizei)call.data_size; ++i)
+    (*names)[traced[i]] = created[i];
+}
+
+static void DeleteNames(NAME_MAP* names, const GL_TRACE_CALL& call,
+                        void(GL_APIENTRY* del)(GLsizei, const GLuint*)) {
+  const uint32_t* traced = (const uint32_t*)call.data;
+  std::vector<GLuint> deleted;
+  for (uint32_t i = 0; i < call.data_size / 4; ++i) {
+    GLuint name = Find(*names, traced[i]);
+    if (name) deleted.push_back(name);
+    names->erase(traced[i]);
+  }
+  if (!deleted.empty()) del((GLsizei)deleted.size(), deleted.data());
+}
+
+// Framebuffer 0 of the trace to the attachments of the replay framebuffer
+static GLenum DefaultAttachment(const GLenum attachment) {
+  switch (attachment) {
+    case GL_BACK:
+    case GL_COLOR:
+      return GL_COLOR_ATTACHMENT0;
+    case GL_DEPTH:
+      return GL_DEPTH_ATTACHMENT;
+    case GL_STENCIL:
+      return GL_STENCIL_ATTACHMENT;
+  }
+  return attachment;
+}
+
+static bool CreateDefaultFramebuffer(REPLAY* r, const int32_t width,
+                                     const int32_t height) {
+  glGenRenderbuffers(1, &r->color);
+  glBindRenderbuffer(GL_RENDERBUFFER, r->color);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+  glGenRenderbuffers(1, &r->depth);
+  glBindRenderbuffer(GL_RENDERBUFFER, r->depth);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+  glBindRenderbuffer(GL_RENDERBUFFER, 0);
+  glGenFramebuffers(1, &r->framebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, r->framebuffer);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                            GL_RENDERBUFFER, r->color);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+                            GL_RENDERBUFFER, r->depth);
+  // What a window surface starts with
+  glViewport(0, 0, width, height);
+  glScissor(0, 0, width, height);
+  return glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+}
+
+static void InitReplay(REPLAY* r, const OPTIONS* options) {
+  r->options = options;
+  r->vertex_array = 0;
+  r->program = 0;
+  r->draw_framebuffer = 0;
+  r->read_framebuffer = 0;
+  r->active_texture = GL_TEXTURE0;
+  r->pending.calls = 0;
+  r->framebuffer = 0;
+  r->color = 0;
+  r->depth = 0;
+  r->calls = 0;
+  r->unsupported = 0;
+  r->op_ms.assign(GL_TRACE_OP_COUNT, 0.0);
+  r->op_calls.assign(GL_TRACE_OP_COUNT, 0);
+}
+
+//--------------------------------------------------------------------------------
+// Calls
+//--------------------------------------------------------------------------------
+// The bindings of the trace after the call, whether it was replayed or not
+static void Track(REPLAY* r, const GL_TRACE_CALL& call) {
+  const uint32_t* a = call.args;
+  switch (call.op) {
+    case GL_TRACE_ACTIVE_TEXTURE:
+      r->active_texture = a[0];
+      break;
+    case GL_TRACE_BIND_BUFFER:
+    case GL_TRACE_BIND_BUFFER_RANGE: {
+      const uint32_t buffer = call.op == GL_TRACE_BIND_BUFFER ? a[1] : a[2];
+      if (a[0] == GL_ELEMENT_ARRAY_BUFFER)
+        r->element_buffers[r->vertex_array] = buffer;
+      else
+        r->bound_buffers[a[0]] = buffer;
+      break;
+    }
+    case GL_TRACE_BIND_FRAMEBUFFER:
+      if (a[0] != GL_READ_FRAMEBUFFER) r->draw_framebuffer = a[1];
+      if (a[0] != GL_DRAW_FRAMEBUFFER) r->read_framebuffer = a[1];
+      break;
+    case GL_TRACE_BIND_VERTEX_ARRAY:
+      r->vertex_array = a[0];
+      break;
+    case GL_TRACE_USE_PROGRAM:
+      r->program = a[0];
+      break;
+    default:
+      break;
+  }
+}
+
+static bool SameState(REPLAY* r, const GL_TRACE_OP op, const uint32_t key,
+                      const uint32_t* values, const int32_t num_values) {
+  std::vector<uint32_t>& last = r->state[(uint64_t)op << 32 | key];
+  if ((int32_t)last.size() == num_values &&
+      std::equal(last.begin(), last.end(), values))
+    return true;
+  last.assign(values, values + num_values);
+  return false;
+}
+
+// Binds and state calls that set what the same call set last, the state
+// they set kept for the next ones
+static bool Redundant(REPLAY* r, const GL_TRACE_CALL& call) {
+  const uint32_t* a = call.args;
+  switch (call.op) {
+    case GL_TRACE_BIND_BUFFER:
+    case GL_TRACE_BIND_RENDERBUFFER:
+      return SameState(r, call.op, a[0], a + 1, 1);
+    case GL_TRACE_BIND_FRAMEBUFFER: {
+      if (a[0] != GL_FRAMEBUFFER)
+        return SameState(r, call.op, a[0], a + 1, 1);
+      const bool draw = SameState(r, call.op, GL_DRAW_FRAMEBUFFER, a + 1, 1);
+      const bool read = SameState(r, call.op, GL_READ_FRAMEBUFFER, a + 1, 1);
+      return draw && read;
+    }
+    case GL_TRACE_BIND_TEXTURE:
+      return SameState(r, call.op,
+                       (r->active_texture - GL_TEXTURE0) << 16 | a[0], a + 1,
+                       1);
+    case GL_TRACE_ENABLE:
+    case GL_TRACE_DISABLE: {
+      const uint32_t enabled = call.op == GL_TRACE_ENABLE;
+      return SameState(r, GL_TRACE_ENABLE, a[0], &enabled, 1);
+    }
+    case GL_TRACE_ACTIVE_TEXTURE:
+    case GL_TRACE_BIND_VERTEX_ARRAY:
+    case GL_TRACE_CLEAR_COLOR:
+    case GL_TRACE_CLEAR_DEPTHF:
+    case GL_TRACE_DEPTH_FUNC:
+    case GL_TRACE_DEPTH_MASK:
+    case GL_TRACE_FRONT_FACE:
+    case GL_TRACE_SCISSOR:
+    case GL_TRACE_USE_PROGRAM:
+    case GL_TRACE_VIEWPORT:
+      return SameState(r, call.op, 0, a, call.num_args);
+    default:
+      return false;
+  }
+}
+
+// State the cache of Redundant() no longer knows after the call
+static void InvalidateState(REPLAY* r, const GL_TRACE_CALL& call) {
+  switch (call.op) {
+    case GL_TRACE_BIND_BUFFER_RANGE:
+      r->state[(uint64_t)GL_TRACE_BIND_BUFFER << 32 | call.args[0]].assign(
+          call.args + 2, call.args + 3);
+      break;
+    case GL_TRACE_BIND_VERTEX_ARRAY:
+      r->state.erase((uint64_t)GL_TRACE_BIND_BUFFER << 32 |
+                     GL_ELEMENT_ARRAY_BUFFER);
+      break;
+    case GL_TRACE_DELETE_BUFFERS:
+    case GL_TRACE_DELETE_FRAMEBUFFERS:
+    case GL_TRACE_DELETE_PROGRAM:
+    case GL_TRACE_DELETE_RENDERBUFFERS:
+    case GL_TRACE_DELETE_TEXTURES:
+    case GL_TRACE_DELETE_VERTEX_ARRAYS:
+      // Deletes unbind, the names may come back
+      r->state.clear();
+      break;
+    default:
+      break;
+  }
+}
+
+static float F(const uint32_t word) { return GlTraceFloat(word); }
+
+static const void* Offset(const uint32_t word) {
+  return (const void*)(uintptr_t)word;
+}
+
+static void Execute(REPLAY* r, const GL_TRACE_CALL& call) {
+  const uint32_t* a = call.args;
+  const void* data = call.data_size ? call.data : NULL;
+  switch (call.op) {
+    case GL_TRACE_FRAME:
+    case GL_TRACE_OP_COUNT:
+      break;
+    //--------------------------------------------------------------------
+    // OpenGL ES 2.0
+    //--------------------------------------------------------------------
+    case GL_TRACE_ACTIVE_TEXTURE:
+      glActiveTexture(a[0]);
+      break;
+    case GL_TRACE_ATTACH_SHADER:
+      glAttachShader(Find(r->programs, a[0]), Find(r->shaders, a[1]));
+      break;
+    case GL_TRACE_BIND_ATTRIB_LOCATION:
+      glBindAttribLocation(Find(r->programs, a[0]), a[1],
+                           (const GLchar*)call.data);
+      break;
+    case GL_TRACE_BIND_BUFFER:
+      glBindBuffer(a[0], Find(r->buffers, a[1]));
+      break;
+    case GL_TRACE_BIND_FRAMEBUFFER:
+      glBindFramebuffer(a[0], FindFramebuffer(*r, a[1]));
+      break;
+    case GL_TRACE_BIND_RENDERBUFFER:
+      glBindRenderbuffer(a[0], Find(r->renderbuffers, a[1]));
+      break;
+    case GL_TRACE_BIND_TEXTURE:
+      glBindTexture(a[0], Find(r->textures, a[1]));
+      break;
+    case GL_TRACE_BUFFER_DATA:
+      glBufferData(a[0], a[1], a[3] ? data : NULL, a[2]);
+      break;
+    case GL_TRACE_BUFFER_SUB_DATA:
+      glBufferSubData(a[0], a[1], a[2], data);
+      break;
+    case GL_TRACE_CLEAR:
+      glClear(a[0]);
+      break;
+    case GL_TRACE_CLEAR_COLOR:
+      glClearColor(F(a[0]), F(a[1]), F(a[2]), F(a[3]));
+      break;
+    case GL_TRACE_CLEAR_DEPTHF:
+      glClearDepthf(F(a[0]));
+      break;
+    case GL_TRACE_COMPILE_SHADER:
+      glCompileShader(Find(r->shaders, a[0]));
+      break;
+    case GL_TRACE_CREATE_PROGRAM:
+      r->programs[a[0]] = glCreateProgram();
+      break;
+    case GL_TRACE_CREATE_SHADER:
+      r->shaders[a[1]] = glCreateShader(a[0]);
+      break;
+    case GL_TRACE_DELETE_BUFFERS:
+      DeleteNames(&r->buffers, call, glDeleteBuffers);
+      break;
+    case GL_TRACE_DELETE_FRAMEBUFFERS:
+      DeleteNames(&r->framebuffers, call, glDeleteFramebuffers);
+      break;
+    case GL_TRACE_DELETE_PROGRAM:
+      glDeleteProgram(Find(r->programs, a[0]));
+      r->programs.erase(a[0]);
+      break;
+    case GL_TRACE_DELETE_RENDERBUFFERS:
+      DeleteNames(&r->renderbuffers, call, glDeleteRenderbuffers);
+      break;
+    case GL_TRACE_DELETE_SHADER:
+      glDeleteShader(Find(r->shaders, a[0]));
+      r->shaders.erase(a[0]);
+      break;
+    case GL_TRACE_DELETE_TEXTURES:
+      DeleteNames(&r->textures, call, glDeleteTextures);
+      break;
+    case GL_TRACE_DEPTH_FUNC:
+      glDepthFunc(a[0]);
+      break;
+    case GL_TRACE_DEPTH_MASK:
+      glDepthMask(a[0]);
+      break;
+    case GL_TRACE_DISABLE:
+      glDisable(a[0]);
+      break;
+    case GL_TRACE_DISABLE_VERTEX_ATTRIB_ARRAY:
+      glDisableVertexAttribArray(a[0]);
+      break;
+    case GL_TRACE_DRAW_ARRAYS:
+      glDrawArrays(a[0], a[1], a[2]);
+      break;
+    case GL_TRACE_DRAW_ELEMENTS:
+      if (!BoundBuffer(*r, GL_ELEMENT_ARRAY_BUFFER)) {
+        ++r->unsupported;
+        break;
+      }
+      glDrawElements(a[0], a[1], a[2], Offset(a[3]));
+      break;
+    case GL_TRACE_ENABLE:
+      glEnable(a[0]);
+      break;
+    case GL_TRACE_ENABLE_VERTEX_ATTRIB_ARRAY:
+      glEnableVertexAttribArray(a[0]);
+      break;
+    case GL_TRACE_FRAMEBUFFER_RENDERBUFFER:
+      glFramebufferRenderbuffer(a[0], a[1], a[2],
+                                Find(r->renderbuffers, a[3]));
+      break;
+    case GL_TRACE_FRAMEBUFFER_TEXTURE_2D:
+      glFramebufferTexture2D(a[0], a[1], a[2], Find(r->textures, a[3]), a[4]);
+      break;
+    case GL_TRACE_FRONT_FACE:
+      glFrontFace(a[0]);
+      break;
+    case GL_TRACE_GEN_BUFFERS:
+      GenNames(&r->buffers, call, glGenBuffers);
+      break;
+    case GL_TRACE_GEN_FRAMEBUFFERS:
+      GenNames(&r->framebuffers, call, glGenFramebuffers);
+      break;
+    case GL_TRACE_GEN_RENDERBUFFERS:
+      GenNames(&r->renderbuffers, call, glGenRenderbuffers);
+      break;
+    case GL_TRACE_GEN_TEXTURES:
+      GenNames(&r->textures, call, glGenTextures);
+      break;
+    case GL_TRACE_GENERATE_MIPMAP:
+      glGenerateMipmap(a[0]);
+      break;
+    case GL_TRACE_GET_UNIFORM_LOCATION:
+      r->uniform_locations[(uint64_t)a[0] << 32 | a[1]] = glGetUniformLocation(
+          Find(r->programs, a[0]), (const GLchar*)call.data);
+      break;
+    case GL_TRACE_LINK_PROGRAM:
+      glLinkProgram(Find(r->programs, a[0]));
+      r->linked_programs.insert(a[0]);
+      break;
+    case GL_TRACE_PIXEL_STOREI:
+      glPixelStorei(a[0], a[1]);
+      break;
+    case GL_TRACE_RENDERBUFFER_STORAGE:
+      glRenderbufferStorage(a[0], a[1], a[2], a[3]);
+      break;
+    case GL_TRACE_SCISSOR:
+      glScissor(a[0], a[1], a[2], a[3]);
+      break;
+    case GL_TRACE_SHADER_SOURCE: {
+      const GLchar* source = (const GLchar*)call.data;
+      glShaderSource(Find(r->shaders, a[0]), 1, &source, NULL);
+      break;
+    }
+    case GL_TRACE_TEX_PARAMETERF:
+      glTexParameterf(a[0], a[1], F(a[2]));
+      break;
+    case GL_TRACE_TEX_PARAMETERI:
+      glTexParameteri(a[0], a[1], a[2]);
+      break;
+    case GL_TRACE_TEX_SUB_IMAGE_2D:
+      // Without pixels only an unpack buffer has them
+      if (!data && !BoundBuffer(*r, GL_PIXEL_UNPACK_BUFFER)) {
+        ++r->unsupported;
+        break;
+      }
+      glTexSubImage2D(a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7], data);
+      break;
+    case GL_TRACE_UNIFORM_1F:
+      glUniform1f(FindLocation(*r, a[0]), F(a[1]));
+      break;
+    case GL_TRACE_UNIFORM_1FV:
+      glUniform1fv(FindLocation(*r, a[0]), a[1], (const GLfloat*)call.data);
+      break;
+    case GL_TRACE_UNIFORM_1I:
+      glUniform1i(FindLocation(*r, a[0]), a[1]);
+      break;
+    case GL_TRACE_UNIFORM_2F:
+      glUniform2f(FindLocation(*r, a[0]), F(a[1]), F(a[2]));
+      break;
+    case GL_TRACE_UNIFORM_3F:
+      glUniform3f(FindLocation(*r, a[0]), F(a[1]), F(a[2]), F(a[3]));
+      break;
+    case GL_TRACE_UNIFORM_4F:
+      glUniform4f(FindLocation(*r, a[0]), F(a[1]), F(a[2]), F(a[3]),
+                  F(a[4]));
+      break;
+    case GL_TRACE_UNIFORM_4FV:
+      glUniform4fv(FindLocation(*r, a[0]), a[1], (const GLfloat*)call.data);
+      break;
+    case GL_TRACE_UNIFORM_MATRIX_4FV:
+      glUniformMatrix4fv(FindLocation(*r, a[0]), a[1], a[2],
+                         (const GLfloat*)call.data);
+      break;
+    case GL_TRACE_USE_PROGRAM:
+      glUseProgram(Find(r->programs, a[0]));
+      break;
+    case GL_TRACE_VERTEX_ATTRIB_POINTER:
+      if (!BoundBuffer(*r, GL_ARRAY_BUFFER)) {
+        ++r->unsupported;
+        break;
+      }
+      glVertexAttribPointer(a[0], a[1], a[2], a[3], a[4], Offset(a[5]));
+      break;
+    case GL_TRACE_VIEWPORT:
+      glViewport(a[0], a[1], a[2], a[3]);
+      break;
+    //--------------------------------------------------------------------
+    // OpenGL ES 3.0
+    //--------------------------------------------------------------------
+    case GL_TRACE_BIND_BUFFER_RANGE:
+      glBindBufferRange(a[0], a[1], Find(r->buffers, a[2]), a[3], a[4]);
+      break;
+    case GL_TRACE_BIND_VERTEX_ARRAY:
+      glBindVertexArray(Find(r->vertex_arrays, a[0]));
+      break;
+    case GL_TRACE_DELETE_VERTEX_ARRAYS:
+      DeleteNames(&r->vertex_arrays, call, glDeleteVertexArrays);
+      break;
+    case GL_TRACE_DRAW_BUFFERS: {
+      std::vector<GLenum> buffers((const GLenum*)call.data,
+                                  (const GLenum*)call.data + a[0]);
+      if (!r->draw_framebuffer) {
+        for (size_t i = 0; i < buffers.size(); ++i)
+          buffers[i] = DefaultAttachment(buffers[i]);
+      }
+      glDrawBuffers(a[0], buffers.data());
+      break;
+    }
+    case GL_TRACE_DRAW_ELEMENTS_INSTANCED:
+      if (!BoundBuffer(*r, GL_ELEMENT_ARRAY_BUFFER)) {
+        ++r->unsupported;
+        break;
+      }
+      glDrawElementsInstanced(a[0], a[1], a[2], Offset(a[3]), a[4]);
+      break;
+    case GL_TRACE_FRAMEBUFFER_TEXTURE_LAYER:
+      glFramebufferTextureLayer(a[0], a[1], Find(r->textures, a[2]), a[3],
+                                a[4]);
+      break;
+    case GL_TRACE_GEN_VERTEX_ARRAYS:
+      GenNames(&r->vertex_arrays, call, glGenVertexArrays);
+      break;
+    case GL_TRACE_GET_UNIFORM_BLOCK_INDEX:
+      r->block_indices[(uint64_t)a[0] << 32 | a[1]] = glGetUniformBlockIndex(
+          Find(r->programs, a[0]), (const GLchar*)call.data);
+      break;
+    case GL_TRACE_INVALIDATE_FRAMEBUFFER: {
+      std::vector<GLenum> attachments((const GLenum*)call.data,
+                                      (const GLenum*)call.data + a[1]);
+      const uint32_t bound = a[0] == GL_READ_FRAMEBUFFER
+                                 ? r->read_framebuffer
+                                 : r->draw_framebuffer;
+      if (!bound) {
+        for (size_t i = 0; i < attachments.size(); ++i)
+          attachments[i] = DefaultAttachment(attachments[i]);
+      }
+      glInvalidateFramebuffer(a[0], a[1], attachments.data());
+      break;
+    }
+    case GL_TRACE_MAP_BUFFER_RANGE:
+      r->mapped[a[0]] = glMapBufferRange(a[0], a[1], a[2], a[3]);
+      break;
+    case GL_TRACE_PROGRAM_BINARY:
+      glProgramBinary(Find(r->programs, a[0]), a[1], call.data, a[2]);
+      r->linked_programs.insert(a[0]);
+      break;
+    case GL_TRACE_PROGRAM_PARAMETERI:
+      glProgramParameteri(Find(r->programs, a[0]), a[1], a[2]);
+      break;
+    case GL_TRACE_TEX_STORAGE_2D:
+      glTexStorage2D(a[0], a[1], a[2], a[3], a[4]);
+      break;
+    case GL_TRACE_TEX_STORAGE_3D:
+      glTexStorage3D(a[0], a[1], a[2], a[3], a[4], a[5]);
+      break;
+    case GL_TRACE_UNIFORM_BLOCK_BINDING:
+      glUniformBlockBinding(Find(r->programs, a[0]),
+                            FindBlockIndex(*r, a[0], a[1]), a[2]);
+      break;
+    case GL_TRACE_UNMAP_BUFFER: {
+      void* mapped = r->mapped[a[0]];
+      if (mapped && data) memcpy(mapped, data, call.data_size);
+      r->mapped.erase(a[0]);
+      glUnmapBuffer(a[0]);
+      break;
+    }
+    case GL_TRACE_VERTEX_ATTRIB_DIVISOR:
+      glVertexAttribDivisor(a[0], a[1]);
+      break;
+  }
+}
+
+// Executes a call, timed with --per-call
+static void Submit(REPLAY* r, const GL_TRACE_CALL& call) {
+  ++r->calls;
+  if (!r->options->per_call) {
+    Execute(r, call);
+    return;
+  }
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  Execute(r, call);
+  r->op_ms[call.op] += std::chrono::duration<double, std::milli>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+  ++r->op_calls[call.op];
+}
+
+static void FlushUploads(REPLAY* r) {
+  PENDING_UPLOAD& pending = r->pending;
+  if (!pending.calls) return;
+  const uint32_t args[3] = {pending.target, pending.offset,
+                            (uint32_t)pending.data.size()};
+  GL_TRACE_CALL call = {GL_TRACE_BUFFER_SUB_DATA, 3, args,
+                        (uint32_t)pending.data.size(), pending.data.data()};
+  Submit(r, call);
+  pending.calls = 0;
+  pending.data.clear();
+}
+
+// --batch-uploads, true when the call joined the pending upload
+static bool BatchUpload(REPLAY* r, const GL_TRACE_CALL& call) {
+  PENDING_UPLOAD& pending = r->pending;
+  if (call.op != GL_TRACE_BUFFER_SUB_DATA) {
+    FlushUploads(r);
+    return false;
+  }
+  const bool follows = pending.calls && pending.target == call.args[0] &&
+                       pending.offset + pending.data.size() == call.args[1];
+  if (!follows) {
+    FlushUploads(r);
+    pending.target = call.args[0];
+    pending.offset = call.args[1];
+  }
+  pending.data.insert(pending.data.end(), call.data,
+                      call.data + call.data_size);
+  ++pending.calls;
+  return follows;
+}
+
+//--------------------------------------------------------------------------------
+// --uploads-first
+//--------------------------------------------------------------------------------
+struct HOISTED {
+  size_t index;
+  uint32_t buffer;
+};
+
+// Uploads of the frame to buffers of earlier frames, with the buffer they
+// went to. Map and unmap move together when nothing is between them.
+static void PlanUploads(const REPLAY& r, const FRAME& frame,
+                        std::vector<HOISTED>* hoisted) {
+  hoisted->clear();
+  std::map<GLenum, uint32_t> bound = r.bound_buffers;
+  std::set<uint32_t> fresh;
+  for (size_t i = 0; i < frame.calls.size(); ++i) {
+    const GL_TRACE_CALL& call = frame.calls[i];
+    const uint32_t* a = call.args;
+    switch (call.op) {
+      case GL_TRACE_BIND_BUFFER:
+        bound[a[0]] = a[1];
+        break;
+      case GL_TRACE_BIND_BUFFER_RANGE:
+        bound[a[0]] = a[2];
+        break;
+      case GL_TRACE_GEN_BUFFERS:
+      case GL_TRACE_DELETE_BUFFERS:
+        for (uint32_t n = 0; n < call.data_size / 4; ++n)
+          fresh.insert(((const uint32_t*)call.data)[n]);
+        break;
+      case GL_TRACE_BUFFER_DATA:
+      case GL_TRACE_BUFFER_SUB_DATA:
+      case GL_TRACE_MAP_BUFFER_RANGE: {
+        // Index buffers belong to the vertex array, leave them in place
+        if (a[0] == GL_ELEMENT_ARRAY_BUFFER) break;
+        const uint32_t buffer = bound[a[0]];
+        if (!buffer || fresh.count(buffer) || !r.buffers.count(buffer)) break;
+        HOISTED upload = {i, buffer};
+        if (call.op != GL_TRACE_MAP_BUFFER_RANGE) {
+          hoisted->push_back(upload);
+        } else if (i + 1 < frame.calls.size() &&
+                   frame.calls[i + 1].op == GL_TRACE_UNMAP_BUFFER &&
+                   frame.calls[i + 1].args[0] == a[0]) {
+          hoisted->push_back(upload);
+          upload.index = i + 1;
+          hoisted->push_back(upload);
+          ++i;
+        }
+        break;
+      }
+      default:
+        break;
+    }
+  }
+}
+
+// The uploads with their buffers bound, then the bindings of the trace back
+static void SubmitUploads(REPLAY* r, const FRAME& frame,
+                          const std::vector<HOISTED>& hoisted) {
+  std::set<GLenum> targets;
+  for (size_t i = 0; i < hoisted.size(); ++i) {
+    const GL_TRACE_CALL& call = frame.calls[hoisted[i].index];
+    glBindBuffer(call.args[0], Find(r->buffers, hoisted[i].buffer));
+    Submit(r, call);
+    targets.insert(call.args[0]);
+  }
+  for (std::set<GLenum>::const_iterator it = targets.begin();
+       it != targets.end(); ++it)
+    glBindBuffer(*it, Find(r->buffers, BoundBuffer(*r, *it)));
+}
+
+//--------------------------------------------------------------------------------
+// Frames
+//--------------------------------------------------------------------------------
+struct RESULT {
+  double captured_ms;
+  double submit_ms;
+  double frame_ms;
+  double gpu_ms;
+  bool gpu_valid;
+  int64_t calls;
+  int64_t skipped;
+  int64_t merged;
+  int64_t hoisted;
+  int64_t draw_calls;
+};
+
+static void ReplayFrame(REPLAY* r, const FRAME& frame,
+                        const host_gl::TIMER_QUERY& timer, const GLuint query,
+                        RESULT* result) {
+  const OPTIONS& options = *r->options;
+  memset(result, 0, sizeof(*result));
+  result->captured_ms = frame.captured_ms;
+  result->gpu_valid = timer.available;
+
+  std::vector<HOISTED> hoisted;
+  std::vector<bool> moved(frame.calls.size(), false);
+  if (options.uploads_first) {
+    PlanUploads(*r, frame, &hoisted);
+    for (size_t i = 0; i < hoisted.size(); ++i) moved[hoisted[i].index] = true;
+  }
+  result->hoisted = hoisted.size();
+
+  const int64_t calls = r->calls;
+  host_gl::GL_COUNTERS before = host_gl::counters;
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  if (timer.available) timer.begin_query(GL_TIME_ELAPSED_EXT, query);
+  SubmitUploads(r, frame, hoisted);
+  for (size_t i = 0; i < frame.calls.size(); ++i) {
+    if (moved[i]) continue;
+    const GL_TRACE_CALL& call = frame.calls[i];
+    if (options.skip[call.op] ||
+        (options.skip_redundant && Redundant(r, call))) {
+      ++result->skipped;
+    } else if (options.batch_uploads && BatchUpload(r, call)) {
+      ++result->merged;
+    } else if (!options.batch_uploads ||
+               call.op != GL_TRACE_BUFFER_SUB_DATA) {
+      Submit(r, call);
+    }
+    InvalidateState(r, call);
+    Track(r, call);
+  }
+  FlushUploads(r);
+  if (timer.available) timer.end_query(GL_TIME_ELAPSED_EXT);
+  std::chrono::steady_clock::time_point submitted =
+      std::chrono::steady_clock::now();
+  glFinish();
+
+  result->submit_ms =
+      std::chrono::duration<double, std::milli>(submitted - start).count();
+  result->frame_ms = std::chrono::duration<double, std::milli>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+  result->calls = r->calls - calls;
+  result->draw_calls = host_gl::counters.draw_calls - before.draw_calls;
+  if (timer.available) {
+    GLint disjoint = 0;
+    glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+    if (disjoint) result->gpu_valid = false;
+    GLuint64 ns = 0;
+    timer.get_query_object_ui64v(query, GL_QUERY_RESULT_EXT, &ns);
+    result->gpu_ms = ns / 1000000.0;
+  }
+}
+
+// Programs of the trace that did not link in the replay, program binaries
+// of another driver among them
+static std::vector<uint32_t> FailedPrograms(const REPLAY& r) {
+  std::vector<uint32_t> failed;
+  for (std::set<uint32_t>::const_iterator it = r.linked_programs.begin();
+       it != r.linked_programs.end(); ++it) {
+    GLuint program = Find(r.programs, *it);
+    if (!program) continue;
+    GLint status = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if (!status) failed.push_back(*it);
+  }
+  return failed;
+}
+
+//--------------------------------------------------------------------------------
+// Reports
+//--------------------------------------------------------------------------------
+// Mean of the frames after frame 0 that ended in the trace
+static RESULT Mean(const std::vector<RESULT>& results) {
+  RESULT mean;
+  memset(&mean, 0, sizeof(mean));
+  mean.gpu_valid = true;
+  int32_t count = 0;
+  for (size_t i = 1; i < results.size(); ++i) {
+    const RESULT& r = results[i];
+    if (r.captured_ms < 0.0) continue;
+    mean.captured_ms += r.captured_ms;
+    mean.submit_ms += r.submit_ms;
+    mean.frame_ms += r.frame_ms;
+    mean.gpu_ms += r.gpu_ms;
+    mean.gpu_valid = mean.gpu_valid && r.gpu_valid;
+    mean.calls += r.calls;
+    mean.skipped += r.skipped;
+    mean.merged += r.merged;
+    mean.hoisted += r.hoisted;
+    mean.draw_calls += r.draw_calls;
+    ++count;
+  }
+  if (!count) {
+    mean.gpu_valid = false;
+    return mean;
+  }
+  mean.captured_ms /= count;
+  mean.submit_ms /= count;
+  mean.frame_ms /= count;
+  mean.gpu_ms /= count;
+  mean.calls /= count;
+  mean.skipped /= count;
+  mean.merged /= count;
+  mean.hoisted /= count;
+  mean.draw_calls /= count;
+  return mean;
+}
+
+static void PrintRow(const char* label, const RESULT& r) {
+  char captured[16];
+  if (r.captured_ms >= 0.0)
+    snprintf(captured, sizeof(captured), "%11.3f", r.captured_ms);
+  else
+    snprintf(captured, sizeof(captured), "%11s", "-");
+  char gpu[16];
+  if (r.gpu_valid)
+    snprintf(gpu, sizeof(gpu), "%10.3f", r.gpu_ms);
+  else
+    snprintf(gpu, sizeof(gpu), "%10s", "-");
+  printf("%-6s %s %10.3f %10.3f %s %8lld %8lld %7lld %8lld %7lld\n", label,
+         captured, r.submit_ms, r.frame_ms, gpu, (long long)r.calls,
+         (long long)r.skipped, (long long)r.merged, (long long)r.hoisted,
+         (long long)r.draw_calls);
+}
+
+static void PrintTable(const std::vector<RESULT>& results) {
+  printf("%-6s %11s %10s %10s %10s %8s %8s %7s %8s %7s\n", "frame",
+         "captured ms", "submit ms", "frame ms", "gpu ms", "calls", "skipped",
+         "merged", "hoisted", "draws");
+  for (size_t i = 0; i < results.size(); ++i) {
+    char label[16];
+    snprintf(label, sizeof(label), "%d", (int32_t)i);
+    PrintRow(label, results[i]);
+  }
+  if (results.size() > 1) PrintRow("mean", Mean(results));
+}
+
+// Entry points by total time
+static std::vector<int32_t> SortOps(const REPLAY& r) {
+  std::vector<int32_t> ops;
+  for (int32_t op = 0; op < GL_TRACE_OP_COUNT; ++op) {
+    if (r.op_calls[op]) ops.push_back(op);
+  }
+  for (size_t i = 1; i < ops.size(); ++i) {
+    for (size_t j = i; j > 0 && r.op_ms[ops[j]] > r.op_ms[ops[j - 1]]; --j)
+      std::swap(ops[j], ops[j - 1]);
+  }
+  return ops;
+}
+
+static void PrintOps(const REPLAY& r) {
+  printf("\n%-26s %10s %10s %10s\n", "entry point", "calls", "total ms",
+         "mean us");
+  std::vector<int32_t> ops = SortOps(r);
+  for (size_t i = 0; i < ops.size(); ++i) {
+    const int32_t op = ops[i];
+    printf("%-26s %10lld %10.3f %10.3f\n", GetGlTraceOpName((GL_TRACE_OP)op),
+           (long long)r.op_calls[op], r.op_ms[op],
+           r.op_ms[op] * 1000.0 / r.op_calls[op]);
+  }
+}
+
+static void WriteResultJson(FILE* out, const RESULT& r) {
+  char captured[32];
+  if (r.captured_ms >= 0.0)
+    snprintf(captured, sizeof(captured), "%.4f", r.captured_ms);
+  else
+    snprintf(captured, sizeof(captured), "null");
+  char gpu[32];
+  if (r.gpu_valid)
+    snprintf(gpu, sizeof(gpu), "%.4f", r.gpu_ms);
+  else
+    snprintf(gpu, sizeof(gpu), "null");
+  fprintf(out, "{\"captured_ms\": %s, \"submit_ms\": %.4f, "
+               "\"frame_ms\": %.4f, \"gpu_ms\": %s, \"calls\": %lld, "
+               "\"skipped\": %lld, \"merged\": %lld, \"hoisted\": %lld, "
+               "\"draw_calls\": %lld}",
+          captured, r.submit_ms, r.frame_ms, gpu, (long long)r.calls,
+          (long long)r.skipped, (long long)r.merged, (long long)r.hoisted,
+          (long long)r.draw_calls);
+}
+
+static void WriteJson(FILE* out, const OPTIONS& options,
+                      const GlTraceReader& reader, const REPLAY& replay,
+                      const std::vector<RESULT>& results,
+                      const std::vector<uint32_t>& failed_programs,
+                      const GLenum error) {
+  fprintf(out, "{\n  \"config\": {\"trace\": \"%s\", \"size\": [%d, %d], "
+               "\"skip\": \"%s\", \"skip_redundant\": %s, "
+               "\"batch_uploads\": %s, \"uploads_first\": %s},\n",
+          options.trace.c_str(), reader.GetWidth(), reader.GetHeight(),
+          options.skip_names.c_str(),
+          options.skip_redundant ? "true" : "false",
+          options.batch_uploads ? "true" : "false",
+          options.uploads_first ? "true" : "false");
+  // Driver strings may hold quotes, keep them out of the JSON
+  std::string renderer;
+  const char* value = (const char*)glGetString(GL_RENDERER);
+  for (const char* c = value ? value : ""; *c; ++c) {
+    if (*c != '"' && *c != '\\') renderer.push_back(*c);
+  }
+  fprintf(out, "  \"gl\": {\"renderer\": \"%s\", \"error\": %u},\n",
+          renderer.c_str(), error);
+  fprintf(out, "  \"unsupported_calls\": %lld,\n",
+          (long long)replay.unsupported);
+  fprintf(out, "  \"failed_programs\": [");
+  for (size_t i = 0; i < failed_programs.size(); ++i)
+    fprintf(out, "%s%u", i ? ", " : "", failed_programs[i]);
+  fprintf(out, "],\n  \"mean\": ");
+  WriteResultJson(out, Mean(results));
+  fprintf(out, ",\n  \"frames\": [\n");
+  for (size_t i = 0; i < results.size(); ++i) {
+    fprintf(out, "    ");
+    WriteResultJson(out, results[i]);
+    fprintf(out, "%s\n", i + 1 < results.size() ? "," : "");
+  }
+  fprintf(out, "  ]");
+  if (options.per_call) {
+    fprintf(out, ",\n  \"calls\": [\n");
+    std::vector<int32_t> ops = SortOps(replay);
+    for (size_t i = 0; i < ops.size(); ++i) {
+      const int32_t op = ops[i];
+      fprintf(out, "    {\"name\": \"%s\", \"calls\": %lld, "
+                   "\"total_ms\": %.4f}%s\n",
+              GetGlTraceOpName((GL_TRACE_OP)op),
+              (long long)replay.op_calls[op], replay.op_ms[op],
+              i + 1 < ops.size() ? "," : "");
+    }
+    fprintf(out, "  ]");
+  }
+  fprintf(out, "\n}\n");
+}
+
+int main(int argc, char** argv) {
+  OPTIONS options;
+  if (!ParseOptions(argc, argv, &options)) return 2;
+
+  GlTraceReader reader;
+  if (!reader.Open(options.trace.c_str())) {
+    fprintf(stderr, "Can not read trace %s\n", options.trace.c_str());
+    return 1;
+  }
+  std::vector<FRAME> frames;
+  if (!LoadFrames(&reader, &frames))
+    fprintf(stderr, "Trace ends inside a call, replaying what came before\n");
+
+  host_gl::CONTEXT ctx;
+  if (!host_gl::CreateContext(&ctx)) {
+    fprintf(stderr, "No OpenGL ES 3 context\n");
+    return 1;
+  }
+  host_gl::TIMER_QUERY timer;
+  host_gl::InitTimerQuery(&timer);
+
+  REPLAY replay;
+  InitReplay(&replay, &options);
+  const int32_t width = reader.GetWidth() > 0 ? reader.GetWidth()
+                                              : DEFAULT_SIZE;
+  const int32_t height = reader.GetHeight() > 0 ? reader.GetHeight()
+                                                : DEFAULT_SIZE;
+  if (!CreateDefaultFramebuffer(&replay, width, height)) {
+    fprintf(stderr, "Can not create a %dx%d framebuffer\n", width, height);
+    host_gl::DestroyContext(&ctx);
+    return 1;
+  }
+
+  GLuint query = 0;
+  if (timer.available) {
+    timer.gen_queries(1, &query);
+    // llvmpipe times the first query of a context from its creation
+    timer.begin_query(GL_TIME_ELAPSED_EXT, query);
+    glClear(GL_COLOR_BUFFER_BIT);
+    timer.end_query(GL_TIME_ELAPSED_EXT);
+    GLuint64 ns = 0;
+    timer.get_query_object_ui64v(query, GL_QUERY_RESULT_EXT, &ns);
+  }
+  std::vector<RESULT> results(frames.size());
+  for (size_t i = 0; i < frames.size(); ++i)
+    ReplayFrame(&replay, frames[i], timer, query, &results[i]);
+  if (timer.available) timer.delete_queries(1, &query);
+  std::vector<uint32_t> failed_programs = FailedPrograms(replay);
+  GLenum error = glGetError();
+
+  bool json_only = options.json == "-";
+  if (!json_only) {
+    printf("%s, %dx%d, %d frames, %.1f MB, %s\n", options.trace.c_str(),
+           width, height, (int32_t)frames.size(),
+           reader.GetSize() / (1024.0 * 1024.0), glGetString(GL_RENDERER));
+    PrintTable(results);
+    if (options.per_call) PrintOps(replay);
+    if (replay.unsupported)
+      printf("%lld calls of client side arrays or unsized pixels skipped\n",
+             (long long)replay.unsupported);
+    for (size_t i = 0; i < failed_programs.size(); ++i)
+      printf("Program %u of the trace does not link\n", failed_programs[i]);
+    if (error != GL_NO_ERROR) printf("GL error 0x%04x\n", error);
+  }
+  if (json_only) {
+    WriteJson(stdout, options, reader, replay, results, failed_programs,
+              error);
+  } else if (!options.json.empty()) {
+    FILE* out = fopen(options.json.c_str(), "w");
+    if (out) {
+      WriteJson(out, options, reader, replay, results, failed_programs,
+                error);
+      fclose(out);
+    } else {
+      fprintf(stderr, "Can not write %s\n", options.json.c_str());
+    }
+  }
+
+  host_gl::DestroyContext(&ctx);
+  return 0;
+}
@@ -0,0 +1,30 @@
+/*
+ * Copyright 2018 Leia Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//--------------------------------------------------------------------------------
+// JNIHelper.h
+// Desktop stand in for the logging of ndk_helper/JNIHelper.h
+//--------------------------------------------------------------------------------
+#ifndef HOST_GLES_JNIHELPER_H_
+#define HOST_GLES_JNIHELPER_H_
+
+#include <stdio.h>
+
+#define LOGI(...) ((void)(fprintf(stderr, "I: " __VA_ARGS__), fputc('\n', stderr)))
+#define LOGW(...) ((void)(fprintf(stderr, "W: " __VA_ARGS__), fputc('\n', stderr)))
+#define LOGE(...) ((void)(fprintf(stderr, "E: " __VA_ARGS__), fputc('\n', stderr)))
+
+#endif /* HOST_GLES_JNIHELPER_H_ */
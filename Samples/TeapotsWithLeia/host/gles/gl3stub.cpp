@@ -0,0 +1,29 @@
+/*
+ * Copyright 2018 Leia Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//--------------------------------------------------------------------------------
+// gl3stub.cpp
+// The gl3stub pointers of the desktop GL build, libGLESv2 until a capture
+// wraps them
+//--------------------------------------------------------------------------------
+#define GL3STUB_IMPLEMENTATION
+#include "gl3stub.h"
+
+#define GL3STUB_DEFINE_PROC(op, ret, name, params, args) \
+  ret(GL_APIENTRY* gl3stub_gl##name) params = gl##name;
+GL3STUB_ES2_CAPTURE_PROCS(GL3STUB_DEFINE_PROC)
+GL3STUB_ES3_CAPTURE_PROCS(GL3STUB_DEFINE_PROC)
+#undef GL3STUB_DEFINE_PROC
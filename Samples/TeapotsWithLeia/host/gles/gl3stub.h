@@ -0,0 +1,180 @@
+/*
+ * Copyright 2018 Leia Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//--------------------------------------------------------------------------------
+// gl3stub.h
+// Desktop stand in for ndk_helper/gl3stub.h: OpenGL ES 3.0 from the system
+// headers (Mesa), plus the draw call, clear and uniform update counters of
+// the benchmarks.
+// Every file of the host GL build sees the counted entry points. The entry
+// points of gl3stubProcs.h are always called through gl3stub pointers, like
+// GL3STUB_CAPTURE builds of the apps, so leia_helper::StartGlCapture() works
+// on the desktop too.
+//--------------------------------------------------------------------------------
+#ifndef HOST_GLES_GL3STUB_H_
+#define HOST_GLES_GL3STUB_H_
+
+#include <stdint.h>
+
+#include <GLES3/gl3.h>
+#include <GLES2/gl2ext.h>
+
+#include "gl3stubProcs.h"
+
+#define GL3STUB_CAPTURE 1
+#define GL3STUB_ES3_POINTER(name) gl3stub_gl##name
+
+inline GLboolean gl3stubInit() { return GL_TRUE; }
+
+// The captured entry points, gl3stub.cpp points them to libGLESv2 until a
+// capture wraps them
+#define GL3STUB_DECLARE_PROC(op, ret, name, params, args) \
+  extern ret(GL_APIENTRY* gl3stub_gl##name) params;
+GL3STUB_ES2_CAPTURE_PROCS(GL3STUB_DECLARE_PROC)
+GL3STUB_ES3_CAPTURE_PROCS(GL3STUB_DECLARE_PROC)
+#undef GL3STUB_DECLARE_PROC
+
+namespace host_gl {
+
+struct GL_COUNTERS {
+  int64_t draw_calls;
+  int64_t clears;
+  int64_t uniform_calls;
+};
+
+extern GL_COUNTERS counters;
+
+// The counted calls, through the pointers so that a capture sees them
+inline void DrawArrays(GLenum mode, GLint first, GLsizei count) {
+  ++counters.draw_calls;
+  gl3stub_glDrawArrays(mode, first, count);
+}
+
+inline void DrawElements(GLenum mode, GLsizei count, GLenum type,
+                         const void* indices) {
+  ++counters.draw_calls;
+  gl3stub_glDrawElements(mode, count, type, indices);
+}
+
+inline void DrawElementsInstanced(GLenum mode, GLsizei count, GLenum type,
+                                  const void* indices, GLsizei instances) {
+  ++counters.draw_calls;
+  gl3stub_glDrawElementsInstanced(mode, count, type, indices, instances);
+}
+
+inline void Clear(GLbitfield mask) {
+  ++counters.clears;
+  gl3stub_glClear(mask);
+}
+
+inline void Uniform3f(GLint location, GLfloat x, GLfloat y, GLfloat z) {
+  ++counters.uniform_calls;
+  gl3stub_glUniform3f(location, x, y, z);
+}
+
+inline void Uniform4f(GLint location, GLfloat x, GLfloat y, GLfloat z,
+                      GLfloat w) {
+  ++counters.uniform_calls;
+  gl3stub_glUniform4f(location, x, y, z, w);
+}
+
+inline void UniformMatrix4fv(GLint location, GLsizei count,
+                             GLboolean transpose, const GLfloat* value) {
+  ++counters.uniform_calls;
+  gl3stub_glUniformMatrix4fv(location, count, transpose, value);
+}
+
+}  // namespace host_gl
+
+// gl3stub.cpp defines the pointers with the names of the functions
+#ifndef GL3STUB_IMPLEMENTATION
+#define glActiveTexture gl3stub_glActiveTexture
+#define glAttachShader gl3stub_glAttachShader
+#define glBindAttribLocation gl3stub_glBindAttribLocation
+#define glBindBuffer gl3stub_glBindBuffer
+#define glBindFramebuffer gl3stub_glBindFramebuffer
+#define glBindRenderbuffer gl3stub_glBindRenderbuffer
+#define glBindTexture gl3stub_glBindTexture
+#define glBufferData gl3stub_glBufferData
+#define glBufferSubData gl3stub_glBufferSubData
+#define glClear host_gl::Clear
+#define glClearColor gl3stub_glClearColor
+#define glClearDepthf gl3stub_glClearDepthf
+#define glCompileShader gl3stub_glCompileShader
+#define glCreateProgram gl3stub_glCreateProgram
+#define glCreateShader gl3stub_glCreateShader
+#define glDeleteBuffers gl3stub_glDeleteBuffers
+#define glDeleteFramebuffers gl3stub_glDeleteFramebuffers
+#define glDeleteProgram gl3stub_glDeleteProgram
+#define glDeleteRenderbuffers gl3stub_glDeleteRenderbuffers
+#define glDeleteShader gl3stub_glDeleteShader
+#define glDeleteTextures gl3stub_glDeleteTextures
+#define glDepthFunc gl3stub_glDepthFunc
+#define glDepthMask gl3stub_glDepthMask
+#define glDisable gl3stub_glDisable
+#define glDisableVertexAttribArray gl3stub_glDisableVertexAttribArray
+#define glDrawArrays host_gl::DrawArrays
+#define glDrawElements host_gl::DrawElements
+#define glEnable gl3stub_glEnable
+#define glEnableVertexAttribArray gl3stub_glEnableVertexAttribArray
+#define glFramebufferRenderbuffer gl3stub_glFramebufferRenderbuffer
+#define glFramebufferTexture2D gl3stub_glFramebufferTexture2D
+#define glFrontFace gl3stub_glFrontFace
+#define glGenBuffers gl3stub_glGenBuffers
+#define glGenFramebuffers gl3stub_glGenFramebuffers
+#define glGenRenderbuffers gl3stub_glGenRenderbuffers
+#define glGenTextures gl3stub_glGenTextures
+#define glGenerateMipmap gl3stub_glGenerateMipmap
+#define glGetUniformLocation gl3stub_glGetUniformLocation
+#define glLinkProgram gl3stub_glLinkProgram
+#define glPixelStorei gl3stub_glPixelStorei
+#define glRenderbufferStorage gl3stub_glRenderbufferStorage
+#define glScissor gl3stub_glScissor
+#define glShaderSource gl3stub_glShaderSource
+#define glTexParameterf gl3stub_glTexParameterf
+#define glTexParameteri gl3stub_glTexParameteri
+#define glTexSubImage2D gl3stub_glTexSubImage2D
+#define glUniform1f gl3stub_glUniform1f
+#define glUniform1fv gl3stub_glUniform1fv
+#define glUniform1i gl3stub_glUniform1i
+#define glUniform2f gl3stub_glUniform2f
+#define glUniform3f host_gl::Uniform3f
+#define glUniform4f host_gl::Uniform4f
+#define glUniform4fv gl3stub_glUniform4fv
+#define glUniformMatrix4fv host_gl::UniformMatrix4fv
+#define glUseProgram gl3stub_glUseProgram
+#define glVertexAttribPointer gl3stub_glVertexAttribPointer
+#define glViewport gl3stub_glViewport
+#define glBindBufferRange gl3stub_glBindBufferRange
+#define glBindVertexArray gl3stub_glBindVertexArray
+#define glDeleteVertexArrays gl3stub_glDeleteVertexArrays
+#define glDrawBuffers gl3stub_glDrawBuffers
+#define glDrawElementsInstanced host_gl::DrawElementsInstanced
+#define glFramebufferTextureLayer gl3stub_glFramebufferTextureLayer
+#define glGenVertexArrays gl3stub_glGenVertexArrays
+#define glGetUniformBlockIndex gl3stub_glGetUniformBlockIndex
+#define glInvalidateFramebuffer gl3stub_glInvalidateFramebuffer
+#define glMapBufferRange gl3stub_glMapBufferRange
+#define glProgramBinary gl3stub_glProgramBinary
+#define glProgramParameteri gl3stub_glProgramParameteri
+#define glTexStorage2D gl3stub_glTexStorage2D
+#define glTexStorage3D gl3stub_glTexStorage3D
+#define glUniformBlockBinding gl3stub_glUniformBlockBinding
+#define glUnmapBuffer gl3stub_glUnmapBuffer
+#define glVertexAttribDivisor gl3stub_glVertexAttribDivisor
+#endif
+
+#endif /* HOST_GLES_GL3STUB_H_ */
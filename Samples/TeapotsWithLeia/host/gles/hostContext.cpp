@@ -0,0 +1,97 @@
+/*
+ * Copyright 2018 Leia Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//--------------------------------------------------------------------------------
+// hostContext.cpp
+// Headless EGL context and timer queries of the GL benchmarks
+//--------------------------------------------------------------------------------
+#include <string.h>
+
+#include "hostContext.h"
+
+namespace host_gl {
+
+bool CreateContext(CONTEXT* ctx) {
+  ctx->display = EGL_NO_DISPLAY;
+  ctx->surface = EGL_NO_SURFACE;
+  PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+      (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress(
+          "eglGetPlatformDisplayEXT");
+  if (get_platform_display) {
+    ctx->display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA,
+                                        EGL_DEFAULT_DISPLAY, NULL);
+  }
+  bool surfaceless = ctx->display != EGL_NO_DISPLAY &&
+                     eglInitialize(ctx->display, NULL, NULL);
+  if (!surfaceless) {
+    ctx->display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (!eglInitialize(ctx->display, NULL, NULL)) return false;
+  }
+  eglBindAPI(EGL_OPENGL_ES_API);
+
+  const EGLint config_attribs[] = {
+      EGL_RENDERABLE_TYPE, EGL_OPENGL_ES3_BIT_KHR, EGL_SURFACE_TYPE,
+      surfaceless ? 0 : EGL_PBUFFER_BIT, EGL_NONE};
+  EGLConfig config;
+  EGLint num_configs = 0;
+  if (!eglChooseConfig(ctx->display, config_attribs, &config, 1,
+                       &num_configs) ||
+      num_configs < 1)
+    return false;
+
+  const EGLint context_attribs[] = {EGL_CONTEXT_CLIENT_VERSION, 3, EGL_NONE};
+  ctx->context =
+      eglCreateContext(ctx->display, config, EGL_NO_CONTEXT, context_attribs);
+  if (ctx->context == EGL_NO_CONTEXT) return false;
+  if (!surfaceless) {
+    // Everything renders to framebuffer objects, the pbuffer is only there
+    // to make the context current
+    const EGLint pbuffer_attribs[] = {EGL_WIDTH, 16, EGL_HEIGHT, 16, EGL_NONE};
+    ctx->surface =
+        eglCreatePbufferSurface(ctx->display, config, pbuffer_attribs);
+  }
+  return eglMakeCurrent(ctx->display, ctx->surface, ctx->surface,
+                        ctx->context) == EGL_TRUE;
+}
+
+void DestroyContext(CONTEXT* ctx) {
+  eglMakeCurrent(ctx->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+  if (ctx->surface != EGL_NO_SURFACE)
+    eglDestroySurface(ctx->display, ctx->surface);
+  eglDestroyContext(ctx->display, ctx->context);
+  eglTerminate(ctx->display);
+}
+
+void InitTimerQuery(TIMER_QUERY* timer) {
+  memset(timer, 0, sizeof(*timer));
+  const char* extensions = (const char*)glGetString(GL_EXTENSIONS);
+  if (!extensions || !strstr(extensions, "GL_EXT_disjoint_timer_query"))
+    return;
+  timer->gen_queries =
+      (PFNGLGENQUERIESEXTPROC)eglGetProcAddress("glGenQueriesEXT");
+  timer->delete_queries =
+      (PFNGLDELETEQUERIESEXTPROC)eglGetProcAddress("glDeleteQueriesEXT");
+  timer->begin_query =
+      (PFNGLBEGINQUERYEXTPROC)eglGetProcAddress("glBeginQueryEXT");
+  timer->end_query = (PFNGLENDQUERYEXTPROC)eglGetProcAddress("glEndQueryEXT");
+  timer->get_query_object_ui64v = (PFNGLGETQUERYOBJECTUI64VEXTPROC)
+      eglGetProcAddress("glGetQueryObjectui64vEXT");
+  timer->available = timer->gen_queries && timer->delete_queries &&
+                     timer->begin_query && timer->end_query &&
+                     timer->get_query_object_ui64v;
+}
+
+}  // namespace host_gl
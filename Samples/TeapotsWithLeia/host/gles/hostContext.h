@@ -0,0 +1,55 @@
+/*
+ * Copyright 2018 Leia Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//--------------------------------------------------------------------------------
+// hostContext.h
+// Headless OpenGL ES 3 context and GPU timers of the GL benchmarks
+//--------------------------------------------------------------------------------
+#ifndef HOST_GLES_HOSTCONTEXT_H_
+#define HOST_GLES_HOSTCONTEXT_H_
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include "gl3stub.h"
+
+namespace host_gl {
+
+struct CONTEXT {
+  EGLDisplay display;
+  EGLSurface surface;
+  EGLContext context;
+};
+
+// Surfaceless, or a pbuffer when the platform has no surfaceless display.
+// Everything renders to framebuffer objects.
+bool CreateContext(CONTEXT* ctx);
+void DestroyContext(CONTEXT* ctx);
+
+// GL_EXT_disjoint_timer_query entry points, available is false without it
+struct TIMER_QUERY {
+  PFNGLGENQUERIESEXTPROC gen_queries;
+  PFNGLDELETEQUERIESEXTPROC delete_queries;
+  PFNGLBEGINQUERYEXTPROC begin_query;
+  PFNGLENDQUERYEXTPROC end_query;
+  PFNGLGETQUERYOBJECTUI64VEXTPROC get_query_object_ui64v;
+  bool available;
+};
+
+void InitTimerQuery(TIMER_QUERY* timer);
+
+}  // namespace host_gl
+#endif /* HOST_GLES_HOSTCONTEXT_H_ */
@@ -0,0 +1,66 @@
+/*
+ * Copyright 2018 Leia Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//--------------------------------------------------------------------------------
+// hostGL.cpp
+// Shader helpers and counters of the desktop GL build
+//--------------------------------------------------------------------------------
+#include <stdlib.h>
+
+#include "JNIHelper.h"
+#include "shader.h"
+
+namespace host_gl {
+GL_COUNTERS counters = {0, 0, 0};
+}  // namespace host_gl
+
+namespace ndk_helper {
+
+bool shader::CompileShader(GLuint *shader, const GLenum type,
+                           const GLchar *source, const int32_t iSize) {
+  if (source == NULL || iSize <= 0) return false;
+
+  *shader = glCreateShader(type);
+  glShaderSource(*shader, 1, &source, &iSize);
+  glCompileShader(*shader);
+
+  GLint status;
+  glGetShaderiv(*shader, GL_COMPILE_STATUS, &status);
+  if (status == 0) {
+    // Desktop drivers give useful logs, always print them
+    GLchar log[1024];
+    glGetShaderInfoLog(*shader, sizeof(log), NULL, log);
+    LOGE("Shader compile log:\n%s", log);
+    glDeleteShader(*shader);
+    return false;
+  }
+  return true;
+}
+
+bool shader::LinkProgram(const GLuint prog) {
+  GLint status;
+  glLinkProgram(prog);
+  glGetProgramiv(prog, GL_LINK_STATUS, &status);
+  if (status == 0) {
+    GLchar log[1024];
+    glGetProgramInfoLog(prog, sizeof(log), NULL, log);
+    LOGE("Program link log:\n%s", log);
+    return false;
+  }
+  return true;
+}
+
+}  // namespace ndk_helper
@@ -0,0 +1,36 @@
+/*
+ * Copyright 2018 Leia Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//--------------------------------------------------------------------------------
+// shader.h
+// Desktop stand in for ndk_helper/shader.h, the entry points that do not
+// read Android assets
+//--------------------------------------------------------------------------------
+#ifndef HOST_GLES_SHADER_H_
+#define HOST_GLES_SHADER_H_
+
+#include "gl3stub.h"
+
+namespace ndk_helper {
+namespace shader {
+
+bool CompileShader(GLuint *shader, const GLenum type, const GLchar *source,
+                   const int32_t iSize);
+bool LinkProgram(const GLuint prog);
+
+}  // namespace shader
+}  // namespace ndk_helper
+#endif /* HOST_GLES_SHADER_H_ */
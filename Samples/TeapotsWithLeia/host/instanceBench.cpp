@@ -0,0 +1,832 @@
+/*
+ * Copyright 2018 Leia Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//--------------------------------------------------------------------------------
+// instanceBench.cpp
+// Scene submission of MoreTeapotsRenderer from 1k to 100k teapots, in a
+// headless EGL context, the way RenderViewsAtlas() and RenderViewsMultiview()
+// draw them:
+//   loop       a uniform update and a draw per teapot and view, RenderView()
+//              with the GLSL 100 shader
+//   instanced  model views to the instance buffer, one instanced draw per
+//              view, RenderViewInstanced()
+//   multiview  one instanced draw for every view, when the driver has
+//              GL_OVR_multiview2
+//
+// Teapots are culled against the view frusta like CullTeapots(), the loop
+// and instanced modes draw each teapot in the views it is inside of, the
+// multiview mode every teapot inside their union. --spread scales the grid
+// of teapots, 1 fits the views, larger leaves more outside.
+//
+// Per mode and teapot count: CPU time of the submission (culling, the MVP
+// products and uniform calls of the loop, the instance upload of the
+// others), teapots inside the union and draws of a teapot in a view, frame
+// time until glFinish() returns, GPU time from GL_EXT_disjoint_timer_query
+// when the driver has it, draw and uniform calls and bytes handed to GL per
+// frame. Software rasterizers spend most of the frame shading, --triangles
+// draws only the first triangles of each teapot to keep the submission
+// visible. The default of 1 lets the whole sweep finish in seconds on
+// llvmpipe, --triangles=0 draws full teapots, for GPUs.
+//
+// usage: instance-bench [--teapots=1000,10000,100000] [--views=4]
+//                       [--view-size=160x90] [--frames=10] [--triangles=1]
+//                       [--mode=all|loop|instanced|multiview] [--spread=S]
+//                       [--no-cull] [--json=PATH|-] [--capture=PATH]
+//
+// --capture writes the GL calls of every run to a trace for gl-replay.
+//--------------------------------------------------------------------------------
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "attachmentPolicy.h"
+#include "cameraBuffer.h"
+#include "cpuInterlacer.h"
+#include "frustumCulling.h"
+#include "glCapture.h"
+#include "gl3stub.h"
+#include "hostContext.h"
+#include "multiview.h"
+#include "programBuilder.h"
+#include "renderContext.h"
+#include "renderTargetPool.h"
+#include "viewAtlas.h"
+#include "viewTransforms.h"
+
+#include "teapot.inl"
+
+using namespace leia_helper;
+
+static const float CAM_NEAR = 5.0f;
+static const float CAM_FAR = 10000.0f;
+static const float CAM_Z = 800.0f;
+static const float VERTICAL_FOV = 38.6f;
+static const float BASELINE = 4.0f;
+static const float CONVERGENCE_DISTANCE = 800.0f;
+static const int32_t WARMUP_FRAMES = 2;
+
+// Attribute locations of MoreTeapotsRenderer
+enum ATTRIB {
+  ATTRIB_VERTEX,
+  ATTRIB_NORMAL,
+  ATTRIB_COLOR,
+  ATTRIB_UV,
+  ATTRIB_MODEL_VIEW
+};
+static const PROGRAM_ATTRIBUTE TEAPOT_ATTRIBUTES[] = {
+    {ATTRIB_VERTEX, "myVertex"},
+    {ATTRIB_NORMAL, "myNormal"},
+    {ATTRIB_COLOR, "myColor"},
+    {ATTRIB_MODEL_VIEW, "myModelView"}};
+
+enum MODE { MODE_LOOP, MODE_INSTANCED, MODE_MULTIVIEW, MODE_COUNT };
+static const char* MODE_NAMES[MODE_COUNT] = {"loop", "instanced",
+                                             "multiview"};
+
+//--------------------------------------------------------------------------------
+// Options
+//--------------------------------------------------------------------------------
+struct OPTIONS {
+  std::vector<int32_t> teapots;
+  int32_t num_views;
+  int32_t view_width;
+  int32_t view_height;
+  int32_t frames;
+  int32_t triangles;
+  float spread;
+  bool cull;
+  std::string mode;
+  std::string json;
+  std::string capture;
+};
+
+static bool ParseOptions(int argc, char** argv, OPTIONS* options) {
+  options->num_views = 4;
+  options->view_width = 160;
+  options->view_height = 90;
+  options->frames = 10;
+  options->triangles = 1;
+  options->spread = 1.0f;
+  options->cull = true;
+  options->mode = "all";
+  const char* teapots = "1000,10000,100000";
+  for (int i = 1; i < argc; ++i) {
+    const char* arg = argv[i];
+    const char* value = strchr(arg, '=');
+    value = value ? value + 1 : "";
+    bool ok = true;
+    if (!strncmp(arg, "--teapots=", 10)) {
+      teapots = value;
+    } else if (!strncmp(arg, "--views=", 8)) {
+      options->num_views = atoi(value);
+      ok = options->num_views > 0 &&
+           options->num_views <= CAMERA_BLOCK_MAX_VIEWS;
+    } else if (!strncmp(arg, "--view-size=", 12)) {
+      ok = sscanf(value, "%dx%d", &options->view_width,
+                  &options->view_height) == 2 &&
+           options->view_width > 0 && options->view_height > 0;
+    } else if (!strncmp(arg, "--frames=", 9)) {
+      options->frames = atoi(value);
+      ok = options->frames > 0;
+    } else if (!strncmp(arg, "--triangles=", 12)) {
+      options->triangles = atoi(value);
+      ok = options->triangles >= 0;
+    } else if (!strncmp(arg, "--spread=", 9)) {
+      options->spread = (float)atof(value);
+      ok = options->spread > 0.0f;
+    } else if (!strcmp(arg, "--no-cull")) {
+      options->cull = false;
+    } else if (!strncmp(arg, "--mode=", 7)) {
+      options->mode = value;
+    } else if (!strncmp(arg, "--json=", 7)) {
+      options->json = value;
+    } else if (!strncmp(arg, "--capture=", 10)) {
+      options->capture = value;
+    } else {
+      ok = false;
+    }
+    if (!ok) {
+      fprintf(stderr, "Bad argument %s\n", arg);
+      return false;
+    }
+  }
+  for (const char* p = teapots; *p;) {
+    int32_t count = atoi(p);
+    if (count <= 0) {
+      fprintf(stderr, "Bad teapot count in %s\n", teapots);
+      return false;
+    }
+    options->teapots.push_back(count);
+    p = strchr(p, ',');
+    if (!p) break;
+    ++p;
+  }
+  return true;
+}
+
+//--------------------------------------------------------------------------------
+// Programs
+//--------------------------------------------------------------------------------
+static bool ReadShader(const char* name,
+                       const std::map<std::string, std::string>& defines,
+                       std::string* source) {
+  std::string path = std::string(TEAPOT_SHADER_DIR "/") + name;
+  FILE* file = fopen(path.c_str(), "rb");
+  if (!file) {
+    fprintf(stderr, "Can not open %s\n", path.c_str());
+    return false;
+  }
+  char buffer[4096];
+  size_t size;
+  while ((size = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    source->append(buffer, size);
+  fclose(file);
+  // Like shader::ReadShader() of ndk_helper
+  std::map<std::string, std::string>::const_iterator it;
+  for (it = defines.begin(); it != defines.end(); ++it) {
+    size_t pos;
+    while ((pos = source->find(it->first)) != std::string::npos)
+      source->replace(pos, it->first.size(), it->second);
+  }
+  return true;
+}
+
+static GLuint LoadProgram(const char* vsh, const char* fsh,
+                          const std::map<std::string, std::string>& defines) {
+  std::string vert_source, frag_source;
+  if (!ReadShader(vsh, defines, &vert_source) ||
+      !ReadShader(fsh, defines, &frag_source))
+    return 0;
+  return CreateProgram("more-teapots", vert_source.c_str(),
+                       frag_source.c_str(), TEAPOT_ATTRIBUTES,
+                       sizeof(TEAPOT_ATTRIBUTES) / sizeof(TEAPOT_ATTRIBUTES[0]));
+}
+
+//--------------------------------------------------------------------------------
+// Scene
+// A cube of teapots in front of the camera, spinning like those of
+// MoreTeapotsRenderer
+//--------------------------------------------------------------------------------
+struct SCENE {
+  GLuint loop_program;
+  GLint matrix_projection;
+  GLint matrix_view;
+  GLint light0;
+  GLint material_diffuse;
+  GLint material_ambient;
+  GLint material_specular;
+  GLuint instanced_program;
+  GLint instanced_projection;
+  GLuint multiview_program;
+
+  GLuint vbo;
+  GLuint ibo;
+  GLuint instance_vbo;
+  GLuint vao;
+  int32_t num_indices;
+  int32_t num_vertices;
+  float bounds[4];
+
+  int32_t num_views;
+  int32_t num_teapots;
+  float spread;
+  bool cull;
+  std::vector<float> projections;
+  std::vector<float> colors;
+  InstanceTransforms teapots;
+  MatrixBuffer model_views;
+
+  // Teapots left by CullScene(), every teapot in every view without culling
+  FrustumCuller culler;
+  std::vector<int32_t> all_visible;
+  std::vector<uint32_t> all_masks;
+  const int32_t* visible;
+  const uint32_t* masks;
+  int32_t num_visible;
+  int32_t view_draws;
+
+  MatrixBuffer visible_model_views;
+  MatrixBuffer mvps;
+  std::vector<float> instance_data;
+  std::vector<int32_t> view_first_instances;
+  int64_t upload_bytes;
+
+  CameraBuffer camera_buffer;
+  ViewAtlas atlas;
+  MultiviewTarget multiview;
+};
+
+// Instance attributes of MoreTeapotsRenderer: model view, color, padding
+static const int32_t INSTANCE_FLOATS = 20;
+
+// Off axis projection of view i, converged at CONVERGENCE_DISTANCE
+static void ViewProjection(const OPTIONS& options, int32_t view, float* m) {
+  const float to_radians = 3.14159f / 180.0f;
+  float n = CAM_NEAR;
+  float f = CAM_FAR;
+  float top = n * tanf(0.5f * VERTICAL_FOV * to_radians);
+  float right = top * options.view_width / options.view_height;
+  float offset = BASELINE * (view - 0.5f * (options.num_views - 1));
+  float shift = offset * n / CONVERGENCE_DISTANCE;
+  float l = -right - shift;
+  float r = right - shift;
+  memset(m, 0, 16 * sizeof(float));
+  m[0] = 2.0f * n / (r - l);
+  m[5] = n / top;
+  m[8] = (r + l) / (r - l);
+  m[10] = -(f + n) / (f - n);
+  m[11] = -1.0f;
+  m[12] = -offset * m[0];
+  m[14] = -2.0f * f * n / (f - n);
+}
+
+static bool InitScene(const OPTIONS& options, SCENE* scene) {
+  std::map<std::string, std::string> defines;
+  defines[CAMERA_BLOCK_TAG] = CAMERA_BLOCK_SOURCE;
+  defines["%MULTIVIEW%"] = "";
+  scene->loop_program =
+      LoadProgram("VS_ShaderPlain.vsh", "ShaderPlain.fsh", defines);
+  scene->instanced_program =
+      LoadProgram("VS_ShaderPlainES3.vsh", "ShaderPlainES3.fsh", defines);
+  if (!scene->loop_program || !scene->instanced_program) return false;
+  GLuint program = scene->loop_program;
+  scene->matrix_projection = glGetUniformLocation(program, "uPMatrix");
+  scene->matrix_view = glGetUniformLocation(program, "uMVMatrix");
+  scene->light0 = glGetUniformLocation(program, "vLight0");
+  scene->material_diffuse = glGetUniformLocation(program, "vMaterialDiffuse");
+  scene->material_ambient = glGetUniformLocation(program, "vMaterialAmbient");
+  scene->material_specular =
+      glGetUniformLocation(program, "vMaterialSpecular");
+  scene->instanced_projection =
+      glGetUniformLocation(scene->instanced_program, "uPMatrix");
+
+  scene->num_views = options.num_views;
+  scene->spread = options.spread;
+  scene->cull = options.cull;
+  scene->multiview_program = 0;
+  if (InitMultiview(options.num_views)) {
+    char num_views[16];
+    snprintf(num_views, sizeof(num_views), "%d", options.num_views);
+    defines["%MULTIVIEW%"] =
+        std::string("#extension GL_OVR_multiview2 : require\n"
+                    "layout(num_views = ") + num_views + ") in;\n"
+        "#define MULTIVIEW 1";
+    scene->multiview_program =
+        LoadProgram("VS_ShaderPlainES3.vsh", "ShaderPlainES3.fsh", defines);
+    if (scene->multiview_program &&
+        !scene->multiview.Init(options.view_width, options.view_height,
+                               options.num_views)) {
+      LeiaRenderContext::GetInstance()->DeleteProgram(
+          &scene->multiview_program);
+    }
+  }
+
+  scene->num_vertices =
+      sizeof(teapotPositions) / sizeof(teapotPositions[0]) / 3;
+  std::vector<float> vertices(scene->num_vertices * 6);
+  for (int32_t i = 0; i < scene->num_vertices; ++i) {
+    memcpy(&vertices[i * 6], &teapotPositions[i * 3], 3 * sizeof(float));
+    memcpy(&vertices[i * 6 + 3], &teapotNormals[i * 3], 3 * sizeof(float));
+  }
+  glGenBuffers(1, &scene->vbo);
+  glBindBuffer(GL_ARRAY_BUFFER, scene->vbo);
+  glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), &vertices[0],
+               GL_STATIC_DRAW);
+  scene->num_indices = sizeof(teapotIndices) / sizeof(teapotIndices[0]);
+  if (options.triangles && options.triangles * 3 < scene->num_indices)
+    scene->num_indices = options.triangles * 3;
+  glGenBuffers(1, &scene->ibo);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, scene->ibo);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(teapotIndices), teapotIndices,
+               GL_STATIC_DRAW);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+  glGenBuffers(1, &scene->instance_vbo);
+
+  // Bounding sphere of MoreTeapotsRenderer::Init()
+  float bounds_min[3], bounds_max[3];
+  for (int32_t c = 0; c < 3; ++c)
+    bounds_min[c] = bounds_max[c] = teapotPositions[c];
+  for (int32_t i = 0; i < scene->num_vertices * 3; ++i) {
+    bounds_min[i % 3] = fminf(bounds_min[i % 3], teapotPositions[i]);
+    bounds_max[i % 3] = fmaxf(bounds_max[i % 3], teapotPositions[i]);
+  }
+  scene->bounds[3] = 0.0f;
+  for (int32_t c = 0; c < 3; ++c)
+    scene->bounds[c] = 0.5f * (bounds_min[c] + bounds_max[c]);
+  for (int32_t i = 0; i < scene->num_vertices; ++i) {
+    float dx = teapotPositions[i * 3] - scene->bounds[0];
+    float dy = teapotPositions[i * 3 + 1] - scene->bounds[1];
+    float dz = teapotPositions[i * 3 + 2] - scene->bounds[2];
+    scene->bounds[3] = fmaxf(scene->bounds[3], dx * dx + dy * dy + dz * dz);
+  }
+  scene->bounds[3] = sqrtf(scene->bounds[3]);
+
+  // The instance vertex array of MoreTeapotsRenderer::UploadInstances(), the
+  // instance attributes are pointed by BindInstances()
+  glGenVertexArrays(1, &scene->vao);
+  glBindVertexArray(scene->vao);
+  glBindBuffer(GL_ARRAY_BUFFER, scene->vbo);
+  glVertexAttribPointer(ATTRIB_VERTEX, 3, GL_FLOAT, GL_FALSE,
+                        6 * sizeof(float), (char*)0);
+  glEnableVertexAttribArray(ATTRIB_VERTEX);
+  glVertexAttribPointer(ATTRIB_NORMAL, 3, GL_FLOAT, GL_FALSE,
+                        6 * sizeof(float), (char*)0 + 3 * sizeof(float));
+  glEnableVertexAttribArray(ATTRIB_NORMAL);
+  glVertexAttribDivisor(ATTRIB_COLOR, 1);
+  glEnableVertexAttribArray(ATTRIB_COLOR);
+  for (int32_t column = 0; column < 4; ++column) {
+    glVertexAttribDivisor(ATTRIB_MODEL_VIEW + column, 1);
+    glEnableVertexAttribArray(ATTRIB_MODEL_VIEW + column);
+  }
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, scene->ibo);
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+  scene->projections.resize(options.num_views * 16);
+  for (int32_t v = 0; v < options.num_views; ++v)
+    ViewProjection(options, v, &scene->projections[v * 16]);
+  const float light0[3] = {100.0f, -200.0f, -600.0f};
+  const float material_ambient[3] = {0.1f, 0.1f, 0.1f};
+  const float material_specular[4] = {1.0f, 1.0f, 1.0f, 10.0f};
+  scene->camera_buffer.SetViewProjections(&scene->projections[0], 16,
+                                          options.num_views);
+  scene->camera_buffer.SetLight(light0, material_ambient, material_specular);
+  scene->culler.SetViews(&scene->projections[0], 16, options.num_views);
+
+  return scene->atlas.Init(options.view_width, options.view_height,
+                           options.num_views, DEFAULT_ATTACHMENT_POLICY);
+}
+
+// Teapots on a grid filling a cube of 500 units times the spread, colors and
+// spin speeds from a fixed seed
+static void SetTeapotCount(SCENE* scene, int32_t num_teapots) {
+  scene->num_teapots = num_teapots;
+  int32_t side = (int32_t)ceilf(cbrtf((float)num_teapots));
+  float size = 500.0f * scene->spread;
+  float gap = side > 1 ? size / (side - 1) : 0.0f;
+  scene->colors.resize(num_teapots * 3);
+  scene->teapots.Resize(num_teapots);
+  srand(1);
+  for (int32_t i = 0; i < num_teapots; ++i) {
+    for (int32_t c = 0; c < 3; ++c)
+      scene->colors[i * 3 + c] = rand() / float(RAND_MAX * 1.1);
+    float rotation_x = rand() / float(RAND_MAX) - 0.5f;
+    float rotation_y = rand() / float(RAND_MAX) - 0.5f;
+    scene->teapots.Set(i, (i % side) * gap - 0.5f * size,
+                       (i / side % side) * gap - 0.5f * size,
+                       (i / (side * side)) * gap - 0.5f * size,
+                       rotation_x * 3.14159f, rotation_y * 3.14159f,
+                       rotation_x * 0.05f, rotation_y * 0.05f);
+  }
+  scene->model_views.Resize(num_teapots);
+  scene->all_visible.resize(num_teapots);
+  scene->all_masks.assign(num_teapots, (1u << scene->num_views) - 1);
+  for (int32_t i = 0; i < num_teapots; ++i) scene->all_visible[i] = i;
+}
+
+static void UnloadScene(SCENE* scene) {
+  LeiaRenderContext* context = LeiaRenderContext::GetInstance();
+  context->DeleteProgram(&scene->loop_program);
+  context->DeleteProgram(&scene->instanced_program);
+  context->DeleteProgram(&scene->multiview_program);
+  glDeleteVertexArrays(1, &scene->vao);
+  glDeleteBuffers(1, &scene->vbo);
+  glDeleteBuffers(1, &scene->ibo);
+  glDeleteBuffers(1, &scene->instance_vbo);
+  scene->camera_buffer.Unload();
+  scene->atlas.Unload();
+  scene->multiview.Unload();
+  RenderTargetPool::GetInstance()->Unload();
+  context->Unload();
+}
+
+// MoreTeapotsRenderer::CullTeapots()
+static void CullScene(SCENE* scene) {
+  if (!scene->cull) {
+    scene->visible = &scene->all_visible[0];
+    scene->masks = &scene->all_masks[0];
+    scene->num_visible = scene->num_teapots;
+    scene->view_draws = scene->num_teapots * scene->num_views;
+    return;
+  }
+  FrustumCuller& culler = scene->culler;
+  culler.SetBounds(scene->model_views, scene->bounds, scene->bounds[3]);
+  culler.Cull(GetBestCpuIsa());
+  scene->num_visible = culler.GetNumVisible();
+  scene->visible = scene->num_visible ? &culler.GetVisible()[0] : NULL;
+  scene->masks = scene->num_visible ? &culler.GetViewMasks()[0] : NULL;
+  scene->view_draws = culler.GetStats().view_draws;
+}
+
+// RenderView() of the GLSL 100 path
+static void RenderViewLoop(const SCENE& scene, int32_t view) {
+  LeiaRenderContext::GetInstance()->UseProgram(scene.loop_program);
+  glBindBuffer(GL_ARRAY_BUFFER, scene.vbo);
+  glVertexAttribPointer(ATTRIB_VERTEX, 3, GL_FLOAT, GL_FALSE,
+                        6 * sizeof(float), (char*)0);
+  glEnableVertexAttribArray(ATTRIB_VERTEX);
+  glVertexAttribPointer(ATTRIB_NORMAL, 3, GL_FLOAT, GL_FALSE,
+                        6 * sizeof(float), (char*)0 + 3 * sizeof(float));
+  glEnableVertexAttribArray(ATTRIB_NORMAL);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, scene.ibo);
+
+  glUniform4f(scene.material_specular, 1.0f, 1.0f, 1.0f, 10.0f);
+  glUniform3f(scene.material_ambient, 0.1f, 0.1f, 0.1f);
+  glUniform3f(scene.light0, 100.0f, -200.0f, -600.0f);
+  const float* mvps = scene.mvps.Get(view * scene.num_visible);
+  for (int32_t k = 0; k < scene.num_visible; ++k) {
+    if (!(scene.masks[k] & (1u << view))) continue;
+    const float* color = &scene.colors[scene.visible[k] * 3];
+    glUniform4f(scene.material_diffuse, color[0], color[1], color[2], 1.0f);
+    glUniformMatrix4fv(scene.matrix_projection, 1, GL_FALSE, mvps + k * 16);
+    glUniformMatrix4fv(scene.matrix_view, 1, GL_FALSE,
+                       scene.visible_model_views.Get(k));
+    glDrawElements(GL_TRIANGLES, scene.num_indices, GL_UNSIGNED_SHORT,
+                   (char*)0);
+  }
+  glDisableVertexAttribArray(ATTRIB_VERTEX);
+  glDisableVertexAttribArray(ATTRIB_NORMAL);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+// MoreTeapotsRenderer::UploadInstances()
+static void UploadInstances(SCENE* scene, bool per_view) {
+  const int32_t num_views = per_view ? scene->num_views : 1;
+  scene->view_first_instances.assign(num_views + 1, 0);
+  scene->instance_data.resize(
+      (per_view ? scene->view_draws : scene->num_visible) * INSTANCE_FLOATS);
+  int32_t instance = 0;
+  for (int32_t v = 0; v < num_views; ++v) {
+    scene->view_first_instances[v] = instance;
+    for (int32_t k = 0; k < scene->num_visible; ++k) {
+      if (per_view && !(scene->masks[k] & (1u << v))) continue;
+      float* out = &scene->instance_data[instance++ * INSTANCE_FLOATS];
+      const int32_t i = scene->visible[k];
+      memcpy(out, scene->model_views.Get(i), 16 * sizeof(float));
+      memcpy(out + 16, &scene->colors[i * 3], 3 * sizeof(float));
+      out[19] = 1.0f;
+    }
+  }
+  scene->view_first_instances[num_views] = instance;
+  const GLsizeiptr size = instance * INSTANCE_FLOATS * sizeof(float);
+  glBindBuffer(GL_ARRAY_BUFFER, scene->instance_vbo);
+  glBufferData(GL_ARRAY_BUFFER, size,
+               instance ? &scene->instance_data[0] : NULL, GL_STREAM_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  scene->upload_bytes += size;
+}
+
+// MoreTeapotsRenderer::BindInstances()
+static void BindInstances(const SCENE& scene, int32_t first) {
+  const GLsizei stride = INSTANCE_FLOATS * sizeof(float);
+  const size_t offset = first * stride;
+  glBindBuffer(GL_ARRAY_BUFFER, scene.instance_vbo);
+  for (int32_t column = 0; column < 4; ++column) {
+    glVertexAttribPointer(ATTRIB_MODEL_VIEW + column, 4, GL_FLOAT, GL_FALSE,
+                          stride,
+                          (char*)0 + offset + column * 4 * sizeof(float));
+  }
+  glVertexAttribPointer(ATTRIB_COLOR, 3, GL_FLOAT, GL_FALSE, stride,
+                        (char*)0 + offset + 16 * sizeof(float));
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+static void DrawInstances(const SCENE& scene, int32_t segment) {
+  const int32_t first = scene.view_first_instances[segment];
+  const int32_t count = scene.view_first_instances[segment + 1] - first;
+  if (!count) return;
+  glBindVertexArray(scene.vao);
+  BindInstances(scene, first);
+  glDrawElementsInstanced(GL_TRIANGLES, scene.num_indices, GL_UNSIGNED_SHORT,
+                          (char*)0, count);
+  glBindVertexArray(0);
+}
+
+// Submits one frame of mode, the scene target bound and cleared
+static void RenderScene(SCENE* scene, MODE mode) {
+  glEnable(GL_DEPTH_TEST);
+  glClearColor(0.4f, 0.4f, 0.4f, 1.0f);
+  scene->upload_bytes = 0;
+  CullScene(scene);
+  if (mode == MODE_MULTIVIEW) {
+    scene->multiview.BindScene();
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    UploadInstances(scene, false);
+    LeiaRenderContext::GetInstance()->UseProgram(scene->multiview_program);
+    UseCameraBlock(scene->multiview_program);
+    DrawInstances(*scene, 0);
+    return;
+  }
+
+  scene->atlas.BindScene();
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  if (mode == MODE_LOOP) {
+    // The model views of the visible teapots gathered, then their MVPs
+    scene->visible_model_views.Resize(scene->num_visible);
+    for (int32_t k = 0; k < scene->num_visible; ++k) {
+      memcpy(scene->visible_model_views.Get(k),
+             scene->model_views.Get(scene->visible[k]), 16 * sizeof(float));
+    }
+    scene->mvps.Resize(scene->num_views * scene->num_visible);
+    MultiplyViewMatrices(&scene->projections[0], 16, scene->num_views,
+                         scene->visible_model_views.Get(0), scene->num_visible,
+                         scene->mvps.Get(0), GetBestCpuIsa(), 0);
+    // The per teapot uniforms, the three of the material once per view
+    scene->upload_bytes +=
+        (scene->view_draws * (4 + 16 + 16) + scene->num_views * (4 + 3 + 3)) *
+        sizeof(float);
+  } else {
+    UploadInstances(scene, true);
+  }
+  for (int32_t v = 0; v < scene->num_views; ++v) {
+    scene->atlas.BindView(v);
+    if (mode == MODE_LOOP) {
+      RenderViewLoop(*scene, v);
+      continue;
+    }
+    LeiaRenderContext::GetInstance()->UseProgram(scene->instanced_program);
+    UseCameraBlock(scene->instanced_program);
+    glUniformMatrix4fv(scene->instanced_projection, 1, GL_FALSE,
+                       &scene->projections[v * 16]);
+    DrawInstances(*scene, v);
+  }
+  scene->atlas.FinishScene();
+}
+
+//--------------------------------------------------------------------------------
+// Runs
+//--------------------------------------------------------------------------------
+struct RESULT {
+  MODE mode;
+  int32_t num_teapots;
+  int32_t visible;
+  int32_t view_draws;
+  double submit_ms;
+  double frame_ms;
+  double gpu_ms;
+  bool gpu_valid;
+  int64_t draw_calls;
+  int64_t uniform_calls;
+  int64_t upload_bytes;
+};
+
+static void Run(SCENE* scene, MODE mode, const OPTIONS& options,
+                const host_gl::TIMER_QUERY& timer, RESULT* result) {
+  memset(result, 0, sizeof(*result));
+  result->mode = mode;
+  result->num_teapots = scene->num_teapots;
+  result->gpu_valid = timer.available;
+  GLuint query = 0;
+  if (timer.available) timer.gen_queries(1, &query);
+
+  LeiaRenderContext* context = LeiaRenderContext::GetInstance();
+  for (int32_t frame = -WARMUP_FRAMES; frame < options.frames; ++frame) {
+    context->Invalidate();
+    scene->camera_buffer.Upload();
+    // The simulation is the same for every mode, it stays out of the timings
+    const float view[16] = {1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f,
+                            0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, -CAM_Z, 1.0f};
+    scene->teapots.Update(view, (float)scene->num_views, &scene->model_views,
+                          0);
+    host_gl::GL_COUNTERS before = host_gl::counters;
+    std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+    if (timer.available) timer.begin_query(GL_TIME_ELAPSED_EXT, query);
+    RenderScene(scene, mode);
+    if (timer.available) timer.end_query(GL_TIME_ELAPSED_EXT);
+    std::chrono::steady_clock::time_point submitted =
+        std::chrono::steady_clock::now();
+    glFinish();
+    EndGlCaptureFrame();
+    if (frame < 0) continue;
+
+    result->submit_ms +=
+        std::chrono::duration<double, std::milli>(submitted - start).count();
+    result->frame_ms += std::chrono::duration<double, std::milli>(
+                            std::chrono::steady_clock::now() - start)
+                            .count();
+    result->draw_calls += host_gl::counters.draw_calls - before.draw_calls;
+    result->uniform_calls +=
+        host_gl::counters.uniform_calls - before.uniform_calls;
+    result->upload_bytes += scene->upload_bytes;
+    result->visible += scene->num_visible;
+    result->view_draws += scene->view_draws;
+    if (timer.available) {
+      GLint disjoint = 0;
+      glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+      if (disjoint) result->gpu_valid = false;
+      GLuint64 ns = 0;
+      timer.get_query_object_ui64v(query, GL_QUERY_RESULT_EXT, &ns);
+      result->gpu_ms += ns / 1000000.0;
+    }
+  }
+  if (timer.available) timer.delete_queries(1, &query);
+
+  result->submit_ms /= options.frames;
+  result->frame_ms /= options.frames;
+  result->gpu_ms /= options.frames;
+  result->draw_calls /= options.frames;
+  result->uniform_calls /= options.frames;
+  result->upload_bytes /= options.frames;
+  result->visible /= options.frames;
+  result->view_draws /= options.frames;
+}
+
+//--------------------------------------------------------------------------------
+// Reports
+//--------------------------------------------------------------------------------
+static void PrintTable(const std::vector<RESULT>& results) {
+  printf("%-10s %8s %8s %9s %10s %10s %10s %8s %9s %10s\n", "mode",
+         "teapots", "visible", "in views", "submit ms", "frame ms", "gpu ms",
+         "draws", "uniforms", "upload MB");
+  for (size_t i = 0; i < results.size(); ++i) {
+    const RESULT& r = results[i];
+    char gpu[16];
+    if (r.gpu_valid)
+      snprintf(gpu, sizeof(gpu), "%10.3f", r.gpu_ms);
+    else
+      snprintf(gpu, sizeof(gpu), "%10s", "-");
+    printf("%-10s %8d %8d %9d %10.3f %10.3f %s %8lld %9lld %10.2f\n",
+           MODE_NAMES[r.mode], r.num_teapots, r.visible, r.view_draws,
+           r.submit_ms, r.frame_ms, gpu,
+           (long long)r.draw_calls, (long long)r.uniform_calls,
+           r.upload_bytes / (1024.0 * 1024.0));
+  }
+}
+
+static void WriteJson(FILE* out, const OPTIONS& options, int32_t num_indices,
+                      const std::vector<RESULT>& results) {
+  fprintf(out, "{\n  \"config\": {\"views\": %d, \"view_size\": [%d, %d], "
+               "\"frames\": %d, \"triangles\": %d, \"spread\": %g, "
+               "\"cull\": %s},\n",
+          options.num_views, options.view_width, options.view_height,
+          options.frames, num_indices / 3, options.spread,
+          options.cull ? "true" : "false");
+  // Driver strings may hold quotes, keep them out of the JSON
+  std::string renderer;
+  const char* value = (const char*)glGetString(GL_RENDERER);
+  for (const char* c = value ? value : ""; *c; ++c) {
+    if (*c != '"' && *c != '\\') renderer.push_back(*c);
+  }
+  fprintf(out, "  \"gl\": {\"renderer\": \"%s\"},\n", renderer.c_str());
+  fprintf(out, "  \"runs\": [\n");
+  for (size_t i = 0; i < results.size(); ++i) {
+    const RESULT& r = results[i];
+    char gpu[32];
+    if (r.gpu_valid)
+      snprintf(gpu, sizeof(gpu), "%.4f", r.gpu_ms);
+    else
+      snprintf(gpu, sizeof(gpu), "null");
+    fprintf(out, "    {\"mode\": \"%s\", \"teapots\": %d, "
+                 "\"visible\": %d, \"view_draws\": %d, "
+                 "\"submit_ms\": %.4f, \"frame_ms\": %.4f, \"gpu_ms\": %s, "
+                 "\"draw_calls\": %lld, \"uniform_calls\": %lld, "
+                 "\"upload_bytes\": %lld}%s\n",
+            MODE_NAMES[r.mode], r.num_teapots, r.visible, r.view_draws,
+            r.submit_ms, r.frame_ms, gpu, (long long)r.draw_calls,
+            (long long)r.uniform_calls, (long long)r.upload_bytes, i + 1 < results.size() ? "," : "");
+  }
+  fprintf(out, "  ]\n}\n");
+}
+
+int main(int argc, char** argv) {
+  OPTIONS options;
+  if (!ParseOptions(argc, argv, &options)) return 2;
+
+  host_gl::CONTEXT ctx;
+  if (!host_gl::CreateContext(&ctx)) {
+    fprintf(stderr, "No OpenGL ES 3 context\n");
+    return 1;
+  }
+  host_gl::TIMER_QUERY timer;
+  host_gl::InitTimerQuery(&timer);
+
+  if (!options.capture.empty() &&
+      !StartGlCapture(options.capture.c_str(), 0)) {
+    fprintf(stderr, "Can not write %s\n", options.capture.c_str());
+    host_gl::DestroyContext(&ctx);
+    return 1;
+  }
+
+  SCENE scene;
+  if (!InitScene(options, &scene)) {
+    fprintf(stderr, "Scene setup failed\n");
+    UnloadScene(&scene);
+    host_gl::DestroyContext(&ctx);
+    return 1;
+  }
+
+  std::vector<RESULT> results;
+  bool skipped_multiview = false;
+  for (size_t t = 0; t < options.teapots.size(); ++t) {
+    SetTeapotCount(&scene, options.teapots[t]);
+    for (int32_t m = 0; m < MODE_COUNT; ++m) {
+      if (options.mode != "all" && options.mode != MODE_NAMES[m]) continue;
+      if (m == MODE_MULTIVIEW && !scene.multiview_program) {
+        skipped_multiview = true;
+        continue;
+      }
+      RESULT result;
+      Run(&scene, (MODE)m, options, timer, &result);
+      results.push_back(result);
+    }
+  }
+  StopGlCapture();
+  GLenum error = glGetError();
+
+  bool json_only = options.json == "-";
+  if (!json_only) {
+    printf("%d views of %dx%d, %d of %d teapot triangles, %d frames, %s\n",
+           options.num_views, options.view_width, options.view_height,
+           scene.num_indices / 3,
+           (int32_t)(sizeof(teapotIndices) / sizeof(teapotIndices[0]) / 3),
+           options.frames, glGetString(GL_RENDERER));
+    if (skipped_multiview)
+      printf("GL_OVR_multiview2 not available, multiview skipped\n");
+    PrintTable(results);
+  }
+  if (json_only) {
+    WriteJson(stdout, options, scene.num_indices, results);
+  } else if (!options.json.empty()) {
+    FILE* out = fopen(options.json.c_str(), "w");
+    if (out) {
+      WriteJson(out, options, scene.num_indices, results);
+      fclose(out);
+    } else {
+      fprintf(stderr, "Can not write %s\n", options.json.c_str());
+    }
+  }
+
+  UnloadScene(&scene);
+  host_gl::DestroyContext(&ctx);
+  if (results.empty()) {
+    fprintf(stderr, "Unknown mode %s\n", options.mode.c_str());
+    return 2;
+  }
+  if (error != GL_NO_ERROR) {
+    fprintf(stderr, "GL error 0x%x\n", error);
+    return 1;
+  }
+  return 0;
+}
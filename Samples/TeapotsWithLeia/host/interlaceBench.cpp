@@ -0,0 +1,152 @@
+/*
+ * Copyright 2018 Leia Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//--------------------------------------------------------------------------------
+// interlaceBench.cpp
+// Throughput of the CPU interlacing and sharpening passes for every ISA the
+// host supports, in screen megapixels per second. Each ISA is checked against
+// the scalar output first.
+//
+// usage: interlace-bench [iterations]
+//--------------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "cpuInterlacer.h"
+
+using namespace leia_helper;
+
+static const int32_t NUM_VIEWS_HORIZONTAL = 4;
+static const int32_t VIEW_WIDTH = 640;
+static const int32_t VIEW_HEIGHT = 360;
+static const int32_t SCREEN_WIDTH = 2560;
+static const int32_t SCREEN_HEIGHT = 1440;
+static const int32_t ALIGNMENT_OFFSET = 1;
+static const float ACT_COEFFICIENTS[] = {0.06f, 0.025f};
+static const int32_t DEFAULT_ITERATIONS = 20;
+
+enum PASS { PASS_INTERLACE, PASS_SHARPEN, PASS_FUSED, PASS_COUNT };
+static const char* PASS_NAMES[PASS_COUNT] = {"interlace", "sharpen", "fused"};
+
+struct BENCH_DATA {
+  LeiaCameraData data;
+  std::vector<std::vector<uint8_t> > view_pixels;
+  std::vector<const uint8_t*> view_pointers;
+  CPU_VIEWS views;
+  std::vector<uint8_t> interlaced;
+  std::vector<uint8_t> output;
+};
+
+static void InitBenchData(BENCH_DATA* bench) {
+  memset(&bench->data, 0, sizeof(bench->data));
+  bench->data.mNumViewsHorizontal = NUM_VIEWS_HORIZONTAL;
+  bench->data.mNumViewsVertical = 1;
+
+  srand(1);
+  bench->view_pixels.resize(NUM_VIEWS_HORIZONTAL);
+  for (int32_t i = 0; i < NUM_VIEWS_HORIZONTAL; ++i) {
+    bench->view_pixels[i].resize(VIEW_WIDTH * VIEW_HEIGHT * 4);
+    for (size_t j = 0; j < bench->view_pixels[i].size(); ++j)
+      bench->view_pixels[i][j] = (uint8_t)(rand() & 0xff);
+    bench->view_pointers.push_back(&bench->view_pixels[i][0]);
+  }
+  bench->views.views = &bench->view_pointers[0];
+  bench->views.view_width = VIEW_WIDTH;
+  bench->views.view_height = VIEW_HEIGHT;
+
+  // Sharpening input
+  bench->interlaced.resize(SCREEN_WIDTH * SCREEN_HEIGHT * 4);
+  CpuViewInterlace(bench->views, &bench->data, ALIGNMENT_OFFSET,
+                   &bench->interlaced[0], SCREEN_WIDTH, SCREEN_HEIGHT,
+                   CPU_ISA_SCALAR, 0);
+  bench->output.resize(SCREEN_WIDTH * SCREEN_HEIGHT * 4);
+}
+
+static void RunPass(BENCH_DATA* bench, const PASS pass, const CPU_ISA isa,
+                    int32_t num_threads) {
+  const int32_t num_act = sizeof(ACT_COEFFICIENTS) / sizeof(float);
+  switch (pass) {
+    case PASS_INTERLACE:
+      CpuViewInterlace(bench->views, &bench->data, ALIGNMENT_OFFSET,
+                       &bench->output[0], SCREEN_WIDTH, SCREEN_HEIGHT, isa,
+                       num_threads);
+      break;
+    case PASS_SHARPEN:
+      CpuViewSharpening(&bench->interlaced[0], SCREEN_WIDTH, SCREEN_HEIGHT,
+                        ACT_COEFFICIENTS, num_act, &bench->output[0], isa,
+                        num_threads);
+      break;
+    default:
+      CpuViewInterlaceAndSharpen(bench->views, &bench->data, ALIGNMENT_OFFSET,
+                                 ACT_COEFFICIENTS, num_act, &bench->output[0],
+                                 SCREEN_WIDTH, SCREEN_HEIGHT, isa, num_threads);
+      break;
+  }
+}
+
+int main(int argc, char** argv) {
+  int32_t iterations = argc > 1 ? atoi(argv[1]) : DEFAULT_ITERATIONS;
+  if (iterations <= 0) iterations = DEFAULT_ITERATIONS;
+  int32_t max_threads = (int32_t)std::thread::hardware_concurrency();
+  if (max_threads <= 0) max_threads = 1;
+
+  BENCH_DATA bench;
+  InitBenchData(&bench);
+
+  printf("%d views %dx%d -> %dx%d, %d iterations\n", NUM_VIEWS_HORIZONTAL,
+         VIEW_WIDTH, VIEW_HEIGHT, SCREEN_WIDTH, SCREEN_HEIGHT, iterations);
+  printf("%-10s %-8s %8s %10s %10s\n", "pass", "isa", "threads", "ms", "MP/s");
+
+  int32_t failures = 0;
+  const double megapixels = SCREEN_WIDTH * SCREEN_HEIGHT / 1000000.0;
+  for (int32_t pass = 0; pass < PASS_COUNT; ++pass) {
+    RunPass(&bench, (PASS)pass, CPU_ISA_SCALAR, 1);
+    std::vector<uint8_t> reference = bench.output;
+
+    for (int32_t isa = 0; isa < CPU_ISA_COUNT; ++isa) {
+      if (!IsCpuIsaSupported((CPU_ISA)isa)) continue;
+
+      RunPass(&bench, (PASS)pass, (CPU_ISA)isa, max_threads);
+      if (bench.output != reference) {
+        printf("%-10s %-8s output differs from scalar\n", PASS_NAMES[pass],
+               GetCpuIsaName((CPU_ISA)isa));
+        ++failures;
+        continue;
+      }
+
+      int32_t thread_counts[] = {1, max_threads};
+      for (int32_t t = 0; t < (max_threads > 1 ? 2 : 1); ++t) {
+        std::chrono::steady_clock::time_point start =
+            std::chrono::steady_clock::now();
+        for (int32_t i = 0; i < iterations; ++i)
+          RunPass(&bench, (PASS)pass, (CPU_ISA)isa, thread_counts[t]);
+        double ms = std::chrono::duration<double, std::milli>(
+                        std::chrono::steady_clock::now() - start)
+                        .count() /
+                    iterations;
+        printf("%-10s %-8s %8d %10.3f %10.1f\n", PASS_NAMES[pass],
+               GetCpuIsaName((CPU_ISA)isa), thread_counts[t], ms,
+               megapixels / (ms / 1000.0));
+      }
+    }
+  }
+  return failures ? 1 : 0;
+}
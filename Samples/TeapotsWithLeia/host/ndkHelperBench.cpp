@@ -0,0 +1,681 @@
+/*
+ * Copyright 2018 Leia Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//--------------------------------------------------------------------------------
+// ndkHelperBench.cpp
+// ns per call of every Vec2, Vec3, Vec4, Mat4, Affine and Quaternion
+// operation, Interpolator::Update() over many tracks and TapCamera::Update()
+// over many cameras, as built into ndk-helper-host. For catching regressions
+// in these paths without a device, --json writes the same numbers for
+// scripts to compare.
+//
+// Each op runs over a batch of inputs and stores every result, best of
+// REPEATS. "momentum" is the update after a drag, EndDrag() included.
+//
+// usage: ndk-helper-bench [--iterations=N] [--tracks=N] [--cameras=N]
+//                         [--filter=TEXT] [--json=PATH|-]
+//--------------------------------------------------------------------------------
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "interpolator.h"
+#include "tapCamera.h"
+#include "vecmath.h"
+
+using ndk_helper::Affine;
+using ndk_helper::Interpolator;
+using ndk_helper::Mat4;
+using ndk_helper::Quaternion;
+using ndk_helper::TapCamera;
+using ndk_helper::Vec2;
+using ndk_helper::Vec3;
+using ndk_helper::Vec3Soa;
+using ndk_helper::Vec4;
+
+static const int32_t COUNT = 1024;
+// Best of, the calls are short enough for the scheduler to show
+static const int32_t REPEATS = 5;
+static const int32_t INTERPOLATOR_TYPES =
+    ndk_helper::INTERPOLATOR_TYPE_EASEOUTEXPO + 1;
+
+//--------------------------------------------------------------------------------
+// Options
+//--------------------------------------------------------------------------------
+struct OPTIONS {
+  int32_t iterations;
+  int32_t tracks;
+  int32_t cameras;
+  std::string filter;
+  std::string json;
+};
+
+static bool ParseOptions(int argc, char** argv, OPTIONS* options) {
+  options->iterations = 200;
+  options->tracks = 10000;
+  options->cameras = 1000;
+  for (int i = 1; i < argc; ++i) {
+    const char* arg = argv[i];
+    const char* value = strchr(arg, '=');
+    value = value ? value + 1 : "";
+    bool ok = true;
+    if (!strncmp(arg, "--iterations=", 13)) {
+      options->iterations = atoi(value);
+      ok = options->iterations > 0;
+    } else if (!strncmp(arg, "--tracks=", 9)) {
+      options->tracks = atoi(value);
+      ok = options->tracks > 0;
+    } else if (!strncmp(arg, "--cameras=", 10)) {
+      options->cameras = atoi(value);
+      ok = options->cameras > 0;
+    } else if (!strncmp(arg, "--filter=", 9)) {
+      options->filter = value;
+    } else if (!strncmp(arg, "--json=", 7)) {
+      options->json = value;
+    } else {
+      ok = false;
+    }
+    if (!ok) {
+      fprintf(stderr, "Bad argument %s\n", arg);
+      return false;
+    }
+  }
+  return true;
+}
+
+//--------------------------------------------------------------------------------
+// Inputs and outputs of every op
+//--------------------------------------------------------------------------------
+struct DATA {
+  std::vector<float> f, f_out;
+  std::vector<Vec2> vec2_a, vec2_b, vec2_out;
+  std::vector<Vec3> vec3_a, vec3_b, vec3_out;
+  std::vector<Vec4> vec4_a, vec4_b, vec4_out;
+  std::vector<Mat4> mat_a, mat_b, mat_out;
+  std::vector<Affine> affine_a, affine_b, affine_out;
+  std::vector<Quaternion> quat_a, quat_b, quat_out;
+  // Point x, y, z and radius arrays
+  std::vector<float> points, point_out;
+
+  double start_time;
+  std::vector<Interpolator> tracks;
+  std::vector<TapCamera> cameras;
+};
+
+// Deterministic values in [-4, 4), none of them 0
+static float Value(int32_t i) {
+  return (float)((uint32_t)i * 7919u % 61u + 1u) * 0.125f - 4.0625f;
+}
+
+// Rotation, scale and translation like the teapot transforms, every fourth
+// one a perspective projection
+static Mat4 Transform(int32_t i, bool projections) {
+  if (projections && i % 4 == 0)
+    return Mat4::Perspective(1.0f + 0.001f * i, 1.5f, 1.0f, 1000.0f);
+  float s = 0.5f + 0.001f * (i % 997);
+  return Mat4::Translation(Value(i) * 10.0f, Value(i + 1) * 10.0f,
+                           -100.0f - 0.1f * i) *
+         Mat4::RotationY(0.37f * i) * Mat4::RotationX(-0.11f * i) *
+         Mat4::Scale(s, s, s);
+}
+
+static void InitData(const OPTIONS& options, DATA* d) {
+  d->f.resize(COUNT);
+  d->f_out.resize(COUNT);
+  d->vec2_a.resize(COUNT);
+  d->vec2_b.resize(COUNT);
+  d->vec2_out.resize(COUNT);
+  d->vec3_a.resize(COUNT);
+  d->vec3_b.resize(COUNT);
+  d->vec3_out.resize(COUNT);
+  d->vec4_a.resize(COUNT);
+  d->vec4_b.resize(COUNT);
+  d->vec4_out.resize(COUNT);
+  d->mat_a.resize(COUNT);
+  d->mat_b.resize(COUNT);
+  d->mat_out.resize(COUNT);
+  d->affine_a.resize(COUNT);
+  d->affine_b.resize(COUNT);
+  d->affine_out.resize(COUNT);
+  d->quat_a.resize(COUNT);
+  d->quat_b.resize(COUNT);
+  d->quat_out.resize(COUNT);
+  d->points.resize(COUNT * 4);
+  d->point_out.resize(COUNT * 4);
+  for (int32_t i = 0; i < COUNT; ++i) {
+    const int32_t k = i * 8;
+    d->f[i] = Value(k);
+    d->vec2_a[i] = Vec2(Value(k), Value(k + 1));
+    d->vec2_b[i] = Vec2(Value(k + 2), Value(k + 3));
+    d->vec3_a[i] = Vec3(Value(k), Value(k + 1), Value(k + 2));
+    d->vec3_b[i] = Vec3(Value(k + 3), Value(k + 4), Value(k + 5));
+    d->vec4_a[i] = Vec4(Value(k), Value(k + 1), Value(k + 2), Value(k + 3));
+    d->vec4_b[i] =
+        Vec4(Value(k + 4), Value(k + 5), Value(k + 6), Value(k + 7));
+    d->mat_a[i] = Transform(i, true);
+    d->mat_b[i] = Transform(i * 7 + 3, false);
+    d->affine_a[i] = Affine(Transform(i * 5 + 1, false));
+    d->affine_b[i] = Affine(d->mat_b[i]);
+    Vec3 axis = d->vec3_a[i];
+    axis.Normalize();
+    d->quat_a[i] = Quaternion::RotationAxis(axis, 0.01f * i);
+    axis = d->vec3_b[i];
+    axis.Normalize();
+    d->quat_b[i] = Quaternion::RotationAxis(axis, -0.02f * i);
+    for (int32_t c = 0; c < 3; ++c) d->points[c * COUNT + i] = Value(k + c);
+    d->points[3 * COUNT + i] = 1.0f + 0.01f * i;
+  }
+
+  // Long enough not to finish during the run, every easing in turn
+  d->start_time = ndk_helper::PerfMonitor::GetCurrentTime();
+  d->tracks.resize(options.tracks);
+  for (int32_t i = 0; i < options.tracks; ++i) {
+    d->tracks[i].Set(Value(i), Value(i + 1),
+                     (ndk_helper::INTERPOLATOR_TYPE)(i % INTERPOLATOR_TYPES),
+                     1000.0 + i);
+  }
+
+  d->cameras.resize(options.cameras);
+  for (int32_t i = 0; i < options.cameras; ++i) {
+    d->cameras[i].BeginDrag(Vec2(0.1f * Value(i), 0.1f * Value(i + 1)));
+    d->cameras[i].Drag(Vec2(0.1f * Value(i + 2), 0.1f * Value(i + 3)));
+    d->cameras[i].EndDrag();
+    d->cameras[i].Update();
+  }
+}
+
+//--------------------------------------------------------------------------------
+// Ops, each returns the number of calls it made
+//--------------------------------------------------------------------------------
+#define EACH for (int32_t i = 0; i < COUNT; ++i)
+
+struct OP {
+  const char* group;
+  const char* name;
+  int32_t (*run)(DATA* d);
+};
+
+static const OP OPS[] = {
+    // Vec2
+    {"Vec2", "+", [](DATA* d) {
+       EACH d->vec2_out[i] = d->vec2_a[i] + d->vec2_b[i];
+       return COUNT;
+     }},
+    {"Vec2", "-", [](DATA* d) {
+       EACH d->vec2_out[i] = d->vec2_a[i] - d->vec2_b[i];
+       return COUNT;
+     }},
+    {"Vec2", "*", [](DATA* d) {
+       EACH d->vec2_out[i] = d->vec2_a[i] * d->vec2_b[i];
+       return COUNT;
+     }},
+    {"Vec2", "/", [](DATA* d) {
+       EACH d->vec2_out[i] = d->vec2_a[i] / d->vec2_b[i];
+       return COUNT;
+     }},
+    {"Vec2", "+=", [](DATA* d) {
+       EACH d->vec2_out[i] += d->vec2_a[i];
+       return COUNT;
+     }},
+    {"Vec2", "*float", [](DATA* d) {
+       EACH d->vec2_out[i] = d->vec2_a[i] * d->f[i];
+       return COUNT;
+     }},
+    {"Vec2", "negate", [](DATA* d) {
+       EACH d->vec2_out[i] = -d->vec2_a[i];
+       return COUNT;
+     }},
+    {"Vec2", "Length", [](DATA* d) {
+       EACH d->f_out[i] = d->vec2_a[i].Length();
+       return COUNT;
+     }},
+    {"Vec2", "Normalize", [](DATA* d) {
+       EACH {
+         d->vec2_out[i] = d->vec2_a[i];
+         d->vec2_out[i].Normalize();
+       }
+       return COUNT;
+     }},
+    {"Vec2", "Dot", [](DATA* d) {
+       EACH d->f_out[i] = d->vec2_a[i].Dot(d->vec2_b[i]);
+       return COUNT;
+     }},
+
+    // Vec3
+    {"Vec3", "+", [](DATA* d) {
+       EACH d->vec3_out[i] = d->vec3_a[i] + d->vec3_b[i];
+       return COUNT;
+     }},
+    {"Vec3", "-", [](DATA* d) {
+       EACH d->vec3_out[i] = d->vec3_a[i] - d->vec3_b[i];
+       return COUNT;
+     }},
+    {"Vec3", "*", [](DATA* d) {
+       EACH d->vec3_out[i] = d->vec3_a[i] * d->vec3_b[i];
+       return COUNT;
+     }},
+    {"Vec3", "/", [](DATA* d) {
+       EACH d->vec3_out[i] = d->vec3_a[i] / d->vec3_b[i];
+       return COUNT;
+     }},
+    {"Vec3", "+=", [](DATA* d) {
+       EACH d->vec3_out[i] += d->vec3_a[i];
+       return COUNT;
+     }},
+    {"Vec3", "*float", [](DATA* d) {
+       EACH d->vec3_out[i] = d->vec3_a[i] * d->f[i];
+       return COUNT;
+     }},
+    {"Vec3", "negate", [](DATA* d) {
+       EACH d->vec3_out[i] = -d->vec3_a[i];
+       return COUNT;
+     }},
+    {"Vec3", "Length", [](DATA* d) {
+       EACH d->f_out[i] = d->vec3_a[i].Length();
+       return COUNT;
+     }},
+    {"Vec3", "Normalize", [](DATA* d) {
+       EACH {
+         d->vec3_out[i] = d->vec3_a[i];
+         d->vec3_out[i].Normalize();
+       }
+       return COUNT;
+     }},
+    {"Vec3", "Dot", [](DATA* d) {
+       EACH d->f_out[i] = d->vec3_a[i].Dot(d->vec3_b[i]);
+       return COUNT;
+     }},
+    {"Vec3", "Cross", [](DATA* d) {
+       EACH d->vec3_out[i] = d->vec3_a[i].Cross(d->vec3_b[i]);
+       return COUNT;
+     }},
+
+    // Vec4
+    {"Vec4", "+", [](DATA* d) {
+       EACH d->vec4_out[i] = d->vec4_a[i] + d->vec4_b[i];
+       return COUNT;
+     }},
+    {"Vec4", "-", [](DATA* d) {
+       EACH d->vec4_out[i] = d->vec4_a[i] - d->vec4_b[i];
+       return COUNT;
+     }},
+    {"Vec4", "*", [](DATA* d) {
+       EACH d->vec4_out[i] = d->vec4_a[i] * d->vec4_b[i];
+       return COUNT;
+     }},
+    {"Vec4", "/", [](DATA* d) {
+       EACH d->vec4_out[i] = d->vec4_a[i] / d->vec4_b[i];
+       return COUNT;
+     }},
+    {"Vec4", "+=", [](DATA* d) {
+       EACH d->vec4_out[i] += d->vec4_a[i];
+       return COUNT;
+     }},
+    {"Vec4", "*float", [](DATA* d) {
+       EACH d->vec4_out[i] = d->vec4_a[i] * d->f[i];
+       return COUNT;
+     }},
+    {"Vec4", "negate", [](DATA* d) {
+       EACH d->vec4_out[i] = -d->vec4_a[i];
+       return COUNT;
+     }},
+    {"Vec4", "Length", [](DATA* d) {
+       EACH d->f_out[i] = d->vec4_a[i].Length();
+       return COUNT;
+     }},
+    {"Vec4", "Normalize", [](DATA* d) {
+       EACH {
+         d->vec4_out[i] = d->vec4_a[i];
+         d->vec4_out[i].Normalize();
+       }
+       return COUNT;
+     }},
+    {"Vec4", "Dot", [](DATA* d) {
+       EACH d->f_out[i] = d->vec4_a[i].Dot(d->vec3_b[i]);
+       return COUNT;
+     }},
+    {"Vec4", "Cross", [](DATA* d) {
+       EACH d->vec3_out[i] = d->vec4_a[i].Cross(d->vec3_b[i]);
+       return COUNT;
+     }},
+    {"Vec4", "*Mat4", [](DATA* d) {
+       EACH d->vec4_out[i] = d->vec4_a[i] * d->mat_a[i];
+       return COUNT;
+     }},
+
+    // Mat4
+    {"Mat4", "*Mat4", [](DATA* d) {
+       EACH d->mat_out[i] = d->mat_a[i] * d->mat_b[i];
+       return COUNT;
+     }},
+    {"Mat4", "*=Mat4", [](DATA* d) {
+       EACH {
+         d->mat_out[i] = d->mat_a[i];
+         d->mat_out[i] *= d->mat_b[i];
+       }
+       return COUNT;
+     }},
+    {"Mat4", "*Vec4", [](DATA* d) {
+       EACH d->vec4_out[i] = d->mat_a[i] * d->vec4_a[i];
+       return COUNT;
+     }},
+    {"Mat4", "+", [](DATA* d) {
+       EACH d->mat_out[i] = d->mat_a[i] + d->mat_b[i];
+       return COUNT;
+     }},
+    {"Mat4", "-", [](DATA* d) {
+       EACH d->mat_out[i] = d->mat_a[i] - d->mat_b[i];
+       return COUNT;
+     }},
+    {"Mat4", "*float", [](DATA* d) {
+       EACH d->mat_out[i] = d->mat_a[i] * d->f[i];
+       return COUNT;
+     }},
+    {"Mat4", "Inverse", [](DATA* d) {
+       EACH {
+         d->mat_out[i] = d->mat_b[i];
+         d->mat_out[i].Inverse();
+       }
+       return COUNT;
+     }},
+    {"Mat4", "Transpose", [](DATA* d) {
+       EACH {
+         d->mat_out[i] = d->mat_a[i];
+         d->mat_out[i].Transpose();
+       }
+       return COUNT;
+     }},
+    {"Mat4", "PostTranslate", [](DATA* d) {
+       EACH {
+         d->mat_out[i] = d->mat_a[i];
+         d->mat_out[i].PostTranslate(d->f[i], 1.0f, -2.0f);
+       }
+       return COUNT;
+     }},
+    {"Mat4", "Perspective", [](DATA* d) {
+       EACH d->mat_out[i] = Mat4::Perspective(1.0f + 0.001f * i, 1.5f, 1.0f,
+                                              1000.0f);
+       return COUNT;
+     }},
+    {"Mat4", "Ortho2D", [](DATA* d) {
+       EACH d->mat_out[i] = Mat4::Ortho2D(d->f[i], 0.0f, 1920.0f, 1080.0f);
+       return COUNT;
+     }},
+    {"Mat4", "LookAt", [](DATA* d) {
+       EACH d->mat_out[i] = Mat4::LookAt(d->vec3_a[i], Vec3(0.0f, 0.0f, 0.0f),
+                                         Vec3(0.0f, 1.0f, 0.0f));
+       return COUNT;
+     }},
+    {"Mat4", "Translation", [](DATA* d) {
+       EACH d->mat_out[i] = Mat4::Translation(d->vec3_a[i]);
+       return COUNT;
+     }},
+    {"Mat4", "RotationX", [](DATA* d) {
+       EACH d->mat_out[i] = Mat4::RotationX(d->f[i]);
+       return COUNT;
+     }},
+    {"Mat4", "RotationY", [](DATA* d) {
+       EACH d->mat_out[i] = Mat4::RotationY(d->f[i]);
+       return COUNT;
+     }},
+    {"Mat4", "RotationZ", [](DATA* d) {
+       EACH d->mat_out[i] = Mat4::RotationZ(d->f[i]);
+       return COUNT;
+     }},
+    {"Mat4", "Scale", [](DATA* d) {
+       EACH d->mat_out[i] = Mat4::Scale(d->f[i], 2.0f, 3.0f);
+       return COUNT;
+     }},
+    {"Mat4", "Identity", [](DATA* d) {
+       EACH d->mat_out[i] = Mat4::Identity();
+       return COUNT;
+     }},
+    {"Mat4", "Multiply batch", [](DATA* d) {
+       Mat4::Multiply(&d->mat_a[0], &d->mat_b[0], COUNT, &d->mat_out[0]);
+       return COUNT;
+     }},
+    {"Mat4", "TransformPoints", [](DATA* d) {
+       float* p = &d->points[0];
+       float* o = &d->point_out[0];
+       const Vec3Soa in = Vec3Soa::Arrays(p, p + COUNT, p + 2 * COUNT);
+       const Vec3Soa out = Vec3Soa::Arrays(o, o + COUNT, o + 2 * COUNT);
+       d->mat_b[0].TransformPoints(in, COUNT, out);
+       return COUNT;
+     }},
+    {"Mat4", "TransformSpheres", [](DATA* d) {
+       d->mat_b[0].TransformSpheres(Vec3Soa::Blocks(&d->points[0], 8, true),
+                                    COUNT,
+                                    Vec3Soa::Blocks(&d->point_out[0], 8, true));
+       return COUNT;
+     }},
+
+    // Affine
+    {"Affine", "*Affine", [](DATA* d) {
+       EACH d->affine_out[i] = d->affine_a[i] * d->affine_b[i];
+       return COUNT;
+     }},
+    {"Affine", "*Vec3", [](DATA* d) {
+       EACH d->vec3_out[i] = d->affine_a[i] * d->vec3_a[i];
+       return COUNT;
+     }},
+    {"Affine", "Inverse", [](DATA* d) {
+       EACH {
+         d->affine_out[i] = d->affine_b[i];
+         d->affine_out[i].Inverse();
+       }
+       return COUNT;
+     }},
+    {"Affine", "InverseRigid", [](DATA* d) {
+       EACH {
+         d->affine_out[i] = d->affine_b[i];
+         d->affine_out[i].InverseRigid();
+       }
+       return COUNT;
+     }},
+    {"Affine", "NormalMatrix", [](DATA* d) {
+       EACH d->affine_b[i].NormalMatrix(&d->point_out[(i % (COUNT / 4)) * 9]);
+       return COUNT;
+     }},
+    {"Affine", "ToMat4", [](DATA* d) {
+       EACH d->mat_out[i] = d->affine_a[i].ToMat4();
+       return COUNT;
+     }},
+    {"Affine", "Affine(Mat4)", [](DATA* d) {
+       EACH d->affine_out[i] = Affine(d->mat_b[i]);
+       return COUNT;
+     }},
+    {"Affine", "LookAt", [](DATA* d) {
+       EACH d->affine_out[i] = Affine::LookAt(
+           d->vec3_a[i], Vec3(0.0f, 0.0f, 0.0f), Vec3(0.0f, 1.0f, 0.0f));
+       return COUNT;
+     }},
+    {"Affine", "Translation", [](DATA* d) {
+       EACH d->affine_out[i] = Affine::Translation(d->vec3_a[i]);
+       return COUNT;
+     }},
+    {"Affine", "RotationX", [](DATA* d) {
+       EACH d->affine_out[i] = Affine::RotationX(d->f[i]);
+       return COUNT;
+     }},
+    {"Affine", "Scale", [](DATA* d) {
+       EACH d->affine_out[i] = Affine::Scale(d->f[i], 2.0f, 3.0f);
+       return COUNT;
+     }},
+
+    // Quaternion
+    {"Quaternion", "*", [](DATA* d) {
+       EACH d->quat_out[i] = d->quat_a[i] * d->quat_b[i];
+       return COUNT;
+     }},
+    {"Quaternion", "*=", [](DATA* d) {
+       EACH {
+         d->quat_out[i] = d->quat_a[i];
+         d->quat_out[i] *= d->quat_b[i];
+       }
+       return COUNT;
+     }},
+    {"Quaternion", "Conjugate", [](DATA* d) {
+       EACH {
+         d->quat_out[i] = d->quat_a[i];
+         d->quat_out[i].Conjugate();
+       }
+       return COUNT;
+     }},
+    {"Quaternion", "Conjugated", [](DATA* d) {
+       EACH d->quat_out[i] = d->quat_a[i].Conjugated();
+       return COUNT;
+     }},
+    {"Quaternion", "ToMatrix", [](DATA* d) {
+       EACH d->quat_a[i].ToMatrix(d->mat_out[i]);
+       return COUNT;
+     }},
+    {"Quaternion", "ToMatrix Affine", [](DATA* d) {
+       EACH d->quat_a[i].ToMatrix(d->affine_out[i]);
+       return COUNT;
+     }},
+    {"Quaternion", "ToMatrixPreserve", [](DATA* d) {
+       EACH d->quat_a[i].ToMatrixPreserveTranslate(d->mat_out[i]);
+       return COUNT;
+     }},
+    {"Quaternion", "RotationAxis", [](DATA* d) {
+       EACH d->quat_out[i] = Quaternion::RotationAxis(d->vec3_a[i], d->f[i]);
+       return COUNT;
+     }},
+
+    // Interpolator, a few seconds into the tracks
+    {"Interpolator", "Update", [](DATA* d) {
+       const double time = d->start_time + 2.5;
+       const int32_t count = (int32_t)d->tracks.size();
+       float* out = &d->f_out[0];
+       for (int32_t i = 0; i < count; ++i)
+         d->tracks[i].Update(time, out[i % COUNT]);
+       return count;
+     }},
+
+    // TapCamera
+    {"TapCamera", "Update", [](DATA* d) {
+       const int32_t count = (int32_t)d->cameras.size();
+       for (int32_t i = 0; i < count; ++i) d->cameras[i].Update();
+       return count;
+     }},
+    {"TapCamera", "Update momentum", [](DATA* d) {
+       const int32_t count = (int32_t)d->cameras.size();
+       for (int32_t i = 0; i < count; ++i) {
+         d->cameras[i].EndDrag();
+         d->cameras[i].Update();
+       }
+       return count;
+     }},
+};
+
+#undef EACH
+
+static double NsPerCall(const OP& op, DATA* d, int32_t iterations) {
+  double best = 0.0;
+  for (int32_t r = 0; r < REPEATS; ++r) {
+    int64_t calls = 0;
+    std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+    for (int32_t i = 0; i < iterations; ++i) calls += op.run(d);
+    double ns = std::chrono::duration<double, std::nano>(
+                    std::chrono::steady_clock::now() - start)
+                    .count() /
+                (double)calls;
+    if (r == 0 || ns < best) best = ns;
+  }
+  return best;
+}
+
+struct RESULT {
+  const OP* op;
+  double ns;
+};
+
+static void WriteJson(FILE* out, const OPTIONS& options, const char* isa,
+                      const std::vector<RESULT>& results) {
+  fprintf(out, "{\n  \"config\": {\"isa\": \"%s\", \"batch\": %d, "
+               "\"iterations\": %d, \"tracks\": %d, \"cameras\": %d},\n",
+          isa, COUNT, options.iterations, options.tracks, options.cameras);
+  fprintf(out, "  \"ops\": [\n");
+  for (size_t i = 0; i < results.size(); ++i) {
+    const RESULT& r = results[i];
+    fprintf(out, "    {\"class\": \"%s\", \"op\": \"%s\", \"ns\": %.3f}%s\n",
+            r.op->group, r.op->name, r.ns, i + 1 < results.size() ? "," : "");
+  }
+  fprintf(out, "  ]\n}\n");
+}
+
+int main(int argc, char** argv) {
+  OPTIONS options;
+  if (!ParseOptions(argc, argv, &options)) return 2;
+
+#if defined(VECMATH_SCALAR)
+  const char* isa = "scalar";
+#elif defined(__SSE2__)
+  const char* isa = "sse2";
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+  const char* isa = "neon";
+#else
+  const char* isa = "scalar";
+#endif
+
+  DATA data;
+  InitData(options, &data);
+
+  std::vector<RESULT> results;
+  for (size_t n = 0; n < sizeof(OPS) / sizeof(OPS[0]); ++n) {
+    const OP& op = OPS[n];
+    std::string name = std::string(op.group) + " " + op.name;
+    if (!options.filter.empty() &&
+        name.find(options.filter) == std::string::npos)
+      continue;
+    RESULT result = {&op, NsPerCall(op, &data, options.iterations)};
+    results.push_back(result);
+  }
+
+  bool json_only = options.json == "-";
+  if (!json_only) {
+    printf("%s, %d calls a batch, %d iterations, %d tracks, %d cameras\n", isa,
+           COUNT, options.iterations, options.tracks, options.cameras);
+    printf("%-12s %-18s %10s\n", "class", "op", "ns");
+    for (size_t i = 0; i < results.size(); ++i) {
+      printf("%-12s %-18s %10.2f\n", results[i].op->group,
+             results[i].op->name, results[i].ns);
+    }
+  }
+  if (json_only) {
+    WriteJson(stdout, options, isa, results);
+  } else if (!options.json.empty()) {
+    FILE* out = fopen(options.json.c_str(), "w");
+    if (out) {
+      WriteJson(out, options, isa, results);
+      fclose(out);
+    } else {
+      fprintf(stderr, "Can not write %s\n", options.json.c_str());
+    }
+  }
+
+  if (results.empty()) {
+    fprintf(stderr, "No op matches %s\n", options.filter.c_str());
+    return 2;
+  }
+  return 0;
+}
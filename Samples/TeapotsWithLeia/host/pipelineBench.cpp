@@ -0,0 +1,1166 @@
+/*
+ * Copyright 2018 Leia Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//--------------------------------------------------------------------------------
+// pipelineBench.cpp
+// Per stage cost of the view atlas chain of RenderViewsAtlas(): scene, depth
+// of field, interlacing and view sharpening, in a headless EGL context
+// (surfaceless, or a pbuffer when the platform has no surfaceless display).
+// Runs on Mesa llvmpipe. The leia_helper passes are the ones the renderers
+// call; sharpening uses ViewSharpening(), the SDK pass is Android only.
+//
+// Every chain of the renderers is measured, and the two-pass chain without
+// depth of field:
+//   two-pass  scene, dof, interlace, sharpen
+//   fused     scene, dof, interlace+sharpen
+//   folded    scene, interlace+dof, sharpen
+//   no-dof    scene, interlace, sharpen
+//
+// Per stage and per frame: submit time, the CPU time until the stage's
+// calls return and before anything waits for the GPU, GPU time from
+// GL_EXT_disjoint_timer_query when the driver has it, draw calls, clears,
+// and the bytes the stage reads and writes counting every texel of its
+// inputs and outputs once. Drivers that execute when the next pass binds
+// its target, llvmpipe among them, can still bill a stage's work to the
+// next stage's submit time. --sync adds a glFinish() after every stage and
+// reports the time until it returns as wall time, submission and execution.
+// The frame row is the wall time of the whole frame, up to the glFinish()
+// that ends it.
+//
+// usage: pipeline-bench [--views=4x1] [--view-size=640x360]
+//                       [--screen=2560x1440] [--teapots=3] [--frames=60]
+//                       [--chain=all|two-pass|fused|folded|no-dof] [--sync]
+//                       [--color=rgba8|rgb565|rgb10a2|r11g11b10f]
+//                       [--depth=16|24|32f] [--discard] [--transient-depth]
+//                       [--program-cache=DIR]
+//                       [--program-build=auto|sync|parallel|worker]
+//                       [--json=PATH|-] [--capture=PATH]
+//
+// --program-cache loads and stores program binaries in DIR like the
+// renderers do, run twice to compare cold and warm program creation.
+// --program-build picks how ProgramBuilder builds the programs the cache
+// misses, the report gives the time until all were ready and the part of it
+// the calling thread spent blocked. --capture writes the GL calls of every
+// chain to a trace for gl-replay.
+// --transient-depth makes the atlas depth a renderbuffer discarded after the
+// scene, like ATTACHMENT_POLICY::depth_sampled false. Nothing can sample it
+// then, only no-dof runs. The run fails when a pooled target is still
+// acquired after the pipeline released its own.
+//
+// After the timed frames of a chain, the interlacing and sharpening results
+// are read back and compared with the CPU reference of cpuInterlacer.h run
+// on the depth of field atlas the GL passes read. The run fails when any
+// channel differs by more than 1 LSB. The fused pass is only checked with
+// --color=rgba8 or rgb565, the reference sharpens 8 bit views.
+//--------------------------------------------------------------------------------
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "attachmentPolicy.h"
+#include "cameraBuffer.h"
+#include "cpuInterlacer.h"
+#include "gl3stub.h"
+#include "glCapture.h"
+#include "hostContext.h"
+#include "postProcess.h"
+#include "programBuilder.h"
+#include "programCache.h"
+#include "renderContext.h"
+#include "renderTargetPool.h"
+#include "viewAtlas.h"
+#include "viewIndexMap.h"
+#include "viewTransforms.h"
+
+#include "teapot.inl"
+
+using namespace leia_helper;
+
+static const float CAM_NEAR = 5.0f;
+static const float CAM_FAR = 10000.0f;
+static const float CONVERGENCE_DISTANCE = 200.0f;
+static const float VERTICAL_FOV = 38.6f;
+static const float SYSTEM_DISPARITY_PIXELS = 8.0f;
+static const float ACT_COEFFICIENTS[] = {0.06f, 0.025f};
+static const int32_t WARMUP_FRAMES = 5;
+// Largest difference to the CPU reference, per 8 bit channel
+static const int32_t CHECK_TOLERANCE = 1;
+
+enum ATTRIB { ATTRIB_VERTEX, ATTRIB_NORMAL };
+
+//--------------------------------------------------------------------------------
+// Options
+//--------------------------------------------------------------------------------
+struct OPTIONS {
+  int32_t views_wide;
+  int32_t views_high;
+  int32_t view_width;
+  int32_t view_height;
+  int32_t screen_width;
+  int32_t screen_height;
+  int32_t teapots;
+  int32_t frames;
+  std::string chain;
+  bool sync;
+  ATTACHMENT_POLICY attachments;
+  std::string program_cache;
+  PROGRAM_BUILD_MODE program_build;
+  std::string json;
+  std::string capture;
+};
+
+static bool ParseSize(const char* value, int32_t* w, int32_t* h) {
+  return sscanf(value, "%dx%d", w, h) == 2 && *w > 0 && *h > 0;
+}
+
+static bool ParseFormat(const char* value, const char* const* names,
+                        const GLenum* formats, int32_t count, GLenum* format) {
+  for (int32_t i = 0; i < count; ++i) {
+    if (!strcmp(value, names[i])) {
+      *format = formats[i];
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool ParseOptions(int argc, char** argv, OPTIONS* options) {
+  options->views_wide = 4;
+  options->views_high = 1;
+  options->view_width = 640;
+  options->view_height = 360;
+  options->screen_width = 2560;
+  options->screen_height = 1440;
+  options->teapots = 3;
+  options->frames = 60;
+  options->chain = "all";
+  options->sync = false;
+  options->attachments = DEFAULT_ATTACHMENT_POLICY;
+  options->program_build = PROGRAM_BUILD_AUTO;
+  static const char* const COLOR_NAMES[] = {"rgba8", "rgb565", "rgb10a2",
+                                            "r11g11b10f"};
+  static const GLenum COLOR_FORMATS[] = {GL_RGBA8, GL_RGB565, GL_RGB10_A2,
+                                         GL_R11F_G11F_B10F};
+  static const char* const DEPTH_NAMES[] = {"16", "24", "32f"};
+  static const GLenum DEPTH_FORMATS[] = {
+      GL_DEPTH_COMPONENT16, GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT32F};
+  for (int i = 1; i < argc; ++i) {
+    const char* arg = argv[i];
+    const char* value = strchr(arg, '=');
+    value = value ? value + 1 : "";
+    bool ok = true;
+    if (!strncmp(arg, "--views=", 8)) {
+      ok = ParseSize(value, &options->views_wide, &options->views_high);
+    } else if (!strncmp(arg, "--view-size=", 12)) {
+      ok = ParseSize(value, &options->view_width, &options->view_height);
+    } else if (!strncmp(arg, "--screen=", 9)) {
+      ok = ParseSize(value, &options->screen_width, &options->screen_height);
+    } else if (!strncmp(arg, "--teapots=", 10)) {
+      options->teapots = atoi(value);
+      ok = options->teapots > 0;
+    } else if (!strncmp(arg, "--frames=", 9)) {
+      options->frames = atoi(value);
+      ok = options->frames > 0;
+    } else if (!strncmp(arg, "--chain=", 8)) {
+      options->chain = value;
+    } else if (!strcmp(arg, "--sync")) {
+      options->sync = true;
+    } else if (!strncmp(arg, "--color=", 8)) {
+      ok = ParseFormat(value, COLOR_NAMES, COLOR_FORMATS, 4,
+                       &options->attachments.color_format);
+    } else if (!strncmp(arg, "--depth=", 8)) {
+      ok = ParseFormat(value, DEPTH_NAMES, DEPTH_FORMATS, 3,
+                       &options->attachments.depth_format);
+    } else if (!strcmp(arg, "--discard")) {
+      options->attachments.discard = true;
+    } else if (!strcmp(arg, "--transient-depth")) {
+      options->attachments.depth_sampled = false;
+    } else if (!strncmp(arg, "--program-cache=", 16)) {
+      options->program_cache = value;
+    } else if (!strncmp(arg, "--program-build=", 16)) {
+      static const PROGRAM_BUILD_MODE MODES[] = {
+          PROGRAM_BUILD_AUTO, PROGRAM_BUILD_SYNC, PROGRAM_BUILD_PARALLEL,
+          PROGRAM_BUILD_WORKER};
+      ok = false;
+      for (int32_t m = 0; m < 4; ++m) {
+        if (!strcmp(value, GetProgramBuildModeName(MODES[m]))) {
+          options->program_build = MODES[m];
+          ok = true;
+        }
+      }
+    } else if (!strncmp(arg, "--json=", 7)) {
+      options->json = value;
+    } else if (!strncmp(arg, "--capture=", 10)) {
+      options->capture = value;
+    } else {
+      ok = false;
+    }
+    if (!ok) {
+      fprintf(stderr, "Bad argument %s\n", arg);
+      return false;
+    }
+  }
+  return true;
+}
+
+//--------------------------------------------------------------------------------
+// Scene
+// The teapot of the classic sample with its plain shader, spread around the
+// convergence plane so the depth of field has work to do
+//--------------------------------------------------------------------------------
+struct SCENE {
+  GLuint program;
+  GLint matrix_projection;
+  GLint matrix_view;
+  GLint material_diffuse;
+  GLuint vbo;
+  GLuint ibo;
+  int32_t num_indices;
+  int32_t num_vertices;
+  int32_t num_views;
+  int32_t num_teapots;
+  std::vector<float> projections;
+  MatrixBuffer model_views;
+  MatrixBuffer mvps;
+};
+
+static bool ReadFile(const std::string& path, std::string* data) {
+  FILE* file = fopen(path.c_str(), "rb");
+  if (!file) return false;
+  char buffer[4096];
+  size_t size;
+  while ((size = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    data->append(buffer, size);
+  fclose(file);
+  return true;
+}
+
+static const PROGRAM_ATTRIBUTE SCENE_ATTRIBUTES[] = {
+    {ATTRIB_VERTEX, "myVertex"}, {ATTRIB_NORMAL, "myNormal"}};
+
+static bool ReadProgram(const char* vsh, const char* fsh,
+                        std::string* sources) {
+  const char* names[2] = {vsh, fsh};
+  for (int32_t i = 0; i < 2; ++i) {
+    std::string path = std::string(TEAPOT_SHADER_DIR "/") + names[i];
+    if (!ReadFile(path, &sources[i])) {
+      fprintf(stderr, "Can not open %s\n", path.c_str());
+      return false;
+    }
+  }
+  // The renderers fill the tag in through ReadShader()
+  for (int32_t i = 0; i < 2; ++i) {
+    size_t tag = sources[i].find(CAMERA_BLOCK_TAG);
+    if (tag != std::string::npos)
+      sources[i].replace(tag, strlen(CAMERA_BLOCK_TAG), CAMERA_BLOCK_SOURCE);
+  }
+  // ShaderPlain.fsh declares its output without a precision, which GLSL ES
+  // 3.00 requires and Mesa enforces
+  size_t version = sources[1].find("#version");
+  if (version != std::string::npos) {
+    size_t line_end = sources[1].find('\n', version);
+    sources[1].insert(line_end + 1, "precision mediump float;\n");
+  }
+  return true;
+}
+
+// Off axis projection of view i, converged at CONVERGENCE_DISTANCE, like
+// leiaCalculateViews() builds them
+static void ViewProjection(const LeiaCameraData& data, int32_t view,
+                           float* m) {
+  const float to_radians = 3.14159f / 180.0f;
+  float n = data.mNear;
+  float f = data.mFar;
+  float top = n * tanf(0.5f * data.mVerticalFieldOfView * to_radians);
+  float right = top * data.mViewResXPixels / data.mViewResYPixels;
+  float offset =
+      data.mBaseline * (view - 0.5f * (data.mNumViewsHorizontal - 1));
+  float shift = offset * n / data.mConvergenceDistance;
+  float l = -right - shift;
+  float r = right - shift;
+  memset(m, 0, 16 * sizeof(float));
+  m[0] = 2.0f * n / (r - l);
+  m[5] = n / top;
+  m[8] = (r + l) / (r - l);
+  m[10] = -(f + n) / (f - n);
+  m[11] = -1.0f;
+  m[12] = -offset * m[0];
+  m[14] = -2.0f * f * n / (f - n);
+}
+
+static bool InitScene(const OPTIONS& options, const LeiaCameraData& data,
+                      SCENE* scene) {
+  // scene->program comes from InitPipeline()
+  scene->matrix_projection = glGetUniformLocation(scene->program, "uPMatrix");
+  scene->matrix_view = glGetUniformLocation(scene->program, "uMVMatrix");
+  scene->material_diffuse =
+      glGetUniformLocation(scene->program, "vMaterialDiffuse");
+
+  scene->num_vertices = sizeof(teapotPositions) / sizeof(teapotPositions[0]) / 3;
+  std::vector<float> vertices(scene->num_vertices * 6);
+  for (int32_t i = 0; i < scene->num_vertices; ++i) {
+    memcpy(&vertices[i * 6], &teapotPositions[i * 3], 3 * sizeof(float));
+    memcpy(&vertices[i * 6 + 3], &teapotNormals[i * 3], 3 * sizeof(float));
+  }
+  glGenBuffers(1, &scene->vbo);
+  glBindBuffer(GL_ARRAY_BUFFER, scene->vbo);
+  glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), &vertices[0],
+               GL_STATIC_DRAW);
+  scene->num_indices = sizeof(teapotIndices) / sizeof(teapotIndices[0]);
+  glGenBuffers(1, &scene->ibo);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, scene->ibo);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(teapotIndices), teapotIndices,
+               GL_STATIC_DRAW);
+
+  scene->num_views = options.views_wide * options.views_high;
+  scene->num_teapots = options.teapots;
+  scene->projections.resize(scene->num_views * 16);
+  for (int32_t y = 0; y < options.views_high; ++y) {
+    for (int32_t x = 0; x < options.views_wide; ++x) {
+      ViewProjection(data, x,
+                     &scene->projections[(y * options.views_wide + x) * 16]);
+    }
+  }
+
+  // Teapots on a grid from half to twice the convergence distance
+  scene->model_views.Resize(scene->num_teapots);
+  int32_t columns = (int32_t)ceilf(sqrtf((float)scene->num_teapots));
+  for (int32_t i = 0; i < scene->num_teapots; ++i) {
+    float* m = scene->model_views.Get(i);
+    float depth = (float)(i % columns) / (columns > 1 ? columns - 1 : 1);
+    float angle = 0.7f * i;
+    memset(m, 0, 16 * sizeof(float));
+    m[0] = cosf(angle);
+    m[2] = -sinf(angle);
+    m[5] = 1.0f;
+    m[8] = sinf(angle);
+    m[10] = cosf(angle);
+    m[12] = ((i % columns) - 0.5f * (columns - 1)) * 40.0f;
+    m[13] = ((i / columns) - 0.5f * (columns - 1)) * 30.0f;
+    m[14] = -CONVERGENCE_DISTANCE * (0.5f + 1.5f * depth);
+    m[15] = 1.0f;
+  }
+  scene->mvps.Resize(scene->num_views * scene->num_teapots);
+  MultiplyViewMatrices(&scene->projections[0], 16, scene->num_views,
+                       scene->model_views.Get(0), scene->num_teapots,
+                       scene->mvps.Get(0), GetBestCpuIsa(), 1);
+  return true;
+}
+
+static void UnloadScene(SCENE* scene) {
+  LeiaRenderContext::GetInstance()->DeleteProgram(&scene->program);
+  glDeleteBuffers(1, &scene->vbo);
+  glDeleteBuffers(1, &scene->ibo);
+}
+
+// Same state and draws as RenderView() for one view
+static void RenderView(const SCENE& scene, int32_t view) {
+  LeiaRenderContext::GetInstance()->UseProgram(scene.program);
+  glBindBuffer(GL_ARRAY_BUFFER, scene.vbo);
+  glVertexAttribPointer(ATTRIB_VERTEX, 3, GL_FLOAT, GL_FALSE,
+                        6 * sizeof(float), (char*)0);
+  glEnableVertexAttribArray(ATTRIB_VERTEX);
+  glVertexAttribPointer(ATTRIB_NORMAL, 3, GL_FLOAT, GL_FALSE,
+                        6 * sizeof(float), (char*)0 + 3 * sizeof(float));
+  glEnableVertexAttribArray(ATTRIB_NORMAL);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, scene.ibo);
+
+  UseCameraBlock(scene.program);
+  for (int32_t i = 0; i < scene.num_teapots; ++i) {
+    glUniform4f(scene.material_diffuse, 1.0f, 0.5f, 0.5f, 1.0f);
+    glUniformMatrix4fv(scene.matrix_projection, 1, GL_FALSE,
+                       scene.mvps.Get(view * scene.num_teapots + i));
+    glUniformMatrix4fv(scene.matrix_view, 1, GL_FALSE,
+                       scene.model_views.Get(i));
+    glDrawElements(GL_TRIANGLES, scene.num_indices, GL_UNSIGNED_SHORT,
+                   (char*)0);
+  }
+  glDisableVertexAttribArray(ATTRIB_VERTEX);
+  glDisableVertexAttribArray(ATTRIB_NORMAL);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+//--------------------------------------------------------------------------------
+// Pipeline
+//--------------------------------------------------------------------------------
+enum STAGE {
+  STAGE_SCENE,
+  STAGE_DOF,
+  STAGE_INTERLACE,
+  STAGE_SHARPEN,
+  STAGE_INTERLACE_SHARPEN,
+  STAGE_INTERLACE_DOF,
+  STAGE_COUNT
+};
+static const char* STAGE_NAMES[STAGE_COUNT] = {
+    "scene", "dof", "interlace", "sharpen", "interlace+sharpen",
+    "interlace+dof"};
+
+// samples_depth: a depth of field stage reads the scene depth, the chain
+// needs ATTACHMENT_POLICY::depth_sampled
+struct CHAIN {
+  const char* name;
+  STAGE stages[4];
+  int32_t num_stages;
+  bool samples_depth;
+};
+static const CHAIN CHAINS[] = {
+    {"two-pass",
+     {STAGE_SCENE, STAGE_DOF, STAGE_INTERLACE, STAGE_SHARPEN}, 4, true},
+    {"fused", {STAGE_SCENE, STAGE_DOF, STAGE_INTERLACE_SHARPEN}, 3, true},
+    {"folded", {STAGE_SCENE, STAGE_INTERLACE_DOF, STAGE_SHARPEN}, 3, true},
+    {"no-dof", {STAGE_SCENE, STAGE_INTERLACE, STAGE_SHARPEN}, 3, false},
+};
+static const int32_t NUM_CHAINS = sizeof(CHAINS) / sizeof(CHAINS[0]);
+
+struct SCREEN_TARGET {
+  GLuint fbo;
+  GLuint texture;
+};
+
+struct PIPELINE {
+  LeiaCameraData data;
+  SCENE scene;
+  CameraBuffer camera_buffer;
+  ViewAtlas atlas;
+  ViewIndexMap view_index_map;
+  GLuint programs[STAGE_COUNT];
+  // Interlaced image, and the final image standing in for the window
+  SCREEN_TARGET fullscreen;
+  SCREEN_TARGET present;
+  int32_t screen_width;
+  int32_t screen_height;
+  // Program creation, compiled or loaded from the cache, and the part of
+  // it InitPipeline() was blocked
+  double program_ms;
+  double program_blocked_ms;
+  PROGRAM_BUILD_MODE program_build;
+};
+
+static bool InitScreenTarget(int32_t width, int32_t height,
+                             SCREEN_TARGET* target) {
+  glGenTextures(1, &target->texture);
+  glBindTexture(GL_TEXTURE_2D, target->texture);
+  glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, width, height);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glGenFramebuffers(1, &target->fbo);
+  glBindFramebuffer(GL_FRAMEBUFFER, target->fbo);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                         target->texture, 0);
+  bool complete =
+      glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  return complete;
+}
+
+static void UnloadScreenTarget(SCREEN_TARGET* target) {
+  glDeleteFramebuffers(1, &target->fbo);
+  glDeleteTextures(1, &target->texture);
+}
+
+static bool InitPipeline(const OPTIONS& options, PIPELINE* pipeline) {
+  LeiaCameraData& data = pipeline->data;
+  memset(&data, 0, sizeof(data));
+  data.mNumViewsHorizontal = options.views_wide;
+  data.mNumViewsVertical = options.views_high;
+  data.mViewResXPixels = options.view_width;
+  data.mViewResYPixels = options.view_height;
+  data.mVerticalFieldOfView = VERTICAL_FOV;
+  data.mConvergenceDistance = CONVERGENCE_DISTANCE;
+  data.mNear = CAM_NEAR;
+  data.mFar = CAM_FAR;
+  data.mSystemDisparityPixels = SYSTEM_DISPARITY_PIXELS;
+  data.mBaselineScaling = 1.0f;
+  // Points at infinity get the system disparity between neighbouring views
+  const float to_radians = 3.14159f / 180.0f;
+  float f_in_pixels =
+      0.5f * options.view_height / tanf(0.5f * VERTICAL_FOV * to_radians);
+  data.mBaseline =
+      SYSTEM_DISPARITY_PIXELS * CONVERGENCE_DISTANCE / f_in_pixels;
+
+  pipeline->screen_width = options.screen_width;
+  pipeline->screen_height = options.screen_height;
+  const int32_t num_views = options.views_wide * options.views_high;
+  memset(pipeline->programs, 0, sizeof(pipeline->programs));
+  // Like Init() of the renderers: scene program, then the post programs,
+  // but waited for instead of drawing the 2D path meanwhile
+  ProgramCache::GetInstance()->Init(options.program_cache);
+  std::string scene_sources[2];
+  if (!ReadProgram("VS_ShaderPlain.vsh", "ShaderPlain.fsh", scene_sources))
+    return false;
+  pipeline->scene.program = 0;
+  ProgramBuilder builder;
+  builder.AddProgram(&pipeline->scene.program, "teapot", scene_sources[0],
+                     scene_sources[1], SCENE_ATTRIBUTES, 2);
+  AddPostProgram(&builder, &pipeline->programs[STAGE_DOF],
+                 POST_SHADER_ATLAS_DOF, num_views);
+  AddPostProgram(&builder, &pipeline->programs[STAGE_INTERLACE],
+                 POST_SHADER_VIEW_INTERLACE_INDEXED_ATLAS, num_views);
+  AddPostProgram(&builder, &pipeline->programs[STAGE_SHARPEN],
+                 POST_SHADER_VIEW_SHARPENING, num_views);
+  AddPostProgram(&builder, &pipeline->programs[STAGE_INTERLACE_SHARPEN],
+                 POST_SHADER_VIEW_INTERLACE_SHARPEN_INDEXED_ATLAS, num_views);
+  AddPostProgram(&builder, &pipeline->programs[STAGE_INTERLACE_DOF],
+                 POST_SHADER_VIEW_INTERLACE_DOF_INDEXED_ATLAS, num_views);
+  builder.Start(options.program_build);
+  builder.Finish();
+  pipeline->program_ms = builder.GetBuildTime();
+  pipeline->program_blocked_ms = builder.GetBlockedTime();
+  pipeline->program_build = builder.GetMode();
+  if (!pipeline->scene.program) return false;
+  for (int32_t i = STAGE_DOF; i < STAGE_COUNT; ++i) {
+    if (!pipeline->programs[i]) return false;
+  }
+  if (!InitScene(options, data, &pipeline->scene)) return false;
+  const float light0[3] = {100.0f, -200.0f, -600.0f};
+  const float material_ambient[3] = {0.1f, 0.1f, 0.1f};
+  const float material_specular[4] = {1.0f, 1.0f, 1.0f, 10.0f};
+  pipeline->camera_buffer.SetCamera(&data);
+  pipeline->camera_buffer.SetViewProjections(&pipeline->scene.projections[0],
+                                             16, num_views);
+  pipeline->camera_buffer.SetLight(light0, material_ambient,
+                                   material_specular);
+
+  // Both depth of field passes sample depth, unless --transient-depth
+  ATTACHMENT_POLICY policy = ResolveAttachmentPolicy(options.attachments);
+  if (!pipeline->atlas.Init(options.view_width, options.view_height,
+                            num_views, policy))
+    return false;
+  VIEW_INDEX_CALIBRATION calibration = {0, 0, 1, false};
+  if (!pipeline->view_index_map.Update(&data, calibration)) return false;
+  return InitScreenTarget(options.screen_width, options.screen_height,
+                          &pipeline->fullscreen) &&
+         InitScreenTarget(options.screen_width, options.screen_height,
+                          &pipeline->present);
+}
+
+// The number of pooled targets still acquired once the atlas released its
+// own, 0 unless a release missed or freed the wrong entry
+static int32_t UnloadPipeline(PIPELINE* pipeline) {
+  for (int32_t i = 0; i < STAGE_COUNT; ++i) {
+    LeiaRenderContext::GetInstance()->DeleteProgram(&pipeline->programs[i]);
+  }
+  UnloadScreenTarget(&pipeline->fullscreen);
+  UnloadScreenTarget(&pipeline->present);
+  pipeline->view_index_map.Unload();
+  pipeline->atlas.Unload();
+  const int32_t acquired =
+      RenderTargetPool::GetInstance()->GetStats().num_acquired;
+  RenderTargetPool::GetInstance()->Unload();
+  UnloadScene(&pipeline->scene);
+  pipeline->camera_buffer.Unload();
+  LeiaRenderContext::GetInstance()->Unload();
+  return acquired;
+}
+
+// Interlacing reads the depth of field atlas, or the scene without it
+static bool HasStage(const CHAIN& chain, STAGE stage) {
+  for (int32_t s = 0; s < chain.num_stages; ++s) {
+    if (chain.stages[s] == stage) return true;
+  }
+  return false;
+}
+
+// The same calls as RenderViewsAtlas() makes for the stage
+static void RunStage(PIPELINE* p, const CHAIN& chain, STAGE stage,
+                     GLuint target) {
+  const int32_t w = p->screen_width;
+  const int32_t h = p->screen_height;
+  const GLuint views = HasStage(chain, STAGE_DOF) ? p->atlas.GetDOFTexture()
+                                                  : p->atlas.GetColorTexture();
+  if (stage != STAGE_SCENE && stage != STAGE_DOF) {
+    // Every screen pass overwrites its whole target
+    LeiaRenderContext::GetInstance()->BindFramebuffer(target);
+    DiscardColor(p->atlas.GetAttachmentPolicy());
+  }
+  switch (stage) {
+    case STAGE_SCENE:
+      p->atlas.BindScene();
+      glClearColor(1.0f, 0.0f, 1.0f, 1.0f);
+      glEnable(GL_DEPTH_TEST);
+      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+      for (int32_t v = 0; v < p->scene.num_views; ++v) {
+        p->atlas.BindView(v);
+        RenderView(p->scene, v);
+      }
+      p->atlas.FinishScene();
+      break;
+    case STAGE_DOF:
+      p->atlas.BindDOF();
+      PrepareAtlasDOF(p->atlas.GetColorTexture(), p->atlas.GetDepthTexture(),
+                      p->atlas.GetViewRectTable(), &p->data,
+                      p->programs[STAGE_DOF], p->atlas.GetDOFFramebuffer(),
+                      p->atlas.GetWidth(), p->atlas.GetHeight(), 1.0f);
+      DrawQuad();
+      break;
+    case STAGE_INTERLACE:
+      ViewInterlaceIndexedAtlas(
+          views, p->atlas.GetViewRectTable(),
+          p->atlas.GetNumViews(), p->view_index_map.GetTexture(),
+          p->programs[STAGE_INTERLACE], target, w, h);
+      break;
+    case STAGE_SHARPEN:
+      ViewSharpening(p->fullscreen.texture, p->programs[STAGE_SHARPEN], target,
+                     w, h, ACT_COEFFICIENTS, 2);
+      break;
+    case STAGE_INTERLACE_SHARPEN:
+      ViewInterlaceAndSharpenIndexedAtlas(
+          views, p->atlas.GetViewRectTable(),
+          p->atlas.GetNumViews(), p->view_index_map.GetTexture(),
+          p->programs[STAGE_INTERLACE_SHARPEN], target, w, h, ACT_COEFFICIENTS,
+          2);
+      break;
+    case STAGE_INTERLACE_DOF:
+      ViewInterlaceDOFIndexedAtlas(
+          p->atlas.GetColorTexture(), p->atlas.GetDepthTexture(),
+          p->atlas.GetViewRectTable(), p->view_index_map.GetTexture(),
+          &p->data, p->programs[STAGE_INTERLACE_DOF], target, w, h, 1.0f);
+      break;
+    default:
+      break;
+  }
+}
+
+// Bytes read and written by a stage, each texel of every input and output
+// once: a lower bound that ignores filter taps hitting the cache again
+static void StageBytes(const PIPELINE& p, STAGE stage, int64_t* read,
+                       int64_t* written) {
+  const int64_t atlas = (int64_t)p.atlas.GetWidth() * p.atlas.GetHeight();
+  const int64_t screen = (int64_t)p.screen_width * p.screen_height;
+  const int64_t shown = screen < atlas ? screen : atlas;
+  const int64_t draws = (int64_t)p.scene.num_views * p.scene.num_teapots;
+  const ATTACHMENT_POLICY& policy = p.atlas.GetAttachmentPolicy();
+  const int64_t color = GetFormatBytesPerPixel(policy.color_format);
+  // Transient depth never leaves tile memory
+  const int64_t depth =
+      policy.depth_sampled ? GetFormatBytesPerPixel(policy.depth_format) : 0;
+  switch (stage) {
+    case STAGE_SCENE:
+      *read = draws * (p.scene.num_vertices * 6 * sizeof(float) +
+                       p.scene.num_indices * sizeof(uint16_t));
+      *written = atlas * (color + depth);
+      break;
+    case STAGE_DOF:
+      *read = atlas * (color + depth);
+      *written = atlas * color;
+      break;
+    case STAGE_INTERLACE:
+    case STAGE_INTERLACE_SHARPEN:
+      *read = shown * color;
+      *written = screen * 4;
+      break;
+    case STAGE_SHARPEN:
+      *read = screen * 4;
+      *written = screen * 4;
+      break;
+    case STAGE_INTERLACE_DOF:
+      *read = shown * (color + depth);
+      *written = screen * 4;
+      break;
+    default:
+      *read = *written = 0;
+      break;
+  }
+}
+
+// wall_ms only with --sync
+struct STAGE_RESULT {
+  double submit_ms;
+  double wall_ms;
+  double gpu_ms;
+  int64_t draw_calls;
+  int64_t clears;
+  int64_t bytes_read;
+  int64_t bytes_written;
+};
+
+// GL result of a stage against the CPU reference, mismatches counts the
+// channels off by more than CHECK_TOLERANCE
+struct CHECK_RESULT {
+  STAGE stage;
+  int32_t max_diff;
+  int64_t mismatches;
+};
+
+struct CHAIN_RESULT {
+  const CHAIN* chain;
+  double frame_ms;
+  // Per frame, binds made and skipped by LeiaRenderContext
+  RENDER_CONTEXT_STATS context;
+  // Camera blocks written to the uniform buffer, all measured frames
+  int32_t camera_uploads;
+  bool gpu_valid;
+  bool wall_valid;
+  STAGE_RESULT stages[4];
+  CHECK_RESULT checks[4];
+  int32_t num_checks;
+};
+
+static void RunChain(PIPELINE* p, const CHAIN& chain, const OPTIONS& options,
+                     const host_gl::TIMER_QUERY& timer, CHAIN_RESULT* result) {
+  memset(result, 0, sizeof(*result));
+  result->chain = &chain;
+  result->gpu_valid = timer.available;
+  result->wall_valid = options.sync;
+
+  GLuint queries[4] = {0, 0, 0, 0};
+  if (timer.available) timer.gen_queries(chain.num_stages, queries);
+
+  double frame_ms = 0.0;
+  LeiaRenderContext* context = LeiaRenderContext::GetInstance();
+  for (int32_t frame = -WARMUP_FRAMES; frame < options.frames; ++frame) {
+    const bool measured = frame >= 0;
+    // Like RenderViews(), whatever ran between frames bound on its own
+    context->Invalidate();
+    if (!frame) {
+      context->ResetStats();
+      result->camera_uploads = -p->camera_buffer.GetNumUploads();
+    }
+    std::chrono::steady_clock::time_point frame_start =
+        std::chrono::steady_clock::now();
+    // Like UpdateCameraBlock(), the same block every frame
+    p->camera_buffer.Upload();
+    for (int32_t s = 0; s < chain.num_stages; ++s) {
+      STAGE stage = chain.stages[s];
+      // The fullscreen target feeds sharpening, the last stage presents
+      GLuint target = s == chain.num_stages - 1 ? p->present.fbo
+                                                : p->fullscreen.fbo;
+      host_gl::GL_COUNTERS before = host_gl::counters;
+      std::chrono::steady_clock::time_point start =
+          std::chrono::steady_clock::now();
+      if (timer.available) timer.begin_query(GL_TIME_ELAPSED_EXT, queries[s]);
+      RunStage(p, chain, stage, target);
+      if (timer.available) timer.end_query(GL_TIME_ELAPSED_EXT);
+      std::chrono::steady_clock::time_point submitted =
+          std::chrono::steady_clock::now();
+      if (options.sync) glFinish();
+      if (!measured) continue;
+
+      STAGE_RESULT& r = result->stages[s];
+      r.submit_ms +=
+          std::chrono::duration<double, std::milli>(submitted - start).count();
+      if (options.sync) {
+        r.wall_ms += std::chrono::duration<double, std::milli>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+      }
+      r.draw_calls += host_gl::counters.draw_calls - before.draw_calls;
+      r.clears += host_gl::counters.clears - before.clears;
+    }
+    glFinish();
+    EndGlCaptureFrame();
+    if (!measured) continue;
+    frame_ms += std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - frame_start)
+                    .count();
+
+    if (timer.available) {
+      GLint disjoint = 0;
+      glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+      if (disjoint) result->gpu_valid = false;
+      for (int32_t s = 0; s < chain.num_stages; ++s) {
+        GLuint64 ns = 0;
+        timer.get_query_object_ui64v(queries[s], GL_QUERY_RESULT_EXT, &ns);
+        result->stages[s].gpu_ms += ns / 1000000.0;
+      }
+    }
+  }
+  if (timer.available) timer.delete_queries(chain.num_stages, queries);
+
+  result->frame_ms = frame_ms / options.frames;
+  result->camera_uploads += p->camera_buffer.GetNumUploads();
+  result->context = context->GetStats();
+  int32_t* counters = (int32_t*)&result->context;
+  for (size_t i = 0; i < sizeof(result->context) / sizeof(int32_t); ++i)
+    counters[i] /= options.frames;
+  for (int32_t s = 0; s < chain.num_stages; ++s) {
+    STAGE_RESULT& r = result->stages[s];
+    r.submit_ms /= options.frames;
+    r.wall_ms /= options.frames;
+    r.gpu_ms /= options.frames;
+    r.draw_calls /= options.frames;
+    r.clears /= options.frames;
+    StageBytes(*p, chain.stages[s], &r.bytes_read, &r.bytes_written);
+  }
+}
+
+//--------------------------------------------------------------------------------
+// Check
+// The targets still hold the last frame of the chain. The CPU reference
+// interlaces the atlas the GL pass read, depth of field or scene, and
+// sharpens the fullscreen target. The folded chain has no CPU depth of
+// field, only its sharpening is checked.
+//--------------------------------------------------------------------------------
+static void ReadFramebuffer(GLuint fbo, int32_t width, int32_t height,
+                            GLenum color_format, std::vector<uint8_t>* pixels) {
+  LeiaRenderContext::GetInstance()->BindFramebuffer(fbo);
+  pixels->resize((size_t)width * height * 4);
+  if (color_format != GL_R11F_G11F_B10F) {
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE,
+                 &(*pixels)[0]);
+    return;
+  }
+  // Float targets only read back as floats, rounded like a shader output
+  std::vector<float> texels(pixels->size());
+  glReadPixels(0, 0, width, height, GL_RGBA, GL_FLOAT, &texels[0]);
+  for (size_t i = 0; i < texels.size(); ++i) {
+    float v = texels[i] < 0.0f ? 0.0f : (texels[i] > 1.0f ? 1.0f : texels[i]);
+    (*pixels)[i] = (uint8_t)(v * 255.0f + 0.5f);
+  }
+}
+
+// Every view of the atlas the chain interlaced as its own tightly packed
+// image, for CPU_VIEWS
+static void ReadAtlasViews(const PIPELINE& p, const CHAIN& chain,
+                           std::vector<std::vector<uint8_t> >* views) {
+  std::vector<uint8_t> atlas;
+  const int32_t width = p.atlas.GetWidth();
+  const GLuint fbo = HasStage(chain, STAGE_DOF) ? p.atlas.GetDOFFramebuffer()
+                                                : p.atlas.GetFramebuffer();
+  ReadFramebuffer(fbo, width, p.atlas.GetHeight(),
+                  p.atlas.GetAttachmentPolicy().color_format, &atlas);
+  views->resize(p.atlas.GetNumViews());
+  for (int32_t v = 0; v < p.atlas.GetNumViews(); ++v) {
+    const VIEW_RECT& rect = p.atlas.GetViewRect(v);
+    std::vector<uint8_t>& view = (*views)[v];
+    view.resize((size_t)rect.width * rect.height * 4);
+    for (int32_t y = 0; y < rect.height; ++y) {
+      memcpy(&view[(size_t)y * rect.width * 4],
+             &atlas[((size_t)(rect.y + y) * width + rect.x) * 4],
+             rect.width * 4);
+    }
+  }
+}
+
+static CHECK_RESULT Compare(STAGE stage, const std::vector<uint8_t>& gl,
+                            const std::vector<uint8_t>& cpu) {
+  CHECK_RESULT check = {stage, 0, 0};
+  for (size_t i = 0; i < gl.size(); ++i) {
+    int32_t diff = abs((int32_t)gl[i] - cpu[i]);
+    if (diff > check.max_diff) check.max_diff = diff;
+    if (diff > CHECK_TOLERANCE) ++check.mismatches;
+  }
+  return check;
+}
+
+static void CheckChain(const PIPELINE& p, const CHAIN& chain,
+                       CHAIN_RESULT* result) {
+  const int32_t w = p.screen_width;
+  const int32_t h = p.screen_height;
+  std::vector<uint8_t> fullscreen;
+  std::vector<uint8_t> present;
+  ReadFramebuffer(p.fullscreen.fbo, w, h, GL_RGBA8, &fullscreen);
+  ReadFramebuffer(p.present.fbo, w, h, GL_RGBA8, &present);
+
+  std::vector<std::vector<uint8_t> > views;
+  std::vector<const uint8_t*> view_pointers;
+  ReadAtlasViews(p, chain, &views);
+  for (size_t v = 0; v < views.size(); ++v)
+    view_pointers.push_back(&views[v][0]);
+  const CPU_VIEWS cpu_views = {&view_pointers[0], p.atlas.GetViewRect(0).width,
+                               p.atlas.GetViewRect(0).height};
+
+  // No alignment offset nor slant, the calibration of InitPipeline()
+  std::vector<uint8_t> reference((size_t)w * h * 4);
+  const CPU_ISA isa = GetBestCpuIsa();
+  const GLenum color_format = p.atlas.GetAttachmentPolicy().color_format;
+  const bool eight_bit_views =
+      color_format == GL_RGBA8 || color_format == GL_RGB565;
+  result->num_checks = 0;
+  for (int32_t s = 0; s < chain.num_stages; ++s) {
+    const STAGE stage = chain.stages[s];
+    const std::vector<uint8_t>& target =
+        s == chain.num_stages - 1 ? present : fullscreen;
+    switch (stage) {
+      case STAGE_INTERLACE:
+        CpuViewInterlace(cpu_views, &p.data, 0, &reference[0], w, h, isa, 0);
+        break;
+      case STAGE_INTERLACE_SHARPEN:
+        // The fused pass sharpens the atlas texels themselves, with 10 bit
+        // or float colour they are more precise than the RGBA8 reference
+        if (!eight_bit_views) continue;
+        CpuViewInterlaceAndSharpen(cpu_views, &p.data, 0, ACT_COEFFICIENTS, 2,
+                                   &reference[0], w, h, isa, 0);
+        break;
+      case STAGE_SHARPEN:
+        CpuViewSharpening(&fullscreen[0], w, h, ACT_COEFFICIENTS, 2,
+                          &reference[0], isa, 0);
+        break;
+      default:
+        // Scene and depth of field have no CPU reference
+        continue;
+    }
+    result->checks[result->num_checks++] = Compare(stage, target, reference);
+  }
+}
+
+//--------------------------------------------------------------------------------
+// Reports
+//--------------------------------------------------------------------------------
+static void PrintTable(const std::vector<CHAIN_RESULT>& results) {
+  printf("%-9s %-18s %9s %9s %9s %6s %6s %9s %9s\n", "chain", "stage",
+         "submit ms", "wall ms", "gpu ms", "draws", "clears", "read MB",
+         "write MB");
+  for (size_t c = 0; c < results.size(); ++c) {
+    const CHAIN_RESULT& chain = results[c];
+    for (int32_t s = 0; s < chain.chain->num_stages; ++s) {
+      const STAGE_RESULT& r = chain.stages[s];
+      char wall[16];
+      char gpu[16];
+      if (chain.wall_valid)
+        snprintf(wall, sizeof(wall), "%9.3f", r.wall_ms);
+      else
+        snprintf(wall, sizeof(wall), "%9s", "-");
+      if (chain.gpu_valid)
+        snprintf(gpu, sizeof(gpu), "%9.3f", r.gpu_ms);
+      else
+        snprintf(gpu, sizeof(gpu), "%9s", "-");
+      printf("%-9s %-18s %9.3f %s %s %6lld %6lld %9.2f %9.2f\n",
+             chain.chain->name, STAGE_NAMES[chain.chain->stages[s]],
+             r.submit_ms, wall, gpu, (long long)r.draw_calls,
+             (long long)r.clears, r.bytes_read / (1024.0 * 1024.0),
+             r.bytes_written / (1024.0 * 1024.0));
+    }
+    const RENDER_CONTEXT_STATS& context = chain.context;
+    // A frame always ends in glFinish(), its time is wall time
+    printf("%-9s %-18s %9s %9.3f  binds %d, %d elided, %d uniform queries, "
+           "%d camera uploads\n",
+           chain.chain->name, "frame", "-", chain.frame_ms,
+           context.program_binds + context.framebuffer_binds +
+               context.texture_binds,
+           context.programs_elided + context.framebuffers_elided +
+               context.textures_elided,
+           context.uniform_queries, chain.camera_uploads);
+    printf("%-9s %-18s", chain.chain->name, "cpu check");
+    if (!chain.num_checks) printf(" none");
+    for (int32_t i = 0; i < chain.num_checks; ++i) {
+      const CHECK_RESULT& check = chain.checks[i];
+      printf("%s %s max %d LSB", i ? "," : "", STAGE_NAMES[check.stage],
+             check.max_diff);
+      if (check.mismatches)
+        printf(" (%lld over %d)", (long long)check.mismatches, CHECK_TOLERANCE);
+    }
+    printf("\n");
+  }
+}
+
+static void WriteJson(FILE* out, const OPTIONS& options,
+                      const PIPELINE& pipeline,
+                      const std::vector<CHAIN_RESULT>& results) {
+  const ATTACHMENT_POLICY& policy = pipeline.atlas.GetAttachmentPolicy();
+  fprintf(out, "{\n  \"config\": {\"views\": [%d, %d], \"view_size\": [%d, %d], "
+               "\"screen\": [%d, %d], \"teapots\": %d, \"frames\": %d, "
+               "\"sync\": %s, \"color\": \"%s\", \"depth\": \"%s\", "
+               "\"discard\": %s, \"transient_depth\": %s},\n",
+          options.views_wide, options.views_high, options.view_width,
+          options.view_height, options.screen_width, options.screen_height,
+          options.teapots, options.frames, options.sync ? "true" : "false",
+          GetFormatName(policy.color_format), GetFormatName(policy.depth_format),
+          policy.discard ? "true" : "false",
+          policy.depth_sampled ? "false" : "true");
+  ATTACHMENT_BANDWIDTH bandwidth = EstimateAttachmentBandwidth(
+      policy, options.view_width, options.view_height,
+      options.views_wide * options.views_high, options.screen_width,
+      options.screen_height);
+  fprintf(out, "  \"estimate\": {\"bytes_read\": %lld, "
+               "\"bytes_written\": %lld, \"loads\": %lld},\n",
+          (long long)bandwidth.total_read, (long long)bandwidth.total_written,
+          (long long)bandwidth.loads);
+  PROGRAM_CACHE_STATS cache = ProgramCache::GetInstance()->GetStats();
+  fprintf(out, "  \"programs\": {\"ms\": %.4f, \"blocked_ms\": %.4f, "
+               "\"build\": \"%s\", \"loaded\": %d, \"compiled\": %d, "
+               "\"rejected\": %d, \"stored\": %d},\n",
+          pipeline.program_ms, pipeline.program_blocked_ms,
+          GetProgramBuildModeName(pipeline.program_build), cache.hits,
+          cache.misses + cache.rejects, cache.rejects, cache.stores);
+  // Driver strings may hold quotes, keep them out of the JSON
+  std::string strings[3];
+  const GLenum names[3] = {GL_VENDOR, GL_RENDERER, GL_VERSION};
+  for (int32_t i = 0; i < 3; ++i) {
+    const char* value = (const char*)glGetString(names[i]);
+    for (const char* c = value ? value : ""; *c; ++c) {
+      if (*c != '"' && *c != '\\') strings[i].push_back(*c);
+    }
+  }
+  fprintf(out, "  \"gl\": {\"vendor\": \"%s\", \"renderer\": \"%s\", "
+               "\"version\": \"%s\"},\n",
+          strings[0].c_str(), strings[1].c_str(), strings[2].c_str());
+  fprintf(out, "  \"chains\": [\n");
+  for (size_t c = 0; c < results.size(); ++c) {
+    const CHAIN_RESULT& chain = results[c];
+    const RENDER_CONTEXT_STATS& context = chain.context;
+    fprintf(out, "    {\"name\": \"%s\", \"frame_ms\": %.4f, "
+                 "\"context\": {\"program_binds\": %d, "
+                 "\"programs_elided\": %d, \"framebuffer_binds\": %d, "
+                 "\"framebuffers_elided\": %d, \"texture_binds\": %d, "
+                 "\"textures_elided\": %d, \"uniform_lookups\": %d, "
+                 "\"uniform_queries\": %d}, \"camera_uploads\": %d, "
+                 "\"stages\": [\n",
+            chain.chain->name, chain.frame_ms, context.program_binds,
+            context.programs_elided, context.framebuffer_binds,
+            context.framebuffers_elided, context.texture_binds,
+            context.textures_elided, context.uniform_lookups,
+            context.uniform_queries, chain.camera_uploads);
+    for (int32_t s = 0; s < chain.chain->num_stages; ++s) {
+      const STAGE_RESULT& r = chain.stages[s];
+      char wall[32];
+      char gpu[32];
+      if (chain.wall_valid)
+        snprintf(wall, sizeof(wall), "%.4f", r.wall_ms);
+      else
+        snprintf(wall, sizeof(wall), "null");
+      if (chain.gpu_valid)
+        snprintf(gpu, sizeof(gpu), "%.4f", r.gpu_ms);
+      else
+        snprintf(gpu, sizeof(gpu), "null");
+      fprintf(out, "      {\"name\": \"%s\", \"submit_ms\": %.4f, "
+                   "\"wall_ms\": %s, \"gpu_ms\": %s, \"draw_calls\": %lld, "
+                   "\"clears\": %lld, \"bytes_read\": %lld, "
+                   "\"bytes_written\": %lld}%s\n",
+              STAGE_NAMES[chain.chain->stages[s]], r.submit_ms, wall, gpu,
+              (long long)r.draw_calls, (long long)r.clears,
+              (long long)r.bytes_read, (long long)r.bytes_written,
+              s + 1 < chain.chain->num_stages ? "," : "");
+    }
+    fprintf(out, "    ], \"check\": [");
+    for (int32_t i = 0; i < chain.num_checks; ++i) {
+      const CHECK_RESULT& check = chain.checks[i];
+      fprintf(out, "%s{\"stage\": \"%s\", \"max_diff\": %d, "
+                   "\"mismatches\": %lld}",
+              i ? ", " : "", STAGE_NAMES[check.stage], check.max_diff,
+              (long long)check.mismatches);
+    }
+    fprintf(out, "]}%s\n", c + 1 < results.size() ? "," : "");
+  }
+  fprintf(out, "  ]\n}\n");
+}
+
+int main(int argc, char** argv) {
+  OPTIONS options;
+  if (!ParseOptions(argc, argv, &options)) return 2;
+
+  host_gl::CONTEXT ctx;
+  if (!host_gl::CreateContext(&ctx)) {
+    fprintf(stderr, "No OpenGL ES 3 context\n");
+    return 1;
+  }
+  host_gl::TIMER_QUERY timer;
+  host_gl::InitTimerQuery(&timer);
+
+  if (!options.capture.empty() &&
+      !StartGlCapture(options.capture.c_str(), 0)) {
+    fprintf(stderr, "Can not write %s\n", options.capture.c_str());
+    host_gl::DestroyContext(&ctx);
+    return 1;
+  }
+
+  PIPELINE pipeline;
+  if (!InitPipeline(options, &pipeline)) {
+    fprintf(stderr, "Pipeline setup failed\n");
+    UnloadPipeline(&pipeline);
+    host_gl::DestroyContext(&ctx);
+    return 1;
+  }
+
+  std::vector<CHAIN_RESULT> results;
+  const bool depth_sampled = pipeline.atlas.GetAttachmentPolicy().depth_sampled;
+  for (int32_t c = 0; c < NUM_CHAINS; ++c) {
+    if (options.chain != "all" && options.chain != CHAINS[c].name) continue;
+    if (CHAINS[c].samples_depth && !depth_sampled) continue;
+    CHAIN_RESULT result;
+    RunChain(&pipeline, CHAINS[c], options, timer, &result);
+    CheckChain(pipeline, CHAINS[c], &result);
+    results.push_back(result);
+  }
+  StopGlCapture();
+  GLenum error = glGetError();
+
+  bool json_only = options.json == "-";
+  if (!json_only) {
+    printf("%dx%d views of %dx%d -> %dx%d, %d teapots, %d frames%s, %s\n",
+           options.views_wide, options.views_high, options.view_width,
+           options.view_height, options.screen_width, options.screen_height,
+           options.teapots, options.frames, options.sync ? ", synced" : "",
+           glGetString(GL_RENDERER));
+    const ATTACHMENT_POLICY& policy = pipeline.atlas.GetAttachmentPolicy();
+    ATTACHMENT_BANDWIDTH bandwidth = EstimateAttachmentBandwidth(
+        policy, options.view_width, options.view_height,
+        options.views_wide * options.views_high, options.screen_width,
+        options.screen_height);
+    printf("%s + %s%s%s, two-pass estimate %.2f MB read (%.2f MB loads), "
+           "%.2f MB written\n",
+           GetFormatName(policy.color_format), GetFormatName(policy.depth_format),
+           policy.depth_sampled ? "" : " transient",
+           policy.discard ? ", discard" : "",
+           bandwidth.total_read / (1024.0 * 1024.0),
+           bandwidth.loads / (1024.0 * 1024.0),
+           bandwidth.total_written / (1024.0 * 1024.0));
+    PROGRAM_CACHE_STATS cache = ProgramCache::GetInstance()->GetStats();
+    printf("programs %.2f ms (%s, %.2f ms blocked), %d loaded, %d compiled%s\n",
+           pipeline.program_ms, GetProgramBuildModeName(pipeline.program_build),
+           pipeline.program_blocked_ms, cache.hits,
+           cache.misses + cache.rejects,
+           ProgramCache::GetInstance()->IsEnabled() ? "" : ", no cache");
+    PrintTable(results);
+  }
+  if (json_only) {
+    WriteJson(stdout, options, pipeline, results);
+  } else if (!options.json.empty()) {
+    FILE* out = fopen(options.json.c_str(), "w");
+    if (out) {
+      WriteJson(out, options, pipeline, results);
+      fclose(out);
+    } else {
+      fprintf(stderr, "Can not write %s\n", options.json.c_str());
+    }
+  }
+
+  const int32_t leaked = UnloadPipeline(&pipeline);
+  host_gl::DestroyContext(&ctx);
+  if (results.empty()) {
+    fprintf(stderr, depth_sampled ? "Unknown chain %s\n"
+                                  : "No chain %s without depth of field\n",
+            options.chain.c_str());
+    return 2;
+  }
+  if (leaked) {
+    fprintf(stderr, "%d pooled targets still acquired after unload\n",
+            leaked);
+    return 1;
+  }
+  if (error != GL_NO_ERROR) {
+    fprintf(stderr, "GL error 0x%x\n", error);
+    return 1;
+  }
+  for (size_t c = 0; c < results.size(); ++c) {
+    for (int32_t i = 0; i < results[c].num_checks; ++i) {
+      const CHECK_RESULT& check = results[c].checks[i];
+      if (!check.mismatches) continue;
+      fprintf(stderr, "%s %s differs from the CPU reference by %d LSB\n",
+              results[c].chain->name, STAGE_NAMES[check.stage],
+              check.max_diff);
+      return 1;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,345 @@
+/*
+ * Copyright 2018 Leia Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//--------------------------------------------------------------------------------
+// vecmathBench.cpp
+// ndk_helper::Mat4 with the SIMD kernels the host gets, SSE2 or NEON,
+// against the same classes built with VECMATH_SCALAR, in ns per call over a
+// batch of inputs. Every result is checked to match the scalar one first.
+// "chain" is a renderer style product of temporaries, "chain batch" the same
+// through the Mat4::Multiply() batches, likewise for points. The Affine rows
+// run on the non projective inputs. The header
+// only vecmath2.h runs the same code and is checked the same way.
+//
+// usage: vecmath-bench [iterations]
+//--------------------------------------------------------------------------------
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <vector>
+
+#include "vecmath.h"
+// ndk-helper-scalar-host, the same classes in namespace vecmath_scalar
+#undef VECMATH_H_
+#define ndk_helper vecmath_scalar
+#include "vecmath.h"
+#undef ndk_helper
+#include "vecmath2.h"
+
+static const int32_t COUNT = 1024;
+static const int32_t DEFAULT_ITERATIONS = 2000;
+// Best of, the calls are short enough for the scheduler to show
+static const int32_t REPEATS = 5;
+
+struct MAT4 {
+  float f[16];
+};
+
+// Rotation, scale and translation like the teapot transforms, every fourth
+// one a perspective projection
+static MAT4 Input(int32_t i, bool projections) {
+  MAT4 ret;
+  memset(&ret, 0, sizeof(ret));
+  if (projections && i % 4 == 0) {
+    ret.f[0] = 1.2f + 0.001f * i;
+    ret.f[5] = 2.1f;
+    ret.f[10] = -1.001f;
+    ret.f[11] = -1.0f;
+    ret.f[14] = -10.005f;
+    return ret;
+  }
+  float a = 0.37f * i;
+  float b = -0.11f * i;
+  float s = 0.5f + 0.001f * (i % 997);
+  ret.f[0] = cosf(a) * s;
+  ret.f[1] = sinf(a) * cosf(b) * s;
+  ret.f[2] = sinf(a) * sinf(b) * s;
+  ret.f[4] = -sinf(a) * s;
+  ret.f[5] = cosf(a) * cosf(b) * s;
+  ret.f[6] = cosf(a) * sinf(b) * s;
+  ret.f[9] = -sinf(b) * s;
+  ret.f[10] = cosf(b) * s;
+  ret.f[12] = (float)(i % 100) - 50.0f;
+  ret.f[13] = (float)((i / 100) % 100) - 50.0f;
+  ret.f[14] = -100.0f - 0.1f * i;
+  ret.f[15] = 1.0f;
+  return ret;
+}
+
+/******************************************************************
+ * One batch of every operation, for either build of the classes
+ */
+template <typename MAT, typename AFFINE, typename VEC3, typename VEC4,
+          typename SOA>
+struct OPS {
+  std::vector<MAT> a, b, out, temp;
+  std::vector<AFFINE> affine, affine_out;
+  std::vector<VEC4> vecs, vec_out;
+  // Points as separate arrays and as blocks of 8, with radii
+  std::vector<float> points, point_out;
+
+  OPS()
+      : a(COUNT),
+        b(COUNT),
+        out(COUNT),
+        temp(COUNT),
+        affine(COUNT),
+        affine_out(COUNT),
+        vecs(COUNT),
+        vec_out(COUNT),
+        points(COUNT * 4),
+        point_out(COUNT * 4) {
+    for (int32_t i = 0; i < COUNT; ++i) {
+      a[i] = MAT(Input(i, true).f);
+      b[i] = MAT(Input(i * 7 + 3, false).f);
+      affine[i] = AFFINE(b[i]);
+      float v[4];
+      for (int32_t k = 0; k < 4; ++k)
+        v[k] = (float)((i * 4 + k) % 37) * 0.25f - 4.0f;
+      vecs[i] = VEC4(v[0], v[1], v[2], v[3]);
+      for (int32_t k = 0; k < 4; ++k)
+        points[k * COUNT + i] = k < 3 ? v[k] : 1.0f + 0.01f * i;
+    }
+  }
+
+  void Multiply() {
+    for (int32_t i = 0; i < COUNT; ++i) out[i] = a[i] * b[i];
+  }
+
+  // Chained the way the renderers build model views, two products
+  void MultiplyAssign() {
+    for (int32_t i = 0; i < COUNT; ++i) {
+      out[i] = a[i];
+      out[i] *= b[i];
+      out[i] *= b[(i + 1) % COUNT];
+    }
+  }
+
+  void Transform() {
+    for (int32_t i = 0; i < COUNT; ++i) vec_out[i] = a[i] * vecs[i];
+  }
+
+  void TransformRow() {
+    for (int32_t i = 0; i < COUNT; ++i) vec_out[i] = vecs[i] * a[i];
+  }
+
+  void Inverse() {
+    for (int32_t i = 0; i < COUNT; ++i) {
+      out[i] = b[i];
+      out[i].Inverse();
+    }
+  }
+
+  void LookAt() {
+    for (int32_t i = 0; i < COUNT; ++i) {
+      const float* eye = b[i].Ptr() + 12;
+      out[i] = MAT::LookAt(VEC3(eye[0], eye[1], eye[2]), VEC3(0.0f, 0.0f, 0.0f),
+                           VEC3(0.0f, 1.0f, 0.0f));
+    }
+  }
+
+  void Perspective() {
+    for (int32_t i = 0; i < COUNT; ++i)
+      out[i] = MAT::Perspective(1.0f + 0.001f * i, 1.5f, 1.0f, 1000.0f);
+  }
+
+  // The chain the renderers built a teapot with, one temporary per product
+  void Chain() {
+    for (int32_t i = 0; i < COUNT; ++i) out[i] = a[i] * b[0] * b[i] * a[1];
+  }
+
+  void ChainBatch() {
+    MAT::Multiply(&a[0], b[0], COUNT, &out[0]);
+    MAT::Multiply(&out[0], &b[0], COUNT, &temp[0]);
+    MAT::Multiply(&temp[0], a[1], COUNT, &out[0]);
+  }
+
+  void Points() {
+    for (int32_t i = 0; i < COUNT; ++i) {
+      VEC4 p = b[0] * VEC4(points[i], points[COUNT + i], points[2 * COUNT + i],
+                           1.0f);
+      float w;
+      p.Value(point_out[i], point_out[COUNT + i], point_out[2 * COUNT + i], w);
+    }
+  }
+
+  void PointsBatch() {
+    float* p = &points[0];
+    float* o = &point_out[0];
+    b[0].TransformPoints(SOA::Arrays(p, p + COUNT, p + 2 * COUNT), COUNT,
+                         SOA::Arrays(o, o + COUNT, o + 2 * COUNT));
+  }
+
+  // Blocks of 8 in place of the arrays, same results in another order
+  void SpheresBatch() {
+    b[0].TransformSpheres(SOA::Blocks(&points[0], 8, true), COUNT,
+                          SOA::Blocks(&point_out[0], 8, true));
+  }
+
+  void AffineMultiply() {
+    for (int32_t i = 0; i < COUNT; ++i)
+      affine_out[i] = affine[i] * affine[(i + 1) % COUNT];
+  }
+
+  void AffineInverse() {
+    for (int32_t i = 0; i < COUNT; ++i) {
+      affine_out[i] = affine[i];
+      affine_out[i].Inverse();
+    }
+  }
+
+  // Wrong for the scaled inputs, but the same everywhere
+  void AffineInverseRigid() {
+    for (int32_t i = 0; i < COUNT; ++i) {
+      affine_out[i] = affine[i];
+      affine_out[i].InverseRigid();
+    }
+  }
+
+  void Result(std::vector<float>* result) {
+    result->resize(COUNT * 32);
+    for (int32_t i = 0; i < COUNT; ++i) {
+      memcpy(&(*result)[i * 16], out[i].Ptr(), sizeof(MAT4));
+      vec_out[i].Value((*result)[i * 16], (*result)[i * 16 + 1],
+                       (*result)[i * 16 + 2], (*result)[i * 16 + 3]);
+    }
+    memcpy(&(*result)[COUNT * 16], &point_out[0], sizeof(float) * COUNT * 4);
+    for (int32_t i = 0; i < COUNT; ++i)
+      memcpy(&(*result)[COUNT * 20 + i * 12], affine_out[i].Ptr(),
+             sizeof(float) * 12);
+  }
+};
+
+typedef OPS<ndk_helper::Mat4, ndk_helper::Affine, ndk_helper::Vec3,
+            ndk_helper::Vec4, ndk_helper::Vec3Soa>
+    SIMD_OPS;
+typedef OPS<vecmath_scalar::Mat4, vecmath_scalar::Affine, vecmath_scalar::Vec3,
+            vecmath_scalar::Vec4, vecmath_scalar::Vec3Soa>
+    SCALAR_OPS;
+typedef OPS<ndk_helper::v2::Mat4, ndk_helper::v2::Affine, ndk_helper::v2::Vec3,
+            ndk_helper::v2::Vec4, ndk_helper::v2::Vec3Soa>
+    V2_OPS;
+
+// vecmath2.h folds constant transforms at compile time
+static constexpr ndk_helper::v2::Mat4 V2_MODEL = ndk_helper::v2::Mat4::Product(
+    ndk_helper::v2::Mat4::Identity(),
+    ndk_helper::v2::Mat4::Translation(1.0f, 2.0f, -200.0f),
+    ndk_helper::v2::Mat4::Scale(50.0f, 50.0f, 1.0f));
+static_assert(V2_MODEL * ndk_helper::v2::Vec4(1.0f, 1.0f, 1.0f, 1.0f) ==
+                  ndk_helper::v2::Vec4(51.0f, 52.0f, -199.0f, 1.0f),
+              "vecmath2.h is not constexpr");
+
+template <typename T>
+static double NsPerCall(T* ops, void (T::*op)(), int32_t iterations,
+                        int32_t calls) {
+  double best = 0.0;
+  for (int32_t r = 0; r < REPEATS; ++r) {
+    std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+    for (int32_t i = 0; i < iterations; ++i) (ops->*op)();
+    double ns = std::chrono::duration<double, std::nano>(
+                    std::chrono::steady_clock::now() - start)
+                    .count();
+    if (r == 0 || ns < best) best = ns;
+  }
+  return best / ((double)iterations * COUNT * calls);
+}
+
+// Same bits, but the sign of a zero cofactor may differ
+static int32_t Compare(const char* name, const char* build,
+                       const std::vector<float>& result,
+                       const std::vector<float>& scalar_result) {
+  for (size_t k = 0; k < result.size(); ++k) {
+    if (result[k] != scalar_result[k]) {
+      printf("%-12s%s differs from the scalar build at %d: %g %g\n", name,
+             build, (int32_t)k, result[k], scalar_result[k]);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  int32_t iterations = argc > 1 ? atoi(argv[1]) : DEFAULT_ITERATIONS;
+  if (iterations <= 0) iterations = DEFAULT_ITERATIONS;
+
+#if defined(__SSE2__)
+  const char* isa = "sse2";
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+  const char* isa = "neon";
+#else
+  const char* isa = "scalar";
+#endif
+  printf("%s, %d calls, %d iterations\n", isa, COUNT, iterations);
+  printf("%-12s %10s %10s %9s %10s %9s\n", "op", "scalar ns", "ns", "speedup",
+         "v2 ns", "speedup");
+
+  struct OP {
+    const char* name;
+    void (SIMD_OPS::*simd)();
+    void (SCALAR_OPS::*scalar)();
+    void (V2_OPS::*v2)();
+    // Products per call
+    int32_t calls;
+  };
+#define OP_ROW(name, op, calls) \
+  { name, &SIMD_OPS::op, &SCALAR_OPS::op, &V2_OPS::op, calls }
+  const OP ops[] = {
+      OP_ROW("Mat4*Mat4", Multiply, 1),
+      OP_ROW("Mat4*=Mat4", MultiplyAssign, 2),
+      OP_ROW("Mat4*Vec4", Transform, 1),
+      OP_ROW("Vec4*Mat4", TransformRow, 1),
+      OP_ROW("Inverse", Inverse, 1),
+      OP_ROW("LookAt", LookAt, 1),
+      OP_ROW("Perspective", Perspective, 1),
+      OP_ROW("chain", Chain, 3),
+      OP_ROW("chain batch", ChainBatch, 3),
+      OP_ROW("points", Points, 1),
+      OP_ROW("points batch", PointsBatch, 1),
+      OP_ROW("spheres", SpheresBatch, 1),
+      OP_ROW("Affine*", AffineMultiply, 1),
+      OP_ROW("Affine inv", AffineInverse, 1),
+      OP_ROW("rigid inv", AffineInverseRigid, 1),
+  };
+#undef OP_ROW
+
+  SIMD_OPS simd;
+  SCALAR_OPS scalar;
+  V2_OPS v2;
+  int32_t failures = 0;
+  for (size_t n = 0; n < sizeof(ops) / sizeof(ops[0]); ++n) {
+    const OP& op = ops[n];
+    (simd.*op.simd)();
+    (scalar.*op.scalar)();
+    (v2.*op.v2)();
+    std::vector<float> simd_result, scalar_result, v2_result;
+    simd.Result(&simd_result);
+    scalar.Result(&scalar_result);
+    v2.Result(&v2_result);
+    failures += Compare(op.name, "", simd_result, scalar_result);
+    failures += Compare(op.name, " v2", v2_result, scalar_result);
+
+    double scalar_ns = NsPerCall(&scalar, op.scalar, iterations, op.calls);
+    double simd_ns = NsPerCall(&simd, op.simd, iterations, op.calls);
+    double v2_ns = NsPerCall(&v2, op.v2, iterations, op.calls);
+    printf("%-12s %10.2f %10.2f %8.2fx %10.2f %8.2fx\n", op.name, scalar_ns,
+           simd_ns, scalar_ns / simd_ns, v2_ns, scalar_ns / v2_ns);
+  }
+  return failures ? 1 : 0;
+}
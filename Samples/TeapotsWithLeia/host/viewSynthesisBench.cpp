@@ -0,0 +1,303 @@
+/*
+ * Copyright 2018 Leia Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//--------------------------------------------------------------------------------
+// viewSynthesisBench.cpp
+// Accuracy and cost of the CPU view synthesis reference for each mode.
+// The scene is a stack of textured layers at known depths, so every view,
+// at any position, can be rendered exactly with the disparity model of
+// cpuViewSynthesis.h: the source views are rendered, the others synthesized
+// and compared against their exact rendering.
+//
+// Built with EGL and GLES 3 (VIEW_SYNTHESIS_GL), the same sources also go
+// through the GL pass, POST_SHADER_VIEW_SYNTHESIS_ATLAS into a ViewAtlas.
+// The atlas colour is read back and every view must match CpuViewSynthesis()
+// exactly. Without a context at run time only the CPU reference runs.
+//
+// usage: view-synthesis-bench [iterations]
+//--------------------------------------------------------------------------------
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <vector>
+
+#include "cpuViewSynthesis.h"
+#if defined(VIEW_SYNTHESIS_GL)
+#include "hostContext.h"
+#include "postProcess.h"
+#include "renderContext.h"
+#include "renderTargetPool.h"
+#include "viewAtlas.h"
+#include "viewSynthesis.h"
+#endif
+
+using namespace leia_helper;
+
+static const int32_t NUM_VIEWS = 4;
+static const int32_t VIEW_WIDTH = 640;
+static const int32_t VIEW_HEIGHT = 360;
+static const float VERTICAL_FOV = 38.6f;
+static const float CONVERGENCE_DISTANCE = 200.0f;
+// About 8 pixels of disparity per view at half the convergence distance
+static const float BASELINE = 3.0f;
+static const float CAM_NEAR = 5.0f;
+static const float CAM_FAR = 10000.0f;
+static const int32_t DEFAULT_ITERATIONS = 5;
+// Synthesized views below this are reported as failures
+static const double MIN_PSNR = 25.0;
+
+//--------------------------------------------------------------------------------
+// Layered scene
+// Layers are rectangles in the pixel space of the centre view, back to front
+//--------------------------------------------------------------------------------
+struct LAYER {
+  float z;
+  float x0, y0, x1, y1;
+  uint8_t r, g, b;
+};
+
+static const LAYER LAYERS[] = {
+    {1000.0f, -1.0e6f, -1.0e6f, 1.0e6f, 1.0e6f, 40, 90, 160},
+    {200.0f, 120.0f, 60.0f, 300.0f, 300.0f, 200, 180, 60},
+    {120.0f, 260.0f, 100.0f, 420.0f, 220.0f, 60, 200, 90},
+    {70.0f, 380.0f, 150.0f, 470.0f, 330.0f, 220, 80, 70},
+};
+static const int32_t NUM_LAYERS = sizeof(LAYERS) / sizeof(LAYERS[0]);
+
+static float DepthBufferValue(float z) {
+  float z_n = (CAM_FAR + CAM_NEAR - 2.0f * CAM_NEAR * CAM_FAR / z) /
+              (CAM_FAR - CAM_NEAR);
+  return 0.5f * (z_n + 1.0f);
+}
+
+// Texture with detail at every scale, so misplaced pixels show up
+static void LayerColor(const LAYER& layer, float u, float v, uint8_t* rgba) {
+  float stripes = 0.5f + 0.5f * sinf(u * 0.35f) * cosf(v * 0.21f);
+  int checker = ((int32_t)floorf(u / 8.0f) + (int32_t)floorf(v / 8.0f)) & 1;
+  float shade = 0.55f + 0.3f * stripes + 0.15f * checker;
+  rgba[0] = (uint8_t)(layer.r * shade);
+  rgba[1] = (uint8_t)(layer.g * shade);
+  rgba[2] = (uint8_t)(layer.b * shade);
+  rgba[3] = 255;
+}
+
+static void RenderView(const VIEW_SYNTHESIS_PARAMS& params, float position,
+                       uint8_t* color, float* depth) {
+  float centre = 0.5f * (NUM_VIEWS - 1);
+  for (int32_t y = 0; y < VIEW_HEIGHT; ++y) {
+    for (int32_t x = 0; x < VIEW_WIDTH; ++x) {
+      // Front most layer covering the pixel
+      for (int32_t l = NUM_LAYERS - 1; l >= 0; --l) {
+        const LAYER& layer = LAYERS[l];
+        float disparity = params.disparity_scale *
+                          (1.0f / params.convergence_distance - 1.0f / layer.z);
+        float u = x + 0.5f - (position - centre) * disparity;
+        float v = y + 0.5f;
+        if (u < layer.x0 || u >= layer.x1 || v < layer.y0 || v >= layer.y1)
+          continue;
+        LayerColor(layer, u, v, &color[(y * VIEW_WIDTH + x) * 4]);
+        depth[y * VIEW_WIDTH + x] = DepthBufferValue(layer.z);
+        break;
+      }
+    }
+  }
+}
+
+static double Psnr(const uint8_t* a, const uint8_t* b, int32_t pixels) {
+  double sum = 0.0;
+  for (int32_t i = 0; i < pixels; ++i) {
+    for (int32_t c = 0; c < 3; ++c) {
+      double d = (double)a[i * 4 + c] - b[i * 4 + c];
+      sum += d * d;
+    }
+  }
+  double mse = sum / (pixels * 3.0);
+  return mse > 0.0 ? 10.0 * log10(255.0 * 255.0 / mse) : 99.0;
+}
+
+#if defined(VIEW_SYNTHESIS_GL)
+//--------------------------------------------------------------------------------
+// GL pass
+// The CPU sources are uploaded to the layers of a ViewSynthesisTarget, as if
+// rendered there. Depth can not be read back in GLES, only colour is
+// compared.
+//--------------------------------------------------------------------------------
+// Pixels of the GL atlas that differ from views, -1 when the pass can not run
+static int64_t CompareGL(const VIEW_SYNTHESIS_PARAMS& params,
+                         const std::vector<std::vector<uint8_t> >& colors,
+                         const std::vector<std::vector<float> >& depths,
+                         const std::vector<std::vector<uint8_t> >& views) {
+  ViewSynthesisTarget target;
+  ViewAtlas atlas;
+  GLuint program = CreatePostProgram(POST_SHADER_VIEW_SYNTHESIS_ATLAS,
+                                     params.num_views);
+  LeiaRenderContext* context = LeiaRenderContext::GetInstance();
+  int64_t differ = -1;
+  if (program && target.Init(VIEW_WIDTH, VIEW_HEIGHT) &&
+      atlas.Init(VIEW_WIDTH, VIEW_HEIGHT, params.num_views)) {
+    for (int32_t i = 0; i < params.num_sources; ++i) {
+      context->BindTexture(0, GL_TEXTURE_2D_ARRAY, target.GetColorTexture());
+      glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, i, VIEW_WIDTH, VIEW_HEIGHT,
+                      1, GL_RGBA, GL_UNSIGNED_BYTE, &colors[i][0]);
+      context->BindTexture(0, GL_TEXTURE_2D_ARRAY, target.GetDepthTexture());
+      glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, i, VIEW_WIDTH, VIEW_HEIGHT,
+                      1, GL_DEPTH_COMPONENT, GL_FLOAT, &depths[i][0]);
+    }
+    ViewSynthesisAtlas(target.GetColorTexture(), target.GetDepthTexture(),
+                       atlas.GetViewRectTable(), params, program,
+                       atlas.GetFramebuffer(), atlas.GetWidth(),
+                       atlas.GetHeight());
+
+    std::vector<uint8_t> pixels((size_t)atlas.GetWidth() * atlas.GetHeight() *
+                                4);
+    glReadPixels(0, 0, atlas.GetWidth(), atlas.GetHeight(), GL_RGBA,
+                 GL_UNSIGNED_BYTE, &pixels[0]);
+    differ = 0;
+    for (int32_t v = 0; v < params.num_views; ++v) {
+      const VIEW_RECT& rect = atlas.GetViewRect(v);
+      for (int32_t y = 0; y < VIEW_HEIGHT; ++y) {
+        const uint8_t* gl =
+            &pixels[((size_t)(rect.y + y) * atlas.GetWidth() + rect.x) * 4];
+        const uint8_t* cpu = &views[v][(size_t)y * VIEW_WIDTH * 4];
+        for (int32_t x = 0; x < VIEW_WIDTH; ++x) {
+          if (memcmp(gl + x * 4, cpu + x * 4, 4)) ++differ;
+        }
+      }
+    }
+    if (glGetError() != GL_NO_ERROR) differ = -1;
+  }
+  context->DeleteProgram(&program);
+  atlas.Unload();
+  target.Unload();
+  RenderTargetPool::GetInstance()->Unload();
+  context->Unload();
+  return differ;
+}
+#endif
+
+int main(int argc, char** argv) {
+  int32_t iterations = argc > 1 ? atoi(argv[1]) : DEFAULT_ITERATIONS;
+  if (iterations <= 0) iterations = DEFAULT_ITERATIONS;
+
+  LeiaCameraData data;
+  memset(&data, 0, sizeof(data));
+  data.mNumViewsHorizontal = NUM_VIEWS;
+  data.mNumViewsVertical = 1;
+  data.mViewResXPixels = VIEW_WIDTH;
+  data.mViewResYPixels = VIEW_HEIGHT;
+  data.mVerticalFieldOfView = VERTICAL_FOV;
+  data.mConvergenceDistance = CONVERGENCE_DISTANCE;
+  data.mBaseline = BASELINE;
+  data.mNear = CAM_NEAR;
+  data.mFar = CAM_FAR;
+
+  bool gl = false;
+#if defined(VIEW_SYNTHESIS_GL)
+  host_gl::CONTEXT ctx;
+  gl = host_gl::CreateContext(&ctx);
+  if (!gl) printf("No OpenGL ES 3 context, the GL pass is not checked\n");
+#endif
+
+  const int32_t pixels = VIEW_WIDTH * VIEW_HEIGHT;
+  printf("%d views %dx%d, %d iterations\n", NUM_VIEWS, VIEW_WIDTH, VIEW_HEIGHT,
+         iterations);
+  printf("%-8s %7s %6s %10s %9s %9s %9s %s\n", "mode", "sources", "steps",
+         "ms", "2nd src%", "backgr%", "GL differ", "PSNR per view (dB)");
+
+  int32_t failures = 0;
+  for (int32_t mode = VIEW_SYNTHESIS_FAST; mode < VIEW_SYNTHESIS_MODE_COUNT;
+       ++mode) {
+    VIEW_SYNTHESIS_PARAMS params;
+    if (!GetViewSynthesisParams(&data, (VIEW_SYNTHESIS_MODE)mode, &params)) {
+      printf("%-8s not available\n",
+             GetViewSynthesisModeName((VIEW_SYNTHESIS_MODE)mode));
+      ++failures;
+      continue;
+    }
+
+    std::vector<std::vector<uint8_t> > source_colors(params.num_sources);
+    std::vector<std::vector<float> > source_depths(params.num_sources);
+    std::vector<const uint8_t*> source_color_pointers;
+    std::vector<const float*> source_depth_pointers;
+    for (int32_t i = 0; i < params.num_sources; ++i) {
+      source_colors[i].resize(pixels * 4);
+      source_depths[i].resize(pixels);
+      RenderView(params, params.source_positions[i], &source_colors[i][0],
+                 &source_depths[i][0]);
+      source_color_pointers.push_back(&source_colors[i][0]);
+      source_depth_pointers.push_back(&source_depths[i][0]);
+    }
+
+    std::vector<std::vector<uint8_t> > views(NUM_VIEWS);
+    std::vector<uint8_t*> view_pointers;
+    for (int32_t i = 0; i < NUM_VIEWS; ++i) {
+      views[i].resize(pixels * 4);
+      view_pointers.push_back(&views[i][0]);
+    }
+
+    VIEW_SYNTHESIS_STATS stats;
+    std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+    for (int32_t i = 0; i < iterations; ++i) {
+      CpuViewSynthesis(params, &source_color_pointers[0],
+                       &source_depth_pointers[0], VIEW_WIDTH, VIEW_HEIGHT,
+                       &view_pointers[0], NULL, &stats);
+    }
+    double ms = std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - start)
+                    .count() /
+                iterations;
+
+    double synthesized = stats.synthesized_pixels > 0
+                             ? (double)stats.synthesized_pixels
+                             : 1.0;
+    printf("%-8s %7d %6d %10.3f %9.2f %9.2f",
+           GetViewSynthesisModeName((VIEW_SYNTHESIS_MODE)mode),
+           params.num_sources, params.search_steps, ms,
+           100.0 * stats.second_source_pixels / synthesized,
+           100.0 * stats.background_pixels / synthesized);
+
+    // Pixels where the GL pass disagrees with the CPU reference
+    int64_t gl_differ = 0;
+#if defined(VIEW_SYNTHESIS_GL)
+    if (gl) {
+      gl_differ = CompareGL(params, source_colors, source_depths, views);
+    }
+#endif
+    if (gl)
+      printf(" %9lld", (long long)gl_differ);
+    else
+      printf(" %9s", "-");
+    if (gl_differ) ++failures;
+
+    std::vector<uint8_t> truth(pixels * 4);
+    std::vector<float> truth_depth(pixels);
+    for (int32_t i = 0; i < NUM_VIEWS; ++i) {
+      RenderView(params, (float)i, &truth[0], &truth_depth[0]);
+      double psnr = Psnr(&views[i][0], &truth[0], pixels);
+      printf(" %6.2f", psnr);
+      if (psnr < MIN_PSNR) ++failures;
+    }
+    printf("\n");
+  }
+#if defined(VIEW_SYNTHESIS_GL)
+  if (gl) host_gl::DestroyContext(&ctx);
+#endif
+  return failures ? 1 : 0;
+}
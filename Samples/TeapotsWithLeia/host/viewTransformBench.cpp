@@ -0,0 +1,343 @@
+/*
+ * Copyright 2018 Leia Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//--------------------------------------------------------------------------------
+// viewTransformBench.cpp
+// Throughput of MultiplyViewMatrices() for every ISA the host supports, in
+// million matrices per second, against one Mat4::operator* call per model
+// and view. Each ISA is checked against the per call output first.
+// Then InstanceTransforms::Update() against the Mat4 products the per view
+// loop rebuilt every teapot with, checked to be within rounding of them.
+// Last FrustumCuller::Cull() over spheres scattered around the views, each
+// ISA checked against the scalar masks and the union against every view.
+//
+// usage: view-transform-bench [iterations]
+//--------------------------------------------------------------------------------
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "frustumCulling.h"
+#include "viewTransforms.h"
+
+using namespace leia_helper;
+
+static const int32_t NUM_VIEWS = 4;
+static const int32_t MODEL_COUNTS[] = {100, 1000, 10000, 100000};
+static const int32_t DEFAULT_ITERATIONS = 20;
+
+// Mat4 of ndk_helper without the Android dependencies, by value like
+// the renderers use it
+struct MAT4 {
+  float f[16];
+};
+
+static MAT4 Multiply(const MAT4& a, const MAT4& b) {
+  MAT4 ret;
+  for (int32_t c = 0; c < 4; ++c) {
+    for (int32_t r = 0; r < 4; ++r) {
+      ret.f[c * 4 + r] = a.f[r] * b.f[c * 4] + a.f[4 + r] * b.f[c * 4 + 1] +
+                         a.f[8 + r] * b.f[c * 4 + 2] +
+                         a.f[12 + r] * b.f[c * 4 + 3];
+    }
+  }
+  return ret;
+}
+
+static void InitCameras(LeiaCameraView* views) {
+  memset(views, 0, sizeof(LeiaCameraView) * NUM_VIEWS);
+  for (int32_t v = 0; v < NUM_VIEWS; ++v) {
+    // Sheared perspective like leiaCalculateViews() produces
+    float* m = views[v].matrix;
+    m[0] = 1.2f;
+    m[5] = 2.1f;
+    m[8] = 0.02f * (v - 0.5f * (NUM_VIEWS - 1));
+    m[10] = -1.001f;
+    m[11] = -1.0f;
+    m[12] = 0.5f * (v - 0.5f * (NUM_VIEWS - 1));
+    m[14] = -10.005f;
+  }
+}
+
+static MAT4 Translation(float x, float y, float z) {
+  MAT4 ret;
+  memset(&ret, 0, sizeof(ret));
+  ret.f[0] = ret.f[5] = ret.f[10] = ret.f[15] = 1.0f;
+  ret.f[12] = x;
+  ret.f[13] = y;
+  ret.f[14] = z;
+  return ret;
+}
+
+// Mat4::RotationX(x) * Mat4::RotationY(y)
+static MAT4 Rotation(float x, float y) {
+  MAT4 rx, ry;
+  memset(&rx, 0, sizeof(rx));
+  memset(&ry, 0, sizeof(ry));
+  rx.f[0] = rx.f[15] = 1.0f;
+  rx.f[5] = rx.f[10] = cosf(x);
+  rx.f[9] = sinf(x);
+  rx.f[6] = -sinf(x);
+  ry.f[5] = ry.f[15] = 1.0f;
+  ry.f[0] = ry.f[10] = cosf(y);
+  ry.f[8] = -sinf(y);
+  ry.f[2] = sinf(y);
+  return Multiply(rx, ry);
+}
+
+static void InitModelViews(int32_t num_models, std::vector<MAT4>* models) {
+  models->resize(num_models);
+  for (int32_t i = 0; i < num_models; ++i) {
+    float a = 0.001f * i;
+    float* m = (*models)[i].f;
+    memset(m, 0, sizeof(MAT4));
+    m[0] = cosf(a);
+    m[2] = -sinf(a);
+    m[5] = 1.0f;
+    m[8] = sinf(a);
+    m[10] = cosf(a);
+    m[12] = (float)(i % 100) - 50.0f;
+    m[13] = (float)((i / 100) % 100) - 50.0f;
+    m[14] = -100.0f - (float)(i / 10000);
+    m[15] = 1.0f;
+  }
+}
+
+int main(int argc, char** argv) {
+  int32_t iterations = argc > 1 ? atoi(argv[1]) : DEFAULT_ITERATIONS;
+  if (iterations <= 0) iterations = DEFAULT_ITERATIONS;
+  int32_t max_threads = (int32_t)std::thread::hardware_concurrency();
+  if (max_threads <= 0) max_threads = 1;
+
+  LeiaCameraView views[NUM_VIEWS];
+  InitCameras(views);
+
+  printf("%d views, %d iterations\n", NUM_VIEWS, iterations);
+  printf("%8s %-8s %8s %10s %10s\n", "models", "isa", "threads", "ms",
+         "Mmat/s");
+
+  int32_t failures = 0;
+  for (size_t n = 0; n < sizeof(MODEL_COUNTS) / sizeof(MODEL_COUNTS[0]); ++n) {
+    const int32_t num_models = MODEL_COUNTS[n];
+    const double matrices = (double)num_models * NUM_VIEWS / 1000000.0;
+    std::vector<MAT4> models;
+    InitModelViews(num_models, &models);
+
+    // One Mat4::operator* per model and view, as the per view loop did
+    std::vector<MAT4> reference(num_models * NUM_VIEWS);
+    std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+    for (int32_t i = 0; i < iterations; ++i) {
+      for (int32_t v = 0; v < NUM_VIEWS; ++v) {
+        MAT4 projection;
+        memcpy(projection.f, views[v].matrix, sizeof(projection.f));
+        for (int32_t m = 0; m < num_models; ++m)
+          reference[v * num_models + m] = Multiply(projection, models[m]);
+      }
+    }
+    double ms = std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - start)
+                    .count() /
+                iterations;
+    printf("%8d %-8s %8d %10.3f %10.1f\n", num_models, "per call", 1, ms,
+           matrices / (ms / 1000.0));
+
+    MatrixBuffer mvps;
+    mvps.Resize(num_models * NUM_VIEWS);
+    for (int32_t isa = 0; isa < CPU_ISA_COUNT; ++isa) {
+      if (!IsCpuIsaSupported((CPU_ISA)isa)) continue;
+
+      memset(mvps.Get(0), 0, sizeof(MAT4) * mvps.GetCount());
+      MultiplyViewMatrices(views, NUM_VIEWS, models[0].f, num_models,
+                           mvps.Get(0), (CPU_ISA)isa, max_threads);
+      if (memcmp(mvps.Get(0), &reference[0], sizeof(MAT4) * mvps.GetCount())) {
+        printf("%8d %-8s output differs from Mat4::operator*\n", num_models,
+               GetCpuIsaName((CPU_ISA)isa));
+        ++failures;
+        continue;
+      }
+
+      int32_t thread_counts[] = {1, max_threads};
+      for (int32_t t = 0; t < (max_threads > 1 ? 2 : 1); ++t) {
+        start = std::chrono::steady_clock::now();
+        for (int32_t i = 0; i < iterations; ++i) {
+          MultiplyViewMatrices(views, NUM_VIEWS, models[0].f, num_models,
+                               mvps.Get(0), (CPU_ISA)isa, thread_counts[t]);
+        }
+        ms = std::chrono::duration<double, std::milli>(
+                 std::chrono::steady_clock::now() - start)
+                 .count() /
+             iterations;
+        printf("%8d %-8s %8d %10.3f %10.1f\n", num_models,
+               GetCpuIsaName((CPU_ISA)isa), thread_counts[t], ms,
+               matrices / (ms / 1000.0));
+      }
+    }
+  }
+
+  // Instance updates: one matrix per model and frame, written for all views
+  printf("\n%8s %-8s %8s %10s %10s\n", "models", "update", "threads", "ms",
+         "Mmat/s");
+  MAT4 view = Translation(0.0f, 0.0f, -800.0f);
+  view.f[0] = view.f[10] = cosf(0.3f);
+  view.f[8] = sinf(0.3f);
+  view.f[2] = -sinf(0.3f);
+  const float steps = 4.0f;
+  for (size_t n = 0; n < sizeof(MODEL_COUNTS) / sizeof(MODEL_COUNTS[0]); ++n) {
+    const int32_t num_models = MODEL_COUNTS[n];
+    const double matrices = (double)num_models / 1000000.0;
+    std::vector<float> positions(num_models * 3), angles(num_models * 2),
+        speeds(num_models * 2);
+    for (int32_t i = 0; i < num_models; ++i) {
+      positions[i * 3] = (float)(i % 100) * 5.0f - 250.0f;
+      positions[i * 3 + 1] = (float)((i / 100) % 100) * 5.0f - 250.0f;
+      positions[i * 3 + 2] = (float)(i / 10000) * 5.0f - 250.0f;
+      angles[i * 2] = 0.001f * i;
+      angles[i * 2 + 1] = -0.002f * i;
+      speeds[i * 2] = 0.01f + 0.00001f * (i % 1000);
+      speeds[i * 2 + 1] = 0.02f - 0.00001f * (i % 1000);
+    }
+
+    // Mat4 products per model, as RenderView() rebuilt them
+    std::vector<MAT4> reference(num_models);
+    std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+    for (int32_t i = 0; i < iterations; ++i) {
+      for (int32_t m = 0; m < num_models; ++m) {
+        float x = angles[m * 2] + steps * speeds[m * 2];
+        float y = angles[m * 2 + 1] + steps * speeds[m * 2 + 1];
+        reference[m] = Multiply(
+            Multiply(view, Translation(positions[m * 3], positions[m * 3 + 1],
+                                       positions[m * 3 + 2])),
+            Rotation(x, y));
+      }
+    }
+    double ms = std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - start)
+                    .count() /
+                iterations;
+    printf("%8d %-8s %8d %10.3f %10.1f\n", num_models, "Mat4", 1, ms,
+           matrices / (ms / 1000.0));
+
+    InstanceTransforms instances;
+    instances.Resize(num_models);
+    MatrixBuffer model_views;
+    int32_t thread_counts[] = {1, max_threads};
+    for (int32_t t = 0; t < (max_threads > 1 ? 2 : 1); ++t) {
+      for (int32_t m = 0; m < num_models; ++m) {
+        instances.Set(m, positions[m * 3], positions[m * 3 + 1],
+                      positions[m * 3 + 2], angles[m * 2], angles[m * 2 + 1],
+                      speeds[m * 2], speeds[m * 2 + 1]);
+      }
+      instances.Update(view.f, steps, &model_views, thread_counts[t]);
+      float max_error = 0.0f;
+      for (int32_t m = 0; m < num_models; ++m) {
+        for (int32_t k = 0; k < 16; ++k) {
+          float error = fabsf(model_views.Get(m)[k] - reference[m].f[k]);
+          if (error > max_error) max_error = error;
+        }
+      }
+      // Translations reach 1000, a few ulp of that
+      if (max_error > 1e-3f) {
+        printf("%8d %-8s off the Mat4 products by %g\n", num_models,
+               "update", max_error);
+        ++failures;
+        continue;
+      }
+
+      start = std::chrono::steady_clock::now();
+      for (int32_t i = 0; i < iterations; ++i)
+        instances.Update(view.f, steps, &model_views, thread_counts[t]);
+      ms = std::chrono::duration<double, std::milli>(
+               std::chrono::steady_clock::now() - start)
+               .count() /
+           iterations;
+      printf("%8d %-8s %8d %10.3f %10.1f\n", num_models, "update",
+             thread_counts[t], ms, matrices / (ms / 1000.0));
+    }
+  }
+
+  // Culling: a third to a half of the spheres in front of the views
+  printf("\n%8s %-8s %8s %8s %10s %10s\n", "models", "cull", "visible",
+         "draws", "ms", "Mobj/s");
+  FrustumCuller culler;
+  culler.SetViews(views[0].matrix, sizeof(LeiaCameraView) / sizeof(float),
+                  NUM_VIEWS);
+  for (size_t n = 0; n < sizeof(MODEL_COUNTS) / sizeof(MODEL_COUNTS[0]); ++n) {
+    const int32_t num_models = MODEL_COUNTS[n];
+    const double objects = (double)num_models / 1000000.0;
+    srand(7);
+    culler.SetNumObjects(num_models);
+    for (int32_t i = 0; i < num_models; ++i) {
+      float x = rand() / (float)RAND_MAX * 400.0f - 200.0f;
+      float y = rand() / (float)RAND_MAX * 400.0f - 200.0f;
+      float z = -rand() / (float)RAND_MAX * 300.0f + 20.0f;
+      culler.SetBounds(i, x, y, z, 1.0f + rand() / (float)RAND_MAX * 10.0f);
+    }
+
+    // Every sphere against every view, the masks the two levels must give
+    FrustumCuller single;
+    std::vector<uint32_t> expected(num_models, 0);
+    for (int32_t v = 0; v < NUM_VIEWS; ++v) {
+      single.SetViews(views[v].matrix, 0, 1);
+      single.SetNumObjects(0);
+      single.SetNumObjects(num_models);
+      srand(7);
+      for (int32_t i = 0; i < num_models; ++i) {
+        float x = rand() / (float)RAND_MAX * 400.0f - 200.0f;
+        float y = rand() / (float)RAND_MAX * 400.0f - 200.0f;
+        float z = -rand() / (float)RAND_MAX * 300.0f + 20.0f;
+        single.SetBounds(i, x, y, z, 1.0f + rand() / (float)RAND_MAX * 10.0f);
+      }
+      single.Cull(CPU_ISA_SCALAR);
+      for (int32_t k = 0; k < single.GetNumVisible(); ++k) {
+        if (single.GetViewMasks()[k])
+          expected[single.GetVisible()[k]] |= 1u << v;
+      }
+    }
+
+    for (int32_t isa = 0; isa < CPU_ISA_COUNT; ++isa) {
+      if (!IsCpuIsaSupported((CPU_ISA)isa)) continue;
+      culler.Cull((CPU_ISA)isa);
+      std::vector<uint32_t> masks(num_models, 0);
+      for (int32_t k = 0; k < culler.GetNumVisible(); ++k)
+        masks[culler.GetVisible()[k]] = culler.GetViewMasks()[k];
+      if (masks != expected) {
+        printf("%8d %-8s masks differ from the per view tests\n", num_models,
+               GetCpuIsaName((CPU_ISA)isa));
+        ++failures;
+        continue;
+      }
+
+      std::chrono::steady_clock::time_point start =
+          std::chrono::steady_clock::now();
+      for (int32_t i = 0; i < iterations; ++i) culler.Cull((CPU_ISA)isa);
+      double ms = std::chrono::duration<double, std::milli>(
+                      std::chrono::steady_clock::now() - start)
+                      .count() /
+                  iterations;
+      printf("%8d %-8s %8d %8d %10.3f %10.1f\n", num_models,
+             GetCpuIsaName((CPU_ISA)isa), culler.GetStats().visible,
+             culler.GetStats().view_draws, ms, objects / (ms / 1000.0));
+    }
+  }
+  return failures ? 1 : 0;
+}
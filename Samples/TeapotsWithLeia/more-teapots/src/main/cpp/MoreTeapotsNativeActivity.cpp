@@ -20,6 +20,7 @@
 #include <jni.h>
 #include <errno.h>
 
+#include <string>
 #include <vector>
 #include <EGL/egl.h>
 #include <GLES/gl.h>
@@ -32,6 +33,7 @@
 
 #include "MoreTeapotsRenderer.h"
 #include "LeiaJNIDisplayParameters.h"
+#include "glCapture.h"
 
 //-------------------------------------------------------------------------
 // Preprocessor
@@ -46,6 +48,18 @@ const int32_t NUM_TEAPOTS_X = 8;
 const int32_t NUM_TEAPOTS_Y = 8;
 const int32_t NUM_TEAPOTS_Z = 8;
 
+#ifdef RENDER_PATH_AB
+// Frames rendered by each path before switching between the per view loop and
+// single pass multiview, so both timings end up in the log
+const int32_t MULTIVIEW_TOGGLE_FRAMES = 600;
+#endif
+
+#ifdef GL3STUB_CAPTURE
+// Frames from the first window written to the internal data directory,
+// adb pull it and run host/gl-replay on it
+const int32_t GL_CAPTURE_FRAMES = 300;
+#endif
+
 //-------------------------------------------------------------------------
 // Shared state for our app.
 //-------------------------------------------------------------------------
@@ -128,7 +142,7 @@ Engine::Engine()
           sensor_manager_(NULL),
           accelerometer_sensor_(NULL),
           sensor_event_queue_(NULL),
-          render_with_multiview_ext(false) {
+          render_with_multiview_ext(true) {
     gl_context_ = ndk_helper::GLContext::GetInstance();
 }
 
@@ -156,6 +170,11 @@ void Engine::UnloadResources() { renderer_.Unload(); }
 int Engine::InitDisplay(android_app *app) {
     if (!initialized_resources_) {
         gl_context_->Init(app_->window);
+#ifdef GL3STUB_CAPTURE
+        std::string trace = app_->activity->internalDataPath;
+        trace += "/more-teapots.gltrace";
+        leia_helper::StartGlCapture(trace.c_str(), GL_CAPTURE_FRAMES);
+#endif
         LoadResources();
         initialized_resources_ = true;
     } else if (app->window != gl_context_->GetANativeWindow()) {
@@ -207,6 +226,15 @@ void Engine::DrawFrame() {
     if (monitor_.Update(fps)) {
         UpdateFPS(fps);
     }
+#ifdef RENDER_PATH_AB
+    static int32_t frame_count = 0;
+    if (++frame_count > MULTIVIEW_TOGGLE_FRAMES) {
+        frame_count = 0;
+        render_with_multiview_ext = !render_with_multiview_ext;
+    }
+#endif
+
+    // Multiview whenever the renderer supports it on this device
     double dTime = monitor_.GetCurrentTime();
     renderer_.Update(dTime, render_with_multiview_ext);
 
@@ -220,6 +248,7 @@ void Engine::DrawFrame() {
         UnloadResources();
         LoadResources();
     }
+    leia_helper::EndGlCaptureFrame();
 }
 
 /**
@@ -232,8 +261,6 @@ void Engine::TrimMemory() {
     gl_context_->Invalidate();
 }
 
-static bool is_using_multiview = false;
-
 /**
  * Process the next input event.
  */
@@ -23,6 +23,7 @@
 //--------------------------------------------------------------------------------
 #include "MoreTeapotsRenderer.h"
 
+#include <stdio.h>
 #include <string.h>
 #include <LeiaCameraViews.h>
 #include <LeiaNativeSDK.h>
@@ -32,6 +33,7 @@
 //--------------------------------------------------------------------------------
 #include "teapot.inl"
 #include "LeiaJNIDisplayParameters.h"
+#include <algorithm>
 #include <cmath>
 #include <cstdlib>
 
@@ -40,6 +42,37 @@ const unsigned int CAMERAS_WIDE = 4;
 LeiaCameraView cameras[CAMERAS_HIGH][CAMERAS_WIDE];
 LeiaCameraData data;
 
+// Number of frames averaged before RenderViews() timings are logged
+const int32_t RENDER_VIEWS_LOG_FRAMES = 120;
+
+// Panel layout for the indexed interlacing of the multiview path, the
+// alignment offset comes from LeiaJNIDisplayParameters
+const int32_t VIEW_SLANT_NUMERATOR = 0;
+const int32_t VIEW_SLANT_DENOMINATOR = 1;
+const bool VIEW_SUBPIXEL_INTERLACING = false;
+
+// Render every view, or only the view synthesis sources and synthesize the
+// others, see cpuViewSynthesis.h
+const leia_helper::VIEW_SYNTHESIS_MODE VIEW_SYNTHESIS = leia_helper::VIEW_SYNTHESIS_OFF;
+
+// Draw the teapots of a view with one instanced draw when the instanced
+// programs are built, instead of a uniform update and a draw per teapot
+const bool INSTANCED_TEAPOTS = true;
+
+// Spin speed of the teapots, the rotations advanced once per rendered view
+// of a 60 fps frame when RenderView() updated them
+const float ROTATION_STEPS_PER_SECOND = 60.0f * CAMERAS_WIDE * CAMERAS_HIGH;
+// Longer frames, or the first one, do not jump the animation ahead
+const double MAX_UPDATE_INTERVAL = 0.1;
+
+// Instance attributes: model view, then color and one float of padding
+const int32_t INSTANCE_FLOATS = 20;
+
+// Formats and discards of the view targets, see attachmentPolicy.h. Every path
+// runs depth of field on scene depth, so depth stays a sampled texture
+const leia_helper::ATTACHMENT_POLICY VIEW_ATTACHMENTS = {
+        GL_RGBA8, GL_DEPTH_COMPONENT32F, true, true};
+
 //--------------------------------------------------------------------------------
 // Ctor
 //--------------------------------------------------------------------------------
@@ -57,6 +90,36 @@ void MoreTeapotsRenderer::Init(const int32_t numX, const int32_t numY,
                                const int32_t numZ) {
     using_simple_leia_rendering_api = false;
 
+    // Single pass multiview is used when the driver exposes GL_OVR_multiview2,
+    // the per view loop stays as the fallback
+    render_with_multiview_ext_ = false;
+    multiview_shader_param_.program_ = 0;
+    instanced_shader_param_.program_ = 0;
+    multiview_instanced_shader_param_.program_ = 0;
+    instance_vao_ = 0;
+    instance_vbo_ = 0;
+    drawing_instanced_ = false;
+    multiview_dof_program_ = 0;
+    multiview_interlace_program_ = 0;
+    multiview_interlace_sharpen_program_ = 0;
+    multiview_interlace_dof_program_ = 0;
+    using_fused_interlace_sharpening_ = true;
+    using_folded_dof_ = false;
+    atlas_dof_program_ = 0;
+    atlas_interlace_program_ = 0;
+    atlas_interlace_sharpen_program_ = 0;
+    atlas_interlace_dof_program_ = 0;
+    using_view_atlas_ = true;
+    view_synthesis_program_ = 0;
+    view_synthesis_mode_ = VIEW_SYNTHESIS;
+    transform_isa_ = leia_helper::GetBestCpuIsa();
+    for (int32_t i = 0; i < RENDER_PATH_COUNT; ++i) {
+        render_views_time_[i] = 0.0;
+        render_views_frames_[i] = 0;
+    }
+    const int32_t num_views = CAMERAS_WIDE * CAMERAS_HIGH;
+    leia_helper::InitMultiview(num_views);
+
     // Settings
     glFrontFace(GL_CCW);
 
@@ -89,11 +152,32 @@ void MoreTeapotsRenderer::Init(const int32_t numX, const int32_t numY,
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     delete[] p;
 
+    // Bounding sphere around the center of the bounding box
+    float bounds_min[3], bounds_max[3];
+    for (int32_t c = 0; c < 3; ++c) bounds_min[c] = bounds_max[c] = teapotPositions[c];
+    for (int32_t i = 0; i < num_vertices_ * 3; ++i) {
+        bounds_min[i % 3] = std::min(bounds_min[i % 3], teapotPositions[i]);
+        bounds_max[i % 3] = std::max(bounds_max[i % 3], teapotPositions[i]);
+    }
+    teapot_bounds_[3] = 0.0f;
+    for (int32_t c = 0; c < 3; ++c) teapot_bounds_[c] = 0.5f * (bounds_min[c] + bounds_max[c]);
+    for (int32_t i = 0; i < num_vertices_; ++i) {
+        float dx = teapotPositions[i * 3] - teapot_bounds_[0];
+        float dy = teapotPositions[i * 3 + 1] - teapot_bounds_[1];
+        float dz = teapotPositions[i * 3 + 2] - teapot_bounds_[2];
+        teapot_bounds_[3] = std::max(teapot_bounds_[3], dx * dx + dy * dy + dz * dz);
+    }
+    teapot_bounds_[3] = sqrtf(teapot_bounds_[3]);
+
     // Init Projection matrices
     teapot_x_ = numX;
     teapot_y_ = numY;
     teapot_z_ = numZ;
-    vec_mat_models_.reserve(teapot_x_ * teapot_y_ * teapot_z_);
+    teapots_.Resize(teapot_x_ * teapot_y_ * teapot_z_);
+    culled_teapots_ = 0;
+    teapot_view_draws_ = 0;
+    model_views_.Resize(teapot_x_ * teapot_y_ * teapot_z_);
+    last_update_time_ = 0.0;
 
     UpdateViewport();
 
@@ -105,87 +189,116 @@ void MoreTeapotsRenderer::Init(const int32_t numX, const int32_t numY,
     float offset_y = -total_width / 2.f;
     float offset_z = -total_width / 2.f;
 
+    int32_t teapot = 0;
     for (int32_t x = 0; x < teapot_x_; ++x)
         for (int32_t y = 0; y < teapot_y_; ++y)
             for (int32_t z = 0; z < teapot_z_; ++z) {
-                vec_mat_models_.push_back(ndk_helper::Mat4::Translation(
-                        x * gap_x + offset_x, y * gap_y + offset_y,
-                        z * gap_z + offset_z));
                 vec_colors_.push_back(ndk_helper::Vec3(
                         random() / float(RAND_MAX * 1.1), random() / float(RAND_MAX * 1.1),
                         random() / float(RAND_MAX * 1.1)));
 
                 float rotation_x = random() / float(RAND_MAX) - 0.5f;
                 float rotation_y = random() / float(RAND_MAX) - 0.5f;
-                vec_rotations_.push_back(ndk_helper::Vec2(rotation_x * 0.05f, rotation_y * 0.05f));
-                vec_current_rotations_.push_back(
-                        ndk_helper::Vec2(rotation_x * M_PI, rotation_y * M_PI));
+                teapots_.Set(teapot++, x * gap_x + offset_x, y * gap_y + offset_y,
+                             z * gap_z + offset_z, rotation_x * M_PI, rotation_y * M_PI,
+                             rotation_x * 0.05f, rotation_y * 0.05f);
             }
 
-    unsigned int len = 0;
+    // Binaries of the programs linked by the last run on this driver
+    leia_helper::ProgramCache::GetInstance()->Init(
+            ndk_helper::JNIHelper::GetInstance()->GetExternalFilesDir() +
+            "/program_cache");
+
+    // The 2D path draws with shader_param_ only, the 3D programs build in the
+    // background and RenderViews() shows the 2D path until they are ready
     LoadShaders(&shader_param_, "Shaders/VS_ShaderPlain.vsh",
                 "Shaders/ShaderPlain.fsh");
-    dof_shader.program_ = leiaCreateProgram(leiaGetShader(LEIA_VERTEX_DOF, &len),
-                                            leiaGetShader(LEIA_FRAGMENT_DOF, &len));
-    view_interlacing_shader.program_ = leiaCreateProgram(
+    unsigned int len = 0;
+    program_builder_.AddProgram(
+            &dof_shader.program_, "leia", leiaGetShader(LEIA_VERTEX_DOF, &len),
+            leiaGetShader(LEIA_FRAGMENT_DOF, &len), leiaCreateProgram);
+    program_builder_.AddProgram(
+            &view_interlacing_shader.program_, "leia",
             leiaGetShader(LEIA_VERTEX_VIEW_INTERLACE, &len),
-            leiaGetShader(LEIA_FRAGMENT_VIEW_INTERLACE, &len));
-    view_sharpening_shader.program_ = leiaCreateProgram(
+            leiaGetShader(LEIA_FRAGMENT_VIEW_INTERLACE, &len), leiaCreateProgram);
+    program_builder_.AddProgram(
+            &view_sharpening_shader.program_, "leia",
             leiaGetShader(LEIA_VERTEX_VIEW_SHARPENING, &len),
-            leiaGetShader(LEIA_FRAGMENT_VIEW_SHARPENING, &len));
-}
-
-void MoreTeapotsRenderer::UpdateViewport() {
-    // Init Projection matrices
-
-    int32_t viewport[4];
-    glGetIntegerv(GL_VIEWPORT, viewport);
-    view_width_pixels_ = 640;//LeiaJNIDisplayParameters::mViewResolution[0];
-    view_height_pixels_ = 360;//LeiaJNIDisplayParameters::mViewResolution[1];
-    screen_width_pixels_ = 2560;//LeiaJNIDisplayParameters::mScreenResolution[0];
-    screen_height_pixels_ = 1440;//LeiaJNIDisplayParameters::mScreenResolution[1];
-    float baseline_scaling = 1.0f;
-    float to_radians = 3.14159f / 180.0f;
-    float to_degrees = 180.0f / 3.14159f;
-    // We convert to radians, make sure the aspect ratio is applied so things look the same
-    // regardless of the orientation, then convert back to degrees
-    float vertical_fov_degrees = atanf(tanf((66.9f * to_radians) / 2.0f) *
-                                       (float) view_height_pixels_ /
-                                       (float) fmax((float) view_width_pixels_,
-                                                    (float) view_height_pixels_)) *
-                                       to_degrees * 2.0f;
-    float convergence_distance = 200.0f;
-    leiaInitializeCameraData(&data, CAMERAS_WIDE, CAMERAS_HIGH,
-                             8.0,//LeiaJNIDisplayParameters::mSystemDisparity,
-                             baseline_scaling, convergence_distance,
-                             vertical_fov_degrees, CAM_NEAR, CAM_FAR,
-                             view_width_pixels_, view_height_pixels_);
-    if (!leiaCalculateViews(&data, (LeiaCameraView *) cameras, CAMERAS_WIDE, CAMERAS_HIGH)) {
-        LOGE("leiaCalculateViews did not work. The camera data is invalid.");
-    }
-
-    PrepareFullscreenSurface();
-    PrepareRenderTargetSurfaces();
-
-    const float CAM_NEAR = 5.f;
-    const float CAM_FAR = 10000.f;
-    if (viewport[2] < viewport[3]) {
-        float aspect =
-                static_cast<float>(viewport[2]) / static_cast<float>(viewport[3]);
-        mat_projection_ =
-                ndk_helper::Mat4::Perspective(aspect, 1.0f, CAM_NEAR, CAM_FAR);
-    } else {
-        float aspect =
-                static_cast<float>(viewport[3]) / static_cast<float>(viewport[2]);
-        mat_projection_ =
-                ndk_helper::Mat4::Perspective(1.0f, aspect, CAM_NEAR, CAM_FAR);
+            leiaGetShader(LEIA_FRAGMENT_VIEW_SHARPENING, &len), leiaCreateProgram);
+    std::map<std::string, std::string> instanced_defines;
+    instanced_defines["%MULTIVIEW%"] = "";
+    AddShaders(&instanced_shader_param_, "Shaders/VS_ShaderPlainES3.vsh",
+               "Shaders/ShaderPlainES3.fsh", &instanced_defines);
+
+    if (leia_helper::IsMultiviewSupported()) {
+        char str_num_views[16];
+        snprintf(str_num_views, sizeof(str_num_views), "%d", num_views);
+        std::map<std::string, std::string> defines;
+        defines["%NUM_VIEWS%"] = str_num_views;
+        AddShaders(&multiview_shader_param_, "Shaders/VS_multiview.vsh",
+                   "Shaders/multiview.fsh", &defines);
+        instanced_defines["%MULTIVIEW%"] =
+                std::string("#extension GL_OVR_multiview2 : require\n"
+                            "layout(num_views = ") + str_num_views + ") in;\n"
+                "#define MULTIVIEW 1";
+        AddShaders(&multiview_instanced_shader_param_, "Shaders/VS_ShaderPlainES3.vsh",
+                   "Shaders/ShaderPlainES3.fsh", &instanced_defines);
+        leia_helper::AddPostProgram(&program_builder_, &multiview_dof_program_,
+                                    leia_helper::POST_SHADER_MULTIVIEW_DOF, num_views);
+        leia_helper::AddPostProgram(&program_builder_, &multiview_interlace_program_,
+                                    leia_helper::POST_SHADER_VIEW_INTERLACE_INDEXED,
+                                    num_views);
+        leia_helper::AddPostProgram(&program_builder_,
+                                    &multiview_interlace_sharpen_program_,
+                                    leia_helper::POST_SHADER_VIEW_INTERLACE_SHARPEN_INDEXED,
+                                    num_views);
+        leia_helper::AddPostProgram(&program_builder_, &multiview_interlace_dof_program_,
+                                    leia_helper::POST_SHADER_VIEW_INTERLACE_DOF_INDEXED,
+                                    num_views);
     }
+
+    leia_helper::AddPostProgram(&program_builder_, &atlas_dof_program_,
+                                leia_helper::POST_SHADER_ATLAS_DOF, num_views);
+    leia_helper::AddPostProgram(&program_builder_, &atlas_interlace_program_,
+                                leia_helper::POST_SHADER_VIEW_INTERLACE_INDEXED_ATLAS,
+                                num_views);
+    leia_helper::AddPostProgram(&program_builder_, &atlas_interlace_sharpen_program_,
+                                leia_helper::POST_SHADER_VIEW_INTERLACE_SHARPEN_INDEXED_ATLAS,
+                                num_views);
+    leia_helper::AddPostProgram(&program_builder_, &atlas_interlace_dof_program_,
+                                leia_helper::POST_SHADER_VIEW_INTERLACE_DOF_INDEXED_ATLAS,
+                                num_views);
+    leia_helper::AddPostProgram(&program_builder_, &view_synthesis_program_,
+                                leia_helper::POST_SHADER_VIEW_SYNTHESIS_ATLAS, num_views);
+    programs_ready_ = false;
+    program_builder_.Start();
 }
 
 //--------------------------------------------------------------------------------
-// Unload
+// OnProgramsReady
 //--------------------------------------------------------------------------------
+void MoreTeapotsRenderer::OnProgramsReady() {
+    if (multiview_shader_param_.program_) GetUniformLocations(&multiview_shader_param_);
+    if (instanced_shader_param_.program_) GetUniformLocations(&instanced_shader_param_);
+    if (multiview_instanced_shader_param_.program_)
+        GetUniformLocations(&multiview_instanced_shader_param_);
+
+    leia_helper::PROGRAM_CACHE_STATS cache_stats =
+            leia_helper::ProgramCache::GetInstance()->GetStats();
+    LOGI("%d programs ready after %.1f ms (%s, %.1f ms on the render thread), "
+         "%d loaded, %d compiled, %d rejected binaries",
+         program_builder_.GetNumPrograms(), program_builder_.GetBuildTime(),
+         leia_helper::GetProgramBuildModeName(program_builder_.GetMode()),
+         program_builder_.GetBlockedTime(), cache_stats.hits,
+         cache_stats.misses + cache_stats.rejects, cache_stats.rejects);
+}
+
 void MoreTeapotsRenderer::Unload() {
+    // Programs still building are deleted, finished ones below
+    program_builder_.Cancel();
+    programs_ready_ = false;
+    leia_helper::LeiaRenderContext *context = leia_helper::LeiaRenderContext::GetInstance();
+
     if (vbo_) {
         glDeleteBuffers(1, &vbo_);
         vbo_ = 0;
@@ -194,61 +307,45 @@ void MoreTeapotsRenderer::Unload() {
         glDeleteBuffers(1, &ibo_);
         ibo_ = 0;
     }
-    if (shader_param_.program_) {
-        glDeleteProgram(shader_param_.program_);
-        shader_param_.program_ = 0;
+    context->DeleteProgram(&shader_param_.program_);
+    context->DeleteProgram(&instanced_shader_param_.program_);
+    context->DeleteProgram(&multiview_instanced_shader_param_.program_);
+    if (instance_vao_) {
+        glDeleteVertexArrays(1, &instance_vao_);
+        instance_vao_ = 0;
     }
-
-    if (fullscreen_fbo) {
-        glDeleteFramebuffers(1, &fullscreen_fbo);
-        fullscreen_fbo = 0;
-    }
-
-    if (fullscreen_texture) {
-        glDeleteFramebuffers(1, &fullscreen_texture);
-        fullscreen_texture = 0;
-    }
-
-    if (fbos[0]) {
-        glDeleteFramebuffers(RT_COUNT, fbos);
-        glDeleteTextures(RT_COUNT, render_textures);
-        glDeleteTextures(RT_COUNT, depth_textures);
-        for (int i = 0; i < RT_COUNT; ++i) {
-            fbos[i] = 0;
-            render_textures[i] = 0;
-            depth_textures[i] = 0;
-        }
-    }
-    if (fbo_dof[RT_COUNT - 1]) {
-        glDeleteTextures(RT_COUNT, fbo_dof);
-        glDeleteTextures(RT_COUNT, texture_dof);
-        for (int i = 0; i < RT_COUNT; ++i) {
-            fbo_dof[i] = 0;
-            texture_dof[i] = 0;
-        }
-    }
-
-    if (checkerboard_texture) {
-        glDeleteTextures(1, &checkerboard_texture);
-        checkerboard_texture = 0;
-    }
-
-    if (dof_shader.program_) {
-        glDeleteProgram(dof_shader.program_);
-        dof_shader.program_ = 0;
-    }
-    if (view_interlacing_shader.program_) {
-        glDeleteProgram(view_interlacing_shader.program_);
-        view_interlacing_shader.program_ = 0;
-    }
-    if (view_sharpening_shader.program_) {
-        glDeleteProgram(view_sharpening_shader.program_);
-        view_sharpening_shader.program_ = 0;
-    }
-    if (texture_shader.program_) {
-        glDeleteProgram(texture_shader.program_);
-        texture_shader.program_ = 0;
+    if (instance_vbo_) {
+        glDeleteBuffers(1, &instance_vbo_);
+        instance_vbo_ = 0;
     }
+    camera_buffer_.Unload();
+
+    ReleaseSurfaces();
+
+    context->DeleteProgram(&dof_shader.program_);
+    context->DeleteProgram(&view_interlacing_shader.program_);
+    context->DeleteProgram(&view_sharpening_shader.program_);
+    context->DeleteProgram(&texture_shader.program_);
+
+    multiview_target_.Unload();
+    view_index_map_.Unload();
+    view_atlas_.Unload();
+    view_synthesis_target_.Unload();
+    // Everything acquired from the pool has been released above
+    leia_helper::RenderTargetPool::GetInstance()->Unload();
+    model_views_.Unload();
+    view_mvps_.Unload();
+    context->DeleteProgram(&view_synthesis_program_);
+    context->DeleteProgram(&atlas_dof_program_);
+    context->DeleteProgram(&atlas_interlace_program_);
+    context->DeleteProgram(&atlas_interlace_sharpen_program_);
+    context->DeleteProgram(&atlas_interlace_dof_program_);
+    context->DeleteProgram(&multiview_shader_param_.program_);
+    context->DeleteProgram(&multiview_dof_program_);
+    context->DeleteProgram(&multiview_interlace_program_);
+    context->DeleteProgram(&multiview_interlace_sharpen_program_);
+    context->DeleteProgram(&multiview_interlace_dof_program_);
+    context->Unload();
 }
 
 //--------------------------------------------------------------------------------
@@ -259,22 +356,91 @@ void MoreTeapotsRenderer::Update(float fTime, bool render_with_multiview_ext) {
     const float CAM_Y = 0.f;
     const float CAM_Z = 800.f;
 
-    mat_view_ = ndk_helper::Mat4::LookAt(ndk_helper::Vec3(CAM_X, CAM_Y, CAM_Z),
-                                         ndk_helper::Vec3(0.f, 0.f, 0.f),
-                                         ndk_helper::Vec3(0.f, 1.f, 0.f));
+    mat_view_ = ndk_helper::Affine::LookAt(ndk_helper::Vec3(CAM_X, CAM_Y, CAM_Z),
+                                           ndk_helper::Vec3(0.f, 0.f, 0.f),
+                                           ndk_helper::Vec3(0.f, 1.f, 0.f));
 
     if (camera_) {
         camera_->Update();
         mat_view_ = camera_->GetTransformMatrix() * mat_view_ *
                     camera_->GetRotationMatrix();
     }
+
+    // Every teapot once per frame, fTime is too coarse as a float to time it
+    double now = ndk_helper::PerfMonitor::GetCurrentTime();
+    double interval = last_update_time_ > 0.0 ? now - last_update_time_ : 0.0;
+    if (interval < 0.0 || interval > MAX_UPDATE_INTERVAL) interval = MAX_UPDATE_INTERVAL;
+    last_update_time_ = now;
+    ndk_helper::Mat4 view = mat_view_.ToMat4();
+    teapots_.Update(view.Ptr(), (float)(interval * ROTATION_STEPS_PER_SECOND),
+                    &model_views_, 0);
+
+    render_with_multiview_ext_ = render_with_multiview_ext &&
+                                 multiview_target_.GetColorTexture() &&
+                                 multiview_shader_param_.program_ &&
+                                 multiview_dof_program_ &&
+                                 multiview_interlace_program_ &&
+                                 multiview_interlace_sharpen_program_ &&
+                                 multiview_interlace_dof_program_;
 }
 //--------------------------------------------------------------------------------
 // Render
 //--------------------------------------------------------------------------------
 
 void MoreTeapotsRenderer::RenderViews(bool is_backlight_still_on) {
-    if (is_backlight_still_on) {
+    if (!programs_ready_ && program_builder_.Poll()) {
+        programs_ready_ = true;
+        OnProgramsReady();
+    }
+    // 2D until the 3D programs are built
+    is_backlight_still_on = is_backlight_still_on && programs_ready_;
+    // Nothing is known of the binds made since the last frame
+    leia_helper::LeiaRenderContext *context = leia_helper::LeiaRenderContext::GetInstance();
+    context->Invalidate();
+    UpdateCameraBlock();
+
+#ifdef RENDER_PATH_AB
+    // Alternate the fused and the two pass post processing, the view atlas and
+    // the per view framebuffers, and the separate and folded depth of field,
+    // for comparison
+    static int toggle_count = 0;
+    if (++toggle_count > RENDER_VIEWS_LOG_FRAMES) {
+        toggle_count = 0;
+        using_fused_interlace_sharpening_ = !using_fused_interlace_sharpening_;
+        if (using_fused_interlace_sharpening_) {
+            using_view_atlas_ = !using_view_atlas_;
+            if (using_view_atlas_) {
+                using_folded_dof_ = !using_folded_dof_;
+            }
+        }
+    }
+#endif
+    bool render_with_view_atlas = using_view_atlas_ &&
+                                  view_atlas_.GetColorTexture() &&
+                                  atlas_dof_program_ && atlas_interlace_program_ &&
+                                  atlas_interlace_sharpen_program_ &&
+                                  atlas_interlace_dof_program_;
+
+    const int32_t num_views = CAMERAS_WIDE * CAMERAS_HIGH;
+    drawing_instanced_ = INSTANCED_TEAPOTS && programs_ready_ &&
+                         instanced_shader_param_.program_;
+
+    if (is_backlight_still_on && render_with_multiview_ext_) {
+        double start = ndk_helper::PerfMonitor::GetCurrentTime();
+        RenderViewsMultiview();
+        LogRenderViewsTime(using_folded_dof_ ? RENDER_PATH_MULTIVIEW_FOLDED_DOF :
+                           using_fused_interlace_sharpening_ ?
+                           RENDER_PATH_MULTIVIEW_FUSED : RENDER_PATH_MULTIVIEW,
+                           ndk_helper::PerfMonitor::GetCurrentTime() - start);
+    } else if (is_backlight_still_on && render_with_view_atlas) {
+        double start = ndk_helper::PerfMonitor::GetCurrentTime();
+        RenderViewsAtlas();
+        LogRenderViewsTime(using_folded_dof_ ? RENDER_PATH_ATLAS_FOLDED_DOF :
+                           using_fused_interlace_sharpening_ ?
+                           RENDER_PATH_ATLAS_FUSED : RENDER_PATH_ATLAS,
+                           ndk_helper::PerfMonitor::GetCurrentTime() - start);
+    } else if (is_backlight_still_on) {
+        double start = ndk_helper::PerfMonitor::GetCurrentTime();
 
         static int count = 0;
         ++count;
@@ -283,16 +449,22 @@ void MoreTeapotsRenderer::RenderViews(bool is_backlight_still_on) {
             using_simple_leia_rendering_api = !using_simple_leia_rendering_api;
         }
         float debug = 0.0f;
+        UpdateViewMVPs(cameras[0][0].matrix, sizeof(LeiaCameraView) / sizeof(GLfloat),
+                       num_views);
         glViewport(0, 0, view_width_pixels_, view_height_pixels_);
         for (unsigned int y = 0; y < CAMERAS_HIGH; ++y) {
             for (unsigned int x = 0; x < CAMERAS_WIDE; ++x) {
                 unsigned int index = y * CAMERAS_WIDE + x;
-                glBindFramebuffer(GL_FRAMEBUFFER, fbos[index]);
+                context->BindFramebuffer(fbos[index]);
                 glEnable(GL_DEPTH_TEST);
                 glClearColor(0.4, 0.4, 0.4, 1.0);
                 glClearDepthf(1.0f);
                 glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-                RenderView(x, y, is_backlight_still_on);
+                RenderView(index);
+                leia_helper::DiscardTransientDepth(attachment_policy_);
+                // Depth of field overwrites the whole target
+                context->BindFramebuffer(fbo_dof[index]);
+                leia_helper::DiscardColor(attachment_policy_);
                 if (using_simple_leia_rendering_api) {
                     leiaDOF(render_textures[index], depth_textures[index],
                             &data, dof_shader.program_, fbo_dof[index], 1.0f);
@@ -301,9 +473,12 @@ void MoreTeapotsRenderer::RenderViews(bool is_backlight_still_on) {
                                    &data, dof_shader.program_, fbo_dof[index], 1.0f, debug);
                     leiaDrawQuad(dof_shader.program_, 0, 0);
                 }
+                context->Invalidate();
             }
         }
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        context->BindFramebuffer(fullscreen_fbo);
+        leia_helper::DiscardColor(attachment_policy_);
+        context->BindFramebuffer(0);
         CHECK_GL_ERROR();
 
         if (using_simple_leia_rendering_api) {
@@ -323,26 +498,164 @@ void MoreTeapotsRenderer::RenderViews(bool is_backlight_still_on) {
                                       LeiaJNIDisplayParameters::mViewSharpeningParams, 2, debug);
             leiaDrawQuad(view_sharpening_shader.program_, 0, 0);
         }
-
+        context->Invalidate();
+        LogRenderViewsTime(RENDER_PATH_PER_VIEW,
+                           ndk_helper::PerfMonitor::GetCurrentTime() - start);
     } else
     {
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        context->BindFramebuffer(0);
         glEnable(GL_DEPTH_TEST);
         glClearColor(0.4, 0.4, 0.4, 1.0);
         glClearDepthf(1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        RenderView(-1, -1, is_backlight_still_on);
+        UpdateViewMVPs(mat_projection_.Ptr(), 16, 1);
+        RenderView(0);
     }
 }
 
-void MoreTeapotsRenderer::RenderView(unsigned int x, unsigned int y, bool use_leia) {
+void MoreTeapotsRenderer::UpdateViewMVPs(const float *projections,
+                                         int32_t projection_stride, int32_t num_views) {
+    CullTeapots(projections, projection_stride, num_views);
+    if (drawing_instanced_) {
+        // The instanced shader applies the projection, it is all a view needs
+        view_projections_.resize(num_views * 16);
+        for (int32_t i = 0; i < num_views; ++i) {
+            memcpy(&view_projections_[i * 16], projections + i * projection_stride,
+                   16 * sizeof(GLfloat));
+        }
+        UploadInstances(true);
+        return;
+    }
+    // Every visible teapot for every view in one call, instead of a Mat4
+    // product per teapot in each view
+    const std::vector<int32_t> &visible = culler_.GetVisible();
+    const int32_t num_visible = culler_.GetNumVisible();
+    visible_model_views_.Resize(num_visible);
+    for (int32_t k = 0; k < num_visible; ++k) {
+        memcpy(visible_model_views_.Get(k), model_views_.Get(visible[k]), 16 * sizeof(GLfloat));
+    }
+    view_mvps_.Resize(num_views * num_visible);
+    leia_helper::MultiplyViewMatrices(projections, projection_stride, num_views,
+                                      visible_model_views_.Get(0), num_visible,
+                                      view_mvps_.Get(0), transform_isa_, 0);
+}
+
+// Teapots outside every view are not drawn, those outside some views are
+// skipped in them
+void MoreTeapotsRenderer::CullTeapots(const float *projections, int32_t projection_stride,
+                                      int32_t num_views) {
+    culler_.SetViews(projections, projection_stride, num_views);
+    culler_.SetBounds(model_views_, teapot_bounds_, teapot_bounds_[3]);
+    culler_.Cull(transform_isa_);
+    culled_teapots_ += culler_.GetStats().culled;
+    teapot_view_draws_ += culler_.GetStats().view_draws;
+}
 
-    ndk_helper::Mat4 perspective;
-    perspective = mat_projection_;
-    if (use_leia) {
-        for (int i = 0; i < 16; ++i) {
-            perspective.Ptr()[i] = cameras[y][x].matrix[i];
+// Cameras only change with the viewport, an unchanged block is not uploaded again
+void MoreTeapotsRenderer::UpdateCameraBlock() {
+    const GLfloat light0[3] = {100.f, -200.f, -600.f};
+    TEAPOT_MATERIALS material = {{1.0f, 1.0f, 1.0f, 10.f},
+                                 {0.1f, 0.1f, 0.1f},};
+    camera_buffer_.SetCamera(&data);
+    camera_buffer_.SetViewProjections(cameras[0][0].matrix,
+                                      sizeof(LeiaCameraView) / sizeof(GLfloat),
+                                      CAMERAS_WIDE * CAMERAS_HIGH);
+    camera_buffer_.SetLight(light0, material.ambient_color, material.specular_color);
+    camera_buffer_.Upload();
+}
+
+// Visible teapots to the instance buffer, view after view or once for all
+// views, the vertex array on the first call
+void MoreTeapotsRenderer::UploadInstances(bool per_view) {
+    if (!instance_vao_) {
+        glGenBuffers(1, &instance_vbo_);
+        glGenVertexArrays(1, &instance_vao_);
+        glBindVertexArray(instance_vao_);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo_);
+        int32_t iStride = sizeof(TEAPOT_VERTEX);
+        glVertexAttribPointer(ATTRIB_VERTEX, 3, GL_FLOAT, GL_FALSE, iStride,
+                              BUFFER_OFFSET(0));
+        glEnableVertexAttribArray(ATTRIB_VERTEX);
+        glVertexAttribPointer(ATTRIB_NORMAL, 3, GL_FLOAT, GL_FALSE, iStride,
+                              BUFFER_OFFSET(3 * sizeof(GLfloat)));
+        glEnableVertexAttribArray(ATTRIB_NORMAL);
+
+        glVertexAttribDivisor(ATTRIB_COLOR, 1);
+        glEnableVertexAttribArray(ATTRIB_COLOR);
+        for (int32_t column = 0; column < 4; ++column) {
+            glVertexAttribDivisor(ATTRIB_MODEL_VIEW + column, 1);
+            glEnableVertexAttribArray(ATTRIB_MODEL_VIEW + column);
         }
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo_);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    }
+
+    const std::vector<int32_t> &visible = culler_.GetVisible();
+    const std::vector<uint32_t> &masks = culler_.GetViewMasks();
+    const int32_t num_visible = culler_.GetNumVisible();
+    const int32_t num_views = per_view ? culler_.GetNumViews() : 1;
+    view_first_instances_.assign(num_views + 1, 0);
+    instance_data_.resize((per_view ? culler_.GetStats().view_draws : num_visible) *
+                          INSTANCE_FLOATS);
+    int32_t instance = 0;
+    for (int32_t v = 0; v < num_views; ++v) {
+        view_first_instances_[v] = instance;
+        for (int32_t k = 0; k < num_visible; ++k) {
+            if (per_view && !(masks[k] & (1u << v))) continue;
+            GLfloat *out = &instance_data_[instance++ * INSTANCE_FLOATS];
+            memcpy(out, model_views_.Get(visible[k]), 16 * sizeof(GLfloat));
+            vec_colors_[visible[k]].Value(out[16], out[17], out[18]);
+            out[19] = 1.0f;
+        }
+    }
+    view_first_instances_[num_views] = instance;
+
+    // New storage every frame, the draws of the last one may still read the old
+    glBindBuffer(GL_ARRAY_BUFFER, instance_vbo_);
+    glBufferData(GL_ARRAY_BUFFER, instance * INSTANCE_FLOATS * sizeof(GLfloat),
+                 instance ? &instance_data_[0] : NULL, GL_STREAM_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// Points the instance attributes of instance_vao_, bound, at instance first
+void MoreTeapotsRenderer::BindInstances(int32_t first) {
+    const GLsizei stride = INSTANCE_FLOATS * sizeof(GLfloat);
+    const size_t offset = first * stride;
+    glBindBuffer(GL_ARRAY_BUFFER, instance_vbo_);
+    for (int32_t column = 0; column < 4; ++column) {
+        glVertexAttribPointer(ATTRIB_MODEL_VIEW + column, 4, GL_FLOAT, GL_FALSE, stride,
+                              BUFFER_OFFSET(offset + column * 4 * sizeof(GLfloat)));
+    }
+    glVertexAttribPointer(ATTRIB_COLOR, 3, GL_FLOAT, GL_FALSE, stride,
+                          BUFFER_OFFSET(offset + 16 * sizeof(GLfloat)));
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// The teapots visible in view in one draw, with the projection
+// UpdateViewMVPs() kept for it
+void MoreTeapotsRenderer::RenderViewInstanced(int32_t view) {
+    const int32_t first = view_first_instances_[view];
+    const int32_t count = view_first_instances_[view + 1] - first;
+    if (!count) return;
+    leia_helper::LeiaRenderContext::GetInstance()->UseProgram(
+            instanced_shader_param_.program_);
+    leia_helper::UseCameraBlock(instanced_shader_param_.program_);
+    glUniformMatrix4fv(instanced_shader_param_.matrix_projection_, 1, GL_FALSE,
+                       &view_projections_[view * 16]);
+
+    glBindVertexArray(instance_vao_);
+    BindInstances(first);
+    glDrawElementsInstanced(GL_TRIANGLES, num_indices_, GL_UNSIGNED_SHORT, BUFFER_OFFSET(0),
+                            count);
+    glBindVertexArray(0);
+    CHECK_GL_ERROR();
+}
+
+void MoreTeapotsRenderer::RenderView(int32_t view) {
+    if (drawing_instanced_) {
+        RenderViewInstanced(view);
+        return;
     }
 
     // Bind the VBO
@@ -362,7 +675,7 @@ void MoreTeapotsRenderer::RenderView(unsigned int x, unsigned int y, bool use_le
     // Bind the IB
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo_);
 
-    glUseProgram(shader_param_.program_);
+    leia_helper::LeiaRenderContext::GetInstance()->UseProgram(shader_param_.program_);
 
     TEAPOT_MATERIALS material = {{1.0f, 1.0f, 1.0f, 10.f},
                                  {0.1f, 0.1f, 0.1f},};
@@ -379,25 +692,23 @@ void MoreTeapotsRenderer::RenderView(unsigned int x, unsigned int y, bool use_le
 
     glUniform3f(shader_param_.light0_, 100.f, -200.f, -600.f);
 
-    // Regular rendering pass
-    for (int32_t i = 0; i < teapot_x_ * teapot_y_ * teapot_z_; ++i) {
+    // Regular rendering pass, the teapots the culling left in this view
+    const std::vector<int32_t> &visible = culler_.GetVisible();
+    const std::vector<uint32_t> &masks = culler_.GetViewMasks();
+    const int32_t num_visible = culler_.GetNumVisible();
+    const GLfloat *mvps = view_mvps_.Get(view * num_visible);
+    for (int32_t k = 0; k < num_visible; ++k) {
+        if (!(masks[k] & (1u << view))) continue;
         // Set diffuse
         float x, y, z;
-        vec_colors_[i].Value(x, y, z);
+        vec_colors_[visible[k]].Value(x, y, z);
         glUniform4f(shader_param_.material_diffuse_, x, y, z, 1.f);
 
-        // Rotation
-        vec_current_rotations_[i] += vec_rotations_[i];
-        vec_current_rotations_[i].Value(x, y);
-        ndk_helper::Mat4 mat_rotation =
-                ndk_helper::Mat4::RotationX(x) * ndk_helper::Mat4::RotationY(y);
-
         // Feed Projection and Model View matrices to the shaders
-        ndk_helper::Mat4 mat_v = mat_view_ * vec_mat_models_[i] * mat_rotation;
-        ndk_helper::Mat4 mat_vp = perspective * mat_v;
         glUniformMatrix4fv(shader_param_.matrix_projection_, 1, GL_FALSE,
-                           mat_vp.Ptr());
-        glUniformMatrix4fv(shader_param_.matrix_view_, 1, GL_FALSE, mat_v.Ptr());
+                           mvps + k * 16);
+        glUniformMatrix4fv(shader_param_.matrix_view_, 1, GL_FALSE,
+                           visible_model_views_.Get(k));
 
         glDrawElements(GL_TRIANGLES, num_indices_, GL_UNSIGNED_SHORT,
                        BUFFER_OFFSET(0));
@@ -409,68 +720,311 @@ void MoreTeapotsRenderer::RenderView(unsigned int x, unsigned int y, bool use_le
 }
 
 //--------------------------------------------------------------------------------
-// LoadShaders
+// Single pass multiview rendering
 //--------------------------------------------------------------------------------
-bool MoreTeapotsRenderer::LoadShaders(SHADER_PARAMS *params, const char *strVsh,
-                                      const char *strFsh) {
-    //
-    // Shader load for GLES2
-    // In GLES2.0, shader attribute locations need to be explicitly specified
-    // before linking
-    //
-    GLuint program;
-    GLuint vertShader, fragShader;
-
-    // Create shader program
-    program = glCreateProgram();
-    LOGI("Created Shader %d", program);
-
-    // Create and compile vertex shader
-    if (!ndk_helper::shader::CompileShader(&vertShader, GL_VERTEX_SHADER,
-                                           strVsh)) {
-        LOGI("Failed to compile vertex shader");
-        glDeleteProgram(program);
-        return false;
+void MoreTeapotsRenderer::RenderViewsMultiview() {
+    // All views are rendered by one pass into the layers of the multiview target
+    multiview_target_.BindScene();
+    glEnable(GL_DEPTH_TEST);
+    glClearColor(0.4, 0.4, 0.4, 1.0);
+    glClearDepthf(1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    // One pass draws every view, only the union of the views is culled
+    CullTeapots(cameras[0][0].matrix, sizeof(LeiaCameraView) / sizeof(GLfloat),
+                CAMERAS_WIDE * CAMERAS_HIGH);
+    if (drawing_instanced_) UploadInstances(false);
+    RenderViewMultiview();
+
+    UpdateViewIndexMap();
+    if (using_folded_dof_) {
+        // Depth of field only on the texels the interlacer shows, straight from
+        // the scene layers
+        leia_helper::ViewInterlaceDOFIndexed(multiview_target_.GetColorTexture(),
+                                             multiview_target_.GetDepthTexture(),
+                                             view_index_map_.GetTexture(), &data,
+                                             multiview_interlace_dof_program_,
+                                             fullscreen_fbo, screen_width_pixels_,
+                                             screen_height_pixels_, 1.0f);
+        SharpenFullscreen();
+        CHECK_GL_ERROR();
+        return;
     }
 
-    // Create and compile fragment shader
-    if (!ndk_helper::shader::CompileShader(&fragShader, GL_FRAGMENT_SHADER,
-                                           strFsh)) {
-        LOGI("Failed to compile fragment shader");
-        glDeleteProgram(program);
-        return false;
+    // Depth of field on every layer at once
+    leia_helper::PrepareMultiviewDOF(multiview_target_.GetColorTexture(),
+                                     multiview_target_.GetDepthTexture(), &data,
+                                     multiview_dof_program_,
+                                     multiview_target_.GetDOFFramebuffer(), 1.0f);
+    leia_helper::DrawQuad();
+
+    if (using_fused_interlace_sharpening_) {
+        // Straight to the back buffer, fullscreen_fbo is skipped
+        leia_helper::ViewInterlaceAndSharpenIndexed(
+                multiview_target_.GetDOFTexture(), view_index_map_.GetTexture(),
+                multiview_interlace_sharpen_program_, 0, screen_width_pixels_,
+                screen_height_pixels_, LeiaJNIDisplayParameters::mViewSharpeningParams, 2);
+    } else {
+        leia_helper::ViewInterlaceIndexed(multiview_target_.GetDOFTexture(),
+                                          view_index_map_.GetTexture(),
+                                          multiview_interlace_program_, fullscreen_fbo,
+                                          screen_width_pixels_, screen_height_pixels_);
+        SharpenFullscreen();
+    }
+    CHECK_GL_ERROR();
+}
+
+void MoreTeapotsRenderer::RenderViewMultiview() {
+    if (drawing_instanced_ && multiview_instanced_shader_param_.program_) {
+        // Every visible teapot in every view, one draw for the frame
+        const int32_t count = view_first_instances_[1];
+        if (!count) return;
+        leia_helper::LeiaRenderContext::GetInstance()->UseProgram(
+                multiview_instanced_shader_param_.program_);
+        leia_helper::UseCameraBlock(multiview_instanced_shader_param_.program_);
+        glBindVertexArray(instance_vao_);
+        BindInstances(0);
+        glDrawElementsInstanced(GL_TRIANGLES, num_indices_, GL_UNSIGNED_SHORT,
+                                BUFFER_OFFSET(0), count);
+        glBindVertexArray(0);
+        CHECK_GL_ERROR();
+        return;
     }
 
-    // Attach vertex shader to program
-    glAttachShader(program, vertShader);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo_);
+    int32_t iStride = sizeof(TEAPOT_VERTEX);
+    glVertexAttribPointer(ATTRIB_VERTEX, 3, GL_FLOAT, GL_FALSE, iStride,
+                          BUFFER_OFFSET(0));
+    glEnableVertexAttribArray(ATTRIB_VERTEX);
+    glVertexAttribPointer(ATTRIB_NORMAL, 3, GL_FLOAT, GL_FALSE, iStride,
+                          BUFFER_OFFSET(3 * sizeof(GLfloat)));
+    glEnableVertexAttribArray(ATTRIB_NORMAL);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo_);
+
+    // Projections, light and specular material come from the camera block
+    leia_helper::LeiaRenderContext::GetInstance()->UseProgram(
+            multiview_shader_param_.program_);
+    leia_helper::UseCameraBlock(multiview_shader_param_.program_);
 
-    // Attach fragment shader to program
-    glAttachShader(program, fragShader);
+    const std::vector<int32_t> &visible = culler_.GetVisible();
+    for (int32_t k = 0; k < culler_.GetNumVisible(); ++k) {
+        const int32_t i = visible[k];
+        float x, y, z;
+        vec_colors_[i].Value(x, y, z);
+        glUniform4f(multiview_shader_param_.material_diffuse_, x, y, z, 1.f);
 
-    // Bind attribute locations
-    // this needs to be done prior to linking
-    glBindAttribLocation(program, ATTRIB_VERTEX, "myVertex");
-    glBindAttribLocation(program, ATTRIB_NORMAL, "myNormal");
+        // Projection is applied per view in the shader
+        glUniformMatrix4fv(multiview_shader_param_.matrix_view_, 1, GL_FALSE,
+                           model_views_.Get(i));
 
-    // Link program
-    if (!ndk_helper::shader::LinkProgram(program)) {
-        LOGI("Failed to link program: %d", program);
+        glDrawElements(GL_TRIANGLES, num_indices_, GL_UNSIGNED_SHORT,
+                       BUFFER_OFFSET(0));
+    }
 
-        if (vertShader) {
-            glDeleteShader(vertShader);
-            vertShader = 0;
-        }
-        if (fragShader) {
-            glDeleteShader(fragShader);
-            fragShader = 0;
-        }
-        if (program) {
-            glDeleteProgram(program);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    CHECK_GL_ERROR();
+}
+
+//--------------------------------------------------------------------------------
+// View atlas rendering
+//--------------------------------------------------------------------------------
+void MoreTeapotsRenderer::RenderViewsAtlas() {
+    // One framebuffer and one clear for every view, each view is drawn into its
+    // own region of the atlas
+    view_atlas_.BindScene();
+    glEnable(GL_DEPTH_TEST);
+    glClearColor(0.4, 0.4, 0.4, 1.0);
+    glClearDepthf(1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    if (!RenderViewSynthesisSources()) {
+        UpdateViewMVPs(cameras[0][0].matrix, sizeof(LeiaCameraView) / sizeof(GLfloat),
+                       CAMERAS_WIDE * CAMERAS_HIGH);
+        for (unsigned int y = 0; y < CAMERAS_HIGH; ++y) {
+            for (unsigned int x = 0; x < CAMERAS_WIDE; ++x) {
+                view_atlas_.BindView(y * CAMERAS_WIDE + x);
+                RenderView(y * CAMERAS_WIDE + x);
+            }
         }
+    }
+    view_atlas_.FinishScene();
+
+    UpdateViewIndexMap();
+    if (using_folded_dof_) {
+        leia_helper::LeiaRenderContext::GetInstance()->BindFramebuffer(fullscreen_fbo);
+        leia_helper::DiscardColor(attachment_policy_);
+        leia_helper::ViewInterlaceDOFIndexedAtlas(
+                view_atlas_.GetColorTexture(), view_atlas_.GetDepthTexture(),
+                view_atlas_.GetViewRectTable(), view_index_map_.GetTexture(), &data,
+                atlas_interlace_dof_program_, fullscreen_fbo, screen_width_pixels_,
+                screen_height_pixels_, 1.0f);
+        SharpenFullscreen();
+        CHECK_GL_ERROR();
+        return;
+    }
+
+    // Depth of field on every view at once
+    view_atlas_.BindDOF();
+    leia_helper::PrepareAtlasDOF(view_atlas_.GetColorTexture(),
+                                 view_atlas_.GetDepthTexture(),
+                                 view_atlas_.GetViewRectTable(), &data, atlas_dof_program_,
+                                 view_atlas_.GetDOFFramebuffer(), view_atlas_.GetWidth(),
+                                 view_atlas_.GetHeight(), 1.0f);
+    leia_helper::DrawQuad();
+
+    if (using_fused_interlace_sharpening_) {
+        leia_helper::ViewInterlaceAndSharpenIndexedAtlas(
+                view_atlas_.GetDOFTexture(), view_atlas_.GetViewRectTable(),
+                view_atlas_.GetNumViews(), view_index_map_.GetTexture(),
+                atlas_interlace_sharpen_program_, 0, screen_width_pixels_,
+                screen_height_pixels_, LeiaJNIDisplayParameters::mViewSharpeningParams, 2);
+    } else {
+        leia_helper::LeiaRenderContext::GetInstance()->BindFramebuffer(fullscreen_fbo);
+        leia_helper::DiscardColor(attachment_policy_);
+        leia_helper::ViewInterlaceIndexedAtlas(
+                view_atlas_.GetDOFTexture(), view_atlas_.GetViewRectTable(),
+                view_atlas_.GetNumViews(), view_index_map_.GetTexture(),
+                atlas_interlace_program_, fullscreen_fbo, screen_width_pixels_,
+                screen_height_pixels_);
+        SharpenFullscreen();
+    }
+    CHECK_GL_ERROR();
+}
+
+bool MoreTeapotsRenderer::RenderViewSynthesisSources() {
+    // Only the source views are rendered, the synthesis pass fills every view
+    // region of the atlas, color and depth, for the passes that follow
+    leia_helper::VIEW_SYNTHESIS_PARAMS params;
+    if (view_synthesis_mode_ == leia_helper::VIEW_SYNTHESIS_OFF ||
+        !view_synthesis_program_ || !view_synthesis_target_.GetColorTexture() ||
+        !leia_helper::GetViewSynthesisParams(&data, view_synthesis_mode_, &params)) {
         return false;
     }
 
-    // Get uniform locations
+    GLfloat projections[leia_helper::VIEW_SYNTHESIS_MAX_SOURCES * 16];
+    for (int32_t i = 0; i < params.num_sources; ++i) {
+        leia_helper::InterpolateViewMatrix(cameras[0], CAMERAS_WIDE,
+                                           params.source_positions[i], &projections[i * 16]);
+    }
+    UpdateViewMVPs(projections, 16, params.num_sources);
+    for (int32_t i = 0; i < params.num_sources; ++i) {
+        view_synthesis_target_.BindSource(i);
+        glEnable(GL_DEPTH_TEST);
+        glClearColor(0.4, 0.4, 0.4, 1.0);
+        glClearDepthf(1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        RenderView(i);
+    }
+
+    leia_helper::ViewSynthesisAtlas(view_synthesis_target_.GetColorTexture(),
+                                    view_synthesis_target_.GetDepthTexture(),
+                                    view_atlas_.GetViewRectTable(), params,
+                                    view_synthesis_program_, view_atlas_.GetFramebuffer(),
+                                    view_atlas_.GetWidth(), view_atlas_.GetHeight());
+    CHECK_GL_ERROR();
+    return true;
+}
+
+void MoreTeapotsRenderer::SetViewSynthesisMode(leia_helper::VIEW_SYNTHESIS_MODE mode) {
+    view_synthesis_mode_ = mode;
+}
+
+// The Leia SDK binds on its own, the context forgets what it tracked
+void MoreTeapotsRenderer::SharpenFullscreen() {
+    leiaViewSharpening(fullscreen_texture, &data, view_sharpening_shader.program_, 0,
+                       screen_width_pixels_,
+                       LeiaJNIDisplayParameters::mViewSharpeningParams, 2);
+    leia_helper::LeiaRenderContext::GetInstance()->Invalidate();
+}
+
+void MoreTeapotsRenderer::UpdateViewIndexMap() {
+    // Only rebuilt when the calibration changes
+    leia_helper::VIEW_INDEX_CALIBRATION calibration = {
+            LeiaJNIDisplayParameters::mAlignmentOffset, VIEW_SLANT_NUMERATOR,
+            VIEW_SLANT_DENOMINATOR, VIEW_SUBPIXEL_INTERLACING};
+    view_index_map_.Update(&data, calibration);
+}
+
+void MoreTeapotsRenderer::LogRenderViewsTime(RENDER_PATH path, double elapsed) {
+    render_views_time_[path] += elapsed;
+    if (++render_views_frames_[path] >= RENDER_VIEWS_LOG_FRAMES) {
+        const char *names[RENDER_PATH_COUNT] = {"per view loop", "multiview",
+                                                "multiview, fused sharpening",
+                                                "multiview, folded depth of field",
+                                                "view atlas",
+                                                "view atlas, fused sharpening",
+                                                "view atlas, folded depth of field"};
+        LOGI("RenderViews (%s%s): %.3f ms CPU per frame", names[path],
+             drawing_instanced_ ? ", instanced" : "",
+             render_views_time_[path] * 1000.0 / render_views_frames_[path]);
+        // Since the last log, which may include frames of another path
+        leia_helper::LeiaRenderContext *context =
+                leia_helper::LeiaRenderContext::GetInstance();
+        leia_helper::RENDER_CONTEXT_STATS stats = context->GetStats();
+        const int32_t frames = render_views_frames_[path];
+        LOGI("RenderViews (%s): %d binds, %d elided, %d uniform queries per frame",
+             names[path],
+             (stats.program_binds + stats.framebuffer_binds + stats.texture_binds) / frames,
+             (stats.programs_elided + stats.framebuffers_elided + stats.textures_elided) /
+             frames, stats.uniform_queries / frames);
+        LOGI("RenderViews (%s): %lld of %d teapots culled, %lld view draws per frame",
+             names[path], (long long)(culled_teapots_ / frames),
+             teapot_x_ * teapot_y_ * teapot_z_, (long long)(teapot_view_draws_ / frames));
+        culled_teapots_ = 0;
+        teapot_view_draws_ = 0;
+        context->ResetStats();
+        render_views_time_[path] = 0.0;
+        render_views_frames_[path] = 0;
+    }
+}
+
+//--------------------------------------------------------------------------------
+// LoadShaders
+//--------------------------------------------------------------------------------
+// Shader attribute locations need to be explicitly specified before linking
+static const leia_helper::PROGRAM_ATTRIBUTE TEAPOT_ATTRIBUTES[] = {
+        {ATTRIB_VERTEX, "myVertex"}, {ATTRIB_NORMAL, "myNormal"},
+        {ATTRIB_COLOR, "myColor"}, {ATTRIB_MODEL_VIEW, "myModelView"}};
+static const int32_t NUM_TEAPOT_ATTRIBUTES =
+        sizeof(TEAPOT_ATTRIBUTES) / sizeof(TEAPOT_ATTRIBUTES[0]);
+
+// Both stages, with the LeiaCamera block added to defines
+static bool ReadShaders(const char *strVsh, const char *strFsh,
+                        const std::map<std::string, std::string> *defines,
+                        std::string *vert_source, std::string *frag_source) {
+    std::map<std::string, std::string> shader_defines;
+    if (defines) shader_defines = *defines;
+    shader_defines[CAMERA_BLOCK_TAG] = leia_helper::CAMERA_BLOCK_SOURCE;
+    return ndk_helper::shader::ReadShader(strVsh, &shader_defines, vert_source) &&
+           ndk_helper::shader::ReadShader(strFsh, &shader_defines, frag_source);
+}
+
+bool MoreTeapotsRenderer::LoadShaders(SHADER_PARAMS *params, const char *strVsh,
+                                      const char *strFsh,
+                                      const std::map<std::string, std::string> *defines) {
+    std::string vert_source, frag_source;
+    if (!ReadShaders(strVsh, strFsh, defines, &vert_source, &frag_source)) return false;
+    params->program_ = leia_helper::CreateProgram(
+            "more-teapots", vert_source.c_str(), frag_source.c_str(),
+            TEAPOT_ATTRIBUTES, NUM_TEAPOT_ATTRIBUTES);
+    if (!params->program_) return false;
+    LOGI("Created Shader %d", params->program_);
+    GetUniformLocations(params);
+    return true;
+}
+
+// Queued on program_builder_, GetUniformLocations() once it is ready
+bool MoreTeapotsRenderer::AddShaders(SHADER_PARAMS *params, const char *strVsh,
+                                     const char *strFsh,
+                                     const std::map<std::string, std::string> *defines) {
+    std::string vert_source, frag_source;
+    if (!ReadShaders(strVsh, strFsh, defines, &vert_source, &frag_source)) return false;
+    program_builder_.AddProgram(&params->program_, "more-teapots", vert_source,
+                                frag_source, TEAPOT_ATTRIBUTES, NUM_TEAPOT_ATTRIBUTES);
+    return true;
+}
+
+void MoreTeapotsRenderer::GetUniformLocations(SHADER_PARAMS *params) {
+    GLuint program = params->program_;
     params->matrix_projection_ = glGetUniformLocation(program, "uPMatrix");
     params->matrix_view_ = glGetUniformLocation(program, "uMVMatrix");
 
@@ -479,13 +1033,6 @@ bool MoreTeapotsRenderer::LoadShaders(SHADER_PARAMS *params, const char *strVsh,
     params->material_ambient_ = glGetUniformLocation(program, "vMaterialAmbient");
     params->material_specular_ =
             glGetUniformLocation(program, "vMaterialSpecular");
-
-    // Release vertex and fragment shaders
-    if (vertShader) glDeleteShader(vertShader);
-    if (fragShader) glDeleteShader(fragShader);
-
-    params->program_ = program;
-    return true;
 }
 
 //--------------------------------------------------------------------------------
@@ -498,14 +1045,8 @@ bool MoreTeapotsRenderer::Bind(ndk_helper::TapCamera *camera) {
 
 void MoreTeapotsRenderer::PrepareFullscreenSurface() {
     glGenFramebuffers(1, &fullscreen_fbo);
-    glGenTextures(1, &fullscreen_texture);
-    glBindTexture(GL_TEXTURE_2D, fullscreen_texture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, screen_width_pixels_, screen_height_pixels_, 0,
-                 GL_RGBA,
-                 GL_UNSIGNED_BYTE,
-                 NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    fullscreen_texture = AcquireTexture(screen_width_pixels_, screen_height_pixels_,
+                                        GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
     glBindFramebuffer(GL_FRAMEBUFFER, fullscreen_fbo);
     GLenum attachment = GL_COLOR_ATTACHMENT0;
     glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, fullscreen_texture, 0);
@@ -523,17 +1064,16 @@ void MoreTeapotsRenderer::PrepareRenderTargetSurfaces() {
         // the objects need to be drawn into FBOs
         // This is the general rendering FBO set
         glBindFramebuffer(GL_FRAMEBUFFER, fbos[i]);
-        render_textures[i] = CreateTexture(view_width_pixels_, view_height_pixels_,
-                                           GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        render_textures[i] = leia_helper::AcquireColorAttachment(
+                attachment_policy_, view_width_pixels_, view_height_pixels_);
         GLenum attachment = GL_COLOR_ATTACHMENT0;
         glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D,
                                render_textures[i], 0);
 
-        depth_textures[i] = CreateTexture(view_width_pixels_, view_height_pixels_,
-                                          GL_DEPTH_COMPONENT32F, GL_DEPTH_COMPONENT,
-                                          GL_FLOAT, NULL);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
-                               GL_TEXTURE_2D, depth_textures[i], 0);
+        // A renderbuffer when nothing samples depth, see attachmentPolicy.h
+        depth_textures[i] = leia_helper::AcquireDepthAttachment(
+                attachment_policy_, view_width_pixels_, view_height_pixels_);
+        leia_helper::AttachDepth(attachment_policy_, depth_textures[i]);
 
         glDrawBuffers(1, &attachment);
         GLuint status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
@@ -544,8 +1084,8 @@ void MoreTeapotsRenderer::PrepareRenderTargetSurfaces() {
         // Create the FBOs and Textures needed for the DoF pass
         // Also verify the framebuffer is valid after creation
         glBindFramebuffer(GL_FRAMEBUFFER, fbo_dof[i]);
-        texture_dof[i] = CreateTexture(view_width_pixels_, view_height_pixels_, GL_RGBA8,
-                                       GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        texture_dof[i] = leia_helper::AcquireColorAttachment(
+                attachment_policy_, view_width_pixels_, view_height_pixels_);
         attachment = GL_COLOR_ATTACHMENT0;
         glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, texture_dof[i], 0);
         glDrawBuffers(1, &attachment);
@@ -559,93 +1099,47 @@ void MoreTeapotsRenderer::PrepareRenderTargetSurfaces() {
     glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
 }
 
-GLuint MoreTeapotsRenderer::CreateTexture(int width, int height,
-                                          GLint internal_format,
-                                          GLenum format, GLenum type,
-                                          void *data) {
-    GLuint texture_id;
-    glGenTextures(1, &texture_id);
-    glBindTexture(GL_TEXTURE_2D, texture_id);
-    glTexImage2D(GL_TEXTURE_2D, 0, internal_format, width, height, 0, format, type,
-                 data);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-    return texture_id;
-}
-
-void MoreTeapotsRenderer::DrawTexturedQuad(GLint program_id) {
-    CHECK_GL_ERROR();
-
-// vao and vbo handle
-    static GLuint vbo, ibo;
-    GLuint pos_loc = glGetAttribLocation(program_id, "myVertex");
-    GLuint tex_loc = glGetAttribLocation(program_id, "myUV");
-
-    // generate and bind the vertex buffer object
-    glGenBuffers(1, &vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    CHECK_GL_ERROR();
-
-    // data for a fullscreen quad (this time with texture coords)
-    GLfloat vertexData[] = {
-            //  X     Y     Z           U     V
-            1.0f, 1.0f, 0.0f, 1.0f, 1.0f, // vertex 0
-            -1.0f, 1.0f, 0.0f, 0.0f, 1.0f, // vertex 1
-            1.0f, -1.0f, 0.0f, 1.0f, 0.0f, // vertex 2
-            -1.0f, -1.0f, 0.0f, 0.0f, 0.0f, // vertex 3
-    }; // 4 vertices with 5 components (floats) each
-
-    // fill with data
-    glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * 4 * 5, vertexData, GL_STATIC_DRAW);
-
-
-    // set up generic attrib pointers
-    glEnableVertexAttribArray(pos_loc);
-    CHECK_GL_ERROR();
-    glVertexAttribPointer(pos_loc, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat),
-                          (char *) 0 + 0 * sizeof(GLfloat));
-
-    glEnableVertexAttribArray(tex_loc);
-    glVertexAttribPointer(tex_loc, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat),
-                          (char *) 0 + 3 * sizeof(GLfloat));
-
-
-    // generate and bind the index buffer object
-    glGenBuffers(1, &ibo);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
-    CHECK_GL_ERROR();
-
-    GLuint indexData[] = {
-            0, 1, 2, // first triangle
-            2, 1, 3, // second triangle
-    };
-
-    // fill with data
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * 2 * 3, indexData, GL_STATIC_DRAW);
+void MoreTeapotsRenderer::ReleaseSurfaces() {
+    leia_helper::RenderTargetPool *pool = leia_helper::RenderTargetPool::GetInstance();
+    if (fullscreen_fbo) {
+        glDeleteFramebuffers(1, &fullscreen_fbo);
+        fullscreen_fbo = 0;
+    }
+    pool->ReleaseTexture(fullscreen_texture);
+    fullscreen_texture = 0;
 
-    CHECK_GL_ERROR();
+    if (fbos[0]) {
+        glDeleteFramebuffers(RT_COUNT, fbos);
+    }
+    if (fbo_dof[0]) {
+        glDeleteFramebuffers(RT_COUNT, fbo_dof);
+    }
+    for (int i = 0; i < RT_COUNT; ++i) {
+        pool->ReleaseTexture(render_textures[i]);
+        leia_helper::ReleaseDepthAttachment(attachment_policy_, depth_textures[i]);
+        pool->ReleaseTexture(texture_dof[i]);
+        fbos[i] = 0;
+        fbo_dof[i] = 0;
+        render_textures[i] = 0;
+        depth_textures[i] = 0;
+        texture_dof[i] = 0;
+    }
 
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glVertexAttribPointer(pos_loc, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat),
-                          (char *) 0 + 0 * sizeof(GLfloat));
-    glVertexAttribPointer(tex_loc, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat),
-                          (char *) 0 + 3 * sizeof(GLfloat));
-    glEnableVertexAttribArray(pos_loc);
-    glEnableVertexAttribArray(tex_loc);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
-    CHECK_GL_ERROR();
+    pool->ReleaseTexture(checkerboard_texture);
+    checkerboard_texture = 0;
+}
 
-    // draw
-    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-    CHECK_GL_ERROR();
+GLuint MoreTeapotsRenderer::AcquireTexture(int width, int height,
+                                           GLint internal_format,
+                                           GLenum format, GLenum type,
+                                           void *data) {
+    // Same size and format as a released target reuses it without allocating
+    GLuint texture_id = leia_helper::RenderTargetPool::GetInstance()->AcquireTexture(
+            width, height, internal_format);
+    if (data) {
+        glBindTexture(GL_TEXTURE_2D, texture_id);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, format, type, data);
+    }
 
-    glDisableVertexAttribArray(pos_loc);
-    glDisableVertexAttribArray(tex_loc);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-    glDeleteBuffers(1, &vbo);
-    glDeleteBuffers(1, &ibo);
+    return texture_id;
 }
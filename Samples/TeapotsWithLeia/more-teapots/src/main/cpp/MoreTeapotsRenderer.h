@@ -26,7 +26,9 @@
 //--------------------------------------------------------------------------------
 #include <jni.h>
 #include <errno.h>
+#include <map>
 #include <random>
+#include <string>
 #include <vector>
 
 #include <EGL/egl.h>
@@ -42,6 +44,18 @@
 #define APPLICATION_CLASS_NAME "com/sample/moreteapots/MoreTeapotsApplication"
 
 #include "NDKHelper.h"
+#include "attachmentPolicy.h"
+#include "cameraBuffer.h"
+#include "frustumCulling.h"
+#include "multiview.h"
+#include "postProcess.h"
+#include "programBuilder.h"
+#include "renderContext.h"
+#include "renderTargetPool.h"
+#include "viewAtlas.h"
+#include "viewIndexMap.h"
+#include "viewSynthesis.h"
+#include "viewTransforms.h"
 
 #define BUFFER_OFFSET(i) ((char*)NULL + (i))
 
@@ -54,7 +68,9 @@ enum SHADER_ATTRIBUTES {
     ATTRIB_VERTEX,
     ATTRIB_NORMAL,
     ATTRIB_COLOR,
-    ATTRIB_UV
+    ATTRIB_UV,
+    // mat4, the four columns on consecutive locations
+    ATTRIB_MODEL_VIEW
 };
 
 struct SHADER_PARAMS {
@@ -81,15 +97,57 @@ class MoreTeapotsRenderer {
 
     SHADER_PARAMS shader_param_;
 
+    SHADER_PARAMS multiview_shader_param_;
+
+    // Instanced drawing, ES 3.0: one draw for the visible teapots of a view,
+    // or of every view with multiview. Model views and colors are per
+    // instance attributes on instance_vao_, the instances of view v start at
+    // view_first_instances_[v].
+    SHADER_PARAMS instanced_shader_param_;
+    SHADER_PARAMS multiview_instanced_shader_param_;
+    GLuint instance_vao_;
+    GLuint instance_vbo_;
+    std::vector<GLfloat> instance_data_;
+    std::vector<int32_t> view_first_instances_;
+    bool drawing_instanced_;
+    // Projections of the views of the frame, applied in the shader
+    std::vector<GLfloat> view_projections_;
+
     bool LoadShaders(SHADER_PARAMS *params, const char *strVsh,
-                     const char *strFsh);
+                     const char *strFsh,
+                     const std::map<std::string, std::string> *defines = NULL);
+    bool AddShaders(SHADER_PARAMS *params, const char *strVsh,
+                    const char *strFsh,
+                    const std::map<std::string, std::string> *defines = NULL);
+    void GetUniformLocations(SHADER_PARAMS *params);
+
+    // Programs of the 3D paths, built while the 2D path is shown
+    leia_helper::ProgramBuilder program_builder_;
+    bool programs_ready_;
+    void OnProgramsReady();
 
     ndk_helper::Mat4 mat_projection_;
-    ndk_helper::Mat4 mat_view_;
-    std::vector<ndk_helper::Mat4> vec_mat_models_;
+    ndk_helper::Affine mat_view_;
     std::vector<ndk_helper::Vec3> vec_colors_;
-    std::vector<ndk_helper::Vec2> vec_rotations_;
-    std::vector<ndk_helper::Vec2> vec_current_rotations_;
+
+    // Positions and spins of the teapots. Update() advances them and writes
+    // model_views_ once per frame, every view only reads it.
+    leia_helper::InstanceTransforms teapots_;
+    double last_update_time_;
+
+    // Model view of every teapot for the frame, and the model view projection
+    // of every teapot for each view being rendered, view after view
+    leia_helper::MatrixBuffer model_views_;
+    leia_helper::MatrixBuffer view_mvps_;
+    // Teapots in the views being rendered, from the model space bounding
+    // sphere, center and radius. The loop draws with the model views of the
+    // visible teapots gathered.
+    leia_helper::FrustumCuller culler_;
+    GLfloat teapot_bounds_[4];
+    leia_helper::MatrixBuffer visible_model_views_;
+    int64_t culled_teapots_;
+    int64_t teapot_view_draws_;
+    leia_helper::CPU_ISA transform_isa_;
 
     ndk_helper::TapCamera *camera_;
 
@@ -121,7 +179,74 @@ class MoreTeapotsRenderer {
 
     GLuint checkerboard_texture;
 
+    // Single pass multiview (GL_OVR_multiview2) resources
+    leia_helper::MultiviewTarget multiview_target_;
+    leia_helper::ViewIndexMap view_index_map_;
+    GLuint multiview_dof_program_;
+    GLuint multiview_interlace_program_;
+    GLuint multiview_interlace_sharpen_program_;
+    GLuint multiview_interlace_dof_program_;
+    bool render_with_multiview_ext_;
+    bool using_fused_interlace_sharpening_;
+    // Depth of field evaluated by the interlacer, no depth of field pass
+    bool using_folded_dof_;
+
+    // All views in one framebuffer, used instead of the per view
+    // framebuffers when GL_OVR_multiview2 is not available
+    leia_helper::ViewAtlas view_atlas_;
+    leia_helper::ATTACHMENT_POLICY attachment_policy_;
+    GLuint atlas_dof_program_;
+    GLuint atlas_interlace_program_;
+    GLuint atlas_interlace_sharpen_program_;
+    GLuint atlas_interlace_dof_program_;
+    bool using_view_atlas_;
+
+    // Views synthesized from one or two rendered views on the atlas path
+    leia_helper::ViewSynthesisTarget view_synthesis_target_;
+    GLuint view_synthesis_program_;
+    leia_helper::VIEW_SYNTHESIS_MODE view_synthesis_mode_;
+
+    // CPU time spent in RenderViews(), per path
+    enum RENDER_PATH {
+        RENDER_PATH_PER_VIEW,
+        RENDER_PATH_MULTIVIEW,
+        RENDER_PATH_MULTIVIEW_FUSED,
+        RENDER_PATH_MULTIVIEW_FOLDED_DOF,
+        RENDER_PATH_ATLAS,
+        RENDER_PATH_ATLAS_FUSED,
+        RENDER_PATH_ATLAS_FOLDED_DOF,
+        RENDER_PATH_COUNT
+    };
+    double render_views_time_[RENDER_PATH_COUNT];
+    int32_t render_views_frames_[RENDER_PATH_COUNT];
+
     bool using_simple_leia_rendering_api;
+
+    void RenderViewsMultiview();
+
+    void RenderViewsAtlas();
+
+    bool RenderViewSynthesisSources();
+
+    void UpdateViewMVPs(const float *projections, int32_t projection_stride,
+                        int32_t num_views);
+
+    void CullTeapots(const float *projections, int32_t projection_stride, int32_t num_views);
+
+    void UploadInstances(bool per_view);
+
+    void BindInstances(int32_t first);
+
+    void RenderViewInstanced(int32_t view);
+
+    void UpdateViewIndexMap();
+    void SharpenFullscreen();
+
+    // Per frame camera and lighting uniforms of the multiview and post programs
+    leia_helper::CameraBuffer camera_buffer_;
+    void UpdateCameraBlock();
+
+    void LogRenderViewsTime(RENDER_PATH path, double elapsed);
 public:
     MoreTeapotsRenderer();
 
@@ -133,9 +258,13 @@ public:
 
     void PrepareRenderTargetSurfaces();
 
+    void ReleaseSurfaces();
+
     void RenderViews(bool is_backlight_still_on);
 
-    void RenderView(unsigned int x, unsigned int y, bool use_leia);
+    void RenderView(int32_t view);
+
+    void RenderViewMultiview();
 
     void Update(float dTime, bool render_with_multiview_ext);
 
@@ -145,10 +274,10 @@ public:
 
     void UpdateViewport();
 
-    GLuint CreateTexture(int width, int height, GLint internal_format,
-                         GLenum format, GLenum type, void *data);
+    void SetViewSynthesisMode(leia_helper::VIEW_SYNTHESIS_MODE mode);
 
-    void DrawTexturedQuad(GLint shader_id);
+    GLuint AcquireTexture(int width, int height, GLint internal_format,
+                          GLenum format, GLenum type, void *data);
 };
 
 #define CHECK_GL_ERROR() \